@@ -266,6 +266,19 @@ int ogs_app_context_parse_config(void)
                 } else if (!strcmp(logger_key, "domain")) {
                     self.logger.domain =
                         ogs_yaml_iter_value(&logger_iter);
+                } else if (!strcmp(logger_key, "async")) {
+                    ogs_yaml_iter_t async_iter;
+                    ogs_yaml_iter_recurse(&logger_iter, &async_iter);
+                    while (ogs_yaml_iter_next(&async_iter)) {
+                        const char *async_key =
+                            ogs_yaml_iter_key(&async_iter);
+                        ogs_assert(async_key);
+                        if (!strcmp(async_key, "lines")) {
+                            const char *v = ogs_yaml_iter_value(&async_iter);
+                            if (v) self.logger.async_lines = atoi(v);
+                        } else
+                            ogs_warn("unknown key `%s`", async_key);
+                    }
                 }
             }
         } else if (!strcmp(root_key, "parameter")) {
@@ -350,6 +363,9 @@ int ogs_app_context_parse_config(void)
                 } else if (!strcmp(parameter_key, "no_pfcp_rr_select")) {
                     self.parameter.no_pfcp_rr_select =
                         ogs_yaml_iter_bool(&parameter_iter);
+                } else if (!strcmp(parameter_key, "timer_wheel")) {
+                    self.parameter.timer_wheel =
+                        ogs_yaml_iter_bool(&parameter_iter);
                 } else if (!strcmp(parameter_key,
                             "use_mongodb_change_stream")) {
 #if MONGOC_MAJOR_VERSION >= 1 && MONGOC_MINOR_VERSION >= 9
@@ -47,6 +47,7 @@ typedef struct ogs_app_context_s {
         const char *file;
         const char *level;
         const char *domain;
+        int async_lines;    /* 0: write in the calling thread */
     } logger;
 
     ogs_queue_t *queue;
@@ -85,6 +86,8 @@ typedef struct ogs_app_context_s {
         int no_ipv4v6_local_addr_in_packet_filter;
 
         int no_pfcp_rr_select;
+
+        int timer_wheel;
     } parameter;
 
     struct {
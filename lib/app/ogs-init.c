@@ -110,6 +110,11 @@ int ogs_app_initialize(
             ogs_app()->logger.domain, ogs_app()->logger.level);
     if (rv != OGS_OK) return rv;
 
+    if (ogs_app()->logger.async_lines > 0) {
+        rv = ogs_log_async_start(ogs_app()->logger.async_lines);
+        if (rv != OGS_OK) return rv;
+    }
+
     /**************************************************************************
      * Stage 5 : Setup Database Module
      */
@@ -141,7 +146,9 @@ int ogs_app_initialize(
      */
     ogs_app()->queue = ogs_queue_create(ogs_app()->pool.event);
     ogs_assert(ogs_app()->queue);
-    ogs_app()->timer_mgr = ogs_timer_mgr_create(ogs_app()->pool.timer);
+    ogs_app()->timer_mgr = ogs_timer_mgr_create_type(ogs_app()->pool.timer,
+            ogs_app()->parameter.timer_wheel ?
+                OGS_TIMER_MGR_WHEEL : OGS_TIMER_MGR_RBTREE);
     ogs_assert(ogs_app()->timer_mgr);
     ogs_app()->pollset = ogs_pollset_create(ogs_app()->pool.socket);
     ogs_assert(ogs_app()->pollset);
@@ -151,8 +158,11 @@ int ogs_app_initialize(
 
 void ogs_app_terminate(void)
 {
+    ogs_log_async_stop();
+
     ogs_app_context_final();
 
+    ogs_pkbuf_log_stats();
     ogs_pkbuf_default_destroy();
 
     ogs_core_terminate();
@@ -46,3 +46,4 @@ asn__format_to_callback(int (*cb)(const void *, size_t, void *key), void *key,
     return wrote;
 }
 
+__thread ogs_arena_t *ogs_asn_arena;
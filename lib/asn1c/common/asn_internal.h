@@ -42,9 +42,25 @@ int get_asn1c_environment_version(void);	/* Run-time version */
 #else
 #include "proto/ogs-proto.h"
 
+/*
+ * While a decoder runs with ogs_asn_arena set (see ogs_asn_decode_arena()),
+ * the IEs are carved out of that arena instead of the heap. Anything the
+ * arena refuses falls back to the heap, so FREEMEM() only frees pointers
+ * the current arena does not own.
+ */
+extern __thread ogs_arena_t *ogs_asn_arena;
+
 static ogs_inline void *ogs_asn_malloc(size_t size, const char *file_line)
 {
-    void *ptr = ogs_malloc(size);
+    void *ptr = NULL;
+
+    if (ogs_asn_arena) {
+        ptr = ogs_arena_alloc(ogs_asn_arena, size);
+        if (ptr)
+            return ptr;
+    }
+
+    ptr = ogs_malloc(size);
     if (!ptr) {
         ogs_fatal("asn_malloc() failed in `%s`", file_line);
         ogs_assert_if_reached();
@@ -55,7 +71,15 @@ static ogs_inline void *ogs_asn_malloc(size_t size, const char *file_line)
 static ogs_inline void *ogs_asn_calloc(
         size_t nmemb, size_t size, const char *file_line)
 {
-    void *ptr = ogs_calloc(nmemb, size);
+    void *ptr = NULL;
+
+    if (ogs_asn_arena) {
+        ptr = ogs_arena_calloc(ogs_asn_arena, nmemb, size);
+        if (ptr)
+            return ptr;
+    }
+
+    ptr = ogs_calloc(nmemb, size);
     if (!ptr) {
         ogs_fatal("asn_calloc() failed in `%s`", file_line);
         ogs_assert_if_reached();
@@ -66,7 +90,27 @@ static ogs_inline void *ogs_asn_calloc(
 static ogs_inline void *ogs_asn_realloc(
         void *oldptr, size_t size, const char *file_line)
 {
-    void *ptr = ogs_realloc(oldptr, size);
+    void *ptr = NULL;
+
+    if (ogs_asn_arena && (!oldptr || ogs_arena_owns(ogs_asn_arena, oldptr))) {
+        ptr = ogs_arena_realloc(ogs_asn_arena, oldptr, size);
+        if (ptr)
+            return ptr;
+
+        /* Move an arena block that can no longer grow to the heap */
+        if (oldptr) {
+            ptr = ogs_malloc(size);
+            if (!ptr) {
+                ogs_fatal("asn_realloc() failed in `%s`", file_line);
+                ogs_assert_if_reached();
+            }
+            memcpy(ptr, oldptr, ogs_min(size, ogs_arena_size_of(oldptr)));
+
+            return ptr;
+        }
+    }
+
+    ptr = ogs_realloc(oldptr, size);
     if (!ptr) {
         ogs_fatal("asn_realloc() failed in `%s`", file_line);
         ogs_assert_if_reached();
@@ -74,11 +118,18 @@ static ogs_inline void *ogs_asn_realloc(
 
     return ptr;
 }
+static ogs_inline void ogs_asn_freemem(void *ptr)
+{
+    if (ogs_asn_arena && ptr && ogs_arena_owns(ogs_asn_arena, ptr))
+        return;
+
+    ogs_free(ptr);
+}
 
 #define CALLOC(nmemb, size) ogs_asn_calloc(nmemb, size, OGS_FILE_LINE)
 #define MALLOC(size) ogs_asn_malloc(size, OGS_FILE_LINE)
 #define REALLOC(oldptr, size) ogs_asn_realloc(oldptr, size, OGS_FILE_LINE)
-#define FREEMEM(ptr) ogs_free(ptr)
+#define FREEMEM(ptr) ogs_asn_freemem(ptr)
 
 #endif
 
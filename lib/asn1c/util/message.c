@@ -19,32 +19,39 @@
 
 #include "message.h"
 
+/*
+ * PDUs are encoded into a per-thread scratch buffer and then copied into a
+ * pkbuf of the encoded size, so that a short PDU held in an SCTP queue or
+ * in a retransmission slot does not pin an OGS_MAX_SDU_LEN cluster.
+ */
+static __thread uint8_t encode_buffer[OGS_MAX_SDU_LEN];
+
 ogs_pkbuf_t *ogs_asn_encode(const asn_TYPE_descriptor_t *td, void *sptr)
 {
     asn_enc_rval_t enc_ret = {0};
     ogs_pkbuf_t *pkbuf = NULL;
+    size_t size;
 
     ogs_assert(td);
     ogs_assert(sptr);
 
-    pkbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
-    if (!pkbuf) {
-        ogs_error("ogs_pkbuf_alloc() failed");
-        return NULL;
-    }
-    ogs_pkbuf_put(pkbuf, OGS_MAX_SDU_LEN);
-
     enc_ret = aper_encode_to_buffer(td, NULL,
-                    sptr, pkbuf->data, OGS_MAX_SDU_LEN);
+                    sptr, encode_buffer, sizeof(encode_buffer));
     ogs_asn_free(td, sptr);
 
     if (enc_ret.encoded < 0) {
         ogs_error("Failed to encode ASN-PDU [%d]", (int)enc_ret.encoded);
-        ogs_pkbuf_free(pkbuf);
         return NULL;
     }
 
-    ogs_pkbuf_trim(pkbuf, ((enc_ret.encoded + 7) >> 3));
+    size = (enc_ret.encoded + 7) >> 3;
+
+    pkbuf = ogs_pkbuf_alloc(NULL, size);
+    if (!pkbuf) {
+        ogs_error("ogs_pkbuf_alloc() failed");
+        return NULL;
+    }
+    ogs_pkbuf_put_data(pkbuf, encode_buffer, size);
 
     return pkbuf;
 }
@@ -81,3 +88,41 @@ void ogs_asn_free(const asn_TYPE_descriptor_t *td, void *sptr)
 
     ASN_STRUCT_FREE_CONTENTS_ONLY(*td, sptr);
 }
+
+int ogs_asn_decode_arena(const asn_TYPE_descriptor_t *td,
+        void *struct_ptr, size_t struct_size, ogs_pkbuf_t *pkbuf,
+        ogs_arena_t *arena)
+{
+    ogs_arena_t *saved = ogs_asn_arena;
+    int rv;
+
+    ogs_asn_arena = arena;
+    rv = ogs_asn_decode(td, struct_ptr, struct_size, pkbuf);
+    ogs_asn_arena = saved;
+
+    return rv;
+}
+
+void ogs_asn_free_arena(const asn_TYPE_descriptor_t *td, void *sptr,
+        ogs_arena_t *arena)
+{
+    ogs_arena_t *saved = ogs_asn_arena;
+
+    if (!arena) {
+        ogs_asn_free(td, sptr);
+        return;
+    }
+
+    /*
+     * If the arena never refused an allocation, every IE lives in it and
+     * there is nothing to walk. Otherwise free the structure as usual;
+     * FREEMEM() skips what the arena owns and releases the heap part.
+     */
+    if (ogs_arena_exhausted(arena)) {
+        ogs_asn_arena = arena;
+        ogs_asn_free(td, sptr);
+        ogs_asn_arena = saved;
+    }
+
+    ogs_arena_reset(arena);
+}
@@ -34,6 +34,23 @@ int ogs_asn_decode(const asn_TYPE_descriptor_t *td,
         void *struct_ptr, size_t struct_size, ogs_pkbuf_t *pkbuf);
 void ogs_asn_free(const asn_TYPE_descriptor_t *td, void *sptr);
 
+/*
+ * Same as ogs_asn_decode()/ogs_asn_free(), but the IEs are taken from
+ * the given arena. Whatever does not fit is allocated from the heap,
+ * and ogs_asn_free_arena() releases both, resetting the arena. The
+ * decoded structure must not be modified in between, and the arena must
+ * not be shared by two messages at the same time. A NULL arena falls
+ * back to the plain functions.
+ */
+#define OGS_ASN_ARENA_CHUNK_SIZE    (8*1024)
+#define OGS_ASN_ARENA_MAX_SIZE      (64*1024)
+
+int ogs_asn_decode_arena(const asn_TYPE_descriptor_t *td,
+        void *struct_ptr, size_t struct_size, ogs_pkbuf_t *pkbuf,
+        ogs_arena_t *arena);
+void ogs_asn_free_arena(const asn_TYPE_descriptor_t *td, void *sptr,
+        ogs_arena_t *arena);
+
 #ifdef __cplusplus
 }
 #endif
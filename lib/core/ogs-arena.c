@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ogs-core.h"
+
+#define ARENA_ALIGN         8
+#define ARENA_ALIGN_UP(__sIZE) \
+    (((__sIZE) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+
+/* Every allocation is preceded by its size so that realloc can copy */
+#define ARENA_HDR_SIZE      ARENA_ALIGN_UP(sizeof(uint64_t))
+
+typedef struct arena_chunk_s {
+    struct arena_chunk_s *next;
+    uint8_t         *base;
+    size_t          size;
+    size_t          pos;
+} arena_chunk_t;
+
+#define CHUNK_HDR_SIZE      ARENA_ALIGN_UP(sizeof(arena_chunk_t))
+
+struct ogs_arena_s {
+    /*
+     * The first chunk shares the allocation of the arena itself and is
+     * never released before ogs_arena_destroy(). head is the chunk being
+     * filled; oversized chunks are linked in behind it.
+     */
+    arena_chunk_t   first;
+    arena_chunk_t   *head;
+
+    size_t          chunk_size;
+    size_t          max_size;
+    size_t          total;          /* Bytes of chunks currently held */
+
+    void            *last;          /* Most recent allocation */
+    arena_chunk_t   *last_chunk;
+
+    size_t          used;
+    unsigned int    num_of_alloc;
+    bool            exhausted;
+};
+
+#define ARENA_SIZE          ARENA_ALIGN_UP(sizeof(ogs_arena_t))
+
+ogs_arena_t *ogs_arena_create(size_t chunk_size, size_t max_size)
+{
+    ogs_arena_t *arena = NULL;
+
+    ogs_assert(chunk_size);
+    chunk_size = ARENA_ALIGN_UP(chunk_size);
+    ogs_assert(max_size >= chunk_size);
+
+    arena = ogs_malloc(ARENA_SIZE + chunk_size);
+    if (!arena) {
+        ogs_error("ogs_malloc() failed");
+        return NULL;
+    }
+    memset(arena, 0, sizeof(*arena));
+
+    arena->first.base = (uint8_t *)arena + ARENA_SIZE;
+    arena->first.size = chunk_size;
+    arena->head = &arena->first;
+
+    arena->chunk_size = chunk_size;
+    arena->max_size = max_size;
+    arena->total = chunk_size;
+
+    return arena;
+}
+
+static void free_chunks(ogs_arena_t *arena)
+{
+    arena_chunk_t *chunk = NULL, *next = NULL;
+
+    for (chunk = arena->first.next; chunk; chunk = next) {
+        next = chunk->next;
+        ogs_free(chunk);
+    }
+    arena->first.next = NULL;
+}
+
+void ogs_arena_destroy(ogs_arena_t *arena)
+{
+    ogs_assert(arena);
+
+    free_chunks(arena);
+    ogs_free(arena);
+}
+
+static arena_chunk_t *add_chunk(ogs_arena_t *arena, size_t need)
+{
+    arena_chunk_t *chunk = NULL;
+    size_t size = ogs_max(arena->chunk_size, need);
+
+    if (size > arena->max_size - arena->total) {
+        arena->exhausted = true;
+        return NULL;
+    }
+
+    chunk = ogs_malloc(CHUNK_HDR_SIZE + size);
+    if (!chunk) {
+        ogs_error("ogs_malloc() failed");
+        arena->exhausted = true;
+        return NULL;
+    }
+
+    chunk->base = (uint8_t *)chunk + CHUNK_HDR_SIZE;
+    chunk->size = size;
+    chunk->pos = 0;
+    arena->total += size;
+
+    /*
+     * A chunk sized for a single large object is filled on the spot;
+     * keep allocating from the current head instead of wasting it.
+     */
+    chunk->next = arena->head->next;
+    arena->head->next = chunk;
+    if (size <= arena->chunk_size)
+        arena->head = chunk;
+
+    return chunk;
+}
+
+void *ogs_arena_alloc(ogs_arena_t *arena, size_t size)
+{
+    arena_chunk_t *chunk = NULL;
+    uint8_t *ptr = NULL;
+    size_t need;
+
+    ogs_assert(arena);
+
+    if (size > arena->max_size) {
+        arena->exhausted = true;
+        return NULL;
+    }
+    need = ARENA_HDR_SIZE + ARENA_ALIGN_UP(size);
+
+    chunk = arena->head;
+    if (ogs_unlikely(need > chunk->size - chunk->pos)) {
+        chunk = add_chunk(arena, need);
+        if (!chunk)
+            return NULL;
+    }
+
+    ptr = chunk->base + chunk->pos;
+    *(uint64_t *)ptr = size;
+    ptr += ARENA_HDR_SIZE;
+    chunk->pos += need;
+
+    arena->last = ptr;
+    arena->last_chunk = chunk;
+    arena->used += size;
+    arena->num_of_alloc++;
+
+    return ptr;
+}
+
+void *ogs_arena_calloc(ogs_arena_t *arena, size_t nmemb, size_t size)
+{
+    void *ptr = NULL;
+
+    ogs_assert(arena);
+
+    if (size && nmemb > arena->max_size / size) {
+        arena->exhausted = true;
+        return NULL;
+    }
+
+    ptr = ogs_arena_alloc(arena, nmemb * size);
+    if (ptr)
+        memset(ptr, 0, nmemb * size);
+
+    return ptr;
+}
+
+void *ogs_arena_realloc(ogs_arena_t *arena, void *ptr, size_t size)
+{
+    arena_chunk_t *chunk = NULL;
+    uint64_t *hdr = NULL;
+    size_t offset;
+    void *new = NULL;
+
+    ogs_assert(arena);
+
+    if (!ptr)
+        return ogs_arena_alloc(arena, size);
+    if (size > arena->max_size) {
+        arena->exhausted = true;
+        return NULL;
+    }
+
+    hdr = (uint64_t *)((uint8_t *)ptr - ARENA_HDR_SIZE);
+
+    /* The most recent allocation can grow or shrink in place */
+    if (ptr == arena->last) {
+        chunk = arena->last_chunk;
+        offset = (uint8_t *)ptr - chunk->base;
+        if (ARENA_ALIGN_UP(size) <= chunk->size - offset) {
+            chunk->pos = offset + ARENA_ALIGN_UP(size);
+            arena->used = arena->used - (size_t)*hdr + size;
+            *hdr = size;
+            return ptr;
+        }
+    }
+
+    if (size <= *hdr)
+        return ptr;
+
+    new = ogs_arena_alloc(arena, size);
+    if (new)
+        memcpy(new, ptr, (size_t)*hdr);
+
+    return new;
+}
+
+size_t ogs_arena_size_of(const void *ptr)
+{
+    ogs_assert(ptr);
+    return (size_t)*(const uint64_t *)((const uint8_t *)ptr - ARENA_HDR_SIZE);
+}
+
+bool ogs_arena_owns(ogs_arena_t *arena, const void *ptr)
+{
+    arena_chunk_t *chunk = NULL;
+    const uint8_t *p = ptr;
+
+    ogs_assert(arena);
+
+    for (chunk = &arena->first; chunk; chunk = chunk->next)
+        if (p >= chunk->base && p < chunk->base + chunk->size)
+            return true;
+
+    return false;
+}
+
+void ogs_arena_reset(ogs_arena_t *arena)
+{
+    ogs_assert(arena);
+
+    free_chunks(arena);
+
+    arena->first.pos = 0;
+    arena->head = &arena->first;
+    arena->total = arena->first.size;
+
+    arena->last = NULL;
+    arena->last_chunk = NULL;
+
+    arena->used = 0;
+    arena->num_of_alloc = 0;
+    arena->exhausted = false;
+}
+
+size_t ogs_arena_used(ogs_arena_t *arena)
+{
+    ogs_assert(arena);
+    return arena->used;
+}
+
+unsigned int ogs_arena_num_of_alloc(ogs_arena_t *arena)
+{
+    ogs_assert(arena);
+    return arena->num_of_alloc;
+}
+
+bool ogs_arena_exhausted(ogs_arena_t *arena)
+{
+    ogs_assert(arena);
+    return arena->exhausted;
+}
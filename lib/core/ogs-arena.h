@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(OGS_CORE_INSIDE) && !defined(OGS_CORE_COMPILATION)
+#error "This header cannot be included directly."
+#endif
+
+#ifndef OGS_ARENA_H
+#define OGS_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bump allocator for short-lived object graphs.
+ *
+ * Allocations are carved out of a list of chunks and are never freed one
+ * by one; ogs_arena_reset() drops everything at once and keeps the first
+ * chunk for the next round, so a steady workload stops touching the heap.
+ * An arena never grows beyond max_size bytes of chunks: past that point
+ * ogs_arena_alloc() returns NULL and the caller is expected to fall back
+ * to the heap. Every allocation is 8-byte aligned.
+ *
+ * An arena is not thread-safe. Use one per thread, or one per message
+ * when the object graph is handed over to another thread.
+ */
+typedef struct ogs_arena_s ogs_arena_t;
+
+ogs_arena_t *ogs_arena_create(size_t chunk_size, size_t max_size);
+void ogs_arena_destroy(ogs_arena_t *arena);
+
+void *ogs_arena_alloc(ogs_arena_t *arena, size_t size);
+void *ogs_arena_calloc(ogs_arena_t *arena, size_t nmemb, size_t size);
+void *ogs_arena_realloc(ogs_arena_t *arena, void *ptr, size_t size);
+size_t ogs_arena_size_of(const void *ptr);
+
+bool ogs_arena_owns(ogs_arena_t *arena, const void *ptr);
+void ogs_arena_reset(ogs_arena_t *arena);
+
+/* Bytes handed out and number of allocations since the last reset */
+size_t ogs_arena_used(ogs_arena_t *arena);
+unsigned int ogs_arena_num_of_alloc(ogs_arena_t *arena);
+
+/* True once an allocation has been refused since the last reset */
+bool ogs_arena_exhausted(ogs_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* OGS_ARENA_H */
@@ -24,7 +24,9 @@
 
 #define OGS_CORE_INSIDE
 
+#ifndef OGS_USE_TALLOC
 #define OGS_USE_TALLOC 1
+#endif
 
 #include "core/ogs-compat.h"
 #include "core/ogs-macros.h"
@@ -60,6 +62,8 @@
 #include "core/ogs-env.h"
 #include "core/ogs-fsm.h"
 #include "core/ogs-hash.h"
+#include "core/ogs-flatmap.h"
+#include "core/ogs-arena.h"
 #include "core/ogs-misc.h"
 #include "core/ogs-getopt.h"
 #include "core/ogs-file.h"
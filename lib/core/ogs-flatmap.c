@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ogs-core.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Control bytes: EMPTY and DELETED have the top bit set, a full slot
+ * holds the low 7 bits of the key hash (H2). The remaining hash bits
+ * (H1) select the first group to probe.
+ */
+#define CTRL_EMPTY          ((uint8_t)0x80)
+#define CTRL_DELETED        ((uint8_t)0xfe)
+
+#define GROUP_WIDTH         16
+#define INITIAL_CAPACITY    GROUP_WIDTH
+
+/* Rehash once 7/8 of the slots are either full or tombstones */
+#define MAX_LOAD(__cAP)     ((__cAP) - (__cAP) / 8)
+
+struct ogs_flatmap_s {
+    uint8_t         *ctrl;
+    uint8_t         *keys;
+    void            **vals;
+
+    size_t          key_size;
+    uint32_t        capacity;       /* power of two, >= GROUP_WIDTH */
+    uint32_t        count;
+    uint32_t        growth_left;    /* EMPTY slots we may still consume */
+
+    uint64_t        seed;
+};
+
+#if defined(__SSE2__)
+static ogs_inline uint32_t group_match(const uint8_t *group, uint8_t h2)
+{
+    __m128i ctrl = _mm_load_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_set1_epi8((char)h2), ctrl));
+}
+
+static ogs_inline uint32_t group_match_empty(const uint8_t *group)
+{
+    return group_match(group, CTRL_EMPTY);
+}
+
+static ogs_inline uint32_t group_match_empty_or_deleted(const uint8_t *group)
+{
+    __m128i ctrl = _mm_load_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(ctrl);
+}
+#else
+static ogs_inline uint32_t group_match(const uint8_t *group, uint8_t h2)
+{
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < GROUP_WIDTH; i++)
+        if (group[i] == h2)
+            mask |= 1u << i;
+
+    return mask;
+}
+
+static ogs_inline uint32_t group_match_empty(const uint8_t *group)
+{
+    return group_match(group, CTRL_EMPTY);
+}
+
+static ogs_inline uint32_t group_match_empty_or_deleted(const uint8_t *group)
+{
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < GROUP_WIDTH; i++)
+        if (group[i] & 0x80)
+            mask |= 1u << i;
+
+    return mask;
+}
+#endif
+
+static ogs_inline uint64_t fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+/*
+ * key_size is a literal at every call site below, so the compiler folds
+ * the switch and emits one specialized probe loop per key width.
+ */
+static ogs_inline uint64_t key_hash(
+        const void *key, size_t key_size, uint64_t seed)
+{
+    uint32_t k32;
+    uint64_t k64[2];
+
+    switch (key_size) {
+    case 4:
+        memcpy(&k32, key, 4);
+        return fmix64(seed ^ k32);
+    case 8:
+        memcpy(&k64[0], key, 8);
+        return fmix64(seed ^ k64[0]);
+    case 16:
+        memcpy(k64, key, 16);
+        return fmix64(fmix64(seed ^ k64[0]) ^ k64[1]);
+    default:
+        return ogs_hash_xxh64(key, key_size, seed);
+    }
+}
+
+static ogs_inline int key_equal(const void *a, const void *b, size_t key_size)
+{
+    uint32_t a32, b32;
+    uint64_t a64[2], b64[2];
+
+    switch (key_size) {
+    case 4:
+        memcpy(&a32, a, 4);
+        memcpy(&b32, b, 4);
+        return a32 == b32;
+    case 8:
+        memcpy(&a64[0], a, 8);
+        memcpy(&b64[0], b, 8);
+        return a64[0] == b64[0];
+    case 16:
+        memcpy(a64, a, 16);
+        memcpy(b64, b, 16);
+        return ((a64[0] ^ b64[0]) | (a64[1] ^ b64[1])) == 0;
+    default:
+        return memcmp(a, b, key_size) == 0;
+    }
+}
+
+static ogs_inline int find_index(const ogs_flatmap_t *map,
+        const void *key, size_t key_size, uint64_t hash)
+{
+    uint32_t group_mask = map->capacity / GROUP_WIDTH - 1;
+    uint32_t group = (uint32_t)(hash >> 7) & group_mask;
+    uint8_t h2 = (uint8_t)(hash & 0x7f);
+    uint32_t step = 0;
+
+    for ( ;; ) {
+        const uint8_t *ctrl = map->ctrl + group * GROUP_WIDTH;
+        uint32_t match = group_match(ctrl, h2);
+
+        while (match) {
+            uint32_t index = group * GROUP_WIDTH + __builtin_ctz(match);
+            if (key_equal(map->keys + (size_t)index * key_size,
+                        key, key_size))
+                return index;
+            match &= match - 1;
+        }
+
+        /* An EMPTY slot ends every probe sequence that reached it */
+        if (group_match_empty(ctrl))
+            return -1;
+
+        /* Triangular probing visits every group of a power-of-two table */
+        step++;
+        group = (group + step) & group_mask;
+    }
+}
+
+static uint32_t find_insert_index(const ogs_flatmap_t *map, uint64_t hash)
+{
+    uint32_t group_mask = map->capacity / GROUP_WIDTH - 1;
+    uint32_t group = (uint32_t)(hash >> 7) & group_mask;
+    uint32_t step = 0;
+
+    for ( ;; ) {
+        uint32_t match = group_match_empty_or_deleted(
+                map->ctrl + group * GROUP_WIDTH);
+        if (match)
+            return group * GROUP_WIDTH + __builtin_ctz(match);
+
+        step++;
+        group = (group + step) & group_mask;
+    }
+}
+
+static void alloc_table(ogs_flatmap_t *map, uint32_t capacity)
+{
+    ogs_assert(capacity >= GROUP_WIDTH);
+    ogs_assert((capacity & (capacity - 1)) == 0);
+
+    /*
+     * _mm_load_si128() needs 16-byte aligned groups; ogs_malloc() only
+     * promises pointer alignment, so over-allocate and align by hand
+     * through a header that remembers the original pointer.
+     */
+    map->ctrl = ogs_malloc(capacity + GROUP_WIDTH + sizeof(void *));
+    ogs_assert(map->ctrl);
+    {
+        uint8_t *raw = map->ctrl;
+        uintptr_t aligned = ((uintptr_t)raw + sizeof(void *) +
+                GROUP_WIDTH - 1) & ~(uintptr_t)(GROUP_WIDTH - 1);
+        memcpy((uint8_t *)aligned - sizeof(void *), &raw, sizeof(void *));
+        map->ctrl = (uint8_t *)aligned;
+    }
+    memset(map->ctrl, CTRL_EMPTY, capacity);
+
+    map->keys = ogs_malloc((size_t)capacity * map->key_size);
+    ogs_assert(map->keys);
+    map->vals = ogs_malloc((size_t)capacity * sizeof(void *));
+    ogs_assert(map->vals);
+
+    map->capacity = capacity;
+    map->growth_left = MAX_LOAD(capacity);
+}
+
+static void free_table(ogs_flatmap_t *map)
+{
+    uint8_t *raw = NULL;
+
+    memcpy(&raw, map->ctrl - sizeof(void *), sizeof(void *));
+    ogs_free(raw);
+    ogs_free(map->keys);
+    ogs_free(map->vals);
+}
+
+static void rehash(ogs_flatmap_t *map)
+{
+    ogs_flatmap_t old = *map;
+    uint32_t capacity = map->capacity;
+    uint32_t i;
+
+    /* Grow when mostly full, otherwise rebuild in place to drop tombstones */
+    if ((uint64_t)map->count * 16 >= (uint64_t)capacity * 7)
+        capacity *= 2;
+
+    alloc_table(map, capacity);
+
+    for (i = 0; i < old.capacity; i++) {
+        uint32_t index;
+        uint64_t hash;
+        const uint8_t *key;
+
+        if (old.ctrl[i] & 0x80)
+            continue;
+
+        key = old.keys + (size_t)i * old.key_size;
+        hash = key_hash(key, map->key_size, map->seed);
+        index = find_insert_index(map, hash);
+
+        map->ctrl[index] = (uint8_t)(hash & 0x7f);
+        memcpy(map->keys + (size_t)index * map->key_size, key, map->key_size);
+        map->vals[index] = old.vals[i];
+        map->growth_left--;
+    }
+
+    free_table(&old);
+}
+
+ogs_flatmap_t *ogs_flatmap_create(size_t key_size)
+{
+    ogs_flatmap_t *map = NULL;
+    ogs_time_t now = ogs_get_monotonic_time();
+
+    ogs_assert(key_size);
+
+    map = ogs_calloc(1, sizeof(*map));
+    if (!map) {
+        ogs_error("ogs_calloc() failed");
+        return NULL;
+    }
+
+    map->key_size = key_size;
+    map->seed = fmix64((uint64_t)now ^ (uintptr_t)map);
+    alloc_table(map, INITIAL_CAPACITY);
+
+    return map;
+}
+
+void ogs_flatmap_destroy(ogs_flatmap_t *map)
+{
+    ogs_assert(map);
+
+    free_table(map);
+    ogs_free(map);
+}
+
+static int lookup(const ogs_flatmap_t *map, const void *key, uint64_t *hash)
+{
+    switch (map->key_size) {
+    case 4:
+        *hash = key_hash(key, 4, map->seed);
+        return find_index(map, key, 4, *hash);
+    case 8:
+        *hash = key_hash(key, 8, map->seed);
+        return find_index(map, key, 8, *hash);
+    case 16:
+        *hash = key_hash(key, 16, map->seed);
+        return find_index(map, key, 16, *hash);
+    default:
+        *hash = key_hash(key, map->key_size, map->seed);
+        return find_index(map, key, map->key_size, *hash);
+    }
+}
+
+void ogs_flatmap_set(ogs_flatmap_t *map, const void *key, const void *val)
+{
+    uint64_t hash;
+    uint32_t index;
+    int found;
+
+    ogs_assert(map);
+    ogs_assert(key);
+
+    found = lookup(map, key, &hash);
+
+    if (found >= 0) {
+        if (val) {
+            map->vals[found] = (void *)val;
+            return;
+        }
+
+        /*
+         * A probe only walks past a group that has no EMPTY slot. If this
+         * group already has one, nobody probes through it and the slot
+         * can go straight back to EMPTY; otherwise leave a tombstone.
+         */
+        if (group_match_empty(map->ctrl +
+                    (found & ~(GROUP_WIDTH - 1)))) {
+            map->ctrl[found] = CTRL_EMPTY;
+            map->growth_left++;
+        } else {
+            map->ctrl[found] = CTRL_DELETED;
+        }
+        map->count--;
+        return;
+    }
+
+    if (!val)
+        return;
+
+    index = find_insert_index(map, hash);
+    if (map->growth_left == 0 && map->ctrl[index] == CTRL_EMPTY) {
+        rehash(map);
+        index = find_insert_index(map, hash);
+    }
+
+    if (map->ctrl[index] == CTRL_EMPTY)
+        map->growth_left--;
+
+    map->ctrl[index] = (uint8_t)(hash & 0x7f);
+    memcpy(map->keys + (size_t)index * map->key_size, key, map->key_size);
+    map->vals[index] = (void *)val;
+    map->count++;
+}
+
+void *ogs_flatmap_get(ogs_flatmap_t *map, const void *key)
+{
+    uint64_t hash;
+    int found;
+
+    ogs_assert(map);
+    ogs_assert(key);
+
+    found = lookup(map, key, &hash);
+    if (found < 0)
+        return NULL;
+
+    return map->vals[found];
+}
+
+unsigned int ogs_flatmap_count(ogs_flatmap_t *map)
+{
+    ogs_assert(map);
+    return map->count;
+}
+
+void ogs_flatmap_clear(ogs_flatmap_t *map)
+{
+    ogs_assert(map);
+
+    memset(map->ctrl, CTRL_EMPTY, map->capacity);
+    map->count = 0;
+    map->growth_left = MAX_LOAD(map->capacity);
+}
+
+int ogs_flatmap_do(ogs_flatmap_do_callback_fn_t *comp,
+        void *rec, const ogs_flatmap_t *map)
+{
+    uint32_t i;
+
+    ogs_assert(comp);
+    ogs_assert(map);
+
+    for (i = 0; i < map->capacity; i++) {
+        if (map->ctrl[i] & 0x80)
+            continue;
+        if (!(*comp)(rec, map->keys + (size_t)i * map->key_size,
+                    map->vals[i]))
+            return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(OGS_CORE_INSIDE) && !defined(OGS_CORE_COMPILATION)
+#error "This header cannot be included directly."
+#endif
+
+#ifndef OGS_FLATMAP_H
+#define OGS_FLATMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Open-addressing hash table with fixed-size keys.
+ *
+ * Keys and values are stored inline in flat arrays, and slots are probed
+ * a group of 16 control bytes at a time (SSE2 when available), so a lookup
+ * touches one or two cache lines and an insert never allocates unless
+ * the table has to grow. Keys of 4, 8 and 16 bytes get specialized hash
+ * and compare paths; any other size falls back to xxh64 and memcmp.
+ *
+ * Unlike ogs_hash_t, the key is copied into the table, so the caller's
+ * buffer does not need to outlive the entry. As with ogs_hash_set(),
+ * setting a NULL value removes the key.
+ */
+typedef struct ogs_flatmap_s ogs_flatmap_t;
+
+ogs_flatmap_t *ogs_flatmap_create(size_t key_size);
+void ogs_flatmap_destroy(ogs_flatmap_t *map);
+
+void ogs_flatmap_set(ogs_flatmap_t *map, const void *key, const void *val);
+void *ogs_flatmap_get(ogs_flatmap_t *map, const void *key);
+
+unsigned int ogs_flatmap_count(ogs_flatmap_t *map);
+void ogs_flatmap_clear(ogs_flatmap_t *map);
+
+typedef int (ogs_flatmap_do_callback_fn_t)(
+        void *rec, const void *key, const void *value);
+
+int ogs_flatmap_do(ogs_flatmap_do_callback_fn_t *comp,
+        void *rec, const ogs_flatmap_t *map);
+
+static ogs_inline void ogs_flatmap_set_u32(
+        ogs_flatmap_t *map, uint32_t key, const void *val)
+{
+    ogs_flatmap_set(map, &key, val);
+}
+
+static ogs_inline void *ogs_flatmap_get_u32(ogs_flatmap_t *map, uint32_t key)
+{
+    return ogs_flatmap_get(map, &key);
+}
+
+static ogs_inline void ogs_flatmap_set_u64(
+        ogs_flatmap_t *map, uint64_t key, const void *val)
+{
+    ogs_flatmap_set(map, &key, val);
+}
+
+static ogs_inline void *ogs_flatmap_get_u64(ogs_flatmap_t *map, uint64_t key)
+{
+    return ogs_flatmap_get(map, &key);
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* OGS_FLATMAP_H */
@@ -84,6 +84,13 @@ typedef int (ogs_hash_do_callback_fn_t)(
 int ogs_hash_do(ogs_hash_do_callback_fn_t *comp,
         void *rec, const ogs_hash_t *ht);
 
+/*
+ * 64-bit xxHash (XXH64). Unlike the table hash above it is stable
+ * across processes and hosts, so it can be used to build keys
+ * that are shared with other nodes.
+ */
+uint64_t ogs_hash_xxh64(const void *buf, size_t len, uint64_t seed);
+
 
 #ifdef __cplusplus
 }
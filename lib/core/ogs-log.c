@@ -111,11 +111,57 @@ static char *log_linefeed(char *buf, char *last);
 static void file_writer(
         ogs_log_t *log, ogs_log_level_e level, const char *string);
 
+/*
+ * Held while a log file is reopened and while a line is written to a
+ * file on the calling thread, so that neither the writer thread nor
+ * another caller ever writes to a FILE that is being closed.
+ */
+static ogs_thread_mutex_t file_mutex;
+static void inline_write(
+        ogs_log_t *log, ogs_log_level_e level, const char *string);
+
+#define OGS_LOG_ASYNC_INLINE_LEN    480
+#define OGS_LOG_ASYNC_WAIT          ogs_time_from_msec(100)
+
+typedef struct log_slot_s {
+    uint64_t seq;
+
+    ogs_log_t *log;     /* NULL for the stderr fallback */
+    char *text;         /* malloc()'ed when the line does not fit */
+    char buf[OGS_LOG_ASYNC_INLINE_LEN];
+} log_slot_t;
+
+/* Bounded MPSC ring: any thread pushes, only the writer pops */
+static struct {
+    bool running;
+    bool stopping;
+    bool cycle;
+
+    unsigned int size;
+    log_slot_t *slot;
+    uint64_t tail;      /* next free position, claimed with CAS */
+    uint64_t head;      /* writer only */
+
+    uint64_t dropped;
+    uint64_t reported;  /* writer only */
+
+    bool waiting;
+    ogs_thread_mutex_t mutex;
+    ogs_thread_cond_t cond;
+    ogs_thread_t *thread;
+} async;
+
+static bool async_push(
+        ogs_log_t *log, ogs_log_level_e level, const char *string);
+static void async_write(ogs_log_t *log, const char *string);
+
 void ogs_log_init(void)
 {
     ogs_pool_init(&log_pool, ogs_core()->log.pool);
     ogs_pool_init(&domain_pool, ogs_core()->log.domain_pool);
 
+    ogs_thread_mutex_init(&file_mutex);
+
     ogs_log_add_domain("core", ogs_core()->log.level);
     ogs_log_add_stderr();
 }
@@ -125,6 +171,8 @@ void ogs_log_final(void)
     ogs_log_t *log, *saved_log;
     ogs_log_domain_t *domain, *saved_domain;
 
+    ogs_log_async_stop();
+
     ogs_list_for_each_safe(&log_list, saved_log, log)
         ogs_log_remove(log);
     ogs_pool_final(&log_pool);
@@ -132,12 +180,21 @@ void ogs_log_final(void)
     ogs_list_for_each_safe(&domain_list, saved_domain, domain)
         ogs_log_remove_domain(domain);
     ogs_pool_final(&domain_pool);
+
+    ogs_thread_mutex_destroy(&file_mutex);
 }
 
 void ogs_log_cycle(void)
 {
     ogs_log_t *log = NULL;
 
+    if (__atomic_load_n(&async.running, __ATOMIC_ACQUIRE)) {
+        /* The writer owns the files */
+        __atomic_store_n(&async.cycle, true, __ATOMIC_RELEASE);
+        return;
+    }
+
+    ogs_thread_mutex_lock(&file_mutex);
     ogs_list_for_each(&log_list, log) {
         switch(log->type) {
         case OGS_LOG_FILE_TYPE:
@@ -146,6 +203,7 @@ void ogs_log_cycle(void)
             break;
         }
     }
+    ogs_thread_mutex_unlock(&file_mutex);
 }
 
 ogs_log_t *ogs_log_add_stderr(void)
@@ -426,8 +484,9 @@ void ogs_log_vprintf(ogs_log_level_e level, int id,
                 p = log_linefeed(p, last);
         }
 
-        log->writer(log, level, logstr);
-        
+        if (!async_push(log, level, logstr))
+            inline_write(log, level, logstr);
+
         if (log->type == OGS_LOG_STDERR_TYPE)
             wrote_stderr = 1;
     }
@@ -453,8 +512,10 @@ void ogs_log_vprintf(ogs_log_level_e level, int id,
             p = log_linefeed(p, last);
         }
 
-        fprintf(stderr, "%s", logstr);
-        fflush(stderr);
+        if (!async_push(NULL, level, logstr)) {
+            fprintf(stderr, "%s", logstr);
+            fflush(stderr);
+        }
     }
 }
 
@@ -540,13 +601,18 @@ static int file_cycle(ogs_log_t *log)
 static char *log_timestamp(char *buf, char *last,
         int use_color)
 {
+    /* localtime() and strftime() once a second per thread */
+    static __thread time_t last_sec = -1;
+    static __thread char nowstr[32];
     struct timeval tv;
     struct tm tm;
-    char nowstr[32];
 
     ogs_gettimeofday(&tv);
-    ogs_localtime(tv.tv_sec, &tm);
-    strftime(nowstr, sizeof nowstr, "%m/%d %H:%M:%S", &tm);
+    if (tv.tv_sec != last_sec) {
+        ogs_localtime(tv.tv_sec, &tm);
+        strftime(nowstr, sizeof nowstr, "%m/%d %H:%M:%S", &tm);
+        last_sec = tv.tv_sec;
+    }
 
     buf = ogs_slprintf(buf, last, "%s%s.%03d%s: ",
             use_color ? TA_FGC_GREEN : "",
@@ -623,3 +689,241 @@ static void file_writer(
     fflush(log->file.out);
 }
 
+/*
+ * Writes on the calling thread: in synchronous mode, while the writer
+ * is being stopped, or for an error that found the ring full. The writer
+ * thread may be reopening the files at that moment.
+ */
+static void inline_write(
+        ogs_log_t *log, ogs_log_level_e level, const char *string)
+{
+    if (log->type != OGS_LOG_FILE_TYPE) {
+        log->writer(log, level, string);
+        return;
+    }
+
+    ogs_thread_mutex_lock(&file_mutex);
+    log->writer(log, level, string);
+    ogs_thread_mutex_unlock(&file_mutex);
+}
+
+/*
+ * Returns false when the caller has to write the line itself: the
+ * writer is not running, or the ring is full and the line is an error.
+ */
+static bool async_push(
+        ogs_log_t *log, ogs_log_level_e level, const char *string)
+{
+    log_slot_t *slot = NULL;
+    uint64_t pos, seq;
+    int64_t diff;
+    size_t len;
+
+    if (!__atomic_load_n(&async.running, __ATOMIC_ACQUIRE))
+        return false;
+
+    pos = __atomic_load_n(&async.tail, __ATOMIC_RELAXED);
+    for ( ;; ) {
+        slot = &async.slot[pos & (async.size - 1)];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        diff = (int64_t)seq - (int64_t)pos;
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&async.tail, &pos, pos + 1,
+                        true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            if (level <= OGS_LOG_ERROR)
+                return false;
+
+            __atomic_fetch_add(&async.dropped, 1, __ATOMIC_RELAXED);
+            return true;
+        } else {
+            pos = __atomic_load_n(&async.tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->log = log;
+    slot->text = NULL;
+
+    len = strlen(string);
+    if (len < sizeof(slot->buf)) {
+        memcpy(slot->buf, string, len + 1);
+    } else {
+        slot->text = strdup(string);
+        if (!slot->text)
+            snprintf(slot->buf, sizeof(slot->buf), "%.*s...\n",
+                    (int)sizeof(slot->buf) - 5, string);
+    }
+
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&async.waiting, __ATOMIC_SEQ_CST)) {
+        ogs_thread_mutex_lock(&async.mutex);
+        ogs_thread_cond_signal(&async.cond);
+        ogs_thread_mutex_unlock(&async.mutex);
+    }
+
+    return true;
+}
+
+static void async_write(ogs_log_t *log, const char *string)
+{
+    fputs(string, log ? log->file.out : stderr);
+}
+
+static void async_flush(void)
+{
+    ogs_log_t *log = NULL;
+
+    ogs_list_for_each(&log_list, log)
+        fflush(log->file.out);
+    fflush(stderr);
+}
+
+/* Pops what is in the ring, returns the number of lines written */
+static int async_drain(void)
+{
+    log_slot_t *slot = NULL;
+    uint64_t dropped;
+    char notice[64];
+    int n = 0;
+
+    for ( ;; ) {
+        slot = &async.slot[async.head & (async.size - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != async.head + 1)
+            break;
+
+        if (slot->text) {
+            async_write(slot->log, slot->text);
+            free(slot->text);
+            slot->text = NULL;
+        } else {
+            async_write(slot->log, slot->buf);
+        }
+
+        __atomic_store_n(&slot->seq,
+                async.head + async.size, __ATOMIC_RELEASE);
+        async.head++;
+        n++;
+    }
+
+    dropped = __atomic_load_n(&async.dropped, __ATOMIC_RELAXED);
+    if (dropped != async.reported) {
+        ogs_log_t *log = NULL;
+
+        snprintf(notice, sizeof(notice), "[log] %llu lines dropped\n",
+                (unsigned long long)(dropped - async.reported));
+        ogs_list_for_each(&log_list, log)
+            async_write(log, notice);
+        async.reported = dropped;
+        n++;
+    }
+
+    if (n)
+        async_flush();
+
+    return n;
+}
+
+static void async_main(void *data)
+{
+    ogs_log_t *log = NULL;
+
+    for ( ;; ) {
+        if (__atomic_exchange_n(&async.cycle, false, __ATOMIC_ACQ_REL)) {
+            ogs_thread_mutex_lock(&file_mutex);
+            ogs_list_for_each(&log_list, log)
+                if (log->type == OGS_LOG_FILE_TYPE)
+                    file_cycle(log);
+            ogs_thread_mutex_unlock(&file_mutex);
+        }
+
+        if (async_drain())
+            continue;
+
+        if (__atomic_load_n(&async.stopping, __ATOMIC_ACQUIRE))
+            break;
+
+        ogs_thread_mutex_lock(&async.mutex);
+        __atomic_store_n(&async.waiting, true, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&async.slot[async.head & (async.size - 1)].seq,
+                    __ATOMIC_SEQ_CST) != async.head + 1 &&
+            !__atomic_load_n(&async.stopping, __ATOMIC_SEQ_CST))
+            ogs_thread_cond_timedwait(
+                    &async.cond, &async.mutex, OGS_LOG_ASYNC_WAIT);
+        __atomic_store_n(&async.waiting, false, __ATOMIC_SEQ_CST);
+        ogs_thread_mutex_unlock(&async.mutex);
+    }
+}
+
+int ogs_log_async_start(unsigned int num_of_lines)
+{
+    unsigned int i;
+
+    ogs_assert(num_of_lines > 0);
+    ogs_assert(async.running == false);
+
+    for (async.size = 1; async.size < num_of_lines; async.size <<= 1)
+        ;
+
+    async.slot = calloc(async.size, sizeof(log_slot_t));
+    if (!async.slot) {
+        ogs_error("calloc(%u) failed", async.size);
+        return OGS_ERROR;
+    }
+    for (i = 0; i < async.size; i++)
+        async.slot[i].seq = i;
+
+    async.tail = async.head = 0;
+    async.dropped = async.reported = 0;
+    async.stopping = async.cycle = async.waiting = false;
+
+    ogs_thread_mutex_init(&async.mutex);
+    ogs_thread_cond_init(&async.cond);
+
+    async.thread = ogs_thread_create(async_main, NULL);
+    if (!async.thread) {
+        ogs_thread_cond_destroy(&async.cond);
+        ogs_thread_mutex_destroy(&async.mutex);
+        free(async.slot);
+        async.slot = NULL;
+        return OGS_ERROR;
+    }
+
+    __atomic_store_n(&async.running, true, __ATOMIC_RELEASE);
+
+    return OGS_OK;
+}
+
+void ogs_log_async_stop(void)
+{
+    if (!async.thread)
+        return;
+
+    /* From here on lines are written by the caller again */
+    __atomic_store_n(&async.running, false, __ATOMIC_RELEASE);
+
+    ogs_thread_mutex_lock(&async.mutex);
+    __atomic_store_n(&async.stopping, true, __ATOMIC_RELEASE);
+    ogs_thread_cond_signal(&async.cond);
+    ogs_thread_mutex_unlock(&async.mutex);
+
+    ogs_thread_destroy(async.thread);
+    async.thread = NULL;
+
+    /* Lines pushed while the writer was on its way out */
+    async_drain();
+
+    ogs_thread_cond_destroy(&async.cond);
+    ogs_thread_mutex_destroy(&async.mutex);
+
+    free(async.slot);
+    async.slot = NULL;
+}
+
+uint64_t ogs_log_async_dropped(void)
+{
+    return __atomic_load_n(&async.dropped, __ATOMIC_RELAXED);
+}
+
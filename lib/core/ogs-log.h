@@ -102,6 +102,20 @@ void ogs_log_printf(ogs_log_level_e level, int domain_id,
 void ogs_log_hexdump_func(ogs_log_level_e level, int domain_id,
     const unsigned char *data, size_t len);
 
+/*
+ * Asynchronous logging.
+ *
+ * Once started, the caller still formats each line but hands it to a
+ * writer thread through a lock-free ring of num_of_lines entries. The
+ * writer batches the writes and flushes once per batch. When the ring
+ * is full, FATAL and ERROR lines are written on the calling thread and
+ * anything less severe is dropped and counted. Stop before the logs are
+ * removed, once no other thread is logging.
+ */
+int ogs_log_async_start(unsigned int num_of_lines);
+void ogs_log_async_stop(void);
+uint64_t ogs_log_async_dropped(void);
+
 #define ogs_assert(expr) \
     do { \
         if (ogs_likely(expr)) ; \
@@ -34,7 +34,9 @@ void ogs_mem_init(void)
 {
     ogs_thread_mutex_init(&mutex);
 
+#if OGS_USE_TALLOC == 1
     talloc_enable_null_tracking();
+#endif
 
 #define TALLOC_MEMSIZE 1
     __ogs_talloc_core = talloc_named_const(NULL, TALLOC_MEMSIZE, "core");
@@ -22,7 +22,6 @@
 #undef OGS_LOG_DOMAIN
 #define OGS_LOG_DOMAIN __ogs_mem_domain
 
-#if OGS_USE_TALLOC == 0
 #define OGS_CLUSTER_128_SIZE    128
 #define OGS_CLUSTER_256_SIZE    256
 #define OGS_CLUSTER_512_SIZE    512
@@ -44,6 +43,25 @@
  */
 #define OGS_CLUSTER_BIG_SIZE    (1024*1024+sizeof(ogs_pkbuf_t *))
 
+static const unsigned int cluster_size[OGS_PKBUF_NUM_OF_CLASS] = {
+    OGS_CLUSTER_128_SIZE,
+    OGS_CLUSTER_256_SIZE,
+    OGS_CLUSTER_512_SIZE,
+    OGS_CLUSTER_1024_SIZE,
+    OGS_CLUSTER_2048_SIZE,
+    OGS_CLUSTER_8192_SIZE,
+    OGS_CLUSTER_32768_SIZE,
+    OGS_CLUSTER_BIG_SIZE,
+};
+
+static struct {
+    uint64_t alloc;
+    uint64_t fail;
+    int in_use;
+    int peak;
+} class_stats[OGS_PKBUF_NUM_OF_CLASS];
+
+#if OGS_USE_TALLOC == 0
 typedef uint8_t ogs_cluster_128_t[OGS_CLUSTER_128_SIZE];
 typedef uint8_t ogs_cluster_256_t[OGS_CLUSTER_256_SIZE];
 typedef uint8_t ogs_cluster_512_t[OGS_CLUSTER_512_SIZE];
@@ -75,6 +93,9 @@ typedef struct ogs_pkbuf_pool_s {
     OGS_POOL(cluster_32768, ogs_cluster_32768_t);
     OGS_POOL(cluster_big, ogs_cluster_big_t);
 
+    int num_of_cluster[OGS_PKBUF_NUM_OF_CLASS];
+    int cache_size[OGS_PKBUF_NUM_OF_CLASS];
+
     ogs_thread_mutex_t mutex;
 } ogs_pkbuf_pool_t;
 
@@ -84,8 +105,86 @@ static ogs_pkbuf_pool_t *default_pool = NULL;
 static ogs_cluster_t *cluster_alloc(
         ogs_pkbuf_pool_t *pool, unsigned int size);
 static void cluster_free(ogs_pkbuf_pool_t *pool, ogs_cluster_t *cluster);
+
+#if !defined(_WIN32)
+/*
+ * Per-thread magazines in front of default_pool.
+ *
+ * Each magazine holds pkbufs of one size class with their cluster already
+ * attached, so an alloc/free pair on the same thread never touches
+ * pool->mutex. An empty magazine is refilled, and a full one drained,
+ * half a magazine at a time under a single lock. Since ogs_malloc() is
+ * built on pkbuf when talloc is disabled, the general allocator goes
+ * through the same magazines.
+ *
+ * A magazine holds at most 1/16 of its class, so the small BIG pool
+ * is never cached. Threads using default_pool must exit before
+ * ogs_pkbuf_default_destroy(); their magazines are returned to the pool
+ * by the thread-specific destructor.
+ */
+#define OGS_PKBUF_USE_CACHE 1
+#define OGS_PKBUF_CACHE_MAX 64
+
+typedef struct pkbuf_cache_s {
+    ogs_pkbuf_pool_t *pool;
+
+    struct {
+        int count;
+        ogs_pkbuf_t *pkbuf[OGS_PKBUF_CACHE_MAX];
+    } mag[OGS_PKBUF_NUM_OF_CLASS];
+} pkbuf_cache_t;
+
+static pthread_key_t cache_key;
+
+static pkbuf_cache_t *cache_get(ogs_pkbuf_pool_t *pool);
+static void cache_refill(pkbuf_cache_t *cache, int cls);
+static void cache_flush(pkbuf_cache_t *cache, int cls, int num);
+static void cache_flush_all(pkbuf_cache_t *cache);
+static void cache_destructor(void *data);
+#endif
+
+static ogs_pkbuf_t *pkbuf_get(ogs_pkbuf_pool_t *pool, unsigned int size);
+static void pkbuf_put(ogs_pkbuf_pool_t *pool, ogs_pkbuf_t *pkbuf);
 #endif
 
+static int cluster_class(unsigned int size)
+{
+    int i;
+
+    for (i = 0; i < OGS_PKBUF_NUM_OF_CLASS; i++)
+        if (size <= cluster_size[i])
+            return i;
+
+    return OGS_PKBUF_NUM_OF_CLASS - 1;
+}
+
+static void stats_alloc(unsigned int size)
+{
+    int cls = cluster_class(size);
+    int in_use, peak;
+
+    __atomic_fetch_add(&class_stats[cls].alloc, 1, __ATOMIC_RELAXED);
+    in_use = __atomic_add_fetch(&class_stats[cls].in_use, 1, __ATOMIC_RELAXED);
+
+    peak = __atomic_load_n(&class_stats[cls].peak, __ATOMIC_RELAXED);
+    while (in_use > peak &&
+            !__atomic_compare_exchange_n(&class_stats[cls].peak, &peak,
+                in_use, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void stats_free(unsigned int size)
+{
+    __atomic_fetch_sub(&class_stats[cluster_class(size)].in_use,
+            1, __ATOMIC_RELAXED);
+}
+
+static void stats_fail(unsigned int size)
+{
+    __atomic_fetch_add(&class_stats[cluster_class(size)].fail,
+            1, __ATOMIC_RELAXED);
+}
+
 void *ogs_pkbuf_put_data(
         ogs_pkbuf_t *pkbuf, const void *data, unsigned int len)
 {
@@ -97,19 +196,76 @@ void *ogs_pkbuf_put_data(
 
 void ogs_pkbuf_init(void)
 {
+    memset(class_stats, 0, sizeof(class_stats));
 #if OGS_USE_TALLOC == 0
     ogs_pool_init(&pkbuf_pool, ogs_core()->pkbuf.pool);
 
+#if OGS_PKBUF_USE_CACHE
+    ogs_assert(pthread_key_create(&cache_key, cache_destructor) == 0);
+#endif
 #endif
 }
 
 void ogs_pkbuf_final(void)
 {
 #if OGS_USE_TALLOC == 0
+#if OGS_PKBUF_USE_CACHE
+    pkbuf_cache_t *cache = pthread_getspecific(cache_key);
+    if (cache) {
+        pthread_setspecific(cache_key, NULL);
+        cache_destructor(cache);
+    }
+    pthread_key_delete(cache_key);
+#endif
+
     ogs_pool_final(&pkbuf_pool);
 #endif
 }
 
+void ogs_pkbuf_get_stats(
+        ogs_pkbuf_class_stats_t stats[OGS_PKBUF_NUM_OF_CLASS])
+{
+    int i;
+
+    ogs_assert(stats);
+
+    for (i = 0; i < OGS_PKBUF_NUM_OF_CLASS; i++) {
+        memset(&stats[i], 0, sizeof(stats[i]));
+
+        stats[i].size = cluster_size[i];
+#if OGS_USE_TALLOC == 0
+        if (default_pool)
+            stats[i].pool = default_pool->num_of_cluster[i];
+#endif
+        stats[i].alloc =
+            __atomic_load_n(&class_stats[i].alloc, __ATOMIC_RELAXED);
+        stats[i].fail =
+            __atomic_load_n(&class_stats[i].fail, __ATOMIC_RELAXED);
+        stats[i].in_use =
+            __atomic_load_n(&class_stats[i].in_use, __ATOMIC_RELAXED);
+        stats[i].peak =
+            __atomic_load_n(&class_stats[i].peak, __ATOMIC_RELAXED);
+    }
+}
+
+void ogs_pkbuf_log_stats(void)
+{
+    ogs_pkbuf_class_stats_t stats[OGS_PKBUF_NUM_OF_CLASS];
+    int i;
+
+    ogs_pkbuf_get_stats(stats);
+
+    for (i = 0; i < OGS_PKBUF_NUM_OF_CLASS; i++) {
+        if (!stats[i].alloc && !stats[i].fail)
+            continue;
+
+        ogs_info("pkbuf[%u] pool:%d peak:%d in-use:%d alloc:%llu fail:%llu",
+                stats[i].size, stats[i].pool, stats[i].peak, stats[i].in_use,
+                (unsigned long long)stats[i].alloc,
+                (unsigned long long)stats[i].fail);
+    }
+}
+
 void ogs_pkbuf_default_init(ogs_pkbuf_config_t *config)
 {
 #if OGS_USE_TALLOC == 0
@@ -137,7 +293,16 @@ void ogs_pkbuf_default_create(ogs_pkbuf_config_t *config)
 void ogs_pkbuf_default_destroy(void)
 {
 #if OGS_USE_TALLOC == 0
+#if OGS_PKBUF_USE_CACHE
+    pkbuf_cache_t *cache = pthread_getspecific(cache_key);
+    if (cache && cache->pool == default_pool) {
+        cache_flush_all(cache);
+        cache->pool = NULL;
+    }
+#endif
+
     ogs_pkbuf_pool_destroy(default_pool);
+    default_pool = NULL;
 #endif
 }
 
@@ -145,7 +310,7 @@ ogs_pkbuf_pool_t *ogs_pkbuf_pool_create(ogs_pkbuf_config_t *config)
 {
     ogs_pkbuf_pool_t *pool = NULL;
 #if OGS_USE_TALLOC == 0
-    int tmp = 0;
+    int tmp = 0, i;
 
     ogs_assert(config);
 
@@ -171,6 +336,24 @@ ogs_pkbuf_pool_t *ogs_pkbuf_pool_create(ogs_pkbuf_config_t *config)
     ogs_pool_init(&pool->cluster_8192, config->cluster_8192_pool);
     ogs_pool_init(&pool->cluster_32768, config->cluster_32768_pool);
     ogs_pool_init(&pool->cluster_big, config->cluster_big_pool);
+
+    pool->num_of_cluster[0] = config->cluster_128_pool;
+    pool->num_of_cluster[1] = config->cluster_256_pool;
+    pool->num_of_cluster[2] = config->cluster_512_pool;
+    pool->num_of_cluster[3] = config->cluster_1024_pool;
+    pool->num_of_cluster[4] = config->cluster_2048_pool;
+    pool->num_of_cluster[5] = config->cluster_8192_pool;
+    pool->num_of_cluster[6] = config->cluster_32768_pool;
+    pool->num_of_cluster[7] = config->cluster_big_pool;
+
+    for (i = 0; i < OGS_PKBUF_NUM_OF_CLASS; i++) {
+#if OGS_PKBUF_USE_CACHE
+        pool->cache_size[i] = ogs_min(
+                pool->num_of_cluster[i] / 16, OGS_PKBUF_CACHE_MAX);
+        if (pool->cache_size[i] < 2)
+#endif
+            pool->cache_size[i] = 0;
+    }
 #endif
 
     return pool;
@@ -225,6 +408,7 @@ ogs_pkbuf_t *ogs_pkbuf_alloc_debug(
 
     pkbuf = ogs_talloc_zero_size(pool, sizeof(*pkbuf) + size, file_line);
     if (!pkbuf) {
+        stats_fail(size);
         ogs_error("ogs_pkbuf_alloc() failed [size=%d]", size);
         return NULL;
     }
@@ -239,33 +423,47 @@ ogs_pkbuf_t *ogs_pkbuf_alloc_debug(
 
     pkbuf->file_line = file_line; /* For debug */
 
+    stats_alloc(size);
+
     return pkbuf;
 #else
     ogs_pkbuf_t *pkbuf = NULL;
     ogs_cluster_t *cluster = NULL;
+#if OGS_PKBUF_USE_CACHE
+    pkbuf_cache_t *cache = NULL;
+    int cls;
+#endif
 
     if (pool == NULL)
         pool = default_pool;
     ogs_assert(pool);
 
-    ogs_thread_mutex_lock(&pool->mutex);
-
-    cluster = cluster_alloc(pool, size);
-    if (!cluster) {
-        ogs_error("ogs_pkbuf_alloc() failed [size=%d]", size);
+#if OGS_PKBUF_USE_CACHE
+    cls = cluster_class(size);
+    if (size <= OGS_CLUSTER_BIG_SIZE && pool->cache_size[cls] &&
+            (cache = cache_get(pool)) != NULL) {
+        if (!cache->mag[cls].count)
+            cache_refill(cache, cls);
+        if (cache->mag[cls].count)
+            pkbuf = cache->mag[cls].pkbuf[--cache->mag[cls].count];
+    } else
+#endif
+    {
+        ogs_thread_mutex_lock(&pool->mutex);
+        pkbuf = pkbuf_get(pool, size);
         ogs_thread_mutex_unlock(&pool->mutex);
-        return NULL;
     }
 
-    ogs_pool_alloc(&pool->pkbuf, &pkbuf);
     if (!pkbuf) {
+        stats_fail(size);
         ogs_error("ogs_pkbuf_alloc() failed [size=%d]", size);
-        ogs_thread_mutex_unlock(&pool->mutex);
         return NULL;
     }
-    memset(pkbuf, 0, sizeof(*pkbuf));
 
-    OGS_OBJECT_REF(cluster);
+    cluster = pkbuf->cluster;
+    ogs_assert(cluster);
+
+    memset(pkbuf, 0, sizeof(*pkbuf));
 
     pkbuf->cluster = cluster;
 
@@ -280,7 +478,7 @@ ogs_pkbuf_t *ogs_pkbuf_alloc_debug(
 
     pkbuf->pool = pool;
 
-    ogs_thread_mutex_unlock(&pool->mutex);
+    stats_alloc(cluster->size);
 
     return pkbuf;
 #endif
@@ -289,26 +487,77 @@ ogs_pkbuf_t *ogs_pkbuf_alloc_debug(
 void ogs_pkbuf_free(ogs_pkbuf_t *pkbuf)
 {
 #if OGS_USE_TALLOC == 1
-    ogs_talloc_free(pkbuf, OGS_FILE_LINE);
+    ogs_cluster_t *cluster = NULL;
+    ogs_pkbuf_t *owner = NULL;
+
+    ogs_thread_mutex_lock(ogs_mem_get_mutex());
+
+    /* Shared by ogs_pkbuf_share(), the data lives in the owner */
+    cluster = pkbuf ? pkbuf->cluster : NULL;
+    if (cluster) {
+        owner = (ogs_pkbuf_t *)cluster->buffer;
+        ogs_assert(owner);
+
+        if (OGS_OBJECT_IS_REF(cluster)) {
+            cluster->reference_count--;
+            if (pkbuf != owner)
+                _talloc_free(pkbuf, OGS_FILE_LINE);
+
+            ogs_thread_mutex_unlock(ogs_mem_get_mutex());
+            return;
+        }
+
+        stats_free(cluster->size);
+
+        _talloc_free(cluster, OGS_FILE_LINE);
+        if (pkbuf != owner)
+            _talloc_free(owner, OGS_FILE_LINE);
+    } else if (pkbuf) {
+        stats_free(pkbuf->end - pkbuf->head);
+    }
+
+    _talloc_free(pkbuf, OGS_FILE_LINE);
+
+    ogs_thread_mutex_unlock(ogs_mem_get_mutex());
 #else
     ogs_pkbuf_pool_t *pool = NULL;
     ogs_cluster_t *cluster = NULL;
+#if OGS_PKBUF_USE_CACHE
+    pkbuf_cache_t *cache = NULL;
+    int cls;
+#endif
     ogs_assert(pkbuf);
 
     pool = pkbuf->pool;
     ogs_assert(pool);
 
-    ogs_thread_mutex_lock(&pool->mutex);
-
     cluster = pkbuf->cluster;
     ogs_assert(cluster);
 
-    if (OGS_OBJECT_IS_REF(cluster))
-        OGS_OBJECT_UNREF(cluster);
-    else
-        cluster_free(pool, pkbuf->cluster);
+#if OGS_PKBUF_USE_CACHE
+    /*
+     * Only the last holder of a cluster may cache it. The reference count
+     * can only drop while we hold one, so a stale read just sends us to
+     * the locked path below, which checks again.
+     */
+    cls = cluster_class(cluster->size);
+    if (pool->cache_size[cls] &&
+            __atomic_load_n(&cluster->reference_count, __ATOMIC_ACQUIRE) == 1 &&
+            (cache = cache_get(pool)) != NULL) {
+        if (cache->mag[cls].count == pool->cache_size[cls])
+            cache_flush(cache, cls, pool->cache_size[cls] / 2);
+        cache->mag[cls].pkbuf[cache->mag[cls].count++] = pkbuf;
+
+        stats_free(cluster->size);
+        return;
+    }
+#endif
 
-    ogs_pool_free(&pool->pkbuf, pkbuf);
+    ogs_thread_mutex_lock(&pool->mutex);
+
+    if (!OGS_OBJECT_IS_REF(cluster))
+        stats_free(cluster->size);
+    pkbuf_put(pool, pkbuf);
 
     ogs_thread_mutex_unlock(&pool->mutex);
 #endif
@@ -340,13 +589,13 @@ ogs_pkbuf_t *ogs_pkbuf_copy_debug(ogs_pkbuf_t *pkbuf, const char *file_line)
     }
 
     /* copy data */
-    memcpy(newbuf->_data, pkbuf->_data, size);
+    memcpy(newbuf->_data, pkbuf->head, size);
 
     /* copy header */
     newbuf->len = pkbuf->len;
 
-    newbuf->tail += pkbuf->tail - pkbuf->_data;
-    newbuf->data += pkbuf->data - pkbuf->_data;
+    newbuf->tail += pkbuf->tail - pkbuf->head;
+    newbuf->data += pkbuf->data - pkbuf->head;
 
     return newbuf;
 #else
@@ -372,7 +621,195 @@ ogs_pkbuf_t *ogs_pkbuf_copy_debug(ogs_pkbuf_t *pkbuf, const char *file_line)
     return newbuf;
 }
 
+ogs_pkbuf_t *ogs_pkbuf_share_debug(ogs_pkbuf_t *pkbuf, const char *file_line)
+{
+#if OGS_USE_TALLOC == 1
+    ogs_cluster_t *cluster = NULL;
+    ogs_pkbuf_t *newbuf = NULL;
+
+    ogs_assert(pkbuf);
+
+    ogs_thread_mutex_lock(ogs_mem_get_mutex());
+
+    newbuf = _talloc_zero(NULL, sizeof(*newbuf), file_line);
+    if (!newbuf) {
+        ogs_error("ogs_pkbuf_share() failed");
+        ogs_thread_mutex_unlock(ogs_mem_get_mutex());
+        return NULL;
+    }
+
+    cluster = pkbuf->cluster;
+    if (!cluster) {
+        /* First share, the data stays in the original pkbuf */
+        cluster = _talloc_zero(NULL, sizeof(*cluster), file_line);
+        if (!cluster) {
+            ogs_error("ogs_pkbuf_share() failed");
+            _talloc_free(newbuf, file_line);
+            ogs_thread_mutex_unlock(ogs_mem_get_mutex());
+            return NULL;
+        }
+        cluster->buffer = (unsigned char *)pkbuf;
+        cluster->size = pkbuf->end - pkbuf->head;
+        cluster->reference_count = 1;
+
+        pkbuf->cluster = cluster;
+    }
+
+    memcpy(newbuf, pkbuf, sizeof *pkbuf);
+    newbuf->file_line = file_line; /* For debug */
+
+    cluster->reference_count++;
+
+    ogs_thread_mutex_unlock(ogs_mem_get_mutex());
+
+    return newbuf;
+#else
+    /* Without talloc, copying already shares the cluster */
+    return ogs_pkbuf_copy_debug(pkbuf, file_line);
+#endif
+}
+
+ogs_pkbuf_t *ogs_pkbuf_compact_debug(
+        ogs_pkbuf_t *pkbuf, const char *file_line)
+{
+    ogs_pkbuf_t *newbuf = NULL;
+    unsigned int headroom, size;
+
+    ogs_assert(pkbuf);
+
+    headroom = pkbuf->data - pkbuf->head;
+    size = headroom + pkbuf->len;
+
+    if (cluster_class(size) == cluster_class(pkbuf->end - pkbuf->head))
+        return pkbuf;
+
+    newbuf = ogs_pkbuf_alloc_debug(pkbuf->pool, size, file_line);
+    if (!newbuf)
+        return pkbuf;
+
+    ogs_pkbuf_reserve(newbuf, headroom);
+    ogs_pkbuf_put_data(newbuf, pkbuf->data, pkbuf->len);
+    memcpy(newbuf->param, pkbuf->param, sizeof(pkbuf->param));
+
+    ogs_pkbuf_free(pkbuf);
+
+    return newbuf;
+}
+
 #if OGS_USE_TALLOC == 0
+/* Both called with pool->mutex held */
+static ogs_pkbuf_t *pkbuf_get(ogs_pkbuf_pool_t *pool, unsigned int size)
+{
+    ogs_pkbuf_t *pkbuf = NULL;
+    ogs_cluster_t *cluster = NULL;
+
+    cluster = cluster_alloc(pool, size);
+    if (!cluster)
+        return NULL;
+
+    ogs_pool_alloc(&pool->pkbuf, &pkbuf);
+    if (!pkbuf) {
+        cluster_free(pool, cluster);
+        return NULL;
+    }
+
+    OGS_OBJECT_REF(cluster);
+
+    pkbuf->cluster = cluster;
+    pkbuf->pool = pool;
+
+    return pkbuf;
+}
+
+static void pkbuf_put(ogs_pkbuf_pool_t *pool, ogs_pkbuf_t *pkbuf)
+{
+    ogs_cluster_t *cluster = pkbuf->cluster;
+
+    if (OGS_OBJECT_IS_REF(cluster))
+        OGS_OBJECT_UNREF(cluster);
+    else
+        cluster_free(pool, cluster);
+
+    ogs_pool_free(&pool->pkbuf, pkbuf);
+}
+
+#if OGS_PKBUF_USE_CACHE
+static pkbuf_cache_t *cache_get(ogs_pkbuf_pool_t *pool)
+{
+    pkbuf_cache_t *cache = NULL;
+    int i;
+
+    if (pool != default_pool)
+        return NULL;
+
+    cache = pthread_getspecific(cache_key);
+    if (!cache) {
+        cache = calloc(1, sizeof(*cache));
+        if (!cache)
+            return NULL;
+        if (pthread_setspecific(cache_key, cache) != 0) {
+            free(cache);
+            return NULL;
+        }
+    }
+
+    if (cache->pool != pool) {
+        /* Left over from a destroyed default_pool, nothing to return */
+        for (i = 0; i < OGS_PKBUF_NUM_OF_CLASS; i++)
+            cache->mag[i].count = 0;
+        cache->pool = pool;
+    }
+
+    return cache;
+}
+
+static void cache_refill(pkbuf_cache_t *cache, int cls)
+{
+    ogs_pkbuf_pool_t *pool = cache->pool;
+    ogs_pkbuf_t *pkbuf = NULL;
+    int num;
+
+    num = pool->cache_size[cls] / 2;
+
+    ogs_thread_mutex_lock(&pool->mutex);
+    while (cache->mag[cls].count < num) {
+        pkbuf = pkbuf_get(pool, cluster_size[cls]);
+        if (!pkbuf)
+            break;
+        cache->mag[cls].pkbuf[cache->mag[cls].count++] = pkbuf;
+    }
+    ogs_thread_mutex_unlock(&pool->mutex);
+}
+
+static void cache_flush(pkbuf_cache_t *cache, int cls, int num)
+{
+    ogs_pkbuf_pool_t *pool = cache->pool;
+
+    ogs_thread_mutex_lock(&pool->mutex);
+    while (num-- > 0 && cache->mag[cls].count)
+        pkbuf_put(pool, cache->mag[cls].pkbuf[--cache->mag[cls].count]);
+    ogs_thread_mutex_unlock(&pool->mutex);
+}
+
+static void cache_flush_all(pkbuf_cache_t *cache)
+{
+    int i;
+
+    for (i = 0; i < OGS_PKBUF_NUM_OF_CLASS; i++)
+        cache_flush(cache, i, cache->mag[i].count);
+}
+
+static void cache_destructor(void *data)
+{
+    pkbuf_cache_t *cache = data;
+
+    if (cache->pool && cache->pool == default_pool)
+        cache_flush_all(cache);
+
+    free(cache);
+}
+#endif
+
 static ogs_cluster_t *cluster_alloc(
         ogs_pkbuf_pool_t *pool, unsigned int size)
 {
@@ -386,64 +823,38 @@ static ogs_cluster_t *cluster_alloc(
 
     if (size <= OGS_CLUSTER_128_SIZE) {
         ogs_pool_alloc(&pool->cluster_128, (ogs_cluster_128_t**)&buffer);
-        if (!buffer) {
-            ogs_error("ogs_pool_alloc() failed");
-            return NULL;
-        }
         cluster->size = OGS_CLUSTER_128_SIZE;
     } else if (size <= OGS_CLUSTER_256_SIZE) {
         ogs_pool_alloc(&pool->cluster_256, (ogs_cluster_256_t**)&buffer);
-        if (!buffer) {
-            ogs_error("ogs_pool_alloc() failed");
-            return NULL;
-        }
         cluster->size = OGS_CLUSTER_256_SIZE;
     } else if (size <= OGS_CLUSTER_512_SIZE) {
         ogs_pool_alloc(&pool->cluster_512, (ogs_cluster_512_t**)&buffer);
-        if (!buffer) {
-            ogs_error("ogs_pool_alloc() failed");
-            return NULL;
-        }
         cluster->size = OGS_CLUSTER_512_SIZE;
     } else if (size <= OGS_CLUSTER_1024_SIZE) {
         ogs_pool_alloc(&pool->cluster_1024, (ogs_cluster_1024_t**)&buffer);
-        if (!buffer) {
-            ogs_error("ogs_pool_alloc() failed");
-            return NULL;
-        }
         cluster->size = OGS_CLUSTER_1024_SIZE;
     } else if (size <= OGS_CLUSTER_2048_SIZE) {
         ogs_pool_alloc(&pool->cluster_2048, (ogs_cluster_2048_t**)&buffer);
-        if (!buffer) {
-            ogs_error("ogs_pool_alloc() failed");
-            return NULL;
-        }
         cluster->size = OGS_CLUSTER_2048_SIZE;
     } else if (size <= OGS_CLUSTER_8192_SIZE) {
         ogs_pool_alloc(&pool->cluster_8192, (ogs_cluster_8192_t**)&buffer);
-        if (!buffer) {
-            ogs_error("ogs_pool_alloc() failed");
-            return NULL;
-        }
         cluster->size = OGS_CLUSTER_8192_SIZE;
     } else if (size <= OGS_CLUSTER_32768_SIZE) {
         ogs_pool_alloc(&pool->cluster_32768, (ogs_cluster_32768_t**)&buffer);
-        if (!buffer) {
-            ogs_error("ogs_pool_alloc() failed");
-            return NULL;
-        }
         cluster->size = OGS_CLUSTER_32768_SIZE;
     } else if (size <= OGS_CLUSTER_BIG_SIZE) {
         ogs_pool_alloc(&pool->cluster_big, (ogs_cluster_big_t**)&buffer);
-        if (!buffer) {
-            ogs_error("ogs_pool_alloc() failed");
-            return NULL;
-        }
         cluster->size = OGS_CLUSTER_BIG_SIZE;
     } else {
         ogs_fatal("invalid size = %d", size);
         ogs_assert_if_reached();
     }
+
+    if (!buffer) {
+        /* The caller reports the failure, which also covers cache refill */
+        ogs_pool_free(&pool->cluster, cluster);
+        return NULL;
+    }
     cluster->buffer = buffer;
 
     return cluster;
@@ -73,6 +73,32 @@ typedef struct ogs_pkbuf_config_s {
     int cluster_big_pool;
 } ogs_pkbuf_config_t;
 
+/*
+ * Allocation statistics per cluster size class, counted for every pkbuf
+ * (and, without talloc, every ogs_malloc()) whatever pool it came from.
+ * With talloc there are no cluster pools, so the request size is
+ * bucketed into the same classes and 'pool' is left at zero.
+ *
+ * 'fail' counts requests that found the class exhausted, and 'peak' is
+ * the high-water mark of 'in_use' -- together they are what is needed
+ * to size ogs_pkbuf_config_t from a real workload.
+ */
+#define OGS_PKBUF_NUM_OF_CLASS 8
+
+typedef struct ogs_pkbuf_class_stats_s {
+    unsigned int size;
+    int pool;
+
+    uint64_t alloc;
+    uint64_t fail;
+    int in_use;
+    int peak;
+} ogs_pkbuf_class_stats_t;
+
+void ogs_pkbuf_get_stats(
+        ogs_pkbuf_class_stats_t stats[OGS_PKBUF_NUM_OF_CLASS]);
+void ogs_pkbuf_log_stats(void);
+
 void ogs_pkbuf_init(void);
 void ogs_pkbuf_final(void);
 
@@ -95,6 +121,27 @@ void *ogs_pkbuf_put_data(
     ogs_pkbuf_copy_debug(pkbuf, OGS_FILE_LINE)
 ogs_pkbuf_t *ogs_pkbuf_copy_debug(ogs_pkbuf_t *pkbuf, const char *file_line);
 
+/*
+ * Returns a new pkbuf referring to the data of pkbuf instead of copying it.
+ * The data is released when the last pkbuf sharing it is freed.
+ * Shared data must be treated as read-only.
+ */
+#define ogs_pkbuf_share(pkbuf) \
+    ogs_pkbuf_share_debug(pkbuf, OGS_FILE_LINE)
+ogs_pkbuf_t *ogs_pkbuf_share_debug(ogs_pkbuf_t *pkbuf, const char *file_line);
+
+/*
+ * Moves the data (and its headroom) of a pkbuf that was allocated for the
+ * worst case, e.g. OGS_MAX_SDU_LEN for an encoder, into the smallest
+ * cluster class that holds it, and frees the original. Tailroom is not
+ * kept. The original is returned as is if it already sits in that class
+ * or if the new buffer cannot be allocated.
+ */
+#define ogs_pkbuf_compact(pkbuf) \
+    ogs_pkbuf_compact_debug(pkbuf, OGS_FILE_LINE)
+ogs_pkbuf_t *ogs_pkbuf_compact_debug(
+        ogs_pkbuf_t *pkbuf, const char *file_line);
+
 static ogs_inline int ogs_pkbuf_tailroom(const ogs_pkbuf_t *pkbuf)
 {
     return pkbuf->end - pkbuf->tail;
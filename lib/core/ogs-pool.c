@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core-config-private.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "ogs-core.h"
+
+#undef OGS_LOG_DOMAIN
+#define OGS_LOG_DOMAIN __ogs_mem_domain
+
+/*****************************************
+ * Backing memory for ogs_pool_init_lazy()
+ *****************************************/
+
+#if HAVE_SYS_MMAN_H
+static size_t page_mask(void)
+{
+    static size_t page_size = 0;
+
+    if (!page_size)
+        page_size = sysconf(_SC_PAGESIZE);
+
+    return page_size - 1;
+}
+
+static size_t page_align(size_t size)
+{
+    return (size + page_mask()) & ~page_mask();
+}
+#endif
+
+void *ogs_pool_vm_reserve(size_t size)
+{
+#if HAVE_SYS_MMAN_H
+    void *base = NULL;
+
+    ogs_assert(size);
+
+    /* Address space only, nothing is charged until it is committed */
+    base = mmap(NULL, page_align(size), PROT_NONE,
+            MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_errno,
+                "mmap(%lu) failed", (unsigned long)size);
+        return NULL;
+    }
+
+    return base;
+#else
+    return calloc(1, size);
+#endif
+}
+
+int ogs_pool_vm_commit(void *base, size_t size, size_t from, size_t to)
+{
+#if HAVE_SYS_MMAN_H
+    size_t start, end;
+
+    ogs_assert(base);
+    ogs_assert(from <= to);
+
+    /* The first page may already be committed, which is harmless */
+    start = (from * size) & ~page_mask();
+    end = page_align(to * size);
+    if (end <= start)
+        return OGS_OK;
+
+    if (mprotect((unsigned char *)base + start,
+                end - start, PROT_READ|PROT_WRITE) != 0) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_errno,
+                "mprotect(%lu-%lu) failed",
+                (unsigned long)start, (unsigned long)end);
+        return OGS_ERROR;
+    }
+#endif
+
+    return OGS_OK;
+}
+
+void ogs_pool_vm_release(void *base, size_t size)
+{
+#if HAVE_SYS_MMAN_H
+    ogs_assert(base);
+    munmap(base, page_align(size));
+#else
+    free(base);
+#endif
+}
@@ -38,14 +38,33 @@ extern "C" {
 
 typedef uint32_t ogs_pool_id_t;
 
+/*
+ * A pool created with ogs_pool_init() allocates and fills the whole
+ * array up front. One created with ogs_pool_init_lazy() only reserves
+ * address space for it: slots are handed out in array order and the
+ * memory behind them is committed OGS_POOL_COMMIT_SIZE at a time as the
+ * pool grows, so a large pool costs nothing until it is used. Freed slots
+ * go through the same FIFO in both modes, and ogs_pool_index(),
+ * ogs_pool_find() and ogs_pool_cycle() behave the same way.
+ *
+ * The id generators below touch every slot and are for eager pools only.
+ */
+#define OGS_POOL_COMMIT_SIZE (1024*1024)
+
 #define OGS_POOL(pool, type) \
     struct { \
         const char *name; \
         int head, tail; \
         int size, avail; \
+        int grown, committed, chunk, peak; \
+        bool lazy; \
         type **free, *array, **index; \
     } pool
 
+void *ogs_pool_vm_reserve(size_t size);
+int ogs_pool_vm_commit(void *base, size_t size, size_t from, size_t to);
+void ogs_pool_vm_release(void *base, size_t size);
+
 #define ogs_pool_init(pool, _size) do { \
     int i; \
     (pool)->name = #pool; \
@@ -57,12 +76,32 @@ typedef uint32_t ogs_pool_id_t;
     ogs_assert((pool)->index); \
     (pool)->size = (pool)->avail = _size; \
     (pool)->head = (pool)->tail = 0; \
+    (pool)->grown = (pool)->committed = _size; \
+    (pool)->chunk = (pool)->peak = 0; \
+    (pool)->lazy = false; \
     for (i = 0; i < _size; i++) { \
         (pool)->free[i] = &((pool)->array[i]); \
         (pool)->index[i] = NULL; \
     } \
 } while (0)
 
+#define ogs_pool_init_lazy(pool, _size) do { \
+    (pool)->name = #pool; \
+    (pool)->free = ogs_pool_create(sizeof(*(pool)->free) * _size); \
+    ogs_assert((pool)->free); \
+    (pool)->array = ogs_pool_vm_reserve(sizeof(*(pool)->array) * _size); \
+    ogs_assert((pool)->array); \
+    (pool)->index = ogs_pool_vm_reserve(sizeof(*(pool)->index) * _size); \
+    ogs_assert((pool)->index); \
+    (pool)->size = (pool)->avail = _size; \
+    (pool)->head = (pool)->tail = 0; \
+    (pool)->grown = (pool)->committed = 0; \
+    (pool)->chunk = ogs_max(1, \
+            (int)(OGS_POOL_COMMIT_SIZE / sizeof(*(pool)->array))); \
+    (pool)->peak = 0; \
+    (pool)->lazy = true; \
+} while (0)
+
 /* Make sure to memset after to avoid potental double free issues */
 #define ogs_pool_final(pool) do { \
     if (((pool)->size != (pool)->avail)) \
@@ -71,25 +110,60 @@ typedef uint32_t ogs_pool_id_t;
     if ((0 == (pool)->free) || (0 == (pool)->array) || (0 == (pool)->index)) \
         ogs_fatal("Trying to free memory that wasnt allocated!"); \
     ogs_pool_destroy((pool)->free); \
-    ogs_pool_destroy((pool)->array); \
-    ogs_pool_destroy((pool)->index); \
+    if ((pool)->lazy) { \
+        ogs_pool_vm_release((pool)->array, \
+                sizeof(*(pool)->array) * (pool)->size); \
+        ogs_pool_vm_release((pool)->index, \
+                sizeof(*(pool)->index) * (pool)->size); \
+    } else { \
+        ogs_pool_destroy((pool)->array); \
+        ogs_pool_destroy((pool)->index); \
+    } \
     memset((pool), 0, sizeof(*(pool))); \
 } while (0)
 
 #define ogs_pool_index(pool, node) (((node) - (pool)->array)+1)
 #define ogs_pool_find(pool, _index) \
-    (_index > 0 && _index <= (pool)->size) ? (pool)->index[_index-1] : NULL
+    (((_index) > 0 && (_index) <= (pool)->grown) ? \
+        (pool)->index[(_index)-1] : NULL)
 #define ogs_pool_cycle(pool, node) \
     ogs_pool_find((pool), ogs_pool_index((pool), (node)))
 
+#define ogs_pool_grow(pool) do { \
+    int __committed = ogs_min( \
+            (pool)->committed + (pool)->chunk, (pool)->size); \
+    if (ogs_pool_vm_commit((pool)->array, sizeof(*(pool)->array), \
+                (pool)->committed, __committed) == OGS_OK && \
+        ogs_pool_vm_commit((pool)->index, sizeof(*(pool)->index), \
+                (pool)->committed, __committed) == OGS_OK) \
+        (pool)->committed = __committed; \
+} while (0)
+
+/*
+ * Slots not yet grown count as available but are not in the free FIFO.
+ * A lazy pool keeps growing while the FIFO holds no more than a chunk,
+ * so a freed slot (and its index) is not handed out again right away,
+ * much as an eager pool goes through every slot before reusing one.
+ */
 #define ogs_pool_alloc(pool, node) do { \
+    int __reuse = (pool)->avail - ((pool)->size - (pool)->grown); \
     *(node) = NULL; \
-    if ((pool)->avail > 0) { \
-        (pool)->avail--; \
+    if (__reuse <= (pool)->chunk && (pool)->grown < (pool)->size) { \
+        if ((pool)->grown == (pool)->committed) \
+            ogs_pool_grow(pool); \
+        if ((pool)->grown < (pool)->committed) \
+            *(node) = (void*)&((pool)->array[(pool)->grown++]); \
+    } \
+    if (!*(node) && __reuse > 0) { \
         *(node) = (void*)(pool)->free[(pool)->head]; \
         (pool)->free[(pool)->head] = NULL; \
         (pool)->head = ((pool)->head + 1) % ((pool)->size); \
+    } \
+    if (*(node)) { \
+        (pool)->avail--; \
         (pool)->index[ogs_pool_index(pool, *(node))-1] = *(node); \
+        if ((pool)->size - (pool)->avail > (pool)->peak) \
+            (pool)->peak = (pool)->size - (pool)->avail; \
     } \
 } while (0)
 
@@ -104,6 +178,8 @@ typedef uint32_t ogs_pool_id_t;
 
 #define ogs_pool_size(pool) ((pool)->size)
 #define ogs_pool_avail(pool) ((pool)->avail)
+#define ogs_pool_peak(pool) ((pool)->peak)
+#define ogs_pool_committed(pool) ((pool)->committed)
 
 #define ogs_pool_sequence_id_generate(pool) do { \
     int i; \
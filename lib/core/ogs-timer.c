@@ -22,9 +22,31 @@
 #undef OGS_LOG_DOMAIN
 #define OGS_LOG_DOMAIN __ogs_event_domain
 
+/*
+ * Hierarchical timing wheel: 4 levels of 256 slots with a 1ms tick,
+ * so level N holds the timers due within 256^(N+1) ticks (~49 days).
+ * A timer is linked into one slot and moves down a level each time
+ * the slot above it is cascaded, which makes start and stop O(1).
+ */
+#define WHEEL_TICK              ogs_time_from_msec(1)
+#define WHEEL_LEVELS            4
+#define WHEEL_BITS              8
+#define WHEEL_SIZE              (1 << WHEEL_BITS)
+#define WHEEL_MASK              (WHEEL_SIZE - 1)
+#define WHEEL_MAX_TICKS         ((INT64_C(1) << (WHEEL_LEVELS*WHEEL_BITS)) - 1)
+
+typedef struct ogs_timer_wheel_s {
+    int64_t tick;               /* Next tick to run */
+    unsigned int count[WHEEL_LEVELS];
+    ogs_list_t slot[WHEEL_LEVELS][WHEEL_SIZE];
+    ogs_list_t expired;         /* Due timers whose callback is pending */
+} ogs_timer_wheel_t;
+
 typedef struct ogs_timer_mgr_s {
     OGS_POOL(pool, ogs_timer_t);
+    ogs_timer_mgr_type_e type;
     ogs_rbtree_t tree;
+    ogs_timer_wheel_t *wheel;
 } ogs_timer_mgr_t;
 
 static void add_timer_node(
@@ -52,7 +74,147 @@ static void add_timer_node(
     ogs_rbtree_insert_color(tree, timer);
 }
 
+/* First tick at which the timeout has passed, so nothing fires early */
+static int64_t wheel_tick_of(ogs_time_t time)
+{
+    return (time + WHEEL_TICK - 1) / WHEEL_TICK;
+}
+
+static void wheel_link(ogs_timer_wheel_t *wheel, ogs_timer_t *timer)
+{
+    int64_t expires, delta;
+    int level, index;
+
+    expires = wheel_tick_of(timer->timeout);
+    delta = expires - wheel->tick;
+
+    if (delta < 0) {
+        /* Already due : runs with the next tick */
+        level = 0;
+        index = wheel->tick & WHEEL_MASK;
+    } else {
+        if (delta > WHEEL_MAX_TICKS) {
+            /* Cascaded again when its slot comes up */
+            delta = WHEEL_MAX_TICKS;
+            expires = wheel->tick + delta;
+        }
+        for (level = 0; level < WHEEL_LEVELS - 1; level++)
+            if (delta < (INT64_C(1) << ((level + 1) * WHEEL_BITS)))
+                break;
+        index = (expires >> (level * WHEEL_BITS)) & WHEEL_MASK;
+    }
+
+    timer->wheel_list = &wheel->slot[level][index];
+    timer->wheel_level = level;
+    ogs_list_add(timer->wheel_list, &timer->lnode);
+    wheel->count[level]++;
+}
+
+static void wheel_unlink(ogs_timer_wheel_t *wheel, ogs_timer_t *timer)
+{
+    ogs_assert(timer->wheel_list);
+
+    ogs_list_remove(timer->wheel_list, &timer->lnode);
+    if (timer->wheel_list != &wheel->expired)
+        wheel->count[timer->wheel_level]--;
+    timer->wheel_list = NULL;
+}
+
+/* Moves the timers of a slot one or more levels down */
+static int wheel_cascade(ogs_timer_wheel_t *wheel, int level)
+{
+    OGS_LIST(list);
+    ogs_lnode_t *lnode = NULL;
+    int index = (wheel->tick >> (level * WHEEL_BITS)) & WHEEL_MASK;
+
+    ogs_list_copy(&list, &wheel->slot[level][index]);
+    ogs_list_init(&wheel->slot[level][index]);
+
+    while ((lnode = ogs_list_first(&list))) {
+        ogs_timer_t *timer = ogs_container_of(lnode, ogs_timer_t, lnode);
+
+        ogs_list_remove(&list, lnode);
+        wheel->count[level]--;
+        wheel_link(wheel, timer);
+    }
+
+    return index;
+}
+
+static void wheel_advance(ogs_timer_wheel_t *wheel, int64_t now)
+{
+    while (wheel->tick <= now) {
+        int index = wheel->tick & WHEEL_MASK;
+        int level;
+        ogs_lnode_t *lnode = NULL;
+
+        /* Nothing within the next slots of level 0 : skip to the boundary */
+        if (index != 0 && wheel->count[0] == 0) {
+            wheel->tick = ogs_min(now + 1, (wheel->tick | WHEEL_MASK) + 1);
+            continue;
+        }
+
+        if (index == 0) {
+            for (level = 1; level < WHEEL_LEVELS; level++)
+                if (wheel_cascade(wheel, level) != 0)
+                    break;
+        }
+
+        while ((lnode = ogs_list_first(&wheel->slot[0][index]))) {
+            ogs_timer_t *timer = ogs_container_of(lnode, ogs_timer_t, lnode);
+
+            wheel_unlink(wheel, timer);
+            timer->wheel_list = &wheel->expired;
+            ogs_list_add(&wheel->expired, lnode);
+        }
+
+        wheel->tick++;
+    }
+}
+
+static ogs_time_t wheel_next(ogs_timer_wheel_t *wheel, ogs_time_t current)
+{
+    int level, i;
+    int64_t next = INT64_MAX;
+
+    if (ogs_list_first(&wheel->expired))
+        return OGS_NO_WAIT_TIME;
+
+    /*
+     * Earliest non-empty slot of each level. Above level 0 this is
+     * the tick at which the slot is cascaded, which is never later
+     * than any timer it holds.
+     */
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = level * WHEEL_BITS;
+        int64_t first = (wheel->tick + (INT64_C(1) << shift) - 1) >> shift;
+
+        if (!wheel->count[level])
+            continue;
+
+        for (i = 0; i < WHEEL_SIZE; i++) {
+            if (ogs_list_first(
+                    &wheel->slot[level][(first + i) & WHEEL_MASK])) {
+                next = ogs_min(next, (first + i) << shift);
+                break;
+            }
+        }
+    }
+
+    if (next == INT64_MAX)
+        return OGS_INFINITE_TIME;
+
+    next *= WHEEL_TICK;
+    return next > current ? next - current : OGS_NO_WAIT_TIME;
+}
+
 ogs_timer_mgr_t *ogs_timer_mgr_create(unsigned int capacity)
+{
+    return ogs_timer_mgr_create_type(capacity, OGS_TIMER_MGR_RBTREE);
+}
+
+ogs_timer_mgr_t *ogs_timer_mgr_create_type(
+        unsigned int capacity, ogs_timer_mgr_type_e type)
 {
     ogs_timer_mgr_t *manager = ogs_calloc(1, sizeof *manager);
     if (!manager) {
@@ -61,6 +223,18 @@ ogs_timer_mgr_t *ogs_timer_mgr_create(unsigned int capacity)
     }
 
     ogs_pool_init(&manager->pool, capacity);
+    manager->type = type;
+
+    if (type == OGS_TIMER_MGR_WHEEL) {
+        manager->wheel = ogs_calloc(1, sizeof *manager->wheel);
+        if (!manager->wheel) {
+            ogs_error("ogs_calloc() failed");
+            ogs_pool_final(&manager->pool);
+            ogs_free(manager);
+            return NULL;
+        }
+        manager->wheel->tick = wheel_tick_of(ogs_get_monotonic_time());
+    }
 
     return manager;
 }
@@ -69,6 +243,8 @@ void ogs_timer_mgr_destroy(ogs_timer_mgr_t *manager)
 {
     ogs_assert(manager);
 
+    if (manager->wheel)
+        ogs_free(manager->wheel);
     ogs_pool_final(&manager->pool);
     ogs_free(manager);
 }
@@ -140,6 +316,16 @@ void ogs_timer_start_debug(
         ogs_assert_if_reached();
     }
 
+    if (manager->wheel) {
+        if (timer->running == true)
+            wheel_unlink(manager->wheel, timer);
+
+        timer->running = true;
+        timer->timeout = ogs_get_monotonic_time() + duration;
+        wheel_link(manager->wheel, timer);
+        return;
+    }
+
     if (timer->running == true)
         ogs_rbtree_delete(&manager->tree, timer);
 
@@ -167,7 +353,10 @@ void ogs_timer_stop_debug(ogs_timer_t *timer, const char *file_line)
             return;
 
         timer->running = false;
-        ogs_rbtree_delete(&manager->tree, timer);
+        if (manager->wheel)
+            wheel_unlink(manager->wheel, timer);
+        else
+            ogs_rbtree_delete(&manager->tree, timer);
     } else {
         ogs_warn("ogs_timer_delete() was given a NULL reference to a timer");
     }
@@ -186,6 +375,10 @@ ogs_time_t ogs_timer_mgr_next(ogs_timer_mgr_t *manager)
     ogs_assert(manager);
 
     current = ogs_get_monotonic_time();
+
+    if (manager->wheel)
+        return wheel_next(manager->wheel, current);
+
     rbnode = ogs_rbtree_first(&manager->tree);
     if (rbnode) {
         ogs_timer_t *this = ogs_rb_entry(rbnode, ogs_timer_t, rbnode);
@@ -211,6 +404,22 @@ void ogs_timer_mgr_expire(ogs_timer_mgr_t *manager)
 
     current = ogs_get_monotonic_time();
 
+    if (manager->wheel) {
+        /*
+         * Collect every due timer first, then run the callbacks.
+         * A callback stopping a pending timer unlinks it from the list.
+         */
+        wheel_advance(manager->wheel, current / WHEEL_TICK);
+
+        while ((lnode = ogs_list_first(&manager->wheel->expired))) {
+            this = ogs_container_of(lnode, ogs_timer_t, lnode);
+            ogs_timer_stop(this);
+            if (this->cb)
+                this->cb(this->data);
+        }
+        return;
+    }
+
     ogs_rbtree_for_each(&manager->tree, rbnode) {
         this = ogs_rb_entry(rbnode, ogs_timer_t, rbnode);
 
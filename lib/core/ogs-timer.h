@@ -28,6 +28,11 @@
 extern "C" {
 #endif
 
+typedef enum {
+    OGS_TIMER_MGR_RBTREE = 0,
+    OGS_TIMER_MGR_WHEEL,        /* O(1) start/stop, 1ms resolution */
+} ogs_timer_mgr_type_e;
+
 typedef struct ogs_timer_mgr_s ogs_timer_mgr_t;
 typedef struct ogs_timer_s {
     ogs_rbnode_t rbnode;
@@ -39,9 +44,15 @@ typedef struct ogs_timer_s {
     ogs_timer_mgr_t *manager;
     bool running;
     ogs_time_t timeout;
+
+    /* OGS_TIMER_MGR_WHEEL : the slot holding lnode */
+    ogs_list_t *wheel_list;
+    int wheel_level;
 } ogs_timer_t;
 
 ogs_timer_mgr_t *ogs_timer_mgr_create(unsigned int capacity);
+ogs_timer_mgr_t *ogs_timer_mgr_create_type(
+        unsigned int capacity, ogs_timer_mgr_type_e type);
 void ogs_timer_mgr_destroy(ogs_timer_mgr_t *manager);
 
 ogs_timer_t *ogs_timer_add(
@@ -66,6 +66,39 @@ int ogs_aes_cmac_calculate(uint8_t *cmac, const uint8_t *key,
 int ogs_aes_cmac_verify(uint8_t *cmac, const uint8_t *key,
         const uint8_t *msg, const uint32_t len);
 
+/*
+ * A CMAC key with the AES schedule and the K1/K2 subkeys computed once
+ */
+typedef struct ogs_aes_cmac_key_s {
+    ogs_aes_key_t aes;
+    uint8_t k1[OGS_AES_BLOCK_SIZE];
+    uint8_t k2[OGS_AES_BLOCK_SIZE];
+} ogs_aes_cmac_key_t;
+
+/**
+ * Expand the key and generate the subkeys
+ *
+ * @param cmac_key
+ * @param key 128-bit key
+ *
+ * @return OGS_OK
+ */
+int ogs_aes_cmac_key_setup(ogs_aes_cmac_key_t *cmac_key, const uint8_t *key);
+
+/**
+ * Caculate CMAC value with a key from ogs_aes_cmac_key_setup()
+ *
+ * @param cmac
+ * @param cmac_key
+ * @param msg
+ * @param len
+ *
+ * @return OGS_OK
+ */
+int ogs_aes_cmac_key_calculate(uint8_t *cmac,
+        const ogs_aes_cmac_key_t *cmac_key,
+        const uint8_t *msg, const uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif
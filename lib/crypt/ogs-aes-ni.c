@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2019-2020 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ogs-crypt.h"
+#include "ogs-aes-ni.h"
+
+#if OGS_HAVE_AES_NI
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+/*
+ * Built with the target attribute rather than -maes so that the rest of
+ * the library stays generic; ogs_aes_ni_available() gates every call.
+ */
+#define AES_NI_TARGET __attribute__((target("aes,sse2")))
+
+#define AES_NI_ROUNDS 10
+
+bool ogs_aes_ni_available(void)
+{
+    static int available = -1;
+
+    if (available < 0) {
+        __builtin_cpu_init();
+        available = __builtin_cpu_supports("aes") ? 1 : 0;
+    }
+
+    return available;
+}
+
+static AES_NI_TARGET inline __m128i key_expand(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+
+    return _mm_xor_si128(key, assist);
+}
+
+#define KEY_EXPAND(__rK, __i, __rcon) \
+    __rK[__i] = key_expand(__rK[__i-1], \
+            _mm_aeskeygenassist_si128(__rK[__i-1], __rcon))
+
+AES_NI_TARGET void ogs_aes_ni_setup_enc128(uint32_t *rk, const uint8_t *key)
+{
+    __m128i rK[AES_NI_ROUNDS+1];
+    int i;
+
+    rK[0] = _mm_loadu_si128((const __m128i *)key);
+    KEY_EXPAND(rK, 1, 0x01);
+    KEY_EXPAND(rK, 2, 0x02);
+    KEY_EXPAND(rK, 3, 0x04);
+    KEY_EXPAND(rK, 4, 0x08);
+    KEY_EXPAND(rK, 5, 0x10);
+    KEY_EXPAND(rK, 6, 0x20);
+    KEY_EXPAND(rK, 7, 0x40);
+    KEY_EXPAND(rK, 8, 0x80);
+    KEY_EXPAND(rK, 9, 0x1b);
+    KEY_EXPAND(rK, 10, 0x36);
+
+    for (i = 0; i <= AES_NI_ROUNDS; i++)
+        _mm_storeu_si128((__m128i *)rk + i, rK[i]);
+}
+
+static AES_NI_TARGET inline void load_schedule(
+        __m128i *rK, const uint32_t *rk)
+{
+    int i;
+
+    for (i = 0; i <= AES_NI_ROUNDS; i++)
+        rK[i] = _mm_loadu_si128((const __m128i *)rk + i);
+}
+
+static AES_NI_TARGET inline __m128i encrypt_block(
+        const __m128i *rK, __m128i b)
+{
+    int i;
+
+    b = _mm_xor_si128(b, rK[0]);
+    for (i = 1; i < AES_NI_ROUNDS; i++)
+        b = _mm_aesenc_si128(b, rK[i]);
+
+    return _mm_aesenclast_si128(b, rK[AES_NI_ROUNDS]);
+}
+
+AES_NI_TARGET void ogs_aes_ni_encrypt128(const uint32_t *rk,
+        const uint8_t in[16], uint8_t out[16])
+{
+    __m128i rK[AES_NI_ROUNDS+1];
+
+    load_schedule(rK, rk);
+    _mm_storeu_si128((__m128i *)out,
+            encrypt_block(rK, _mm_loadu_si128((const __m128i *)in)));
+}
+
+/* Same 128-bit big-endian counter as ogs_aes_ctr128_encrypt() */
+static void ctr128_inc(uint8_t *counter)
+{
+    uint32_t n = 16, c = 1;
+
+    do {
+        --n;
+        c += counter[n];
+        counter[n] = (uint8_t)c;
+        c >>= 8;
+    } while (n);
+}
+
+AES_NI_TARGET void ogs_aes_ni_ctr128_encrypt(const uint32_t *rk,
+        uint8_t *ivec, const uint8_t *in, uint32_t len, uint8_t *out)
+{
+    __m128i rK[AES_NI_ROUNDS+1];
+    __m128i b[4];
+    uint8_t ks[16];
+    int i, j;
+
+    load_schedule(rK, rk);
+
+    /* Four independent blocks keep the AESENC pipeline full */
+    while (len >= 64) {
+        for (j = 0; j < 4; j++) {
+            b[j] = _mm_xor_si128(
+                    _mm_loadu_si128((const __m128i *)ivec), rK[0]);
+            ctr128_inc(ivec);
+        }
+        for (i = 1; i < AES_NI_ROUNDS; i++)
+            for (j = 0; j < 4; j++)
+                b[j] = _mm_aesenc_si128(b[j], rK[i]);
+        for (j = 0; j < 4; j++) {
+            b[j] = _mm_aesenclast_si128(b[j], rK[AES_NI_ROUNDS]);
+            _mm_storeu_si128((__m128i *)out + j, _mm_xor_si128(b[j],
+                    _mm_loadu_si128((const __m128i *)in + j)));
+        }
+        len -= 64;
+        in += 64;
+        out += 64;
+    }
+
+    while (len >= 16) {
+        b[0] = encrypt_block(rK, _mm_loadu_si128((const __m128i *)ivec));
+        ctr128_inc(ivec);
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(b[0],
+                _mm_loadu_si128((const __m128i *)in)));
+        len -= 16;
+        in += 16;
+        out += 16;
+    }
+
+    if (len) {
+        _mm_storeu_si128((__m128i *)ks,
+                encrypt_block(rK, _mm_loadu_si128((const __m128i *)ivec)));
+        ctr128_inc(ivec);
+        for (i = 0; i < len; i++)
+            out[i] = in[i] ^ ks[i];
+    }
+}
+
+#else /* OGS_HAVE_AES_NI */
+
+bool ogs_aes_ni_available(void)
+{
+    return false;
+}
+
+void ogs_aes_ni_setup_enc128(uint32_t *rk, const uint8_t *key)
+{
+    ogs_assert_if_reached();
+}
+
+void ogs_aes_ni_encrypt128(const uint32_t *rk,
+        const uint8_t in[16], uint8_t out[16])
+{
+    ogs_assert_if_reached();
+}
+
+void ogs_aes_ni_ctr128_encrypt(const uint32_t *rk,
+        uint8_t *ivec, const uint8_t *in, uint32_t len, uint8_t *out)
+{
+    ogs_assert_if_reached();
+}
+
+#endif /* OGS_HAVE_AES_NI */
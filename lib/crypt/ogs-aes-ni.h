@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019-2020 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(OGS_CRYPT_COMPILATION)
+#error "This header cannot be included directly."
+#endif
+
+#ifndef OGS_AES_NI_H
+#define OGS_AES_NI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * AES-NI kernels behind ogs_aes_key_t. Only AES-128 is accelerated,
+ * which is all EEA2/EIA2 use; the round keys are kept in the byte order
+ * AESENC expects, so a schedule built here must only be used here.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define OGS_HAVE_AES_NI 1
+#endif
+
+bool ogs_aes_ni_available(void);
+
+void ogs_aes_ni_setup_enc128(uint32_t *rk, const uint8_t *key);
+void ogs_aes_ni_encrypt128(const uint32_t *rk,
+        const uint8_t in[16], uint8_t out[16]);
+void ogs_aes_ni_ctr128_encrypt(const uint32_t *rk,
+        uint8_t *ivec, const uint8_t *in, uint32_t len, uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OGS_AES_NI_H */
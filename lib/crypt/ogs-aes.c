@@ -26,6 +26,7 @@
  */
 
 #include "ogs-crypt.h"
+#include "ogs-aes-ni.h"
 
 #define FULL_UNROLL
 
@@ -1404,34 +1405,11 @@ static void ctr128_inc_aligned(uint8_t *counter)
     } while (n);
 }
 
-int ogs_aes_ctr128_encrypt(const uint8_t *key,
-        uint8_t *ivec, const uint8_t *in, const uint32_t inlen,
-        uint8_t *out)
+static void ctr128_encrypt(const uint32_t *rk, int nrounds,
+        uint8_t *ivec, const uint8_t *in, uint32_t len, uint8_t *out)
 {
     uint8_t ecount_buf[16];
-    uint32_t len = inlen;
-
-    uint32_t rk[OGS_AES_RKLENGTH(OGS_AES_MAX_KEY_BITS)];
-    int nrounds;
-
     uint32_t n = 0;
-    size_t l = 0;
-
-    ogs_assert(key);
-    ogs_assert(ivec);
-    ogs_assert(in);
-    ogs_assert(len);
-    ogs_assert(out);
-
-    memset(ecount_buf, 0, 16);
-    nrounds = ogs_aes_setup_enc(rk, key, 128);
-
-    while (n && len) 
-    {
-        *(out++) = *(in++) ^ ecount_buf[n];
-        --len;
-        n = (n + 1) % 16;
-    }
 
     while (len >= 16) 
     {
@@ -1455,21 +1433,86 @@ int ogs_aes_ctr128_encrypt(const uint8_t *key,
             ++n;
         }
     }
-    return OGS_OK;
+}
 
-    /* low-performance for understanding the aes-ctr128 */
-    while (l < len) 
-    {
-        if (n == 0) 
-        {
-            ogs_aes_encrypt(rk, nrounds, ivec, ecount_buf);
-            ctr128_inc(ivec);
-        }
-        out[l] = in[l] ^ ecount_buf[n];
-        ++l;
-        n = (n + 1) % 16;
+int ogs_aes_ctr128_encrypt(const uint8_t *key,
+        uint8_t *ivec, const uint8_t *in, const uint32_t inlen,
+        uint8_t *out)
+{
+    ogs_aes_key_t aes_key;
+
+    ogs_assert(key);
+    ogs_assert(ivec);
+    ogs_assert(in);
+    ogs_assert(inlen);
+    ogs_assert(out);
+
+    ogs_aes_key_setup_enc(&aes_key, key, 128);
+
+    return ogs_aes_key_ctr128_encrypt(&aes_key, ivec, in, inlen, out);
+}
+
+static bool hw_enabled = true;
+
+bool ogs_aes_hw_available(void)
+{
+    return ogs_aes_ni_available();
+}
+
+void ogs_aes_hw_enable(bool enable)
+{
+    hw_enabled = enable;
+}
+
+/**
+ * Expand the cipher key once for ogs_aes_key_encrypt() and
+ * ogs_aes_key_ctr128_encrypt().
+ *
+ * @return the number of rounds for the given cipher key size.
+ */
+int ogs_aes_key_setup_enc(ogs_aes_key_t *aes_key,
+        const uint8_t *key, int keybits)
+{
+    ogs_assert(aes_key);
+    ogs_assert(key);
+
+    if (keybits == 128 && hw_enabled && ogs_aes_ni_available()) {
+        ogs_aes_ni_setup_enc128(aes_key->rk, key);
+        aes_key->nrounds = OGS_AES_NROUNDS(128);
+        aes_key->hw = true;
+    } else {
+        aes_key->nrounds = ogs_aes_setup_enc(aes_key->rk, key, keybits);
+        aes_key->hw = false;
     }
 
-    return OGS_OK;
+    return aes_key->nrounds;
 }
 
+void ogs_aes_key_encrypt(const ogs_aes_key_t *aes_key,
+        const uint8_t plaintext[16], uint8_t ciphertext[16])
+{
+    ogs_assert(aes_key);
+
+    if (aes_key->hw)
+        ogs_aes_ni_encrypt128(aes_key->rk, plaintext, ciphertext);
+    else
+        ogs_aes_encrypt(aes_key->rk, aes_key->nrounds, plaintext, ciphertext);
+}
+
+int ogs_aes_key_ctr128_encrypt(const ogs_aes_key_t *aes_key,
+        uint8_t *ivec, const uint8_t *in, const uint32_t inlen,
+        uint8_t *out)
+{
+    ogs_assert(aes_key);
+    ogs_assert(ivec);
+    ogs_assert(in);
+    ogs_assert(inlen);
+    ogs_assert(out);
+
+    if (aes_key->hw)
+        ogs_aes_ni_ctr128_encrypt(aes_key->rk, ivec, in, inlen, out);
+    else
+        ctr128_encrypt(aes_key->rk, aes_key->nrounds, ivec, in, inlen, out);
+
+    return OGS_OK;
+}
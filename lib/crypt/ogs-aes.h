@@ -64,6 +64,29 @@ int ogs_aes_ctr128_encrypt(const uint8_t *key,
         uint8_t *ivec, const uint8_t *in, const uint32_t inlen,
         uint8_t *out);
 
+/*
+ * An expanded encryption key, for callers that use the same key on
+ * many messages. AES-128 schedules use AES-NI when the CPU has it,
+ * otherwise the table-based code above; the schedule records which.
+ */
+typedef struct ogs_aes_key_s {
+    uint32_t rk[OGS_AES_RKLENGTH(OGS_AES_MAX_KEY_BITS)];
+    int nrounds;
+    bool hw;
+} ogs_aes_key_t;
+
+int ogs_aes_key_setup_enc(ogs_aes_key_t *aes_key,
+        const uint8_t *key, int keybits);
+void ogs_aes_key_encrypt(const ogs_aes_key_t *aes_key,
+        const uint8_t plaintext[16], uint8_t ciphertext[16]);
+int ogs_aes_key_ctr128_encrypt(const ogs_aes_key_t *aes_key,
+        uint8_t *ivec, const uint8_t *in, const uint32_t inlen,
+        uint8_t *out);
+
+/* AES-NI is used by default when available; tests turn it off to compare */
+bool ogs_aes_hw_available(void);
+void ogs_aes_hw_enable(bool enable);
+
 #ifdef __cplusplus
 }
 #endif
@@ -144,44 +144,55 @@ u32 DIValpha(u8 c)
 		( ((u32)MULxPOW(c, 64, 0xa9)) ) ) ;
 }
 
-/* The 32x32-bit S-Box S1
-* Input: a 32-bit input.
-* Output: a 32-bit output of S1 box.
-* See section 3.3.1.
+/* MixColumn.
+* Input w0..w3: the four bytes of a word after the S-box.
+* Input c: an 8-bit input.
+* Output: a 32-bit output.
+* The linear step shared by S1 and S2, see sections 3.3.1 and 3.3.2.
 */
 
-u32 S1(u32 w)
+static u32 MixColumn(u8 w0, u8 w1, u8 w2, u8 w3, u8 c)
 {
 	u8 r0=0, r1=0, r2=0, r3=0;
-	u8 srw0 = SR[ (u8)((w >> 24) & 0xff) ];
-	u8 srw1 = SR[ (u8)((w >> 16) & 0xff) ];
-	u8 srw2 = SR[ (u8)((w >> 8) & 0xff) ];
-	u8 srw3 = SR[ (u8)((w) & 0xff) ];
-	r0 = ( ( MULx( srw0 , 0x1b) ) ^
-		( srw1 ) ^
-		( srw2 ) ^
-		( (MULx( srw3, 0x1b)) ^ srw3 )
+	r0 = ( ( MULx( w0 , c) ) ^
+		( w1 ) ^
+		( w2 ) ^
+		( (MULx( w3, c)) ^ w3 )
 	);
-	r1 = ( ( ( MULx( srw0 , 0x1b) ) ^ srw0 ) ^
-		( MULx(srw1, 0x1b) ) ^
-		( srw2 ) ^
-		( srw3 )
+	r1 = ( ( ( MULx( w0 , c) ) ^ w0 ) ^
+		( MULx(w1, c) ) ^
+		( w2 ) ^
+		( w3 )
 	);
-	r2 = ( ( srw0 ) ^
-		( ( MULx( srw1 , 0x1b) ) ^ srw1 ) ^
-		( MULx(srw2, 0x1b) ) ^
-		( srw3 )
+	r2 = ( ( w0 ) ^
+		( ( MULx( w1 , c) ) ^ w1 ) ^
+		( MULx(w2, c) ) ^
+		( w3 )
 	);
-	r3 = ( ( srw0 ) ^
-		( srw1 ) ^
-		( ( MULx( srw2 , 0x1b) ) ^ srw2 ) ^
-		( MULx( srw3, 0x1b) )
+	r3 = ( ( w0 ) ^
+		( w1 ) ^
+		( ( MULx( w2 , c) ) ^ w2 ) ^
+		( MULx( w3, c) )
 	);
 
 	return ( ( ((u32)r0) << 24 ) | ( ((u32)r1) << 16 ) | ( ((u32)r2) << 8 ) |
 		( ((u32)r3) ) );
 }
 
+/* The 32x32-bit S-Box S1
+* Input: a 32-bit input.
+* Output: a 32-bit output of S1 box.
+* See section 3.3.1.
+*/
+
+u32 S1(u32 w)
+{
+	return MixColumn(SR[ (u8)((w >> 24) & 0xff) ],
+		SR[ (u8)((w >> 16) & 0xff) ],
+		SR[ (u8)((w >> 8) & 0xff) ],
+		SR[ (u8)((w) & 0xff) ], 0x1b);
+}
+
 /* The 32x32-bit S-Box S2
 * Input: a 32-bit input.
 * Output: a 32-bit output of S2 box.
@@ -190,35 +201,55 @@ u32 S1(u32 w)
 
 u32 S2(u32 w)
 {
-	u8 r0=0, r1=0, r2=0, r3=0;
-	u8 sqw0 = SQ[ (u8)((w >> 24) & 0xff) ];
-	u8 sqw1 = SQ[ (u8)((w >> 16) & 0xff) ];
-	u8 sqw2 = SQ[ (u8)((w >> 8) & 0xff) ];
-	u8 sqw3 = SQ[ (u8)((w) & 0xff) ];
-	r0 = ( ( MULx( sqw0 , 0x69) ) ^
-		( sqw1 ) ^
-		( sqw2 ) ^
-		( (MULx( sqw3, 0x69)) ^ sqw3 )
-	);
-	r1 = ( ( ( MULx( sqw0 , 0x69) ) ^ sqw0 ) ^
-		( MULx(sqw1, 0x69) ) ^
-		( sqw2 ) ^
-		( sqw3 )
-	);
-	r2 = ( ( sqw0 ) ^
-		( ( MULx( sqw1 , 0x69) ) ^ sqw1 ) ^
-		( MULx(sqw2, 0x69) ) ^
-		( sqw3 )
-	);
-	r3 = ( ( sqw0 ) ^
-		( sqw1 ) ^
-		( ( MULx( sqw2 , 0x69) ) ^ sqw2 ) ^
-		( MULx( sqw3, 0x69) )
-	);
-	return ( ( ((u32)r0) << 24 ) | ( ((u32)r1) << 16 ) | ( ((u32)r2) << 8 ) |
-		( ((u32)r3) ) );
+	return MixColumn(SQ[ (u8)((w >> 24) & 0xff) ],
+		SQ[ (u8)((w >> 16) & 0xff) ],
+		SQ[ (u8)((w >> 8) & 0xff) ],
+		SQ[ (u8)((w) & 0xff) ], 0x69);
 }
 
+/* Word-oriented tables.
+* MULalpha and DIValpha depend on one byte, and S1/S2 are linear once
+* SR/SQ have been applied, so each becomes one 256-entry lookup per input
+* byte. The tables are built once from the reference functions above so
+* that the MULxPOW recursion stays off the clocking path. Building them
+* twice from two threads stores the same values, which is harmless.
+*/
+
+static u32 MULalpha_T[256];
+static u32 DIValpha_T[256];
+static u32 S1_T[4][256];
+static u32 S2_T[4][256];
+static int Tables_Ready = 0;
+
+static void BuildTables(void)
+{
+	int i;
+
+	if (Tables_Ready)
+		return;
+
+	for (i=0; i<256; i++)
+	{
+		MULalpha_T[i] = MULalpha((u8)i);
+		DIValpha_T[i] = DIValpha((u8)i);
+
+		S1_T[0][i] = MixColumn(SR[i], 0, 0, 0, 0x1b);
+		S1_T[1][i] = MixColumn(0, SR[i], 0, 0, 0x1b);
+		S1_T[2][i] = MixColumn(0, 0, SR[i], 0, 0x1b);
+		S1_T[3][i] = MixColumn(0, 0, 0, SR[i], 0x1b);
+
+		S2_T[0][i] = MixColumn(SQ[i], 0, 0, 0, 0x69);
+		S2_T[1][i] = MixColumn(0, SQ[i], 0, 0, 0x69);
+		S2_T[2][i] = MixColumn(0, 0, SQ[i], 0, 0x69);
+		S2_T[3][i] = MixColumn(0, 0, 0, SQ[i], 0x69);
+	}
+
+	Tables_Ready = 1;
+}
+
+#define S_T(T, w) ( T[0][(w) >> 24] ^ T[1][((w) >> 16) & 0xff] ^ \
+		T[2][((w) >> 8) & 0xff] ^ T[3][(w) & 0xff] )
+
 /* Clocking LFSR in initialization mode.
 * LFSR Registers S0 to S15 are updated as the LFSR receives a single clock.
 * Input F: a 32-bit word comes from output of FSM.
@@ -228,10 +259,10 @@ u32 S2(u32 w)
 void ClockLFSRInitializationMode(u32 F)
 {
 	u32 v = ( ( (LFSR_S0 << 8) & 0xffffff00 ) ^
-		( MULalpha( (u8)((LFSR_S0>>24) & 0xff) ) ) ^
+		( MULalpha_T[ (u8)((LFSR_S0>>24) & 0xff) ] ) ^
 		( LFSR_S2 ) ^
 		( (LFSR_S11 >> 8) & 0x00ffffff ) ^
-		( DIValpha( (u8)( ( LFSR_S11) & 0xff ) ) ) ^
+		( DIValpha_T[ (u8)( ( LFSR_S11) & 0xff ) ] ) ^
 		( F )
 	);
 	LFSR_S0 = LFSR_S1;
@@ -260,10 +291,10 @@ void ClockLFSRInitializationMode(u32 F)
 void ClockLFSRKeyStreamMode(void)
 {
 	u32 v = ( ( (LFSR_S0 << 8) & 0xffffff00 ) ^
-		( MULalpha( (u8)((LFSR_S0>>24) & 0xff) ) ) ^
+		( MULalpha_T[ (u8)((LFSR_S0>>24) & 0xff) ] ) ^
 		( LFSR_S2 ) ^
 		( (LFSR_S11 >> 8) & 0x00ffffff ) ^
-		( DIValpha( (u8)( ( LFSR_S11) & 0xff ) ) )
+		( DIValpha_T[ (u8)( ( LFSR_S11) & 0xff ) ] )
 	);
 	LFSR_S0 = LFSR_S1;
 	LFSR_S1 = LFSR_S2;
@@ -293,8 +324,8 @@ u32 ClockFSM(void)
 {
 	u32 F = ( ( LFSR_S15 + FSM_R1 ) & 0xffffffff ) ^ FSM_R2 ;
 	u32 r = ( FSM_R2 + ( FSM_R3 ^ LFSR_S5 ) ) & 0xffffffff ;
-	FSM_R3 = S2(FSM_R2);
-	FSM_R2 = S1(FSM_R1);
+	FSM_R3 = S_T(S2_T, FSM_R2);
+	FSM_R2 = S_T(S1_T, FSM_R1);
 	FSM_R1 = r;
 	return F;
 }
@@ -310,6 +341,7 @@ void snow_3g_initialize(u32 k[4], u32 IV[4])
 {
 	u8 i=0;
 	u32 F = 0x0;
+	BuildTables();
 	LFSR_S15 = k[3] ^ IV[0];
 	LFSR_S14 = k[2];
 	LFSR_S13 = k[1];
@@ -389,13 +421,16 @@ void snow_3g_generate_key_stream(u32 n, u32 *ks)
 * defined in Section 3.
 */
 
+#define SNOW_3G_KS_CHUNK 16
+
 void snow_3g_f8(u8 *key, u32 count, u32 bearer, u32 dir, u8 *data, u32 length)
 {
 	u32 K[4],IV[4];
 	int n = ( length + 31 ) / 32;
-	int i=0;
+	int bytes = ( length + 7 ) / 8;
+	int i=0, j=0;
 	int lastbits = (8-(length%8)) % 8;
-	u32 *KS;
+	u32 KS[SNOW_3G_KS_CHUNK];
 	
 	/*Initialisation*/
 	/* Load the confidentiality key for SNOW 3G initialization as in section
@@ -411,24 +446,26 @@ void snow_3g_f8(u8 *key, u32 count, u32 bearer, u32 dir, u8 *data, u32 length)
 	IV[1] = IV[3];
 	IV[0] = IV[2];
 	
-	/* Run SNOW 3G algorithm to generate sequence of key stream bits KS*/
+	/* Run SNOW 3G algorithm to generate sequence of key stream bits KS,
+	a chunk at a time instead of into a buffer sized for the whole message */
 	snow_3g_initialize(K,IV);
-	KS = (u32 *)ogs_malloc(4*n);
-    ogs_assert(KS);
-	snow_3g_generate_key_stream(n,(u32*)KS);
+	ClockFSM(); /* Clock FSM once. Discard the output. */
+	ClockLFSRKeyStreamMode(); /* Clock LFSR in keystream mode once. */
 	
 	/* Exclusive-OR the input data with keystream to generate the output bit
-	stream */
-	for (i=0; i<n; i++)
+	stream. Only the bytes that carry the length bits are touched */
+	for (i=0; i<n; i+=SNOW_3G_KS_CHUNK)
 	{
-		data[4*i+0] ^= (u8) (KS[i] >> 24) & 0xff;
-		data[4*i+1] ^= (u8) (KS[i] >> 16) & 0xff;
-		data[4*i+2] ^= (u8) (KS[i] >> 8) & 0xff;
-		data[4*i+3] ^= (u8) (KS[i] ) & 0xff;
+		int chunk = ogs_min(n-i, SNOW_3G_KS_CHUNK);
+		for (j=0; j<chunk; j++)
+		{
+			KS[j] = ClockFSM() ^ LFSR_S0;
+			ClockLFSRKeyStreamMode();
+		}
+		for (j=0; j<chunk*4 && 4*i+j<bytes; j++)
+			data[4*i+j] ^= (u8) (KS[j/4] >> (24-8*(j%4))) & 0xff;
 	}
 	
-	ogs_free(KS);
-	
 	/* zero last bits of data in case its length is not byte-aligned 
 	   this is an addition to the C reference code, which did not handle it */
 	if (lastbits)
@@ -484,12 +521,15 @@ u64 MUL64xPOW(u64 V, u8 i, u64 c)
 u64 MUL64(u64 V, u64 P, u64 c)
 {
 	u64 result = 0;
-	int i = 0;
 
-	for ( i=0; i<64; i++)
+	/* V*x^i is carried from one bit of P to the next rather than
+	   recomputed by MUL64xPOW() from V for every set bit */
+	while (P)
 	{
-		if( ( P>>i ) & 0x1 )
-			result ^= MUL64xPOW(V,i,c);
+		if( P & 0x1 )
+			result ^= V;
+		V = MUL64x(V,c);
+		P >>= 1;
 	}
 	return result;
 }
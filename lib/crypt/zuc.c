@@ -287,15 +287,19 @@ void ZUC(u8* k, u8* iv, u32* ks, u32 len)
  * EEA3: LTE Encryption Algorithm 3
  * EEA3.c
 */
+/* NAS messages fit in this keystream without going to the heap */
+#define ZUC_KS_STACK 64
+
 void zuc_eea3(u8* CK, u32 COUNT, u32 BEARER, u32 DIRECTION, 
 				   u32 LENGTH, u8* M, u8* C)
 {
 	u32 *z, L, L8, i;
+	u32 zbuf[ZUC_KS_STACK];
 	u8 	IV[16];
 	u32 lastbits = (8-(LENGTH%8))%8;
     
 	L 	= (LENGTH+31)/32;
-	z 	= (u32 *) ogs_malloc(L*sizeof(u32));
+	z 	= L <= ZUC_KS_STACK ? zbuf : (u32 *) ogs_malloc(L*sizeof(u32));
     ogs_assert(z);
     
 	L8 	= (LENGTH+7)/8;
@@ -333,7 +337,8 @@ void zuc_eea3(u8* CK, u32 COUNT, u32 BEARER, u32 DIRECTION,
         i--;
 		C[i] &= 0x100 - (1<<lastbits);
 	
-	ogs_free(z);
+	if (z != zbuf)
+		ogs_free(z);
 }
 /* end of EEA3.c */
 
@@ -364,7 +369,9 @@ u8 GET_BIT(u8 * DATA, u32 i)
 void zuc_eia3(u8* IK, u32 COUNT, u32 BEARER, u32 DIRECTION,
 				   u32 LENGTH, u8* M, u32* MAC)
 {
-	u32	*z, N, L, T, i;
+	u32	*z, N, L, T, i, j, W;
+	u32 zbuf[ZUC_KS_STACK];
+	uint64_t K;
 	u8 IV[16];
 
 	IV[0]	= (COUNT>>24) & 0xFF;
@@ -387,19 +394,31 @@ void zuc_eia3(u8* IK, u32 COUNT, u32 BEARER, u32 DIRECTION,
 	
 	N	= LENGTH + 64;
 	L	= (N + 31) / 32;
-	z	= (u32 *) ogs_malloc(L*sizeof(u32));
+	z	= L <= ZUC_KS_STACK ? zbuf : (u32 *) ogs_malloc(L*sizeof(u32));
     ogs_assert(z);
 	ZUC(IK, IV, z, L);
 	
+	/* A word of message at a time: for each set bit j of the word, the
+	   keystream word starting at that bit is a shift of the 64-bit window
+	   over z[i/32] and z[i/32+1], instead of GET_BIT()/GET_WORD() per bit */
 	T = 0;
-	for (i=0; i<LENGTH; i++) {
-		if (GET_BIT(M,i)) {
-			T ^= GET_WORD(z,i);
+	for (i=0; i<LENGTH; i+=32) {
+		W = 0;
+		for (j=0; j<4 && i+8*j<LENGTH; j++)
+			W |= (u32)M[i/8+j] << (24-8*j);
+		if (LENGTH-i < 32)
+			W &= ~(0xffffffff >> (LENGTH-i));
+
+		K = ((uint64_t)z[i/32] << 32) | z[i/32+1];
+		for (j=0; W; j++, W <<= 1) {
+			if (W & 0x80000000)
+				T ^= (u32)(K >> (32-j));
 		}
 	}
 	T ^= GET_WORD(z,LENGTH);
 	
 	*MAC = T ^ z[L-1];
-	ogs_free(z);
+	if (z != zbuf)
+		ogs_free(z);
 }
 /* end of EIA3.c */
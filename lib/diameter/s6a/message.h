@@ -32,6 +32,7 @@ extern "C" {
 
 #define OGS_DIAM_S6A_APPLICATION_ID                     16777251
 
+#define OGS_DIAM_S6A_AVP_CODE_E_UTRAN_VECTOR            (1414)
 #define OGS_DIAM_S6A_AVP_CODE_CONTEXT_IDENTIFIER        (1423)
 #define OGS_DIAM_S6A_AVP_CODE_ALL_APN_CONFIG_INC_IND    (1428)
 #define OGS_DIAM_S6A_AVP_CODE_APN_CONFIGURATION         (1430)
@@ -162,7 +163,10 @@ typedef struct ogs_diam_e_utran_vector_s {
 } ogs_diam_e_utran_vector_t;
 
 typedef struct ogs_diam_s6a_aia_message_s {
-    ogs_diam_e_utran_vector_t e_utran_vector;
+#define OGS_DIAM_S6A_MAX_NUM_OF_E_UTRAN_VECTOR 5
+    int num_of_e_utran_vector;
+    ogs_diam_e_utran_vector_t
+        e_utran_vector[OGS_DIAM_S6A_MAX_NUM_OF_E_UTRAN_VECTOR];
 } ogs_diam_s6a_aia_message_t;
 
 typedef struct ogs_diam_s6a_ula_message_s {
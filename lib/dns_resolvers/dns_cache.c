@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2023 by Ryan Dimsey <ryan@omnitouch.com.au>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <netdb.h>
+#include "dns_cache.h"
+#include "ogs-dns-resolvers-logging.h"
+
+typedef struct dns_cache_entry_s {
+    ogs_lnode_t lnode;          /* LRU, least recently used first */
+
+    ogs_hash_t *hash;           /* Table the entry belongs to */
+    char *key;
+    ogs_time_t expires;
+
+    /* NAPTR, records are copies and array points into them */
+    naptr_resource_record *records;
+    naptr_resource_record **array;
+    int count;
+
+    /* A/SRV */
+    char ip[DNS_CACHE_MAX_IP_STR];
+    int num_ips;
+} dns_cache_entry_t;
+
+static struct {
+    bool enabled;
+    ogs_thread_mutex_t mutex;
+
+    ogs_hash_t *naptr_hash;
+    ogs_hash_t *ip_hash;
+    ogs_list_t lru_list;
+    int num_of_entries;
+
+    int max_entries;
+    uint32_t negative_ttl_sec;
+    uint32_t max_ttl_sec;
+} self;
+
+static dns_cache_entry_t *entry_find(ogs_hash_t *hash, const char *key);
+static dns_cache_entry_t *entry_add(
+        ogs_hash_t *hash, const char *key, uint32_t ttl);
+static void entry_remove(dns_cache_entry_t *entry);
+
+void dns_cache_init(int max_entries,
+        uint32_t negative_ttl_sec, uint32_t max_ttl_sec) {
+    ogs_assert(max_entries > 0);
+    ogs_assert(false == self.enabled);
+
+    self.naptr_hash = ogs_hash_make();
+    ogs_assert(self.naptr_hash);
+    self.ip_hash = ogs_hash_make();
+    ogs_assert(self.ip_hash);
+    ogs_list_init(&self.lru_list);
+    self.num_of_entries = 0;
+
+    self.max_entries = max_entries;
+    self.negative_ttl_sec = negative_ttl_sec;
+    self.max_ttl_sec = max_ttl_sec;
+
+    ogs_thread_mutex_init(&self.mutex);
+    self.enabled = true;
+}
+
+void dns_cache_final(void) {
+    dns_cache_entry_t *entry = NULL, *next_entry = NULL;
+
+    if (false == self.enabled) return;
+
+    ogs_list_for_each_safe(&self.lru_list, next_entry, entry)
+        entry_remove(entry);
+
+    ogs_hash_destroy(self.naptr_hash);
+    ogs_hash_destroy(self.ip_hash);
+    ogs_thread_mutex_destroy(&self.mutex);
+
+    memset(&self, 0, sizeof(self));
+}
+
+bool dns_cache_enabled(void) {
+    return self.enabled;
+}
+
+uint32_t dns_cache_negative_ttl(int herrno) {
+    /* The name or the record type does not exist, the answer
+     * will be the same next time. Anything else may be transient */
+    if ((HOST_NOT_FOUND == herrno) || (NO_DATA == herrno))
+        return self.negative_ttl_sec;
+
+    return 0;
+}
+
+dns_cache_result_e dns_cache_naptr_select(
+        const char *key, naptr_resource_record *selected) {
+    dns_cache_entry_t *entry = NULL;
+    naptr_resource_record *nrr = NULL;
+    dns_cache_result_e result;
+
+    if ((false == self.enabled) || (NULL == key) || (NULL == selected))
+        return DNS_CACHE_MISS;
+
+    ogs_thread_mutex_lock(&self.mutex);
+
+    entry = entry_find(self.naptr_hash, key);
+    if (NULL == entry) {
+        result = DNS_CACHE_MISS;
+    } else if (0 == entry->count) {
+        ogs_debug("[NAPTR-cache] Negative hit for '%s'", key);
+        result = DNS_CACHE_NEGATIVE;
+    } else {
+        /* Selection is still made per call so load keeps being
+         * spread across the records while the set is cached */
+        nrr = naptr_random_select(entry->array, entry->count);
+        if (NULL == nrr) {
+            result = DNS_CACHE_MISS;
+        } else {
+            memcpy(selected, nrr, sizeof(*selected));
+            selected->prev = NULL;
+            selected->next = NULL;
+
+            ogs_debug("[NAPTR-cache] Hit for '%s'", key);
+            result = DNS_CACHE_HIT;
+        }
+    }
+
+    ogs_thread_mutex_unlock(&self.mutex);
+
+    return result;
+}
+
+void dns_cache_naptr_put(const char *key,
+        naptr_resource_record **array, int count, uint32_t ttl) {
+    dns_cache_entry_t *entry = NULL;
+    int i;
+
+    if ((false == self.enabled) || (NULL == key)) return;
+    if ((count > 0) && (NULL == array)) return;
+
+    ogs_thread_mutex_lock(&self.mutex);
+
+    entry = entry_add(self.naptr_hash, key, ttl);
+    if ((NULL != entry) && (count > 0)) {
+        entry->records = ogs_calloc(count, sizeof(*entry->records));
+        ogs_assert(entry->records);
+        entry->array = ogs_calloc(count, sizeof(*entry->array));
+        ogs_assert(entry->array);
+
+        /* Order of the set is kept as given */
+        for (i = 0; i < count; i++) {
+            memcpy(&entry->records[i], array[i], sizeof(entry->records[i]));
+            entry->records[i].prev = NULL;
+            entry->records[i].next = NULL;
+            entry->array[i] = &entry->records[i];
+        }
+        entry->count = count;
+    }
+
+    ogs_thread_mutex_unlock(&self.mutex);
+}
+
+dns_cache_result_e dns_cache_ip_get(const char *key,
+        char *buf, size_t buf_sz, int *num_ips) {
+    dns_cache_entry_t *entry = NULL;
+    dns_cache_result_e result;
+
+    if ((false == self.enabled) || (NULL == key) || (NULL == buf))
+        return DNS_CACHE_MISS;
+
+    ogs_thread_mutex_lock(&self.mutex);
+
+    entry = entry_find(self.ip_hash, key);
+    if (NULL == entry) {
+        result = DNS_CACHE_MISS;
+    } else {
+        if (num_ips) *num_ips = entry->num_ips;
+
+        if (0 == entry->num_ips) {
+            ogs_debug("[IP-cache] Negative hit for '%s'", key);
+            result = DNS_CACHE_NEGATIVE;
+        } else {
+            ogs_cpystrn(buf, entry->ip, buf_sz);
+            ogs_debug("[IP-cache] Hit for '%s' : '%s'", key, buf);
+            result = DNS_CACHE_HIT;
+        }
+    }
+
+    ogs_thread_mutex_unlock(&self.mutex);
+
+    return result;
+}
+
+void dns_cache_ip_put(const char *key,
+        const char *ip, int num_ips, uint32_t ttl) {
+    dns_cache_entry_t *entry = NULL;
+
+    if ((false == self.enabled) || (NULL == key)) return;
+    if ((num_ips > 0) && (NULL == ip)) return;
+
+    ogs_thread_mutex_lock(&self.mutex);
+
+    entry = entry_add(self.ip_hash, key, ttl);
+    if ((NULL != entry) && (num_ips > 0)) {
+        ogs_cpystrn(entry->ip, ip, sizeof(entry->ip));
+        entry->num_ips = num_ips;
+    }
+
+    ogs_thread_mutex_unlock(&self.mutex);
+}
+
+static dns_cache_entry_t *entry_find(ogs_hash_t *hash, const char *key) {
+    dns_cache_entry_t *entry = NULL;
+
+    ogs_assert(hash);
+    ogs_assert(key);
+
+    entry = ogs_hash_get(hash, key, OGS_HASH_KEY_STRING);
+    if (NULL == entry) return NULL;
+
+    if (entry->expires <= ogs_get_monotonic_time()) {
+        entry_remove(entry);
+        return NULL;
+    }
+
+    /* Most recently used go last */
+    ogs_list_remove(&self.lru_list, entry);
+    ogs_list_add(&self.lru_list, entry);
+
+    return entry;
+}
+
+static dns_cache_entry_t *entry_add(
+        ogs_hash_t *hash, const char *key, uint32_t ttl) {
+    dns_cache_entry_t *entry = NULL;
+
+    ogs_assert(hash);
+    ogs_assert(key);
+
+    entry = ogs_hash_get(hash, key, OGS_HASH_KEY_STRING);
+    if (entry) entry_remove(entry);
+
+    ttl = ogs_min(ttl, self.max_ttl_sec);
+    if (0 == ttl) return NULL;
+
+    if (self.num_of_entries >= self.max_entries)
+        entry_remove(ogs_list_first(&self.lru_list));
+
+    entry = ogs_calloc(1, sizeof(*entry));
+    ogs_assert(entry);
+
+    entry->hash = hash;
+    entry->key = ogs_strdup(key);
+    ogs_assert(entry->key);
+    entry->expires = ogs_get_monotonic_time() + ogs_time_from_sec(ttl);
+
+    ogs_hash_set(hash, entry->key, OGS_HASH_KEY_STRING, entry);
+    ogs_list_add(&self.lru_list, entry);
+    self.num_of_entries++;
+
+    return entry;
+}
+
+static void entry_remove(dns_cache_entry_t *entry) {
+    ogs_assert(entry);
+
+    ogs_hash_set(entry->hash, entry->key, OGS_HASH_KEY_STRING, NULL);
+    ogs_list_remove(&self.lru_list, entry);
+    self.num_of_entries--;
+
+    if (entry->records) ogs_free(entry->records);
+    if (entry->array) ogs_free(entry->array);
+    ogs_free(entry->key);
+    ogs_free(entry);
+}
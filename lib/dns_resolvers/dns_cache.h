@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2023 by Ryan Dimsey <ryan@omnitouch.com.au>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "naptr.h"
+
+/*
+ * Cache in front of res_query() for the NAPTR and A/SRV lookups done
+ * by resolve_naptr() and resolve_sgw_naptr().
+ *
+ * NAPTR entries hold the already filtered (and sorted) record set so a
+ * hit only costs the random selection. Entries live for the smallest
+ * TTL of the answer, capped at max_ttl_sec. Names that do not exist or
+ * have no usable records are cached for negative_ttl_sec. Transient
+ * failures (timeouts, SERVFAIL) are never cached.
+ *
+ * Lookups may run on several threads at once, entries are
+ * copied in and out under a mutex.
+ */
+
+enum { DNS_CACHE_MAX_IP_STR = 46 };  /* INET6_ADDRSTRLEN */
+
+typedef enum {
+    DNS_CACHE_MISS,
+    DNS_CACHE_HIT,
+    DNS_CACHE_NEGATIVE,     /* Known not to resolve, do not ask again */
+} dns_cache_result_e;
+
+void dns_cache_init(int max_entries,
+        uint32_t negative_ttl_sec, uint32_t max_ttl_sec);
+void dns_cache_final(void);
+bool dns_cache_enabled(void);
+
+/* TTL to use for a negative entry of a failed lookup.
+ * Returns 0 if the failure must not be cached */
+uint32_t dns_cache_negative_ttl(int herrno);
+
+/* On a hit one record of the best order is picked at random
+ * and copied to selected, prev/next are cleared */
+dns_cache_result_e dns_cache_naptr_select(
+        const char *key, naptr_resource_record *selected);
+/* count == 0 stores a negative entry */
+void dns_cache_naptr_put(const char *key,
+        naptr_resource_record **array, int count, uint32_t ttl);
+
+dns_cache_result_e dns_cache_ip_get(const char *key,
+        char *buf, size_t buf_sz, int *num_ips);
+/* num_ips == 0 stores a negative entry */
+void dns_cache_ip_put(const char *key,
+        const char *ip, int num_ips, uint32_t ttl);
+
+#endif /* DNS_CACHE_H */
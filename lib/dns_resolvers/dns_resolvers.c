@@ -23,9 +23,11 @@
 #include <arpa/inet.h>
 #include <stdio.h>
 #include <resolv.h>
+#include <netdb.h>
 #include "naptr.h"
 #include "regex_extensions.h"
 #include "dns_resolvers.h"
+#include "dns_cache.h"
 #include "ogs-dns-resolvers-logging.h"
 
 enum { MAX_ANSWER_BYTES = 1024 };
@@ -33,19 +35,26 @@ enum { MAX_ANSWER_BYTES = 1024 };
 
 static bool build_domain_name(ResolverContext * const context);
 static bool build_sgw_domain_name(ResolverContext * const context);
+static bool select_naptr(ResolverContext * const context, bool sort, naptr_resource_record *selected);
 static naptr_resource_record * filter_nrrs(ResolverContext const * const context, naptr_resource_record *nrrs);
 static bool should_remove(ResolverContext const * const context, naptr_resource_record *nrr);
 static void transform_domain_name(naptr_resource_record *nrr, char * dname);
-static int type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_sz);
+static int cached_type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_sz);
+static int type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_sz, uint32_t *ttl);
 static void debug_print_nrr(naptr_resource_record *nrr);
 
 
+void dns_resolvers_cache_init(int max_entries, unsigned negative_ttl_sec, unsigned max_ttl_sec) {
+    dns_cache_init(max_entries, negative_ttl_sec, max_ttl_sec);
+}
+
+void dns_resolvers_cache_final(void) {
+    dns_cache_final();
+    reg_cache_flush();
+}
+
 bool resolve_naptr(ResolverContext * const context, char *buf, size_t buf_sz) {
-    bool resolved = false;
-    naptr_resource_record *nrr_list = NULL;
-    naptr_resource_record **nrr_array = NULL;
-    int nrr_count = 0;
-    naptr_resource_record *nrr_selected = NULL;
+    naptr_resource_record nrr_selected;
 
     if ((NULL == context) || (NULL == buf)) return false;
 
@@ -53,98 +62,124 @@ bool resolve_naptr(ResolverContext * const context, char *buf, size_t buf_sz) {
     build_domain_name(context);
     ogs_debug("Built domain name : '%s'", context->_domain_name);
 
-    /* Get all NRRs */
-    nrr_list = naptr_query(context->_domain_name);
-    if (NULL == nrr_list) return false;
-    ogs_debug("NAPTR query returned %i results", naptr_resource_record_list_count(nrr_list));
+    /* Pick a random record among the best order of the sorted set */
+    if (false == select_naptr(context, true, &nrr_selected)) return false;
 
-    /* Remove all the NRRs that don't provide the desired service */
-    nrr_list = filter_nrrs(context, nrr_list);
-    ogs_debug("NAPTR list count after filter %i", naptr_resource_record_list_count(nrr_list));
+    /* Update domain name */
+    transform_domain_name(&nrr_selected, context->_domain_name);
 
-    /* Sort the NRRs so that we can resolve them in order of priority */
-    nrr_list = naptr_list_head(nrr_list);
-    nrr_list = naptr_sort(&nrr_list);
-
-    /* Convert linked list to array */
-    nrr_array = naptr_list_to_array(nrr_list, &nrr_count);
-    if (nrr_array == NULL || nrr_count == 0) {
-        naptr_free_resource_record_list(nrr_list);
-        return false;
+    /* Try to resolve IP for the selected record */
+    if (0 < cached_type_ip_query(nrr_selected.flag, context->_domain_name, buf, buf_sz)) {
+        ogs_debug("Resolve successful, IP is '%s'", buf);
+        return true;
     }
 
-    /* Pick a random record among the best order */
-    nrr_selected = naptr_random_select(nrr_array, nrr_count);
+    return false;
+}
 
-    if (nrr_selected != NULL) {
-        /* Update domain name */
-        transform_domain_name(nrr_selected, context->_domain_name);
 
-        /* Try to resolve IP for the selected record */
-        int num_ips = type_ip_query(nrr_selected->flag, context->_domain_name, buf, buf_sz);
 
-        if (num_ips > 0) {
-            ogs_debug("Resolve successful, IP is '%s'", buf);
-            resolved = true;
-        }
-    }
+bool resolve_sgw_naptr(ResolverContext * const context, char *buf, size_t buf_sz) {
+    naptr_resource_record selected_nrr;
 
-    /* Cleanup */
-    free(nrr_array);
-    naptr_free_resource_record_list(nrr_list);
+    if ((NULL == context) || (NULL == buf)) return false;
+
+    build_sgw_domain_name(context);
+    ogs_debug("Built SGW domain name : '%s'", context->_domain_name);
 
-    return resolved;
+    if (false == select_naptr(context, false, &selected_nrr)) return false;
+
+    transform_domain_name(&selected_nrr, context->_domain_name);
+
+    if (0 < cached_type_ip_query(selected_nrr.flag, context->_domain_name, buf, buf_sz)) {
+        ogs_debug("SGW resolve successful, IP is '%s'", buf);
+        return true;
+    }
+
+    return false;
 }
 
 
 
-bool resolve_sgw_naptr(ResolverContext * const context, char *buf, size_t buf_sz) {
-    bool resolved = false;
+/*
+ * Looks up the NAPTR records of context->_domain_name, keeps the ones
+ * providing the desired service and copies a random one of the best
+ * order into selected. The filtered set is cached for the smallest
+ * TTL of the answer, so the selection is made per call either way.
+ */
+static bool select_naptr(ResolverContext * const context, bool sort, naptr_resource_record *selected) {
+    char key[DNS_RESOLVERS_MAX_DOMAIN_NAME_STR + 32] = "";
     naptr_resource_record *nrr_list = NULL;
     naptr_resource_record **nrr_array = NULL;
+    naptr_resource_record *nrr = NULL;
     int nrr_count = 0;
-    naptr_resource_record *selected_nrr = NULL;
+    uint32_t ttl = UINT32_MAX;
 
-    if ((NULL == context) || (NULL == buf)) return false;
+    if ((NULL == context) || (NULL == selected)) return false;
 
-    build_sgw_domain_name(context);
-    ogs_debug("Built SGW domain name : '%s'", context->_domain_name);
+    /* The filtered set depends on what we are looking for */
+    snprintf(key, sizeof(key), "%s|%s|%s|%s",
+        context->target, context->interface, context->protocol,
+        context->_domain_name);
 
-    nrr_list = naptr_query(context->_domain_name);
-    if (NULL == nrr_list) return false;
+    switch (dns_cache_naptr_select(key, selected)) {
+    case DNS_CACHE_HIT:
+        return true;
+    case DNS_CACHE_NEGATIVE:
+        return false;
+    default:
+        break;
+    }
 
+    /* Get all NRRs */
+    nrr_list = naptr_query(context->_domain_name);
+    if (NULL == nrr_list) {
+        dns_cache_naptr_put(key, NULL, 0, dns_cache_negative_ttl(h_errno));
+        return false;
+    }
     ogs_debug("NAPTR query returned %i results", naptr_resource_record_list_count(nrr_list));
 
+    for (nrr = naptr_list_head(nrr_list); NULL != nrr; nrr = nrr->next)
+        ttl = ogs_min(ttl, nrr->ttl);
+
+    /* Remove all the NRRs that don't provide the desired service */
     nrr_list = filter_nrrs(context, nrr_list);
     ogs_debug("NAPTR list count after filter %i", naptr_resource_record_list_count(nrr_list));
 
-    // Convert filtered list to array for random selection
-    nrr_array = naptr_list_to_array(nrr_list, &nrr_count);
-
-    if (nrr_array != NULL && nrr_count > 0) {
-        selected_nrr = naptr_random_select(nrr_array, nrr_count);
-
-        if (selected_nrr != NULL) {
-            transform_domain_name(selected_nrr, context->_domain_name);
+    /* Sort the NRRs so that we can resolve them in order of priority */
+    if (sort) {
+        nrr_list = naptr_list_head(nrr_list);
+        nrr_list = naptr_sort(&nrr_list);
+    }
 
-            int num_ips = type_ip_query(selected_nrr->flag, context->_domain_name, buf, buf_sz);
+    /* Convert linked list to array */
+    nrr_array = naptr_list_to_array(nrr_list, &nrr_count);
+    if (nrr_array == NULL || nrr_count == 0) {
+        /* Nothing usable, ask again once the records may have changed */
+        dns_cache_naptr_put(key, NULL, 0,
+                ogs_min(ttl, dns_cache_negative_ttl(NO_DATA)));
+        if (nrr_array) free(nrr_array);
+        naptr_free_resource_record_list(nrr_list);
+        return false;
+    }
 
-            if (num_ips > 0) {
-                ogs_debug("SGW resolve successful, IP is '%s'", buf);
-                resolved = true;
-            }
-        }
+    dns_cache_naptr_put(key, nrr_array, nrr_count, ttl);
 
-        free(nrr_array);  // free the array container, not the records themselves
+    /* Pick a random record among the best order */
+    nrr = naptr_random_select(nrr_array, nrr_count);
+    if (NULL != nrr) {
+        memcpy(selected, nrr, sizeof(*selected));
+        selected->prev = NULL;
+        selected->next = NULL;
     }
 
+    /* Cleanup */
+    free(nrr_array);
     naptr_free_resource_record_list(nrr_list);
 
-    return resolved;
+    return (NULL != nrr);
 }
 
-
-
 static bool build_domain_name(ResolverContext * const context) {
     int chars_written = 0;
     //bool build_success = false;
@@ -403,7 +438,43 @@ static void transform_domain_name(naptr_resource_record *nrr, char * dname) {
     }
 }
 
-static int type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_sz) {
+/* A/SRV lookup through the cache. Lookups that resolve are kept for
+ * the smallest TTL of the records used, ones that do not are kept
+ * for the negative TTL unless the failure may be transient */
+static int cached_type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_sz) {
+    char key[DNS_RESOLVERS_MAX_DOMAIN_NAME_STR + 4] = "";
+    char ip[DNS_CACHE_MAX_IP_STR] = "";
+    uint32_t ttl = UINT32_MAX;
+    int ip_count = 0;
+
+    if ((NULL == dname) || (NULL == buf)) return 0;
+
+    snprintf(key, sizeof(key), "%c|%s", lookup_type ? lookup_type : 'a', dname);
+
+    switch (dns_cache_ip_get(key, buf, buf_sz, &ip_count)) {
+    case DNS_CACHE_HIT:
+    case DNS_CACHE_NEGATIVE:
+        return ip_count;
+    default:
+        break;
+    }
+
+    h_errno = NETDB_SUCCESS;
+    ip_count = type_ip_query(lookup_type, dname, ip, sizeof(ip), &ttl);
+
+    if (0 < ip_count) {
+        ogs_cpystrn(buf, ip, buf_sz);
+        dns_cache_ip_put(key, ip, ip_count, ttl);
+    } else {
+        /* Answered but without an address is as good as no data */
+        dns_cache_ip_put(key, NULL, 0, dns_cache_negative_ttl(
+                    NETDB_SUCCESS == h_errno ? NO_DATA : h_errno));
+    }
+
+    return ip_count;
+}
+
+static int type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_sz, uint32_t *ttl) {
     int ip_count = 0;
     int resolv_lookup_type; 
     int bytes_received;
@@ -413,7 +484,7 @@ static int type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_
     ns_rr record;
     ns_msg handle;
 
-    if ((NULL == dname) || (NULL == buf)) return 0;
+    if ((NULL == dname) || (NULL == buf) || (NULL == ttl)) return 0;
 
     if (('a' == lookup_type) || (0 == lookup_type)) {
         resolv_lookup_type = T_A; 
@@ -453,6 +524,7 @@ static int type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_
         if (ns_rr_type(record) == T_A) {
             ogs_debug("Successful parse of A lookup result");
             inet_ntop(AF_INET, ns_rr_rdata(record), buf, buf_sz);
+            *ttl = ogs_min(*ttl, ns_rr_ttl(record));
             ++ip_count;
         } else if (ns_rr_type(record) == T_SRV) {
             ogs_debug("Successful parse of SRV lookup result");
@@ -475,7 +547,8 @@ static int type_ip_query(char lookup_type, char * dname, char * buf, size_t buf_
 
             /* Preform an A query based on SRV target */
             if (0 < bytes_uncompressed) {
-                ip_count += type_ip_query('a', target_uncompressed, buf, buf_sz);
+                *ttl = ogs_min(*ttl, ns_rr_ttl(record));
+                ip_count += type_ip_query('a', target_uncompressed, buf, buf_sz, ttl);
             }
         }
     }
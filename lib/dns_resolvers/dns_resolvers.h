@@ -73,4 +73,14 @@ typedef struct {
  */
 bool resolve_naptr(ResolverContext * const context, char *buf, size_t buf_sz);
 bool resolve_sgw_naptr(ResolverContext * const context, char *buf, size_t buf_sz);
+
+/*
+ * Optional cache in front of the NAPTR and A/SRV queries made by
+ * resolve_naptr() and resolve_sgw_naptr(), see dns_cache.h.
+ * Answers are kept for their TTL (at most max_ttl_sec), names that
+ * do not resolve for negative_ttl_sec. Without init every call
+ * goes to the resolver as before.
+ */
+void dns_resolvers_cache_init(int max_entries, unsigned negative_ttl_sec, unsigned max_ttl_sec);
+void dns_resolvers_cache_final(void);
 #endif /* DNS_RESOLVERS_H */
@@ -279,6 +279,7 @@ static naptr_resource_record * parse_naptr_resource_records(ns_msg * const handl
 
             /* Set the current NRRs data */
             parse_naptr_resource_record(&rr.rdata[0], rr.rdlength, nrr_current);
+            nrr_current->ttl = ns_rr_ttl(rr);
 
             /* This NRR will be added to the start of the list,
              * meaning that the next NRR will be the one we created
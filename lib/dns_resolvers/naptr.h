@@ -19,6 +19,7 @@
 #ifndef NAPTR_H
 #define NAPTR_H
 
+#include <stdint.h>
 #include <arpa/nameser.h>
 
 enum { MAX_REGEX_PATTERN_STR = 64,
@@ -31,6 +32,7 @@ typedef struct naptr_resource_record {
     struct naptr_resource_record* next;
 
     int og_val;
+    uint32_t ttl;
     int order;
     int preference;
     char flag;
@@ -17,15 +17,58 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include "regex_extensions.h"
 
 
 enum { SR_RE_MAX_MATCH = 6 };
+enum { REG_CACHE_BUCKETS = 64 };
+
+
+/*
+ * Compiled patterns keyed by the pattern string. The same NAPTR regexps
+ * come back on every lookup for an APN, so compiling them once saves a
+ * regcomp()/regfree() pair per record. Entries live on a doubly linked
+ * LRU list (most recently used at head) and in a small chained hash
+ * table. Patterns that fail to compile are cached with their error so
+ * they are not recompiled either.
+ */
+typedef struct reg_cache_entry {
+	struct reg_cache_entry *prev;
+	struct reg_cache_entry *next;
+	struct reg_cache_entry *hnext;
+
+	char *pattern;
+	unsigned long hash;
+	int status;		/* 0 when preg is usable, else get_reg_match() error */
+	regex_t preg;
+} reg_cache_entry;
+
+static struct {
+	/* Resolver threads match concurrently, regexec() runs under the lock
+	 * so that an entry cannot be evicted while it is in use */
+	pthread_mutex_t mutex;
+	int capacity;
+	int count;
+	reg_cache_entry *head;
+	reg_cache_entry *tail;
+	reg_cache_entry *buckets[REG_CACHE_BUCKETS];
+	unsigned long hits;
+	unsigned long misses;
+} reg_cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.capacity = REG_CACHE_DEFAULT_ENTRIES,
+};
 
 
 static int replace(regmatch_t* pmatch, char* string, char* replacement, char* buf, size_t buf_sz);
 static int get_reg_match(char const *pattern, char const *string, regmatch_t *pmatch);
+static int compile_reg(regex_t *preg, char const *pattern);
+static reg_cache_entry *reg_cache_get(char const *pattern);
+static void reg_cache_evict(reg_cache_entry *entry);
+static void reg_cache_flush_locked(void);
 
 bool reg_match(char const *pattern, char const *string) {
 	bool has_match = false;
@@ -117,18 +160,62 @@ static int replace(regmatch_t* pmatch, char* string, char* replacement, char* bu
 	return 1;
 }
 
+void reg_cache_resize(int max_entries)
+{
+	if (max_entries < 0) {
+		max_entries = 0;
+	}
+
+	pthread_mutex_lock(&reg_cache.mutex);
+	reg_cache_flush_locked();
+	reg_cache.capacity = max_entries;
+	pthread_mutex_unlock(&reg_cache.mutex);
+}
+
+void reg_cache_flush(void)
+{
+	pthread_mutex_lock(&reg_cache.mutex);
+	reg_cache_flush_locked();
+	pthread_mutex_unlock(&reg_cache.mutex);
+}
+
+void reg_cache_stats(unsigned long *hits, unsigned long *misses)
+{
+	pthread_mutex_lock(&reg_cache.mutex);
+	if (NULL != hits) {
+		*hits = reg_cache.hits;
+	}
+	if (NULL != misses) {
+		*misses = reg_cache.misses;
+	}
+	pthread_mutex_unlock(&reg_cache.mutex);
+}
+
 /* See https://github.com/kamailio/kamailio/blob/master/src/core/strutils.c
  * for original implementation of reg_match */
 static int get_reg_match(char const *pattern, char const *string, regmatch_t *pmatch)
 {
 	regex_t preg;
+	reg_cache_entry *entry;
+	int rv;
 
-	if (regcomp(&preg, pattern, REG_EXTENDED | REG_NEWLINE)) {
-		return -1;
+	pthread_mutex_lock(&reg_cache.mutex);
+	entry = reg_cache_get(pattern);
+	if (NULL != entry) {
+		rv = entry->status;
+		if ((0 == rv) &&
+		    regexec(&entry->preg, string, SR_RE_MAX_MATCH, pmatch, 0)) {
+			rv = -3;
+		}
+		pthread_mutex_unlock(&reg_cache.mutex);
+		return rv;
 	}
-	if (preg.re_nsub > SR_RE_MAX_MATCH) {
-		regfree(&preg);
-		return -2;
+	pthread_mutex_unlock(&reg_cache.mutex);
+
+	/* Cache disabled or out of memory, compile for this call only */
+	rv = compile_reg(&preg, pattern);
+	if (rv) {
+		return rv;
 	}
 	if (regexec(&preg, string, SR_RE_MAX_MATCH, pmatch, 0)) {
 		regfree(&preg);
@@ -137,3 +224,136 @@ static int get_reg_match(char const *pattern, char const *string, regmatch_t *pm
 	regfree(&preg);
 	return 0;
 }
+
+static int compile_reg(regex_t *preg, char const *pattern)
+{
+	if (regcomp(preg, pattern, REG_EXTENDED | REG_NEWLINE)) {
+		return -1;
+	}
+	if (preg->re_nsub > SR_RE_MAX_MATCH) {
+		regfree(preg);
+		return -2;
+	}
+	return 0;
+}
+
+/* djb2 */
+static unsigned long reg_hash(char const *pattern)
+{
+	unsigned long hash = 5381;
+	unsigned char c;
+
+	while ((c = (unsigned char)*pattern++)) {
+		hash = ((hash << 5) + hash) + c;
+	}
+
+	return hash;
+}
+
+/* Returns the entry for pattern, compiling and inserting it on a miss.
+ * Returns NULL if the cache is disabled or allocation fails.
+ * Must be called with reg_cache.mutex held. */
+static reg_cache_entry *reg_cache_get(char const *pattern)
+{
+	reg_cache_entry *entry;
+	unsigned long hash;
+	size_t bucket;
+	size_t len;
+
+	if (0 == reg_cache.capacity) {
+		return NULL;
+	}
+
+	hash = reg_hash(pattern);
+	bucket = hash % REG_CACHE_BUCKETS;
+
+	for (entry = reg_cache.buckets[bucket]; entry; entry = entry->hnext) {
+		if ((entry->hash == hash) && (0 == strcmp(entry->pattern, pattern))) {
+			break;
+		}
+	}
+
+	if (NULL != entry) {
+		reg_cache.hits++;
+
+		/* Move to head of LRU */
+		if (entry != reg_cache.head) {
+			entry->prev->next = entry->next;
+			if (entry->next) {
+				entry->next->prev = entry->prev;
+			} else {
+				reg_cache.tail = entry->prev;
+			}
+			entry->prev = NULL;
+			entry->next = reg_cache.head;
+			reg_cache.head->prev = entry;
+			reg_cache.head = entry;
+		}
+		return entry;
+	}
+
+	reg_cache.misses++;
+
+	len = strlen(pattern);
+	entry = calloc(1, sizeof(*entry) + len + 1);
+	if (NULL == entry) {
+		return NULL;
+	}
+	entry->pattern = (char *)(entry + 1);
+	memcpy(entry->pattern, pattern, len + 1);
+	entry->hash = hash;
+	entry->status = compile_reg(&entry->preg, pattern);
+
+	while (reg_cache.count >= reg_cache.capacity) {
+		reg_cache_evict(reg_cache.tail);
+	}
+
+	entry->hnext = reg_cache.buckets[bucket];
+	reg_cache.buckets[bucket] = entry;
+
+	entry->next = reg_cache.head;
+	if (reg_cache.head) {
+		reg_cache.head->prev = entry;
+	} else {
+		reg_cache.tail = entry;
+	}
+	reg_cache.head = entry;
+	reg_cache.count++;
+
+	return entry;
+}
+
+static void reg_cache_evict(reg_cache_entry *entry)
+{
+	reg_cache_entry **link;
+
+	link = &reg_cache.buckets[entry->hash % REG_CACHE_BUCKETS];
+	while (*link != entry) {
+		link = &(*link)->hnext;
+	}
+	*link = entry->hnext;
+
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		reg_cache.head = entry->next;
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		reg_cache.tail = entry->prev;
+	}
+	reg_cache.count--;
+
+	if (0 == entry->status) {
+		regfree(&entry->preg);
+	}
+	free(entry);
+}
+
+static void reg_cache_flush_locked(void)
+{
+	while (reg_cache.tail) {
+		reg_cache_evict(reg_cache.tail);
+	}
+}
@@ -38,4 +38,27 @@ bool reg_match(char const *pattern, char const *string);
 int reg_replace(char *pattern, char *replacement, char *string, char *buf, size_t buf_sz);
 
 
+/*
+ * reg_match() and reg_replace() keep compiled patterns in a bounded
+ * LRU cache shared by all threads.
+ */
+#define REG_CACHE_DEFAULT_ENTRIES 64
+
+/*
+ * Drops every cached pattern and sets the maximum number of entries.
+ * A size of 0 disables the cache.
+ */
+void reg_cache_resize(int max_entries);
+
+/*
+ * Drops every cached pattern, keeping the current size.
+ */
+void reg_cache_flush(void);
+
+/*
+ * Returns the number of cache hits and misses since start.
+ */
+void reg_cache_stats(unsigned long *hits, unsigned long *misses);
+
+
 #endif /* REGEX_EXTENSION_H */
\ No newline at end of file
@@ -1,7 +1,86 @@
 #include <arpa/inet.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "dns_resolvers.h"
+#include "regex_extensions.h"
+
+enum { BENCH_MAX_RECORDS = 64 };
+
+/*
+ * Runs the regex filtering and replacement done for each NAPTR lookup
+ * against a synthetic operator record set, first compiling every pattern
+ * on each call and then with the compiled pattern cache.
+ */
+static double bench_lookups(char patterns[][128], char replaces[][96],
+        int records, int lookups) {
+    char dname[] = "mms.apn.epc.mnc001.mcc505.3gppnetwork.org";
+    char buf[256];
+    clock_t start;
+    int i, j;
+
+    start = clock();
+    for (i = 0; i < lookups; i++) {
+        for (j = 0; j < records; j++) {
+            if (reg_match(patterns[j], dname)) {
+                reg_replace(patterns[j], replaces[j], dname, buf, sizeof(buf));
+            }
+        }
+    }
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC * 1e6 / lookups;
+}
+
+static int run_bench(int records, int lookups) {
+    static char patterns[BENCH_MAX_RECORDS][128];
+    static char replaces[BENCH_MAX_RECORDS][96];
+    unsigned long hits = 0, misses = 0;
+    double uncached, cached;
+    int i;
+
+    if ((records < 1) || (records > BENCH_MAX_RECORDS) || (lookups < 1)) {
+        printf("Records must be between 1 and %d\n", BENCH_MAX_RECORDS);
+        return 1;
+    }
+
+    /* Mix of per-PLMN anchored rewrites and catch-all label captures,
+     * as seen in operator NAPTR sets */
+    for (i = 0; i < records; i++) {
+        if (i % 4 == 3) {
+            snprintf(patterns[i], sizeof(patterns[i]),
+                    "([a-z0-9]+)(\\.apn\\.epc\\..*%d)", i);
+            snprintf(replaces[i], sizeof(replaces[i]),
+                    "\\1.apn.epc.mnc%03d.mcc999.3gppnetwork.org", i);
+        } else {
+            snprintf(patterns[i], sizeof(patterns[i]),
+                    "^([a-z0-9]+)\\.apn\\.epc\\.mnc([0-9]{3})\\.mcc(%03d)"
+                    "\\.3gppnetwork\\.org$", 500 + i);
+            snprintf(replaces[i], sizeof(replaces[i]),
+                    "topon.s5.pgw\\1.node.epc.mnc\\2.mcc\\3.3gppnetwork.org");
+        }
+    }
+
+    printf("Benchmarking %d lookups over %d NAPTR records...\n",
+            lookups, records);
+
+    reg_cache_resize(0);
+    uncached = bench_lookups(patterns, replaces, records, lookups);
+
+    reg_cache_resize(REG_CACHE_DEFAULT_ENTRIES);
+    cached = bench_lookups(patterns, replaces, records, lookups);
+    reg_cache_stats(&hits, &misses);
+
+    printf("uncached      : %.2f us/lookup\n", uncached);
+    printf("cached        : %.2f us/lookup\n", cached);
+    printf("speedup       : %.1fx\n", cached > 0 ? uncached / cached : 0);
+    printf("cache hits    : %lu\n", hits);
+    printf("cache misses  : %lu\n", misses);
+
+    reg_cache_flush();
+
+    return 0;
+}
 
 int main(int argc, char **argv) {
 
@@ -9,11 +88,18 @@ int main(int argc, char **argv) {
     char ipv4[INET_ADDRSTRLEN] = "";
     bool resolved = false;
 
+    if ((argc >= 2) && (0 == strcmp(argv[1], "bench"))) {
+        return run_bench(argc > 2 ? atoi(argv[2]) : 30,
+                         argc > 3 ? atoi(argv[3]) : 10000);
+    }
+
     if (argc != 8) {
         printf("Not enough arguments for cli runs!\n");
         printf("Expecting something like this:\n");
         printf("\t./main \"<apn>\" \"<mnc>\" \"<mcc>\" \"<domain_suffix>\" \"<target>\" \"<interface>\" \"<protocol>\"\n");
-        printf("\t./main \"mms\" \"030\" \"362\" \"3gppnetwork.org\" \"pgw\" \"s5\" \"gtp\"\n\n");
+        printf("\t./main \"mms\" \"030\" \"362\" \"3gppnetwork.org\" \"pgw\" \"s5\" \"gtp\"\n");
+        printf("Or benchmark regex handling with:\n");
+        printf("\t./main bench [<records, default 30>] [<lookups, default 10000>]\n\n");
 
 
         printf("Running default...\n");
@@ -33,6 +33,27 @@ static uint32_t g_xact_id = 0;
 
 static OGS_POOL(pool, ogs_gtp_xact_t);
 
+/*
+ * Transactions indexed by peer, originator, version and XID, so that a
+ * response does not have to scan every transaction in flight with the
+ * peer. The per-peer lists stay for ogs_gtp_xact_delete_all().
+ */
+typedef struct xact_key_s {
+    ogs_gtp_node_t *gnode;
+    uint32_t xid;
+    uint8_t gtp_version;
+    uint8_t org;
+    uint16_t reserved;
+} xact_key_t;
+
+static ogs_flatmap_t *xact_map;
+
+static struct {
+    uint64_t retransmitted;
+    uint64_t timed_out;
+    uint64_t duplicated;
+} counter;
+
 static ogs_gtp_xact_t *ogs_gtp_xact_remote_create(ogs_gtp_node_t *gnode, uint8_t gtp_version, uint32_t sqn);
 static ogs_gtp_xact_stage_t ogs_gtp2_xact_get_stage(uint8_t type, uint32_t xid);
 static ogs_gtp_xact_stage_t ogs_gtp1_xact_get_stage(uint8_t type, uint32_t xid);
@@ -42,12 +63,88 @@ static int ogs_gtp_xact_update_rx(ogs_gtp_xact_t *xact, uint8_t type);
 static void response_timeout(void *data);
 static void holding_timeout(void *data);
 
+static void xact_key_set(xact_key_t *key, ogs_gtp_node_t *gnode,
+        uint8_t org, uint8_t gtp_version, uint32_t xid)
+{
+    memset(key, 0, sizeof(*key));
+    key->gnode = gnode;
+    key->xid = xid;
+    key->gtp_version = gtp_version;
+    key->org = org;
+}
+
+static ogs_gtp_xact_t *xact_find(ogs_gtp_node_t *gnode,
+        uint8_t org, uint8_t gtp_version, uint32_t xid)
+{
+    xact_key_t key;
+
+    xact_key_set(&key, gnode, org, gtp_version, xid);
+    return ogs_flatmap_get(xact_map, &key);
+}
+
+static void xact_link(ogs_gtp_xact_t *xact)
+{
+    ogs_gtp_xact_t *last = NULL;
+    xact_key_t key;
+
+    ogs_list_add(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
+            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+
+    /*
+     * Like the list scan, the oldest transaction with the XID wins. The
+     * younger ones wait behind it in next_same_key, which is only ever
+     * more than one long once the XID space has wrapped around.
+     */
+    xact->next_same_key = NULL;
+
+    xact_key_set(&key, xact->gnode, xact->org, xact->gtp_version, xact->xid);
+    last = ogs_flatmap_get(xact_map, &key);
+    if (!last) {
+        ogs_flatmap_set(xact_map, &key, xact);
+        return;
+    }
+
+    while (last->next_same_key)
+        last = last->next_same_key;
+    last->next_same_key = xact;
+}
+
+static void xact_unlink(ogs_gtp_xact_t *xact)
+{
+    ogs_gtp_xact_t *prev = NULL;
+    xact_key_t key;
+
+    ogs_list_remove(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
+            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+
+    xact_key_set(&key, xact->gnode, xact->org, xact->gtp_version, xact->xid);
+    prev = ogs_flatmap_get(xact_map, &key);
+    ogs_assert(prev);
+
+    if (prev == xact) {
+        /* The key passes to the next oldest, if there is one */
+        ogs_flatmap_set(xact_map, &key, xact->next_same_key);
+    } else {
+        while (prev->next_same_key != xact) {
+            prev = prev->next_same_key;
+            ogs_assert(prev);
+        }
+        prev->next_same_key = xact->next_same_key;
+    }
+
+    xact->next_same_key = NULL;
+}
+
 int ogs_gtp_xact_init(void)
 {
     ogs_assert(ogs_gtp_xact_initialized == 0);
 
     ogs_pool_init(&pool, ogs_app()->pool.xact);
 
+    xact_map = ogs_flatmap_create(sizeof(xact_key_t));
+    ogs_assert(xact_map);
+    memset(&counter, 0, sizeof(counter));
+
     g_xact_id = 0;
 
     ogs_gtp_xact_initialized = 1;
@@ -59,6 +156,9 @@ void ogs_gtp_xact_final(void)
 {
     ogs_assert(ogs_gtp_xact_initialized == 1);
 
+    ogs_flatmap_destroy(xact_map);
+    xact_map = NULL;
+
     ogs_pool_final(&pool);
 
     ogs_gtp_xact_initialized = 0;
@@ -98,8 +198,7 @@ ogs_gtp_xact_t *ogs_gtp1_xact_local_create(ogs_gtp_node_t *gnode,
     ogs_assert(xact->tm_holding);
     xact->holding_rcount = ogs_app()->time.message.gtp.n3_holding_rcount,
 
-    ogs_list_add(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
-            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+    xact_link(xact);
 
     rv = ogs_gtp1_xact_update_tx(xact, hdesc, pkbuf);
     if (rv != OGS_OK) {
@@ -156,8 +255,7 @@ ogs_gtp_xact_t *ogs_gtp_xact_local_create(ogs_gtp_node_t *gnode,
     ogs_assert(xact->tm_holding);
     xact->holding_rcount = ogs_app()->time.message.gtp.n3_holding_rcount,
 
-    ogs_list_add(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
-            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+    xact_link(xact);
 
     rv = ogs_gtp_xact_update_tx(xact, hdesc, pkbuf);
     if (rv != OGS_OK) {
@@ -203,8 +301,7 @@ static ogs_gtp_xact_t *ogs_gtp_xact_remote_create(ogs_gtp_node_t *gnode, uint8_t
     ogs_assert(xact->tm_holding);
     xact->holding_rcount = ogs_app()->time.message.gtp.n3_holding_rcount,
 
-    ogs_list_add(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
-            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+    xact_link(xact);
 
     ogs_debug("[%d] %s Create  peer [%s]:%d",
             xact->xid,
@@ -215,6 +312,19 @@ static ogs_gtp_xact_t *ogs_gtp_xact_remote_create(ogs_gtp_node_t *gnode, uint8_t
     return xact;
 }
 
+void ogs_gtp_xact_get_stats(ogs_gtp_xact_stats_t *stats)
+{
+    ogs_assert(stats);
+
+    stats->size = ogs_pool_size(&pool);
+    stats->used = ogs_pool_size(&pool) - ogs_pool_avail(&pool);
+    stats->peak = ogs_pool_peak(&pool);
+
+    stats->retransmitted = counter.retransmitted;
+    stats->timed_out = counter.timed_out;
+    stats->duplicated = counter.duplicated;
+}
+
 ogs_gtp_xact_t *ogs_gtp_xact_cycle(ogs_gtp_xact_t *xact)
 {
     return ogs_pool_cycle(&pool, xact);
@@ -500,6 +610,7 @@ static int ogs_gtp_xact_update_rx(ogs_gtp_xact_t *xact, uint8_t type)
                                 buf),
                             OGS_PORT(&xact->gnode->addr));
                 }
+                counter.duplicated++;
 
                 return OGS_RETRY;
             }
@@ -565,6 +676,7 @@ static int ogs_gtp_xact_update_rx(ogs_gtp_xact_t *xact, uint8_t type)
                                 buf),
                             OGS_PORT(&xact->gnode->addr));
                 }
+                counter.duplicated++;
 
                 return OGS_RETRY;
             }
@@ -752,8 +864,10 @@ static void response_timeout(void *data)
         pkbuf = xact->seq[xact->step-1].pkbuf;
         ogs_assert(pkbuf);
 
+        counter.retransmitted++;
         ogs_expect(OGS_OK == ogs_gtp_sendto(xact->gnode, pkbuf));
     } else {
+        counter.timed_out++;
         ogs_warn("[%d] %s No Reponse. Give up! "
                 "for step %d type %d peer [%s]:%d",
                 xact->xid,
@@ -844,23 +958,22 @@ int ogs_gtp1_xact_receive(
     }
 
     ogs_assert(list);
-    ogs_list_for_each(list, new) {
-        if (new->gtp_version == 1 && new->xid == xid) {
-            ogs_debug("[%d] %s Find GTPv%u peer [%s]:%d",
-                    new->xid,
-                    new->org == OGS_GTP_LOCAL_ORIGINATOR ? "LOCAL " : "REMOTE",
-                    new->gtp_version,
-                    OGS_ADDR(&gnode->addr, buf),
-                    OGS_PORT(&gnode->addr));
-            break;
-        }
-    }
-
-    ogs_debug("[%d] Cannot find xact type %u from GTPv1 peer [%s]:%d",
-            xid, type, OGS_ADDR(&gnode->addr, buf), OGS_PORT(&gnode->addr));
+    new = xact_find(gnode, list == &gnode->local_list ?
+            OGS_GTP_LOCAL_ORIGINATOR : OGS_GTP_REMOTE_ORIGINATOR, 1, xid);
+    if (new) {
+        ogs_debug("[%d] %s Find GTPv%u peer [%s]:%d",
+                new->xid,
+                new->org == OGS_GTP_LOCAL_ORIGINATOR ? "LOCAL " : "REMOTE",
+                new->gtp_version,
+                OGS_ADDR(&gnode->addr, buf),
+                OGS_PORT(&gnode->addr));
+    } else {
+        ogs_debug("[%d] Cannot find xact type %u from GTPv1 peer [%s]:%d",
+                xid, type,
+                OGS_ADDR(&gnode->addr, buf), OGS_PORT(&gnode->addr));
 
-    if (!new)
         new = ogs_gtp_xact_remote_create(gnode, 1, sqn);
+    }
     ogs_assert(new);
 
     ogs_debug("[%d] %s Receive peer [%s]:%d",
@@ -932,24 +1045,22 @@ int ogs_gtp_xact_receive(
     }
 
     ogs_assert(list);
-    ogs_list_for_each(list, new) {
-        if (new->gtp_version == 2 && new->xid == xid) {
-            ogs_debug("[%d] %s Find GTPv%u peer [%s]:%d",
-                    new->xid,
-                    new->org == OGS_GTP_LOCAL_ORIGINATOR ? "LOCAL " : "REMOTE",
-                    new->gtp_version,
-                    OGS_ADDR(&gnode->addr, buf),
-                    OGS_PORT(&gnode->addr));
-            break;
-        }
-    }
-
-    ogs_debug("[%d] Cannot find xact type %u from GTPv2 peer [%s]:%d",
-            xid, type,
-            OGS_ADDR(&gnode->addr, buf), OGS_PORT(&gnode->addr));
+    new = xact_find(gnode, list == &gnode->local_list ?
+            OGS_GTP_LOCAL_ORIGINATOR : OGS_GTP_REMOTE_ORIGINATOR, 2, xid);
+    if (new) {
+        ogs_debug("[%d] %s Find GTPv%u peer [%s]:%d",
+                new->xid,
+                new->org == OGS_GTP_LOCAL_ORIGINATOR ? "LOCAL " : "REMOTE",
+                new->gtp_version,
+                OGS_ADDR(&gnode->addr, buf),
+                OGS_PORT(&gnode->addr));
+    } else {
+        ogs_debug("[%d] Cannot find xact type %u from GTPv2 peer [%s]:%d",
+                xid, type,
+                OGS_ADDR(&gnode->addr, buf), OGS_PORT(&gnode->addr));
 
-    if (!new)
         new = ogs_gtp_xact_remote_create(gnode, 2, sqn);
+    }
     ogs_assert(new);
 
     ogs_debug("[%d] %s Receive peer [%s]:%d",
@@ -1152,8 +1263,7 @@ static int ogs_gtp_xact_delete(ogs_gtp_xact_t *xact)
     if (xact->assoc_xact)
         ogs_gtp_xact_deassociate(xact, xact->assoc_xact);
 
-    ogs_list_remove(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
-            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+    xact_unlink(xact);
     ogs_pool_free(&pool, xact);
 
     return OGS_OK;
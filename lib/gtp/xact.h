@@ -69,6 +69,9 @@ typedef struct ogs_gtp_xact_s {
 
     uint32_t        xid;            /**< Transaction ID */
     ogs_gtp_node_t  *gnode;         /**< Relevant GTP node context */
+    struct ogs_gtp_xact_s *next_same_key; /**< Younger transaction with the
+                                         same peer, originator, version
+                                         and XID, if any */
 
     void (*cb)(ogs_gtp_xact_t *, void *); /**< Local timer expiration handler */
     void            *data;          /**< Transaction Data */
@@ -129,9 +132,21 @@ typedef struct ogs_gtp_xact_s {
     int             modify_action;
 } ogs_gtp_xact_t;
 
+typedef struct ogs_gtp_xact_stats_s {
+    int size;
+    int used;
+    int peak;
+
+    uint64_t retransmitted;     /* Requests resent on T3-RESPONSE expiry */
+    uint64_t timed_out;         /* Given up after N3-REQUESTS */
+    uint64_t duplicated;        /* Requests the peer sent again */
+} ogs_gtp_xact_stats_t;
+
 int ogs_gtp_xact_init(void);
 void ogs_gtp_xact_final(void);
 
+void ogs_gtp_xact_get_stats(ogs_gtp_xact_stats_t *stats);
+
 ogs_gtp_xact_t *ogs_gtp1_xact_local_create(ogs_gtp_node_t *gnode,
         ogs_gtp1_header_t *hdesc, ogs_pkbuf_t *pkbuf,
         void (*cb)(ogs_gtp_xact_t *xact, void *data), void *data);
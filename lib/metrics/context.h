@@ -93,6 +93,15 @@ ogs_metrics_spec_t *ogs_metrics_spec_new(
         const char *name, const char *description,
         int initial_val, unsigned int num_labels, const char ** labels,
         ogs_metrics_histogram_params_t *histogram_params);
+/*
+ * Gauge whose series only exist while their instance does:
+ * ogs_metrics_inst_free() removes the series from the exposition.
+ * Meant for labels with unbounded values such as an IMSI.
+ */
+ogs_metrics_spec_t *ogs_metrics_spec_new_dynamic(
+        ogs_metrics_context_t *ctx,
+        const char *name, const char *description,
+        int initial_val, unsigned int num_labels, const char ** labels);
 void ogs_metrics_spec_free(ogs_metrics_spec_t *spec);
 
 typedef struct ogs_metrics_inst_s ogs_metrics_inst_t;
@@ -21,14 +21,39 @@
 #include "ogs-metrics.h"
 
 #include <netdb.h> /* AI_PASSIVE */
+#include <zlib.h>
 #include "prom.h"
 #include "microhttpd.h"
 
 #define MAX_LABELS 8
 
+/* Scrapes within this interval are served from the same snapshot */
+#define SNAPSHOT_INTERVAL ogs_time_from_msec(1000)
+
+typedef enum {
+    SNAPSHOT_TEXT,
+    SNAPSHOT_TEXT_GZIP,
+    SNAPSHOT_OPENMETRICS,
+    SNAPSHOT_OPENMETRICS_GZIP,
+    MAX_SNAPSHOT_BODY,
+} snapshot_body_e;
+
+/*
+ * Rendered exposition, built and used only by the MHD thread of a server.
+ * The other formats are derived from the text one on first request.
+ */
+typedef struct ogs_metrics_snapshot_s {
+    ogs_time_t time;
+    struct {
+        char *buf; /* malloc()ed */
+        size_t len;
+    } body[MAX_SNAPSHOT_BODY];
+} ogs_metrics_snapshot_t;
+
 typedef struct ogs_metrics_server_s {
     ogs_socknode_t node;
     struct MHD_Daemon *mhd;
+    ogs_metrics_snapshot_t *snapshot;
 } ogs_metrics_server_t;
 
 typedef struct ogs_metrics_spec_s {
@@ -42,6 +67,9 @@ typedef struct ogs_metrics_spec_s {
     unsigned int                num_labels;
     char                        *labels[MAX_LABELS];
     prom_metric_t               *prom;
+    bool                        dynamic; /* rendered here, not by prom */
+    char                        *header; /* dynamic only, malloc()ed */
+    size_t                      header_len;
 } ogs_metrics_spec_t;
 
 typedef struct ogs_metrics_inst_s {
@@ -49,13 +77,41 @@ typedef struct ogs_metrics_inst_s {
     ogs_list_t              entry; /* included in ogs_metrics_spec_t spec */
     unsigned int            num_labels;
     char                    *label_values[MAX_LABELS];
+    int64_t                 value; /* dynamic spec only, atomic */
+    char                    *series; /* dynamic spec only, malloc()ed */
+    size_t                  series_len;
 } ogs_metrics_inst_t;
 
+/* A dynamic series or family header, as copied out under list_mutex */
+typedef struct dynamic_sample_s {
+    size_t offset; /* into the copied text */
+    size_t len;
+    int64_t value;
+    bool is_header;
+} dynamic_sample_t;
+
 static OGS_POOL(metrics_spec_pool, ogs_metrics_spec_t);
 static OGS_POOL(metrics_server_pool, ogs_metrics_server_t);
 
+/*
+ * The exposition is rendered on the MHD threads. libprom guards its own
+ * samples; spec_list and the instance lists of dynamic specs are guarded
+ * by list_mutex, and the value of a dynamic instance is a relaxed atomic
+ * so that setting it never waits for a scrape. The family header and the
+ * series name with its labels are rendered once, when the spec or the
+ * instance is created, so a scrape only copies them under list_mutex and
+ * formats after releasing it.
+ */
+static ogs_thread_mutex_t list_mutex;
+
 static int ogs_metrics_context_server_start(ogs_metrics_server_t *server);
 static int ogs_metrics_context_server_stop(ogs_metrics_server_t *server);
+static bool buf_printf(char **buf, size_t *len, size_t *size,
+        const char *fmt, ...);
+static char *dynamic_metrics_append(char *buf);
+static char *dynamic_header_render(ogs_metrics_spec_t *spec, size_t *len);
+static char *dynamic_series_render(ogs_metrics_inst_t *inst, size_t *len);
+static void snapshot_free(ogs_metrics_snapshot_t *snapshot);
 
 void ogs_metrics_server_init(ogs_metrics_context_t *ctx)
 {
@@ -130,52 +186,227 @@ void ogs_metrics_server_remove_all(void)
     }
 }
 
-static void mhd_server_run(short when, ogs_socket_t fd, void *data)
+static void snapshot_free(ogs_metrics_snapshot_t *snapshot)
 {
-    struct MHD_Daemon *mhd_daemon = data;
+    int i;
 
-    ogs_assert(mhd_daemon);
-    MHD_run(mhd_daemon);
+    ogs_assert(snapshot);
+    for (i = 0; i < MAX_SNAPSHOT_BODY; i++)
+        free(snapshot->body[i].buf);
+    ogs_free(snapshot);
 }
 
-static void mhd_server_notify_connection(void *cls,
-        struct MHD_Connection *connection,
-        void **socket_context,
-        enum MHD_ConnectionNotificationCode toe)
+/*
+ * OpenMetrics from the text format: no blank lines, a counter family is
+ * named without its _total suffix, and the exposition ends with # EOF.
+ * Counters whose samples lack the suffix are exposed as unknown.
+ */
+static char *openmetrics_from_text(const char *text, size_t *out_len)
 {
-    struct MHD_Daemon *mhd_daemon = NULL;
-    MHD_socket mhd_socket = INVALID_SOCKET;
+    char *buf = NULL;
+    size_t len = 0, size;
+    const char *line = text, *eol;
+
+    size = strlen(text) + 64;
+    buf = malloc(size);
+    if (!buf)
+        return NULL;
+    buf[0] = '\0';
+
+    for (; *line; line = eol) {
+        const char *name = NULL, *rest = NULL;
+        size_t name_len = 0;
+        bool is_help, is_type;
+
+        eol = strchr(line, '\n');
+        eol = eol ? eol + 1 : line + strlen(line);
+
+        if (*line == '\n')
+            continue;
+
+        is_help = !strncmp(line, "# HELP ", 7);
+        is_type = !strncmp(line, "# TYPE ", 7);
+        if (is_help || is_type) {
+            name = line + 7;
+            rest = name + strcspn(name, " \n");
+            name_len = rest - name;
+        }
 
-    const union MHD_ConnectionInfo *mhd_info = NULL;
-    struct {
-        ogs_poll_t *read;
-    } poll;
-
-    switch (toe) {
-        case MHD_CONNECTION_NOTIFY_STARTED:
-            mhd_info = MHD_get_connection_info(
-                    connection, MHD_CONNECTION_INFO_DAEMON);
-            ogs_assert(mhd_info);
-            mhd_daemon = mhd_info->daemon;
-            ogs_assert(mhd_daemon);
-
-            mhd_info = MHD_get_connection_info(
-                    connection, MHD_CONNECTION_INFO_CONNECTION_FD);
-            ogs_assert(mhd_info);
-            mhd_socket = mhd_info->connect_fd;
-            ogs_assert(mhd_socket != INVALID_SOCKET);
-
-            poll.read = ogs_pollset_add(ogs_app()->pollset,
-                    OGS_POLLIN, mhd_socket, mhd_server_run, mhd_daemon);
-            ogs_assert(poll.read);
-            *socket_context = poll.read;
-            break;
-        case MHD_CONNECTION_NOTIFY_CLOSED:
-            poll.read = *socket_context;
-            if (poll.read)
-                ogs_pollset_remove(poll.read);
-            break;
+        if (is_help) {
+            /* libprom always follows HELP with TYPE */
+            const char *type = eol;
+            bool counter = !strncmp(type, "# TYPE ", 7) &&
+                !strncmp(type + 7, name, name_len) &&
+                !strncmp(type + 7 + name_len, " counter\n", 9);
+
+            if (counter && name_len > 6 &&
+                !strncmp(name + name_len - 6, "_total", 6))
+                name_len -= 6;
+
+            if (!buf_printf(&buf, &len, &size, "# HELP %.*s%.*s",
+                        (int)name_len, name, (int)(eol - rest), rest))
+                goto err;
+        } else if (is_type && !strncmp(rest, " counter\n", 9)) {
+            if (name_len > 6 && !strncmp(name + name_len - 6, "_total", 6)) {
+                if (!buf_printf(&buf, &len, &size, "# TYPE %.*s counter\n",
+                            (int)name_len - 6, name))
+                    goto err;
+            } else {
+                if (!buf_printf(&buf, &len, &size, "# TYPE %.*s unknown\n",
+                            (int)name_len, name))
+                    goto err;
+            }
+        } else {
+            if (!buf_printf(&buf, &len, &size, "%.*s",
+                        (int)(eol - line), line))
+                goto err;
+            if (eol[-1] != '\n' && !buf_printf(&buf, &len, &size, "\n"))
+                goto err;
+        }
     }
+
+    if (!buf_printf(&buf, &len, &size, "# EOF\n"))
+        goto err;
+
+    *out_len = len;
+    return buf;
+
+err:
+    free(buf);
+    return NULL;
+}
+
+static char *gzip_from_buffer(const char *in, size_t in_len, size_t *out_len)
+{
+    z_stream zs;
+    char *out = NULL;
+    size_t size;
+    int rv;
+
+    memset(&zs, 0, sizeof(zs));
+    /* 16 + MAX_WBITS for a gzip header instead of zlib's */
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+
+    size = deflateBound(&zs, in_len);
+    out = malloc(size);
+    if (!out) {
+        deflateEnd(&zs);
+        return NULL;
+    }
+
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = in_len;
+    zs.next_out = (Bytef *)out;
+    zs.avail_out = size;
+
+    rv = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+    if (rv != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+
+    *out_len = zs.total_out;
+    return out;
+}
+
+/* Renders a derived format of the snapshot on first use */
+static bool snapshot_render(ogs_metrics_snapshot_t *snapshot,
+        snapshot_body_e which)
+{
+    size_t n = 0;
+    char *b = NULL;
+
+    if (snapshot->body[which].buf)
+        return true;
+
+    switch (which) {
+    case SNAPSHOT_OPENMETRICS:
+        b = openmetrics_from_text(snapshot->body[SNAPSHOT_TEXT].buf, &n);
+        break;
+    case SNAPSHOT_TEXT_GZIP:
+    case SNAPSHOT_OPENMETRICS_GZIP:
+        if (!snapshot_render(snapshot, which - 1))
+            return false;
+        b = gzip_from_buffer(snapshot->body[which - 1].buf,
+                snapshot->body[which - 1].len, &n);
+        break;
+    default:
+        ogs_assert_if_reached();
+        break;
+    }
+    if (!b)
+        return false;
+
+    snapshot->body[which].buf = b;
+    snapshot->body[which].len = n;
+    return true;
+}
+
+/*
+ * Returns the body in the requested format. Whether the snapshot is stale
+ * is decided once here; rendering never replaces the snapshot it works on.
+ */
+static bool snapshot_body(ogs_metrics_server_t *server,
+        snapshot_body_e which, const char **buf, size_t *len)
+{
+    ogs_metrics_snapshot_t *snapshot = server->snapshot;
+    ogs_time_t now = ogs_get_monotonic_time();
+
+    if (!snapshot || now - snapshot->time >= SNAPSHOT_INTERVAL) {
+        char *text = prom_collector_registry_bridge(
+                PROM_COLLECTOR_REGISTRY_DEFAULT);
+        if (!text)
+            return false;
+        text = dynamic_metrics_append(text);
+
+        /* Keep serving the previous snapshot until this one is built */
+        snapshot = ogs_calloc(1, sizeof(*snapshot));
+        ogs_assert(snapshot);
+        snapshot->time = now;
+        snapshot->body[SNAPSHOT_TEXT].buf = text;
+        snapshot->body[SNAPSHOT_TEXT].len = strlen(text);
+
+        if (server->snapshot)
+            snapshot_free(server->snapshot);
+        server->snapshot = snapshot;
+    }
+
+    if (!snapshot_render(snapshot, which))
+        return false;
+
+    *buf = snapshot->body[which].buf;
+    *len = snapshot->body[which].len;
+    return true;
+}
+
+/* True if the comma separated header lists token with a non-zero q */
+static bool header_accepts(const char *header, const char *token)
+{
+    size_t token_len = strlen(token);
+    const char *p = header;
+
+    while (p && *p) {
+        const char *end = p + strcspn(p, ",");
+        const char *param;
+
+        while (*p == ' ' || *p == '\t')
+            p++;
+
+        if (!ogs_strncasecmp(p, token, token_len) &&
+            (p[token_len] == ';' || p[token_len] == ',' ||
+             p[token_len] == ' ' || p + token_len == end)) {
+            param = strstr(p, "q=");
+            if (!param || param > end || atof(param + 2) > 0)
+                return true;
+        }
+
+        p = *end ? end + 1 : end;
+    }
+
+    return false;
 }
 
 #if MHD_VERSION >= 0x00097001
@@ -188,10 +419,14 @@ static _MHD_Result mhd_server_access_handler(void *cls, struct MHD_Connection *c
         const char *url, const char *method, const char *version,
         const char *upload_data, size_t *upload_data_size, void **con_cls) {
 
+    ogs_metrics_server_t *server = cls;
     const char *buf;
+    size_t len;
     struct MHD_Response *rsp;
     int ret;
 
+    ogs_assert(server);
+
     if (strcmp(method, "GET") != 0) {
         buf = "Invalid HTTP Method\n";
         rsp = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
@@ -207,8 +442,37 @@ static _MHD_Result mhd_server_access_handler(void *cls, struct MHD_Connection *c
         return ret;
     }
     if (strcmp(url, "/metrics") == 0) {
-        buf = prom_collector_registry_bridge(PROM_COLLECTOR_REGISTRY_DEFAULT);
-        rsp = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_MUST_FREE);
+        const char *accept = MHD_lookup_connection_value(
+                connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT);
+        const char *encoding = MHD_lookup_connection_value(
+                connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+        bool openmetrics = accept &&
+            header_accepts(accept, "application/openmetrics-text");
+        bool gzip = encoding && header_accepts(encoding, "gzip");
+        snapshot_body_e which = openmetrics ?
+            SNAPSHOT_OPENMETRICS : SNAPSHOT_TEXT;
+
+        /* Fall back to identity if compression fails */
+        if (!gzip || !snapshot_body(server, which + 1, &buf, &len)) {
+            gzip = false;
+            if (!snapshot_body(server, which, &buf, &len)) {
+                buf = "Internal Server Error\n";
+                rsp = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
+                ret = MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, rsp);
+                MHD_destroy_response(rsp);
+                return ret;
+            }
+        }
+
+        /* The snapshot may be replaced by the next scrape */
+        rsp = MHD_create_response_from_buffer(len, (void *)buf, MHD_RESPMEM_MUST_COPY);
+        MHD_add_response_header(rsp, MHD_HTTP_HEADER_CONTENT_TYPE,
+                openmetrics ?
+                "application/openmetrics-text; version=1.0.0; charset=utf-8" :
+                "text/plain; version=0.0.4; charset=utf-8");
+        MHD_add_response_header(rsp, MHD_HTTP_HEADER_VARY, "Accept, Accept-Encoding");
+        if (gzip)
+            MHD_add_response_header(rsp, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
         ret = MHD_queue_response(connection, MHD_HTTP_OK, rsp);
         MHD_destroy_response(rsp);
         return ret;
@@ -224,7 +488,6 @@ static int ogs_metrics_context_server_start(ogs_metrics_server_t *server)
 {
 #define MAX_NUM_OF_MHD_OPTION_ITEM 8
     struct MHD_OptionItem mhd_ops[MAX_NUM_OF_MHD_OPTION_ITEM];
-    const union MHD_DaemonInfo *mhd_info = NULL;
     int index = 0;
     char buf[OGS_ADDRSTRLEN];
     ogs_sockaddr_t *addr = NULL;
@@ -240,22 +503,16 @@ static int ogs_metrics_context_server_start(ogs_metrics_server_t *server)
     unsigned int mhd_flags = MHD_USE_DEBUG;
 #endif
 
+    /* Scrapes are served by MHD's own thread, not by the pollset */
 #if MHD_VERSION >= 0x00095300
-    mhd_flags |= MHD_ALLOW_SUSPEND_RESUME;
-#elif MHD_VERSION >= 0x00093400
-    mhd_flags |= MHD_USE_SUSPEND_RESUME;
+    mhd_flags |= MHD_USE_INTERNAL_POLLING_THREAD;
 #else
-    mhd_flags |= MHD_USE_PIPE_FOR_SHUTDOWN;
+    mhd_flags |= MHD_USE_SELECT_INTERNALLY;
 #endif
 
     if (addr->ogs_sa_family == AF_INET6)
         mhd_flags |= MHD_USE_IPv6;
 
-    mhd_ops[index].option = MHD_OPTION_NOTIFY_CONNECTION;
-    mhd_ops[index].value = (intptr_t)&mhd_server_notify_connection;
-    mhd_ops[index].ptr_value = NULL;
-    index++;
-
     mhd_ops[index].option = MHD_OPTION_SOCK_ADDR;
     mhd_ops[index].value = 0;
     mhd_ops[index].ptr_value = (void *)&addr->sa;
@@ -283,14 +540,6 @@ static int ogs_metrics_context_server_start(ogs_metrics_server_t *server)
         return OGS_ERROR;
     }
 
-    /* Setup poll for server listening socket */
-    mhd_info = MHD_get_daemon_info(server->mhd, MHD_DAEMON_INFO_LISTEN_FD);
-    ogs_assert(mhd_info);
-
-    server->node.poll = ogs_pollset_add(ogs_app()->pollset,
-            OGS_POLLIN, mhd_info->listen_fd, mhd_server_run, server->mhd);
-    ogs_assert(server->node.poll);
-
     hostname = ogs_gethostname(addr);
     if (hostname)
         ogs_info("metrics_server() [http://%s]:%d",
@@ -306,13 +555,16 @@ static int ogs_metrics_context_server_stop(ogs_metrics_server_t *server)
 {
     ogs_assert(server);
 
-    if (server->node.poll)
-        ogs_pollset_remove(server->node.poll);
-
     if (server->mhd) {
         MHD_stop_daemon(server->mhd);
         server->mhd = NULL;
     }
+
+    /* The MHD thread has been joined */
+    if (server->snapshot) {
+        snapshot_free(server->snapshot);
+        server->snapshot = NULL;
+    }
     return OGS_OK;
 }
 
@@ -320,6 +572,7 @@ void ogs_metrics_spec_init(ogs_metrics_context_t *ctx)
 {
     ogs_list_init(&ctx->spec_list);
     ogs_pool_init(&metrics_spec_pool, ogs_app()->metrics.max_specs);
+    ogs_thread_mutex_init(&list_mutex);
 
     prom_collector_registry_default_init();
 }
@@ -333,6 +586,7 @@ void ogs_metrics_spec_final(ogs_metrics_context_t *ctx)
     }
     prom_collector_registry_destroy(PROM_COLLECTOR_REGISTRY_DEFAULT);
 
+    ogs_thread_mutex_destroy(&list_mutex);
     ogs_pool_final(&metrics_spec_pool);
 }
 
@@ -420,7 +674,45 @@ ogs_metrics_spec_t *ogs_metrics_spec_new(
     }
     prom_collector_registry_must_register_metric(spec->prom);
 
+    ogs_thread_mutex_lock(&list_mutex);
     ogs_list_add(&ctx->spec_list, &spec->entry);
+    ogs_thread_mutex_unlock(&list_mutex);
+    return spec;
+}
+
+ogs_metrics_spec_t *ogs_metrics_spec_new_dynamic(
+        ogs_metrics_context_t *ctx,
+        const char *name, const char *description,
+        int initial_val, unsigned int num_labels, const char ** labels)
+{
+    ogs_metrics_spec_t *spec;
+    unsigned int i;
+
+    ogs_assert(name);
+    ogs_assert(description);
+    ogs_assert(num_labels <= MAX_LABELS);
+
+    ogs_pool_alloc(&metrics_spec_pool, &spec);
+    ogs_assert(spec);
+    memset(spec, 0, sizeof *spec);
+    spec->ctx = ctx;
+    ogs_list_init(&spec->inst_list);
+    spec->type = OGS_METRICS_METRIC_TYPE_GAUGE;
+    spec->name = ogs_strdup(name);
+    spec->description = ogs_strdup(description);
+    spec->initial_val = initial_val;
+    spec->num_labels = num_labels;
+    for (i = 0; i < num_labels; i++) {
+        ogs_assert(labels[i]);
+        spec->labels[i] = ogs_strdup(labels[i]);
+    }
+    spec->dynamic = true;
+    spec->header = dynamic_header_render(spec, &spec->header_len);
+    ogs_assert(spec->header);
+
+    ogs_thread_mutex_lock(&list_mutex);
+    ogs_list_add(&ctx->spec_list, &spec->entry);
+    ogs_thread_mutex_unlock(&list_mutex);
     return spec;
 }
 
@@ -429,7 +721,9 @@ void ogs_metrics_spec_free(ogs_metrics_spec_t *spec)
     ogs_metrics_inst_t *inst = NULL, *next = NULL;
     unsigned int i;
 
+    ogs_thread_mutex_lock(&list_mutex);
     ogs_list_remove(&spec->ctx->spec_list, &spec->entry);
+    ogs_thread_mutex_unlock(&list_mutex);
 
     ogs_list_for_each_entry_safe(&spec->inst_list, next, inst, entry) {
         ogs_metrics_inst_free(inst);
@@ -439,6 +733,7 @@ void ogs_metrics_spec_free(ogs_metrics_spec_t *spec)
     ogs_free(spec->description);
     for (i = 0; i < spec->num_labels; i++)
         ogs_free(spec->labels[i]);
+    free(spec->header);
 
     ogs_pool_free(&metrics_spec_pool, spec);
 }
@@ -462,8 +757,16 @@ ogs_metrics_inst_t *ogs_metrics_inst_new(
         ogs_assert(label_values[i]);
         inst->label_values[i] = ogs_strdup(label_values[i]);
     }
-    ogs_list_add(&spec->inst_list, &inst->entry);
     ogs_metrics_inst_reset(inst);
+
+    if (spec->dynamic) {
+        inst->series = dynamic_series_render(inst, &inst->series_len);
+        ogs_assert(inst->series);
+    }
+
+    if (spec->dynamic) ogs_thread_mutex_lock(&list_mutex);
+    ogs_list_add(&spec->inst_list, &inst->entry);
+    if (spec->dynamic) ogs_thread_mutex_unlock(&list_mutex);
     return inst;
 }
 
@@ -471,16 +774,24 @@ void ogs_metrics_inst_free(ogs_metrics_inst_t *inst)
 {
     unsigned int i;
 
+    if (inst->spec->dynamic) ogs_thread_mutex_lock(&list_mutex);
     ogs_list_remove(&inst->spec->inst_list, &inst->entry);
+    if (inst->spec->dynamic) ogs_thread_mutex_unlock(&list_mutex);
 
     for (i = 0; i < inst->num_labels; i++)
         ogs_free(inst->label_values[i]);
+    free(inst->series);
 
     ogs_free(inst);
 }
 
 void ogs_metrics_inst_set(ogs_metrics_inst_t *inst, int val)
 {
+    if (inst->spec->dynamic) {
+        __atomic_store_n(&inst->value, val, __ATOMIC_RELAXED);
+        return;
+    }
+
     switch (inst->spec->type) {
     case OGS_METRICS_METRIC_TYPE_GAUGE:
         prom_gauge_set(inst->spec->prom, (double)val, (const char **)inst->label_values);
@@ -493,6 +804,12 @@ void ogs_metrics_inst_set(ogs_metrics_inst_t *inst, int val)
 
 void ogs_metrics_inst_set_with_labels(ogs_metrics_inst_t *inst, const char **label_values, int val)
 {
+    /* A dynamic instance is its own series */
+    if (inst->spec->dynamic) {
+        __atomic_store_n(&inst->value, val, __ATOMIC_RELAXED);
+        return;
+    }
+
     switch (inst->spec->type) {
     case OGS_METRICS_METRIC_TYPE_GAUGE:
         prom_gauge_set(inst->spec->prom, (double)val, (const char **)label_values);
@@ -505,6 +822,12 @@ void ogs_metrics_inst_set_with_labels(ogs_metrics_inst_t *inst, const char **lab
 
 void ogs_metrics_inst_reset(ogs_metrics_inst_t *inst)
 {
+    if (inst->spec->dynamic) {
+        __atomic_store_n(&inst->value,
+                inst->spec->initial_val, __ATOMIC_RELAXED);
+        return;
+    }
+
     switch (inst->spec->type) {
     case OGS_METRICS_METRIC_TYPE_COUNTER:
         prom_counter_add(inst->spec->prom, 0.0, (const char **)inst->label_values);
@@ -520,6 +843,11 @@ void ogs_metrics_inst_reset(ogs_metrics_inst_t *inst)
 
 void ogs_metrics_inst_add(ogs_metrics_inst_t *inst, int val)
 {
+    if (inst->spec->dynamic) {
+        __atomic_fetch_add(&inst->value, val, __ATOMIC_RELAXED);
+        return;
+    }
+
     switch (inst->spec->type) {
     case OGS_METRICS_METRIC_TYPE_COUNTER:
         ogs_assert(val >= 0);
@@ -540,3 +868,210 @@ void ogs_metrics_inst_add(ogs_metrics_inst_t *inst, int val)
         break;
     }
 }
+
+/* printf into buf, which was malloc()ed by prom and is kept in a snapshot */
+static bool buf_printf(char **buf, size_t *len, size_t *size,
+        const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    while (1) {
+        va_start(ap, fmt);
+        n = vsnprintf(*buf + *len, *size - *len, fmt, ap);
+        va_end(ap);
+        if (n < 0)
+            return false;
+
+        if (*len + n < *size) {
+            *len += n;
+            return true;
+        }
+
+        {
+            size_t newsize = (*size + n + 1) * 2;
+            char *newbuf = realloc(*buf, newsize);
+            if (!newbuf) {
+                (*buf)[*len] = '\0';
+                return false;
+            }
+            *buf = newbuf;
+            *size = newsize;
+        }
+    }
+}
+
+static bool buf_label_value(char **buf, size_t *len, size_t *size,
+        const char *value)
+{
+    for (; *value; value++) {
+        bool ok;
+        if (*value == '\\')
+            ok = buf_printf(buf, len, size, "\\\\");
+        else if (*value == '"')
+            ok = buf_printf(buf, len, size, "\\\"");
+        else if (*value == '\n')
+            ok = buf_printf(buf, len, size, "\\n");
+        else
+            ok = buf_printf(buf, len, size, "%c", *value);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+/* "# HELP" and "# TYPE" lines of a dynamic spec */
+static char *dynamic_header_render(ogs_metrics_spec_t *spec, size_t *len)
+{
+    size_t size = 64;
+    char *buf = malloc(size);
+
+    if (!buf)
+        return NULL;
+    buf[0] = '\0';
+    *len = 0;
+
+    if (!buf_printf(&buf, len, &size, "# HELP %s %s\n# TYPE %s gauge\n",
+                spec->name, spec->description, spec->name)) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/* Series name and labels of a dynamic instance, without the value */
+static char *dynamic_series_render(ogs_metrics_inst_t *inst, size_t *len)
+{
+    ogs_metrics_spec_t *spec = inst->spec;
+    size_t size = 64;
+    char *buf = malloc(size);
+    unsigned int i;
+
+    if (!buf)
+        return NULL;
+    buf[0] = '\0';
+    *len = 0;
+
+    if (!buf_printf(&buf, len, &size, "%s", spec->name))
+        goto err;
+
+    for (i = 0; i < inst->num_labels; i++) {
+        if (!buf_printf(&buf, len, &size, "%s%s=\"",
+                    i == 0 ? "{" : ",", spec->labels[i]) ||
+            !buf_label_value(&buf, len, &size, inst->label_values[i]) ||
+            !buf_printf(&buf, len, &size, "\""))
+            goto err;
+    }
+
+    if (inst->num_labels && !buf_printf(&buf, len, &size, "}"))
+        goto err;
+
+    return buf;
+
+err:
+    free(buf);
+    return NULL;
+}
+
+/* Appends to the copied text, growing it and the samples as needed */
+static bool dynamic_sample_add(
+        char **text, size_t *text_len, size_t *text_size,
+        dynamic_sample_t **samples, size_t *num, size_t *max,
+        const char *str, size_t len, int64_t value, bool is_header)
+{
+    if (*num == *max) {
+        size_t newmax = *max ? *max * 2 : 64;
+        dynamic_sample_t *newsamples =
+            realloc(*samples, newmax * sizeof(**samples));
+        if (!newsamples)
+            return false;
+        *samples = newsamples;
+        *max = newmax;
+    }
+    if (*text_len + len > *text_size) {
+        size_t newsize = (*text_size + len) * 2;
+        char *newtext = realloc(*text, newsize);
+        if (!newtext)
+            return false;
+        *text = newtext;
+        *text_size = newsize;
+    }
+
+    memcpy(*text + *text_len, str, len);
+    (*samples)[*num].offset = *text_len;
+    (*samples)[*num].len = len;
+    (*samples)[*num].value = value;
+    (*samples)[*num].is_header = is_header;
+    *text_len += len;
+    (*num)++;
+
+    return true;
+}
+
+/* Render dynamic specs in the text exposition format after prom's output */
+static char *dynamic_metrics_append(char *buf)
+{
+    ogs_metrics_context_t *ctx = ogs_metrics_self();
+    ogs_metrics_spec_t *spec = NULL;
+    ogs_metrics_inst_t *inst = NULL;
+    char *text = NULL;
+    size_t text_len = 0, text_size = 0;
+    dynamic_sample_t *samples = NULL;
+    size_t num = 0, max = 0;
+    size_t len, size, i;
+
+    ogs_assert(buf);
+
+    /*
+     * Instances are added and freed on the NF thread, so only copy
+     * what was rendered for them when they were created, and the value.
+     */
+    ogs_thread_mutex_lock(&list_mutex);
+    ogs_list_for_each_entry(&ctx->spec_list, spec, entry) {
+        if (!spec->dynamic)
+            continue;
+
+        if (!dynamic_sample_add(&text, &text_len, &text_size,
+                    &samples, &num, &max,
+                    spec->header, spec->header_len, 0, true))
+            goto unlock;
+
+        ogs_list_for_each_entry(&spec->inst_list, inst, entry) {
+            if (!dynamic_sample_add(&text, &text_len, &text_size,
+                        &samples, &num, &max,
+                        inst->series, inst->series_len,
+                        __atomic_load_n(&inst->value, __ATOMIC_RELAXED),
+                        false))
+                goto unlock;
+        }
+    }
+unlock:
+    ogs_thread_mutex_unlock(&list_mutex);
+
+    len = strlen(buf);
+    size = len + 1;
+
+    for (i = 0; i < num; i++) {
+        dynamic_sample_t *sample = &samples[i];
+
+        if (sample->is_header) {
+            if (i > 0 && !buf_printf(&buf, &len, &size, "\n"))
+                break;
+            if (!buf_printf(&buf, &len, &size, "%.*s",
+                        (int)sample->len, text + sample->offset))
+                break;
+        } else {
+            if (!buf_printf(&buf, &len, &size, "%.*s %lld\n",
+                        (int)sample->len, text + sample->offset,
+                        (long long)sample->value))
+                break;
+        }
+    }
+    if (i == num && num > 0)
+        buf_printf(&buf, &len, &size, "\n");
+
+    free(text);
+    free(samples);
+
+    return buf;
+}
@@ -76,6 +76,14 @@ ogs_metrics_spec_t *ogs_metrics_spec_new(
     return (ogs_metrics_spec_t *)1;
 }
 
+ogs_metrics_spec_t *ogs_metrics_spec_new_dynamic(
+        ogs_metrics_context_t *ctx,
+        const char *name, const char *description,
+        int initial_val, unsigned int num_labels, const char ** labels)
+{
+    return (ogs_metrics_spec_t *)1;
+}
+
 void ogs_metrics_spec_free(ogs_metrics_spec_t *spec)
 {
 }
@@ -3719,7 +3719,8 @@ ogs_pkbuf_t *ogs_nas_5gmm_encode(ogs_nas_5gs_message_t *message)
 
     pkbuf->len = encoded;
 
-    return pkbuf;
+    /* Give back the OGS_MAX_SDU_LEN tailroom, keeping the headroom */
+    return ogs_pkbuf_compact(pkbuf);
 }
 
 ogs_pkbuf_t *ogs_nas_5gsm_encode(ogs_nas_5gs_message_t *message)
@@ -3836,7 +3837,8 @@ ogs_pkbuf_t *ogs_nas_5gsm_encode(ogs_nas_5gs_message_t *message)
     ogs_assert(ogs_pkbuf_push(pkbuf, encoded));
     pkbuf->len = encoded;
 
-    return pkbuf;
+    /* Give back the OGS_MAX_SDU_LEN tailroom, keeping the headroom */
+    return ogs_pkbuf_compact(pkbuf);
 }
 
 ogs_pkbuf_t *ogs_nas_5gs_plain_encode(ogs_nas_5gs_message_t *message)
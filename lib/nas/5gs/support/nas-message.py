@@ -925,7 +925,8 @@ f.write("""    default:
 
     pkbuf->len = encoded;
 
-    return pkbuf;
+    /* Give back the OGS_MAX_SDU_LEN tailroom, keeping the headroom */
+    return ogs_pkbuf_compact(pkbuf);
 }
 
 """)
@@ -977,7 +978,8 @@ f.write("""    default:
     ogs_assert(ogs_pkbuf_push(pkbuf, encoded));
     pkbuf->len = encoded;
 
-    return pkbuf;
+    /* Give back the OGS_MAX_SDU_LEN tailroom, keeping the headroom */
+    return ogs_pkbuf_compact(pkbuf);
 }
 
 ogs_pkbuf_t *ogs_nas_5gs_plain_encode(ogs_nas_5gs_message_t *message)
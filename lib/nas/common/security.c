@@ -19,13 +19,19 @@
 
 #include "ogs-nas-common.h"
 
-void ogs_nas_mac_calculate(uint8_t algorithm_identity,
-        uint8_t *knas_int, uint32_t count, uint8_t bearer, 
+/*
+ * eia2/eea2 are the schedules expanded from the same key, or NULL to
+ * expand them here for this message only.
+ */
+static void nas_mac_calculate(uint8_t algorithm_identity,
+        const uint8_t *knas_int, const ogs_aes_cmac_key_t *eia2,
+        uint32_t count, uint8_t bearer, 
         uint8_t direction, ogs_pkbuf_t *pkbuf, uint8_t *mac)
 {
     uint8_t *ivec = NULL;;
     uint8_t cmac[16];
     uint32_t mac32;
+    ogs_aes_cmac_key_t cmac_key;
 
     ogs_assert(knas_int);
     ogs_assert(bearer <= 0x1f);
@@ -37,10 +43,15 @@ void ogs_nas_mac_calculate(uint8_t algorithm_identity,
 
     switch (algorithm_identity) {
     case OGS_NAS_SECURITY_ALGORITHMS_128_EIA1:
-        snow_3g_f9(knas_int, count, (bearer << 27), direction, 
+        snow_3g_f9((uint8_t *)knas_int, count, (bearer << 27), direction, 
                 pkbuf->data, (pkbuf->len << 3), mac);
         break;
     case OGS_NAS_SECURITY_ALGORITHMS_128_EIA2:
+        if (!eia2) {
+            ogs_aes_cmac_key_setup(&cmac_key, knas_int);
+            eia2 = &cmac_key;
+        }
+
         count = htonl(count);
 
         ogs_pkbuf_push(pkbuf, 8);
@@ -50,14 +61,14 @@ void ogs_nas_mac_calculate(uint8_t algorithm_identity,
         memcpy(ivec + 0, &count, sizeof(count));
         ivec[4] = (bearer << 3) | (direction << 2);
 
-        ogs_aes_cmac_calculate(cmac, knas_int, pkbuf->data, pkbuf->len);
+        ogs_aes_cmac_key_calculate(cmac, eia2, pkbuf->data, pkbuf->len);
         memcpy(mac, cmac, 4);
 
         ogs_pkbuf_pull(pkbuf, 8);
 
         break;
     case OGS_NAS_SECURITY_ALGORITHMS_128_EIA3:
-        zuc_eia3(knas_int, count, bearer, direction, 
+        zuc_eia3((uint8_t *)knas_int, count, bearer, direction, 
                 (pkbuf->len << 3), pkbuf->data, &mac32);
         mac32 = ntohl(mac32);
         memcpy(mac, &mac32, sizeof(uint32_t));
@@ -71,11 +82,13 @@ void ogs_nas_mac_calculate(uint8_t algorithm_identity,
     }
 }
 
-void ogs_nas_encrypt(uint8_t algorithm_identity,
-        uint8_t *knas_enc, uint32_t count, uint8_t bearer, 
+static void nas_encrypt(uint8_t algorithm_identity,
+        const uint8_t *knas_enc, const ogs_aes_key_t *eea2,
+        uint32_t count, uint8_t bearer, 
         uint8_t direction, ogs_pkbuf_t *pkbuf)
 {
     uint8_t ivec[16];
+    ogs_aes_key_t aes_key;
 
     ogs_assert(knas_enc);
     ogs_assert(bearer <= 0x1f);
@@ -86,20 +99,25 @@ void ogs_nas_encrypt(uint8_t algorithm_identity,
 
     switch (algorithm_identity) {
     case OGS_NAS_SECURITY_ALGORITHMS_128_EEA1:
-        snow_3g_f8(knas_enc, count, bearer, direction, 
+        snow_3g_f8((uint8_t *)knas_enc, count, bearer, direction, 
                 pkbuf->data, (pkbuf->len << 3));
         break;
     case OGS_NAS_SECURITY_ALGORITHMS_128_EEA2:
+        if (!eea2) {
+            ogs_aes_key_setup_enc(&aes_key, knas_enc, 128);
+            eea2 = &aes_key;
+        }
+
         count = htonl(count);
 
         memset(ivec, 0, 16);
         memcpy(ivec + 0, &count, sizeof(count));
         ivec[4] = (bearer << 3) | (direction << 2);
-        ogs_aes_ctr128_encrypt(knas_enc, ivec, 
+        ogs_aes_key_ctr128_encrypt(eea2, ivec, 
                 pkbuf->data, pkbuf->len, pkbuf->data);
         break;
     case OGS_NAS_SECURITY_ALGORITHMS_128_EEA3:
-        zuc_eea3(knas_enc, count, bearer, direction, 
+        zuc_eea3((uint8_t *)knas_enc, count, bearer, direction, 
                 (pkbuf->len << 3), pkbuf->data, pkbuf->data);
         break;
     case OGS_NAS_SECURITY_ALGORITHMS_EEA0:
@@ -110,3 +128,47 @@ void ogs_nas_encrypt(uint8_t algorithm_identity,
         break;
     }
 }
+
+void ogs_nas_mac_calculate(uint8_t algorithm_identity,
+        uint8_t *knas_int, uint32_t count, uint8_t bearer, 
+        uint8_t direction, ogs_pkbuf_t *pkbuf, uint8_t *mac)
+{
+    nas_mac_calculate(algorithm_identity, knas_int, NULL,
+            count, bearer, direction, pkbuf, mac);
+}
+
+void ogs_nas_encrypt(uint8_t algorithm_identity,
+        uint8_t *knas_enc, uint32_t count, uint8_t bearer, 
+        uint8_t direction, ogs_pkbuf_t *pkbuf)
+{
+    nas_encrypt(algorithm_identity, knas_enc, NULL,
+            count, bearer, direction, pkbuf);
+}
+
+void ogs_nas_security_key_expand(ogs_nas_security_key_t *key)
+{
+    ogs_assert(key);
+
+    ogs_aes_cmac_key_setup(&key->eia2, key->knas_int);
+    ogs_aes_key_setup_enc(&key->eea2, key->knas_enc, 128);
+}
+
+void ogs_nas_mac_calculate_key(uint8_t algorithm_identity,
+        const ogs_nas_security_key_t *key, uint32_t count, uint8_t bearer,
+        uint8_t direction, ogs_pkbuf_t *pkbuf, uint8_t *mac)
+{
+    ogs_assert(key);
+
+    nas_mac_calculate(algorithm_identity, key->knas_int, &key->eia2,
+            count, bearer, direction, pkbuf, mac);
+}
+
+void ogs_nas_encrypt_key(uint8_t algorithm_identity,
+        const ogs_nas_security_key_t *key, uint32_t count, uint8_t bearer,
+        uint8_t direction, ogs_pkbuf_t *pkbuf)
+{
+    ogs_assert(key);
+
+    nas_encrypt(algorithm_identity, key->knas_enc, &key->eea2,
+            count, bearer, direction, pkbuf);
+}
@@ -39,6 +39,29 @@ void ogs_nas_encrypt(uint8_t algorithm_identity,
     uint8_t *knas_enc, uint32_t count, uint8_t bearer, 
     uint8_t direction, ogs_pkbuf_t *pkbuf);
 
+/*
+ * NAS keys together with their AES key schedules. The caller derives
+ * knas_int/knas_enc and calls ogs_nas_security_key_expand() once;
+ * EIA2/EEA2 then reuse the schedules on every message.
+ */
+typedef struct ogs_nas_security_key_s {
+    uint8_t knas_int[OGS_KEY_LEN];
+    uint8_t knas_enc[OGS_KEY_LEN];
+
+    ogs_aes_cmac_key_t eia2;
+    ogs_aes_key_t eea2;
+} ogs_nas_security_key_t;
+
+void ogs_nas_security_key_expand(ogs_nas_security_key_t *key);
+
+void ogs_nas_mac_calculate_key(uint8_t algorithm_identity,
+    const ogs_nas_security_key_t *key, uint32_t count, uint8_t bearer,
+    uint8_t direction, ogs_pkbuf_t *pkbuf, uint8_t *mac);
+
+void ogs_nas_encrypt_key(uint8_t algorithm_identity,
+    const ogs_nas_security_key_t *key, uint32_t count, uint8_t bearer,
+    uint8_t direction, ogs_pkbuf_t *pkbuf);
+
 #ifdef __cplusplus
 }
 #endif
@@ -3780,7 +3780,8 @@ out:
 
     pkbuf->len = encoded;
 
-    return pkbuf;
+    /* Give back the OGS_MAX_SDU_LEN tailroom, keeping the headroom */
+    return ogs_pkbuf_compact(pkbuf);
 }
 
 ogs_pkbuf_t *ogs_nas_esm_encode(ogs_nas_eps_message_t *message)
@@ -3924,7 +3925,8 @@ ogs_pkbuf_t *ogs_nas_esm_encode(ogs_nas_eps_message_t *message)
     ogs_assert(ogs_pkbuf_push(pkbuf, encoded));
     pkbuf->len = encoded;
 
-    return pkbuf;
+    /* Give back the OGS_MAX_SDU_LEN tailroom, keeping the headroom */
+    return ogs_pkbuf_compact(pkbuf);
 }
 
 ogs_pkbuf_t *ogs_nas_eps_plain_encode(ogs_nas_eps_message_t *message)
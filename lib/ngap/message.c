@@ -40,6 +40,12 @@ ogs_pkbuf_t *ogs_ngap_encode(ogs_ngap_message_t *message)
 }
 
 int ogs_ngap_decode(ogs_ngap_message_t *message, ogs_pkbuf_t *pkbuf)
+{
+    return ogs_ngap_decode_arena(message, pkbuf, NULL);
+}
+
+int ogs_ngap_decode_arena(ogs_ngap_message_t *message,
+        ogs_pkbuf_t *pkbuf, ogs_arena_t *arena)
 {
     int rv;
     ogs_assert(message);
@@ -47,8 +53,8 @@ int ogs_ngap_decode(ogs_ngap_message_t *message, ogs_pkbuf_t *pkbuf)
     ogs_assert(pkbuf->data);
     ogs_assert(pkbuf->len);
 
-    rv = ogs_asn_decode(&asn_DEF_NGAP_NGAP_PDU,
-            message, sizeof(ogs_ngap_message_t), pkbuf);
+    rv = ogs_asn_decode_arena(&asn_DEF_NGAP_NGAP_PDU,
+            message, sizeof(ogs_ngap_message_t), pkbuf, arena);
     if (rv != OGS_OK) {
         ogs_warn("Failed to decode NGAP-PDU");
         return rv;
@@ -61,7 +67,12 @@ int ogs_ngap_decode(ogs_ngap_message_t *message, ogs_pkbuf_t *pkbuf)
 }
 
 void ogs_ngap_free(ogs_ngap_message_t *message)
+{
+    ogs_ngap_free_arena(message, NULL);
+}
+
+void ogs_ngap_free_arena(ogs_ngap_message_t *message, ogs_arena_t *arena)
 {
     ogs_assert(message);
-    ogs_asn_free(&asn_DEF_NGAP_NGAP_PDU, message);
+    ogs_asn_free_arena(&asn_DEF_NGAP_NGAP_PDU, message, arena);
 }
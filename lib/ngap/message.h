@@ -34,6 +34,11 @@ int ogs_ngap_decode(ogs_ngap_message_t *message, ogs_pkbuf_t *pkbuf);
 ogs_pkbuf_t *ogs_ngap_encode(ogs_ngap_message_t *message);
 void ogs_ngap_free(ogs_ngap_message_t *message);
 
+/* Decode into an arena; see ogs_asn_decode_arena() */
+int ogs_ngap_decode_arena(ogs_ngap_message_t *message,
+        ogs_pkbuf_t *pkbuf, ogs_arena_t *arena);
+void ogs_ngap_free_arena(ogs_ngap_message_t *message, ogs_arena_t *arena);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,6 @@
 #include "ogs-redis.h"
 #include "core/ogs-core.h"
+#include "ogs-metrics.h"
 
 redisContext* ogs_redis_initialise(const char* address, uint32_t port) {
     redisContext *connection = redisConnect(
@@ -38,4 +39,671 @@ void ogs_redis_finalise(redisContext* connection) {
     if (NULL != connection) {
         redisFree(connection);
     }
-}
\ No newline at end of file
+}
+
+typedef struct ogs_redis_poll_s {
+    redisAsyncContext *context;
+    ogs_pollset_t *pollset;
+
+    ogs_poll_t *read;
+    ogs_poll_t *write;
+} ogs_redis_poll_t;
+
+static void redis_poll_handle_read(short when, ogs_socket_t fd, void *data) {
+    ogs_redis_poll_t *p = data;
+    ogs_assert(p);
+
+    redisAsyncHandleRead(p->context);
+}
+
+static void redis_poll_handle_write(short when, ogs_socket_t fd, void *data) {
+    ogs_redis_poll_t *p = data;
+    ogs_assert(p);
+
+    redisAsyncHandleWrite(p->context);
+}
+
+static void redis_poll_add_read(void *privdata) {
+    ogs_redis_poll_t *p = privdata;
+    ogs_assert(p);
+
+    if (NULL == p->read) {
+        p->read = ogs_pollset_add(p->pollset, OGS_POLLIN,
+                p->context->c.fd, redis_poll_handle_read, p);
+        ogs_assert(p->read);
+    }
+}
+
+static void redis_poll_del_read(void *privdata) {
+    ogs_redis_poll_t *p = privdata;
+    ogs_assert(p);
+
+    if (NULL != p->read) {
+        ogs_pollset_remove(p->read);
+        p->read = NULL;
+    }
+}
+
+static void redis_poll_add_write(void *privdata) {
+    ogs_redis_poll_t *p = privdata;
+    ogs_assert(p);
+
+    if (NULL == p->write) {
+        p->write = ogs_pollset_add(p->pollset, OGS_POLLOUT,
+                p->context->c.fd, redis_poll_handle_write, p);
+        ogs_assert(p->write);
+    }
+}
+
+static void redis_poll_del_write(void *privdata) {
+    ogs_redis_poll_t *p = privdata;
+    ogs_assert(p);
+
+    if (NULL != p->write) {
+        ogs_pollset_remove(p->write);
+        p->write = NULL;
+    }
+}
+
+static void redis_poll_cleanup(void *privdata) {
+    ogs_redis_poll_t *p = privdata;
+    ogs_assert(p);
+
+    redis_poll_del_read(p);
+    redis_poll_del_write(p);
+    ogs_free(p);
+}
+
+redisAsyncContext* ogs_redis_async_initialise(
+        const char* address, uint32_t port, ogs_pollset_t *pollset) {
+    redisAsyncContext *connection = NULL;
+    ogs_redis_poll_t *p = NULL;
+
+    ogs_assert(pollset);
+
+    connection = redisAsyncConnect(address, port);
+
+    if (NULL == connection) {
+        ogs_error("Failure: Redis async config {address: '%s', port: %i}",
+            address,
+            port
+        );
+
+        return NULL;
+    }
+
+    if (0 != connection->err) {
+        ogs_error("%s - Redis async config {address: '%s', port: %i}",
+            connection->errstr,
+            address,
+            port
+        );
+        redisAsyncFree(connection);
+        return NULL;
+    }
+
+    /* Attach the connection to the pollset in the same way
+     * as the adapters shipped with hiredis do for libevent/libev */
+    p = ogs_calloc(1, sizeof(*p));
+    ogs_assert(p);
+    p->context = connection;
+    p->pollset = pollset;
+
+    connection->ev.addRead = redis_poll_add_read;
+    connection->ev.delRead = redis_poll_del_read;
+    connection->ev.addWrite = redis_poll_add_write;
+    connection->ev.delWrite = redis_poll_del_write;
+    connection->ev.cleanup = redis_poll_cleanup;
+    connection->ev.data = p;
+
+    /* Connect is in progress, we are told by a write event once it is done */
+    redis_poll_add_write(p);
+
+    ogs_debug("Connecting to redis asynchronously {address: '%s', port: %i}",
+        address,
+        port
+    );
+
+    return connection;
+}
+
+void ogs_redis_async_finalise(redisAsyncContext* connection) {
+    if (NULL != connection) {
+        redisAsyncFree(connection);
+    }
+}
+
+
+#define REDIS_POOL_VNODES           64  /* Ring points per endpoint */
+#define REDIS_POOL_MAX_APPENDED     64
+#define REDIS_POOL_MIN_BACKOFF      ogs_time_from_msec(100)
+#define REDIS_POOL_MAX_BACKOFF      ogs_time_from_sec(30)
+
+typedef struct ogs_redis_shard_s ogs_redis_shard_t;
+
+typedef struct ogs_redis_conn_s {
+    ogs_redis_shard_t *shard;   /* backpointer */
+
+    redisContext *context;
+    int num_of_appended;        /* Replies still to be discarded */
+
+    redisAsyncContext *async;   /* Only used by the shard's async_conn */
+
+    ogs_timer_t *t_reconnect;
+    ogs_time_t backoff;
+} ogs_redis_conn_t;
+
+struct ogs_redis_shard_s {
+    ogs_redis_pool_t *pool;     /* backpointer */
+    int index;
+
+    char *address;
+    uint32_t port;
+
+    ogs_redis_conn_t conn[OGS_REDIS_MAX_CONNECTIONS];
+    int next_conn;              /* Round robin */
+
+    ogs_redis_conn_t async_conn;
+
+    struct {
+        ogs_metrics_inst_t *commands;
+        ogs_metrics_inst_t *errors;
+        ogs_metrics_inst_t *rtt;
+    } metrics;
+};
+
+struct ogs_redis_pool_s {
+    int num_of_shards;
+    ogs_redis_shard_t shard[OGS_REDIS_MAX_ENDPOINTS];
+
+    int num_of_connections;
+    ogs_time_t timeout;
+
+    ogs_timer_mgr_t *timer_mgr;
+    ogs_pollset_t *pollset;
+
+    int ring_size;
+    struct {
+        uint64_t point;
+        int shard;
+    } ring[OGS_REDIS_MAX_ENDPOINTS * REDIS_POOL_VNODES];
+};
+
+/* Shared by every pool, prometheus only takes a name once */
+static ogs_metrics_spec_t *redis_spec_commands = NULL;
+static ogs_metrics_spec_t *redis_spec_errors = NULL;
+static ogs_metrics_spec_t *redis_spec_rtt = NULL;
+
+static void redis_pool_metrics_init(ogs_redis_shard_t *shard);
+static void redis_pool_connect(ogs_redis_conn_t *conn);
+static void redis_pool_async_connect(ogs_redis_conn_t *conn);
+static void redis_pool_schedule_reconnect(ogs_redis_conn_t *conn);
+static void redis_pool_reconnect_cb(void *data);
+static void redis_pool_drop(ogs_redis_conn_t *conn);
+static void redis_pool_discard_appended(ogs_redis_conn_t *conn);
+static ogs_redis_conn_t *redis_pool_pick(ogs_redis_shard_t *shard);
+
+static int redis_ring_compare(const void *a, const void *b) {
+    const uint64_t pa = *(const uint64_t *)a;
+    const uint64_t pb = *(const uint64_t *)b;
+
+    return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+ogs_redis_pool_t *ogs_redis_pool_create(
+        ogs_redis_endpoint_t *endpoints, int num_of_endpoints,
+        int num_of_connections, ogs_time_t timeout,
+        ogs_timer_mgr_t *timer_mgr, ogs_pollset_t *pollset) {
+    ogs_redis_pool_t *pool = NULL;
+    int i, j;
+
+    ogs_assert(endpoints);
+    ogs_assert(num_of_endpoints > 0 &&
+            num_of_endpoints <= OGS_REDIS_MAX_ENDPOINTS);
+    ogs_assert(num_of_connections >= 0 &&
+            num_of_connections <= OGS_REDIS_MAX_CONNECTIONS);
+    ogs_assert(timer_mgr);
+
+    pool = ogs_calloc(1, sizeof(*pool));
+    ogs_assert(pool);
+
+    pool->num_of_shards = num_of_endpoints;
+    pool->num_of_connections = num_of_connections;
+    pool->timeout = timeout;
+    pool->timer_mgr = timer_mgr;
+    pool->pollset = pollset;
+
+    for (i = 0; i < num_of_endpoints; i++) {
+        ogs_redis_shard_t *shard = &pool->shard[i];
+        char name[OGS_ADDRSTRLEN + 16];
+
+        ogs_assert(endpoints[i].address);
+
+        shard->pool = pool;
+        shard->index = i;
+        shard->address = ogs_strdup(endpoints[i].address);
+        ogs_assert(shard->address);
+        shard->port = endpoints[i].port;
+
+        /* Ring points only depend on the endpoint, so every node
+         * sharing the same endpoints agrees on the key placement */
+        ogs_snprintf(name, sizeof(name), "%s:%u",
+                shard->address, (unsigned)shard->port);
+        for (j = 0; j < REDIS_POOL_VNODES; j++) {
+            pool->ring[pool->ring_size].point =
+                ogs_hash_xxh64(name, strlen(name), j);
+            pool->ring[pool->ring_size].shard = i;
+            pool->ring_size++;
+        }
+
+        redis_pool_metrics_init(shard);
+
+        for (j = 0; j < num_of_connections; j++) {
+            ogs_redis_conn_t *conn = &shard->conn[j];
+
+            conn->shard = shard;
+            conn->t_reconnect = ogs_timer_add(
+                    timer_mgr, redis_pool_reconnect_cb, conn);
+            ogs_assert(conn->t_reconnect);
+
+            redis_pool_connect(conn);
+        }
+
+        if (pollset) {
+            ogs_redis_conn_t *conn = &shard->async_conn;
+
+            conn->shard = shard;
+            conn->t_reconnect = ogs_timer_add(
+                    timer_mgr, redis_pool_reconnect_cb, conn);
+            ogs_assert(conn->t_reconnect);
+
+            redis_pool_async_connect(conn);
+        }
+    }
+
+    qsort(pool->ring, pool->ring_size,
+            sizeof(pool->ring[0]), redis_ring_compare);
+
+    return pool;
+}
+
+void ogs_redis_pool_destroy(ogs_redis_pool_t *pool) {
+    int i, j;
+
+    ogs_assert(pool);
+
+    for (i = 0; i < pool->num_of_shards; i++) {
+        ogs_redis_shard_t *shard = &pool->shard[i];
+
+        for (j = 0; j < pool->num_of_connections; j++) {
+            ogs_redis_conn_t *conn = &shard->conn[j];
+
+            if (conn->context) {
+                redis_pool_discard_appended(conn);
+                ogs_redis_finalise(conn->context);
+                conn->context = NULL;
+            }
+            ogs_timer_delete(conn->t_reconnect);
+        }
+
+        if (shard->async_conn.t_reconnect) {
+            ogs_redis_conn_t *conn = &shard->async_conn;
+            redisAsyncContext *async = conn->async;
+
+            /* Disconnect callback must not schedule a reconnect */
+            conn->async = NULL;
+            if (async) {
+                async->data = NULL;
+                ogs_redis_async_finalise(async);
+            }
+            ogs_timer_delete(conn->t_reconnect);
+        }
+
+        ogs_metrics_inst_free(shard->metrics.commands);
+        ogs_metrics_inst_free(shard->metrics.errors);
+        ogs_metrics_inst_free(shard->metrics.rtt);
+
+        ogs_free(shard->address);
+    }
+
+    ogs_free(pool);
+}
+
+int ogs_redis_pool_shard(ogs_redis_pool_t *pool,
+        const void *key, size_t keylen) {
+    uint64_t point;
+    int lo, hi;
+
+    ogs_assert(pool);
+
+    if (pool->num_of_shards == 1)
+        return 0;
+
+    point = ogs_hash_xxh64(key, keylen, 0);
+
+    /* First ring point at or after the key, wrapping around */
+    lo = 0;
+    hi = pool->ring_size;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (pool->ring[mid].point < point)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == pool->ring_size)
+        lo = 0;
+
+    return pool->ring[lo].shard;
+}
+
+redisReply *ogs_redis_pool_command(ogs_redis_pool_t *pool,
+        const void *key, size_t keylen, const char *format, ...) {
+    ogs_redis_shard_t *shard = NULL;
+    ogs_redis_conn_t *conn = NULL;
+    redisReply *reply = NULL;
+    ogs_time_t sent_time;
+    va_list ap;
+
+    ogs_assert(pool);
+    ogs_assert(format);
+
+    shard = &pool->shard[ogs_redis_pool_shard(pool, key, keylen)];
+
+    conn = redis_pool_pick(shard);
+    if (!conn) {
+        ogs_metrics_inst_inc(shard->metrics.errors);
+        return NULL;
+    }
+
+    /* Replies come back in order, so the appended ones go first */
+    redis_pool_discard_appended(conn);
+    if (!conn->context) {
+        ogs_metrics_inst_inc(shard->metrics.errors);
+        return NULL;
+    }
+
+    sent_time = ogs_get_monotonic_time();
+    va_start(ap, format);
+    reply = redisvCommand(conn->context, format, ap);
+    va_end(ap);
+
+    ogs_redis_pool_observe(pool, shard->index,
+            ogs_get_monotonic_time() - sent_time, NULL == reply);
+
+    if (NULL == reply) {
+        ogs_error("%s - Redis command failed {address: '%s', port: %i}",
+            conn->context->errstr, shard->address, shard->port);
+        redis_pool_drop(conn);
+    }
+
+    return reply;
+}
+
+int ogs_redis_pool_append(ogs_redis_pool_t *pool,
+        const void *key, size_t keylen, const char *format, ...) {
+    ogs_redis_shard_t *shard = NULL;
+    ogs_redis_conn_t *conn = NULL;
+    va_list ap;
+    int rv;
+
+    ogs_assert(pool);
+    ogs_assert(format);
+
+    shard = &pool->shard[ogs_redis_pool_shard(pool, key, keylen)];
+
+    conn = redis_pool_pick(shard);
+    if (!conn) {
+        ogs_metrics_inst_inc(shard->metrics.errors);
+        return OGS_ERROR;
+    }
+
+    va_start(ap, format);
+    rv = redisvAppendCommand(conn->context, format, ap);
+    va_end(ap);
+
+    if (REDIS_OK != rv) {
+        ogs_metrics_inst_inc(shard->metrics.errors);
+        return OGS_ERROR;
+    }
+
+    ogs_metrics_inst_inc(shard->metrics.commands);
+    if (++conn->num_of_appended >= REDIS_POOL_MAX_APPENDED)
+        redis_pool_discard_appended(conn);
+
+    return OGS_OK;
+}
+
+redisAsyncContext *ogs_redis_pool_async(ogs_redis_pool_t *pool, int shard) {
+    ogs_assert(pool);
+    ogs_assert(shard >= 0 && shard < pool->num_of_shards);
+
+    return pool->shard[shard].async_conn.async;
+}
+
+void ogs_redis_pool_observe(ogs_redis_pool_t *pool,
+        int shard, ogs_time_t rtt, bool error) {
+    ogs_redis_shard_t *s = NULL;
+
+    ogs_assert(pool);
+    ogs_assert(shard >= 0 && shard < pool->num_of_shards);
+    s = &pool->shard[shard];
+
+    ogs_metrics_inst_inc(s->metrics.commands);
+    if (error)
+        ogs_metrics_inst_inc(s->metrics.errors);
+    else
+        ogs_metrics_inst_add(s->metrics.rtt, (int)rtt);
+}
+
+static void redis_pool_metrics_init(ogs_redis_shard_t *shard) {
+    const char *labels[] = { "server" };
+    const char *label_values[1];
+    char server[OGS_ADDRSTRLEN + 16];
+    ogs_metrics_histogram_params_t rtt_params;
+
+    ogs_assert(shard);
+
+    if (NULL == redis_spec_commands) {
+        redis_spec_commands = ogs_metrics_spec_new(ogs_metrics_self(),
+                OGS_METRICS_METRIC_TYPE_COUNTER, "redis_commands",
+                "Number of commands sent to a redis server",
+                0, OGS_ARRAY_SIZE(labels), labels, NULL);
+        redis_spec_errors = ogs_metrics_spec_new(ogs_metrics_self(),
+                OGS_METRICS_METRIC_TYPE_COUNTER, "redis_errors",
+                "Number of redis commands that failed or were not sent",
+                0, OGS_ARRAY_SIZE(labels), labels, NULL);
+
+        memset(&rtt_params, 0, sizeof(rtt_params));
+        rtt_params.type = OGS_METRICS_HISTOGRAM_BUCKET_TYPE_EXPONENTIAL;
+        rtt_params.count = 10;
+        rtt_params.exp.start = 50;
+        rtt_params.exp.factor = 2;
+        redis_spec_rtt = ogs_metrics_spec_new(ogs_metrics_self(),
+                OGS_METRICS_METRIC_TYPE_HISTOGRAM, "redis_rtt",
+                "Redis command round trip time in microseconds",
+                0, OGS_ARRAY_SIZE(labels), labels, &rtt_params);
+    }
+
+    ogs_snprintf(server, sizeof(server), "%s:%u",
+            shard->address, (unsigned)shard->port);
+    label_values[0] = server;
+
+    shard->metrics.commands =
+        ogs_metrics_inst_new(redis_spec_commands, 1, label_values);
+    shard->metrics.errors =
+        ogs_metrics_inst_new(redis_spec_errors, 1, label_values);
+    shard->metrics.rtt =
+        ogs_metrics_inst_new(redis_spec_rtt, 1, label_values);
+}
+
+static ogs_redis_conn_t *redis_pool_pick(ogs_redis_shard_t *shard) {
+    ogs_redis_pool_t *pool = NULL;
+    int i;
+
+    ogs_assert(shard);
+    pool = shard->pool;
+    ogs_assert(pool);
+
+    for (i = 0; i < pool->num_of_connections; i++) {
+        ogs_redis_conn_t *conn = &shard->conn[shard->next_conn];
+
+        shard->next_conn = (shard->next_conn + 1) % pool->num_of_connections;
+        if (conn->context)
+            return conn;
+    }
+
+    return NULL;
+}
+
+static void redis_pool_connect(ogs_redis_conn_t *conn) {
+    ogs_redis_shard_t *shard = NULL;
+    struct timeval tv;
+
+    ogs_assert(conn);
+    shard = conn->shard;
+    ogs_assert(shard);
+
+    tv.tv_sec = ogs_time_sec(shard->pool->timeout);
+    tv.tv_usec = ogs_time_usec(shard->pool->timeout);
+
+    conn->context = redisConnectWithTimeout(shard->address, shard->port, tv);
+    if (NULL == conn->context || 0 != conn->context->err) {
+        ogs_error("%s - Redis config {address: '%s', port: %i}",
+            conn->context ? conn->context->errstr : "Failure",
+            shard->address, shard->port);
+        if (conn->context)
+            redisFree(conn->context);
+        conn->context = NULL;
+
+        redis_pool_schedule_reconnect(conn);
+        return;
+    }
+
+    /* Every command after this is bounded by the same timeout */
+    redisSetTimeout(conn->context, tv);
+
+    conn->num_of_appended = 0;
+    conn->backoff = 0;
+
+    ogs_debug("Successful connection to redis {address: '%s', port: %i}",
+        shard->address, shard->port);
+}
+
+static void redis_pool_async_connect_cb(
+        const redisAsyncContext *c, int status) {
+    ogs_redis_conn_t *conn = c->data;
+
+    if (NULL == conn)
+        return;
+
+    if (REDIS_OK != status) {
+        ogs_error("%s - Redis async connection failed "
+                "{address: '%s', port: %i}",
+            c->errstr, conn->shard->address, conn->shard->port);
+        /* hiredis frees the context once this callback returns */
+        conn->async = NULL;
+        redis_pool_schedule_reconnect(conn);
+        return;
+    }
+
+    conn->backoff = 0;
+    ogs_info("Successful async connection to redis {address: '%s', port: %i}",
+        conn->shard->address, conn->shard->port);
+}
+
+static void redis_pool_async_disconnect_cb(
+        const redisAsyncContext *c, int status) {
+    ogs_redis_conn_t *conn = c->data;
+
+    if (NULL == conn)
+        return;
+
+    ogs_error("%s - Redis async connection lost {address: '%s', port: %i}",
+        REDIS_OK != status ? c->errstr : "Disconnected",
+        conn->shard->address, conn->shard->port);
+
+    conn->async = NULL;
+    redis_pool_schedule_reconnect(conn);
+}
+
+static void redis_pool_async_connect(ogs_redis_conn_t *conn) {
+    ogs_redis_shard_t *shard = NULL;
+
+    ogs_assert(conn);
+    shard = conn->shard;
+    ogs_assert(shard);
+
+    conn->async = ogs_redis_async_initialise(
+            shard->address, shard->port, shard->pool->pollset);
+    if (NULL == conn->async) {
+        redis_pool_schedule_reconnect(conn);
+        return;
+    }
+
+    conn->async->data = conn;
+    redisAsyncSetConnectCallback(conn->async, redis_pool_async_connect_cb);
+    redisAsyncSetDisconnectCallback(
+            conn->async, redis_pool_async_disconnect_cb);
+}
+
+static void redis_pool_schedule_reconnect(ogs_redis_conn_t *conn) {
+    ogs_assert(conn);
+
+    if (conn->backoff == 0)
+        conn->backoff = REDIS_POOL_MIN_BACKOFF;
+    else
+        conn->backoff = ogs_min(conn->backoff * 2, REDIS_POOL_MAX_BACKOFF);
+
+    ogs_warn("Reconnecting to redis {address: '%s', port: %i} in %lldms",
+        conn->shard->address, conn->shard->port,
+        (long long)ogs_time_to_msec(conn->backoff));
+
+    ogs_timer_start(conn->t_reconnect, conn->backoff);
+}
+
+static void redis_pool_reconnect_cb(void *data) {
+    ogs_redis_conn_t *conn = data;
+
+    ogs_assert(conn);
+
+    if (conn == &conn->shard->async_conn)
+        redis_pool_async_connect(conn);
+    else
+        redis_pool_connect(conn);
+}
+
+static void redis_pool_drop(ogs_redis_conn_t *conn) {
+    ogs_assert(conn);
+
+    if (conn->context) {
+        redisFree(conn->context);
+        conn->context = NULL;
+    }
+    conn->num_of_appended = 0;
+
+    redis_pool_schedule_reconnect(conn);
+}
+
+static void redis_pool_discard_appended(ogs_redis_conn_t *conn) {
+    redisReply *reply = NULL;
+
+    ogs_assert(conn);
+
+    while (conn->num_of_appended > 0 && conn->context) {
+        conn->num_of_appended--;
+
+        if (REDIS_OK != redisGetReply(conn->context, (void **)&reply)) {
+            ogs_error("%s - Redis pipelined command failed "
+                    "{address: '%s', port: %i}",
+                conn->context->errstr,
+                conn->shard->address, conn->shard->port);
+            ogs_metrics_inst_inc(conn->shard->metrics.errors);
+            redis_pool_drop(conn);
+            return;
+        }
+        if (reply && REDIS_REPLY_ERROR == reply->type)
+            ogs_metrics_inst_inc(conn->shard->metrics.errors);
+        freeReplyObject(reply);
+    }
+}
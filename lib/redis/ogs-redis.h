@@ -1,5 +1,70 @@
+#ifndef OGS_REDIS_H
+#define OGS_REDIS_H
+
 #include <stdint.h>
 #include <hiredis.h>
+#include <async.h>
+
+#include "core/ogs-core.h"
+
+#define OGS_REDIS_MAX_ENDPOINTS     8
+#define OGS_REDIS_MAX_CONNECTIONS   8   /* Per endpoint */
 
 redisContext* ogs_redis_initialise(const char* address, uint32_t port);
 void ogs_redis_finalise(redisContext* connection);
+
+/* Non-blocking connection driven by the caller's pollset.
+ * Replies are delivered to the redisAsyncCommand() callbacks
+ * from within ogs_pollset_poll() on the thread owning the pollset */
+redisAsyncContext* ogs_redis_async_initialise(
+        const char* address, uint32_t port, ogs_pollset_t *pollset);
+void ogs_redis_async_finalise(redisAsyncContext* connection);
+
+/*
+ * Connection pool
+ *
+ * Keys are sharded across the endpoints with a consistent hash ring,
+ * so adding or removing an endpoint only moves the keys of that
+ * endpoint. Each endpoint has num_of_connections blocking connections
+ * used round robin (none for an async only pool) and, if a pollset
+ * is given, one async connection.
+ * A connection that fails is dropped and reconnected from the timer
+ * manager with exponential backoff, until then commands for its
+ * endpoint fail fast. Commands, errors and round trip times are
+ * exported per endpoint through lib/metrics.
+ */
+typedef struct ogs_redis_endpoint_s {
+    const char *address;
+    uint32_t port;
+} ogs_redis_endpoint_t;
+
+typedef struct ogs_redis_pool_s ogs_redis_pool_t;
+
+ogs_redis_pool_t *ogs_redis_pool_create(
+        ogs_redis_endpoint_t *endpoints, int num_of_endpoints,
+        int num_of_connections, ogs_time_t timeout,
+        ogs_timer_mgr_t *timer_mgr, ogs_pollset_t *pollset);
+void ogs_redis_pool_destroy(ogs_redis_pool_t *pool);
+
+/* Index of the endpoint owning key */
+int ogs_redis_pool_shard(ogs_redis_pool_t *pool,
+        const void *key, size_t keylen);
+
+/* Blocking command on the endpoint owning key. Returns NULL
+ * if no connection is available or the command failed */
+redisReply *ogs_redis_pool_command(ogs_redis_pool_t *pool,
+        const void *key, size_t keylen, const char *format, ...);
+
+/* Pipelined command whose reply is not needed. It is written out,
+ * and its reply discarded, with the next blocking command on the
+ * same connection or once enough of them have been queued */
+int ogs_redis_pool_append(ogs_redis_pool_t *pool,
+        const void *key, size_t keylen, const char *format, ...);
+
+/* Async connection of shard, NULL while it is down.
+ * The caller reports what happened to its commands via observe() */
+redisAsyncContext *ogs_redis_pool_async(ogs_redis_pool_t *pool, int shard);
+void ogs_redis_pool_observe(ogs_redis_pool_t *pool,
+        int shard, ogs_time_t rtt, bool error);
+
+#endif /* OGS_REDIS_H */
@@ -40,6 +40,12 @@ ogs_pkbuf_t *ogs_s1ap_encode(ogs_s1ap_message_t *message)
 }
 
 int ogs_s1ap_decode(ogs_s1ap_message_t *message, ogs_pkbuf_t *pkbuf)
+{
+    return ogs_s1ap_decode_arena(message, pkbuf, NULL);
+}
+
+int ogs_s1ap_decode_arena(ogs_s1ap_message_t *message,
+        ogs_pkbuf_t *pkbuf, ogs_arena_t *arena)
 {
     int rv;
     ogs_assert(message);
@@ -47,8 +53,8 @@ int ogs_s1ap_decode(ogs_s1ap_message_t *message, ogs_pkbuf_t *pkbuf)
     ogs_assert(pkbuf->data);
     ogs_assert(pkbuf->len);
 
-    rv = ogs_asn_decode(&asn_DEF_S1AP_S1AP_PDU,
-            message, sizeof(ogs_s1ap_message_t), pkbuf);
+    rv = ogs_asn_decode_arena(&asn_DEF_S1AP_S1AP_PDU,
+            message, sizeof(ogs_s1ap_message_t), pkbuf, arena);
     if (rv != OGS_OK) {
         ogs_warn("Failed to decode S1AP-PDU");
         return rv;
@@ -61,7 +67,12 @@ int ogs_s1ap_decode(ogs_s1ap_message_t *message, ogs_pkbuf_t *pkbuf)
 }
 
 void ogs_s1ap_free(ogs_s1ap_message_t *message)
+{
+    ogs_s1ap_free_arena(message, NULL);
+}
+
+void ogs_s1ap_free_arena(ogs_s1ap_message_t *message, ogs_arena_t *arena)
 {
     ogs_assert(message);
-    ogs_asn_free(&asn_DEF_S1AP_S1AP_PDU, message);
+    ogs_asn_free_arena(&asn_DEF_S1AP_S1AP_PDU, message, arena);
 }
@@ -34,6 +34,11 @@ int ogs_s1ap_decode(ogs_s1ap_message_t *message, ogs_pkbuf_t *pkbuf);
 ogs_pkbuf_t *ogs_s1ap_encode(ogs_s1ap_message_t *message);
 void ogs_s1ap_free(ogs_s1ap_message_t *message);
 
+/* Decode into an arena; see ogs_asn_decode_arena() */
+int ogs_s1ap_decode_arena(ogs_s1ap_message_t *message,
+        ogs_pkbuf_t *pkbuf, ogs_arena_t *arena);
+void ogs_s1ap_free_arena(ogs_s1ap_message_t *message, ogs_arena_t *arena);
+
 #ifdef __cplusplus
 }
 #endif
@@ -40,6 +40,12 @@ ogs_pkbuf_t *ogs_sbcap_encode(ogs_sbcap_message_t *message)
 }
 
 int ogs_sbcap_decode(ogs_sbcap_message_t *message, ogs_pkbuf_t *pkbuf)
+{
+    return ogs_sbcap_decode_arena(message, pkbuf, NULL);
+}
+
+int ogs_sbcap_decode_arena(ogs_sbcap_message_t *message,
+        ogs_pkbuf_t *pkbuf, ogs_arena_t *arena)
 {
     int rv;
     ogs_assert(message);
@@ -47,8 +53,8 @@ int ogs_sbcap_decode(ogs_sbcap_message_t *message, ogs_pkbuf_t *pkbuf)
     ogs_assert(pkbuf->data);
     ogs_assert(pkbuf->len);
 
-    rv = ogs_asn_decode(&asn_DEF_SBcAP_SBC_AP_PDU,
-            message, sizeof(ogs_sbcap_message_t), pkbuf);
+    rv = ogs_asn_decode_arena(&asn_DEF_SBcAP_SBC_AP_PDU,
+            message, sizeof(ogs_sbcap_message_t), pkbuf, arena);
     if (rv != OGS_OK) {
         ogs_warn("Failed to decode S1AP-PDU");
         return rv;
@@ -61,7 +67,12 @@ int ogs_sbcap_decode(ogs_sbcap_message_t *message, ogs_pkbuf_t *pkbuf)
 }
 
 void ogs_sbcap_free(ogs_sbcap_message_t *message)
+{
+    ogs_sbcap_free_arena(message, NULL);
+}
+
+void ogs_sbcap_free_arena(ogs_sbcap_message_t *message, ogs_arena_t *arena)
 {
     ogs_assert(message);
-    ogs_asn_free(&asn_DEF_SBcAP_SBC_AP_PDU, message);
+    ogs_asn_free_arena(&asn_DEF_SBcAP_SBC_AP_PDU, message, arena);
 }
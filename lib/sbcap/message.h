@@ -34,6 +34,11 @@ int ogs_sbcap_decode(ogs_sbcap_message_t *message, ogs_pkbuf_t *pkbuf);
 ogs_pkbuf_t *ogs_sbcap_encode(ogs_sbcap_message_t *message);
 void ogs_sbcap_free(ogs_sbcap_message_t *message);
 
+/* Decode into an arena; see ogs_asn_decode_arena() */
+int ogs_sbcap_decode_arena(ogs_sbcap_message_t *message,
+        ogs_pkbuf_t *pkbuf, ogs_arena_t *arena);
+void ogs_sbcap_free_arena(ogs_sbcap_message_t *message, ogs_arena_t *arena);
+
 #ifdef __cplusplus
 }
 #endif
@@ -340,7 +340,8 @@ int ogs_sctp_recvmsg(ogs_sock_t *sock, void *msg, size_t len,
             &infolen, &infotype, &flags);
 
     if (n < 0) {
-        ogs_error("sctp_recvmsg(%d) failed", (int)n);
+        if (ogs_socket_errno != OGS_EAGAIN)
+            ogs_error("sctp_recvmsg(%d) failed", (int)n);
         return OGS_ERROR;
     }
     
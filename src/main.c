@@ -71,6 +71,7 @@ static int check_signal(int signum)
                 (unsigned long)talloc_total_blocks(__ogs_talloc_core),
                 (int)talloc_reference_count(__ogs_talloc_core),
                 __ogs_talloc_core);
+        ogs_pkbuf_log_stats();
         break;
 
     case SIGUSR2:
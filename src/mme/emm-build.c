@@ -86,7 +86,7 @@ ogs_pkbuf_t *emm_build_attach_accept(
      *   HSS IMSI[x] Network-Access-Mode[invalid] > serve as requested
      */
 
-    if (mme_ue->network_access_mode == OGS_NETWORK_ACCESS_MODE_ONLY_PACKET) {
+    if (mme_ue->profile->network_access_mode == OGS_NETWORK_ACCESS_MODE_ONLY_PACKET) {
         /* permit only EPS_ATTACH */
         eps_attach_result->result = OGS_NAS_ATTACH_TYPE_EPS_ATTACH;
     } else {
@@ -235,13 +235,13 @@ ogs_pkbuf_t *emm_build_attach_accept(
     }
     
     if (MME_P_TMSI_IS_AVAILABLE(mme_ue)) {
-        ogs_assert(mme_ue->csmap);
+        ogs_assert(mme_ue->profile->csmap);
         ogs_assert(mme_ue->p_tmsi);
 
         attach_accept->presencemask |=
             OGS_NAS_EPS_ATTACH_ACCEPT_LOCATION_AREA_IDENTIFICATION_PRESENT;
-        lai->nas_plmn_id = mme_ue->csmap->lai.nas_plmn_id;
-        lai->lac = mme_ue->csmap->lai.lac;
+        lai->nas_plmn_id = mme_ue->profile->csmap->lai.nas_plmn_id;
+        lai->lac = mme_ue->profile->csmap->lai.lac;
         ogs_debug("    LAI[PLMN_ID:%06x,LAC:%d]",
                 ogs_plmn_id_hexdump(&lai->nas_plmn_id), lai->lac);
 
@@ -466,9 +466,10 @@ ogs_pkbuf_t *emm_build_security_mode_command(mme_ue_t *mme_ue)
     }
 
     ogs_kdf_nas_eps(OGS_KDF_NAS_INT_ALG, mme_ue->selected_int_algorithm,
-            mme_ue->kasme, mme_ue->knas_int);
+            mme_ue->kasme, mme_ue->nas_key.knas_int);
     ogs_kdf_nas_eps(OGS_KDF_NAS_ENC_ALG, mme_ue->selected_enc_algorithm,
-            mme_ue->kasme, mme_ue->knas_enc);
+            mme_ue->kasme, mme_ue->nas_key.knas_enc);
+    ogs_nas_security_key_expand(&mme_ue->nas_key);
 
     return nas_eps_security_encode(mme_ue, &message);
 }
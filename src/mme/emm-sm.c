@@ -899,6 +899,9 @@ void emm_state_authentication(ogs_fsm_t *s, mme_event_t *e)
 
             CLEAR_MME_UE_TIMER(mme_ue->t3460);
 
+            /* Don't retry with vectors from the same AIA */
+            CLEAR_AUTH_VECTORS(mme_ue);
+
             switch (authentication_failure->emm_cause) {
             case OGS_NAS_EMM_CAUSE_MAC_FAILURE:
                 ogs_warn("Authentication failure(MAC failure)");
@@ -1448,6 +1451,7 @@ void emm_state_initial_context_setup(ogs_fsm_t *s, mme_event_t *e)
                     ogs_error("No emmbuf");
                     return;
                 }
+                mme_retx_release(emmbuf);
 
                 mme_ue->t3450.pkbuf = ogs_pkbuf_copy(emmbuf);
                 if (!mme_ue->t3450.pkbuf) {
@@ -1456,6 +1460,7 @@ void emm_state_initial_context_setup(ogs_fsm_t *s, mme_event_t *e)
                     return;
                 }
 
+                mme_retx_hold(mme_ue, mme_ue->t3450.pkbuf);
                 ogs_timer_start(mme_ue->t3450.timer,
                         mme_timer_cfg(MME_TIMER_T3450)->duration);
 
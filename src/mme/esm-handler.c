@@ -243,9 +243,9 @@ int esm_handle_information_response(mme_sess_t *sess,
             OGS_PDU_SESSION_TYPE_IS_VALID(sess->session->paa.session_type))
         {
             mme_csmap_t *csmap = mme_csmap_find_by_tai(&mme_ue->tai);
-            mme_ue->csmap = csmap;
+            mme_ue->profile->csmap = csmap;
 	    if (!csmap ||
-                mme_ue->network_access_mode ==
+                mme_ue->profile->network_access_mode ==
                     OGS_NETWORK_ACCESS_MODE_ONLY_PACKET ||
                 mme_ue->nas_eps.attach.value ==
                     OGS_NAS_ATTACH_TYPE_EPS_ATTACH) {
@@ -10,22 +10,39 @@ typedef struct mme_metrics_spec_def_s {
     int initial_val;
     unsigned int num_labels;
     const char **labels;
+    ogs_metrics_histogram_params_t histogram_params;
+    bool dynamic;   /* Series removed with the UE */
 } mme_metrics_spec_def_t;
 
-enum { MAX_NUM_KEY_LOCAL_LABELS = 8 };
-typedef struct mme_metric_key_local_s {
-    const char* labels[MAX_NUM_KEY_LOCAL_LABELS];
+/* A LOCAL series, interned by the content of its label values so
+ * that the same IMSI or APN from different buffers is one series */
+enum { MAX_LEN_KEY_LOCAL = 512 };
+typedef struct mme_metric_series_local_s {
+    ogs_lnode_t lnode;              /* In the UE's series_list */
+    char *key;
     mme_metric_type_local_t t;
-} mme_metric_key_local_t;
+    int value;
+    ogs_time_t since;               /* When value last became non-zero */
+    ogs_metrics_inst_t *inst;       /* NULL if not exported per UE */
+} mme_metric_series_local_t;
+
+/* Series carrying the IMSI of a UE, dropped when the UE is removed */
+typedef struct mme_metric_ue_local_s {
+    char *imsi;
+    ogs_list_t series_list;
+} mme_metric_ue_local_t;
 
 ogs_hash_t *metrics_hash_local = NULL;   /* hash table for LOCAL labels */
+ogs_hash_t *metrics_hash_ue = NULL;      /* hash table (IMSI : series) */
 
 static void mme_metrics_connected_enb_set(char *ip_address, int val);
 static void mme_metrics_connected_enb_id_set(char* ip_address, char* cell_id, int val);
 static void mme_metrics_ue_session_set(char* imsi, char* apn, int val);
 static void mme_metrics_ue_connected_set(char* imsi, int val);
 static void mme_metrics_ue_idle_set(char* imsi, int val);
-static ogs_metrics_inst_t *get_dynamically_initialised_metric(mme_metric_type_local_t t, const char** labels, unsigned int num_labels);
+static mme_metric_series_local_t *get_dynamically_initialised_metric(mme_metric_type_local_t t, const char** labels, unsigned int num_labels);
+static void set_series_local(mme_metric_series_local_t *series, int val);
+static void free_series_local(mme_metric_series_local_t *series);
 
 /* Helper generic functions: */
 static int mme_metrics_init_inst(ogs_metrics_inst_t **inst, ogs_metrics_spec_t **specs,
@@ -55,10 +72,16 @@ static int mme_metrics_init_spec(ogs_metrics_context_t *ctx,
 {
     unsigned int i;
     for (i = 0; i < len; i++) {
+        if (src[i].dynamic) {
+            dst[i] = ogs_metrics_spec_new_dynamic(ctx,
+                    src[i].name, src[i].description,
+                    src[i].initial_val, src[i].num_labels, src[i].labels);
+            continue;
+        }
         dst[i] = ogs_metrics_spec_new(ctx, src[i].type,
                 src[i].name, src[i].description,
                 src[i].initial_val, src[i].num_labels, src[i].labels,
-                NULL);
+                &src[i].histogram_params);
     }
     return OGS_OK;
 }
@@ -83,6 +106,90 @@ mme_metrics_spec_def_t mme_metrics_spec_def_global[_MME_METR_GLOB_MAX] = {
     .name = "emergency_bearers",
     .description = "Number of emergency bearers connected",
 },
+[MME_METR_GLOB_GAUGE_UE_CONNECTED] = {
+    .type = OGS_METRICS_METRIC_TYPE_GAUGE,
+    .name = "mme_ue_connected",
+    .description = "Number of UEs attached to the MME",
+},
+[MME_METR_GLOB_GAUGE_UE_IDLE] = {
+    .type = OGS_METRICS_METRIC_TYPE_GAUGE,
+    .name = "mme_ue_idle",
+    .description = "Number of UEs that are idle",
+},
+[MME_METR_GLOB_GAUGE_RETX_BUFFERS] = {
+    .type = OGS_METRICS_METRIC_TYPE_GAUGE,
+    .name = "mme_retx_buffers",
+    .description = "Number of NAS/S1AP messages held for retransmission",
+},
+[MME_METR_GLOB_GAUGE_RETX_BYTES] = {
+    .type = OGS_METRICS_METRIC_TYPE_GAUGE,
+    .name = "mme_retx_bytes",
+    .description = "Buffer bytes held by messages kept for retransmission",
+},
+/* Global Counters: */
+[MME_METR_GLOB_CTR_REDIS_DUP_DETECTED] = {
+    .type = OGS_METRICS_METRIC_TYPE_COUNTER,
+    .name = "redis_dup_detected",
+    .description = "Number of S1AP messages dropped as duplicates by redis",
+},
+[MME_METR_GLOB_CTR_REDIS_DUP_FAIL_OPEN] = {
+    .type = OGS_METRICS_METRIC_TYPE_COUNTER,
+    .name = "redis_dup_fail_open",
+    .description = "Number of S1AP messages passed on without a redis verdict",
+},
+[MME_METR_GLOB_CTR_UE_CONNECTED] = {
+    .type = OGS_METRICS_METRIC_TYPE_COUNTER,
+    .name = "mme_ue_connected_total",
+    .description = "Number of times UEs have attached to the MME",
+},
+[MME_METR_GLOB_CTR_UE_IDLE] = {
+    .type = OGS_METRICS_METRIC_TYPE_COUNTER,
+    .name = "mme_ue_idle_total",
+    .description = "Number of times UEs have gone idle",
+},
+[MME_METR_GLOB_CTR_GTP_XACT_RETRANSMITTED] = {
+    .type = OGS_METRICS_METRIC_TYPE_COUNTER,
+    .name = "gtp_xact_retransmitted",
+    .description = "Number of GTP requests resent on T3-RESPONSE expiry",
+},
+[MME_METR_GLOB_CTR_GTP_XACT_TIMED_OUT] = {
+    .type = OGS_METRICS_METRIC_TYPE_COUNTER,
+    .name = "gtp_xact_timed_out",
+    .description = "Number of GTP transactions given up after N3-REQUESTS",
+},
+[MME_METR_GLOB_CTR_GTP_XACT_DUPLICATED] = {
+    .type = OGS_METRICS_METRIC_TYPE_COUNTER,
+    .name = "gtp_xact_duplicated",
+    .description = "Number of duplicate GTP requests received from peers",
+},
+[MME_METR_GLOB_CTR_UE_SESSION] = {
+    .type = OGS_METRICS_METRIC_TYPE_COUNTER,
+    .name = "mme_ue_session_total",
+    .description = "Number of UE sessions established",
+},
+/* Global Histograms: */
+[MME_METR_GLOB_HIST_REDIS_DUP_LATENCY] = {
+    .type = OGS_METRICS_METRIC_TYPE_HISTOGRAM,
+    .name = "redis_dup_latency",
+    .description = "Redis duplicate detection round trip time in microseconds",
+    .histogram_params = {
+        .type = OGS_METRICS_HISTOGRAM_BUCKET_TYPE_EXPONENTIAL,
+        .count = 10,
+        .exp.start = 50,
+        .exp.factor = 2,
+    },
+},
+[MME_METR_GLOB_HIST_UE_SESSION_DURATION] = {
+    .type = OGS_METRICS_METRIC_TYPE_HISTOGRAM,
+    .name = "mme_ue_session_duration",
+    .description = "Duration of UE sessions in seconds",
+    .histogram_params = {
+        .type = OGS_METRICS_HISTOGRAM_BUCKET_TYPE_EXPONENTIAL,
+        .count = 10,
+        .exp.start = 1,
+        .exp.factor = 4,
+    },
+},
 };
 
 int mme_metrics_init_inst_global(void)
@@ -142,6 +249,7 @@ mme_metrics_spec_def_t mme_metrics_spec_def_local[_MME_METR_LOCAL_MAX] = {
         .description = "Status of a session for MME UEs, if the session is active 1 otherwise 0",
         .num_labels = OGS_ARRAY_SIZE(labels_mme_ue_session),
         .labels = labels_mme_ue_session,
+        .dynamic = true,
 },
 [MME_METR_LOCAL_GAUGE_MME_UE_CONNECTED] = {
         .type = OGS_METRICS_METRIC_TYPE_GAUGE,
@@ -149,6 +257,7 @@ mme_metrics_spec_def_t mme_metrics_spec_def_local[_MME_METR_LOCAL_MAX] = {
         .description = "Connection status for MME UEs, if UE is attached to MME 1 otherwise 0",
         .num_labels = OGS_ARRAY_SIZE(labels_mme_ue_connected),
         .labels = labels_mme_ue_connected,
+        .dynamic = true,
 },
 [MME_METR_LOCAL_GAUGE_MME_UE_IDLE] = {
         .type = OGS_METRICS_METRIC_TYPE_GAUGE,
@@ -156,9 +265,106 @@ mme_metrics_spec_def_t mme_metrics_spec_def_local[_MME_METR_LOCAL_MAX] = {
         .description = "Idle status for MME UEs, UEs that have gone idle at least once before will appear here, if idle 1 otherwise 0",
         .num_labels = OGS_ARRAY_SIZE(labels_mme_ue_idle),
         .labels = labels_mme_ue_idle,
+        .dynamic = true,
+},
+};
+
+/* POOL */
+typedef enum mme_metric_type_pool_s {
+    MME_METR_POOL_GAUGE_SIZE,
+    MME_METR_POOL_GAUGE_USED,
+    MME_METR_POOL_GAUGE_PEAK,
+    MME_METR_POOL_GAUGE_COMMITTED,
+    _MME_METR_POOL_GAUGE_MAX,
+} mme_metric_type_pool_t;
+
+const char *labels_pool[] = {
+    "pool"
+};
+
+const char *pool_names[_MME_METR_POOL_MAX] = {
+    [MME_METR_POOL_MME_UE] = "mme_ue",
+    [MME_METR_POOL_MME_UE_PROFILE] = "mme_ue_profile",
+    [MME_METR_POOL_ENB_UE] = "enb_ue",
+    [MME_METR_POOL_SGW_UE] = "sgw_ue",
+    [MME_METR_POOL_MME_SESS] = "mme_sess",
+    [MME_METR_POOL_MME_BEARER] = "mme_bearer",
+    [MME_METR_POOL_GTP_XACT] = "gtp_xact",
+};
+
+ogs_metrics_spec_t *mme_metrics_spec_pool[_MME_METR_POOL_GAUGE_MAX];
+ogs_metrics_inst_t *mme_metrics_inst_pool
+    [_MME_METR_POOL_MAX][_MME_METR_POOL_GAUGE_MAX];
+mme_metrics_spec_def_t mme_metrics_spec_def_pool[_MME_METR_POOL_GAUGE_MAX] = {
+[MME_METR_POOL_GAUGE_SIZE] = {
+        .type = OGS_METRICS_METRIC_TYPE_GAUGE,
+        .name = "mme_pool_size",
+        .description = "Configured number of contexts in the pool",
+        .num_labels = OGS_ARRAY_SIZE(labels_pool),
+        .labels = labels_pool,
+},
+[MME_METR_POOL_GAUGE_USED] = {
+        .type = OGS_METRICS_METRIC_TYPE_GAUGE,
+        .name = "mme_pool_used",
+        .description = "Number of contexts allocated from the pool",
+        .num_labels = OGS_ARRAY_SIZE(labels_pool),
+        .labels = labels_pool,
+},
+[MME_METR_POOL_GAUGE_PEAK] = {
+        .type = OGS_METRICS_METRIC_TYPE_GAUGE,
+        .name = "mme_pool_peak",
+        .description = "High-water mark of contexts allocated from the pool",
+        .num_labels = OGS_ARRAY_SIZE(labels_pool),
+        .labels = labels_pool,
+},
+[MME_METR_POOL_GAUGE_COMMITTED] = {
+        .type = OGS_METRICS_METRIC_TYPE_GAUGE,
+        .name = "mme_pool_committed",
+        .description = "Number of contexts the pool has committed memory for",
+        .num_labels = OGS_ARRAY_SIZE(labels_pool),
+        .labels = labels_pool,
 },
 };
 
+void mme_metrics_pool_set(mme_metric_pool_t p,
+        int size, int used, int peak, int committed)
+{
+    ogs_metrics_inst_t **inst = mme_metrics_inst_pool[p];
+
+    ogs_metrics_inst_set(inst[MME_METR_POOL_GAUGE_SIZE], size);
+    ogs_metrics_inst_set(inst[MME_METR_POOL_GAUGE_USED], used);
+    ogs_metrics_inst_set(inst[MME_METR_POOL_GAUGE_PEAK], peak);
+    ogs_metrics_inst_set(inst[MME_METR_POOL_GAUGE_COMMITTED], committed);
+}
+
+void mme_metrics_gtp_xact_update(void)
+{
+    static ogs_gtp_xact_stats_t last;
+    ogs_gtp_xact_stats_t stats;
+
+    memset(&stats, 0, sizeof(stats));
+    ogs_gtp_xact_get_stats(&stats);
+    if (!memcmp(&stats, &last, sizeof(stats)))
+        return;
+
+    if (stats.used != last.used || stats.peak != last.peak ||
+        stats.size != last.size)
+        mme_metrics_pool_set(MME_METR_POOL_GTP_XACT,
+                stats.size, stats.used, stats.peak, stats.size);
+
+    if (stats.retransmitted != last.retransmitted)
+        mme_metrics_inst_global_add(MME_METR_GLOB_CTR_GTP_XACT_RETRANSMITTED,
+                (int)(stats.retransmitted - last.retransmitted));
+    if (stats.timed_out != last.timed_out)
+        mme_metrics_inst_global_add(MME_METR_GLOB_CTR_GTP_XACT_TIMED_OUT,
+                (int)(stats.timed_out - last.timed_out));
+    if (stats.duplicated != last.duplicated)
+        mme_metrics_inst_global_add(MME_METR_GLOB_CTR_GTP_XACT_DUPLICATED,
+                (int)(stats.duplicated - last.duplicated));
+
+    last = stats;
+}
+
 void mme_metrics_connected_enb_add(char *ip_address)
 {
     ogs_metrics_inst_inc(mme_metrics_inst_local);
@@ -228,15 +434,45 @@ void mme_metrics_ue_idle_clear(char* imsi)
     mme_metrics_ue_idle_set(imsi, 0);
 }
 
+/* Drops the series of a UE that is being removed */
+void mme_metrics_ue_remove(char* imsi)
+{
+    mme_metric_ue_local_t *ue = NULL;
+    mme_metric_series_local_t *series = NULL, *next = NULL;
+
+    if ((NULL == imsi) || ('\0' == imsi[0]) || (NULL == metrics_hash_ue))
+        return;
+
+    ue = ogs_hash_get(metrics_hash_ue, imsi, OGS_HASH_KEY_STRING);
+    if (!ue)
+        return;
+
+    ogs_list_for_each_safe(&ue->series_list, next, series) {
+        ogs_list_remove(&ue->series_list, series);
+
+        /* Take the UE out of the aggregates */
+        set_series_local(series, 0);
+        free_series_local(series);
+    }
+
+    ogs_hash_set(metrics_hash_ue, ue->imsi, OGS_HASH_KEY_STRING, NULL);
+    ogs_free(ue->imsi);
+    ogs_free(ue);
+}
+
 void mme_metrics_init_local(void)
 {
     metrics_hash_local = ogs_hash_make();
     ogs_assert(metrics_hash_local);
+    metrics_hash_ue = ogs_hash_make();
+    ogs_assert(metrics_hash_ue);
 }
 
 void mme_metrics_init(void)
 {
     ogs_metrics_context_t *ctx = ogs_metrics_self();
+    int i;
+
     ogs_metrics_context_init();
 
     mme_metrics_init_spec(ctx, mme_metrics_spec_global, mme_metrics_spec_def_global,
@@ -245,29 +481,52 @@ void mme_metrics_init(void)
     mme_metrics_init_spec(ctx, mme_metrics_spec_local,
             mme_metrics_spec_def_local, _MME_METR_LOCAL_MAX);
 
+    mme_metrics_init_spec(ctx, mme_metrics_spec_pool,
+            mme_metrics_spec_def_pool, _MME_METR_POOL_GAUGE_MAX);
+
     mme_metrics_init_inst_global();
     mme_metrics_init_inst_local();
 
+    for (i = 0; i < _MME_METR_POOL_MAX; i++)
+        mme_metrics_init_inst(mme_metrics_inst_pool[i], mme_metrics_spec_pool,
+                _MME_METR_POOL_GAUGE_MAX, 1, &pool_names[i]);
+
     mme_metrics_init_local();
 }
 
 void mme_metrics_final(void)
 {
+    if (metrics_hash_ue) {
+        ogs_hash_index_t *hi;
+
+        for (hi = ogs_hash_first(metrics_hash_ue); hi; hi = ogs_hash_next(hi)) {
+            mme_metric_ue_local_t *ue = ogs_hash_this_val(hi);
+
+            ogs_hash_set(metrics_hash_ue, ue->imsi, OGS_HASH_KEY_STRING, NULL);
+
+            ogs_free(ue->imsi);
+            ogs_free(ue);
+        }
+        ogs_hash_destroy(metrics_hash_ue);
+        metrics_hash_ue = NULL;
+    }
+
     if (metrics_hash_local) {
         ogs_hash_index_t *hi;
 
         for (hi = ogs_hash_first(metrics_hash_local); hi; hi = ogs_hash_next(hi)) {
-            mme_metric_key_local_t *key =
-                (mme_metric_key_local_t *)ogs_hash_this_key(hi);
+            mme_metric_series_local_t *series = ogs_hash_this_val(hi);
 
-            ogs_hash_set(metrics_hash_local, key, sizeof(*key), NULL);
+            ogs_hash_set(metrics_hash_local,
+                    series->key, OGS_HASH_KEY_STRING, NULL);
 
-            ogs_free(key);
-            /* don't free val (metric ifself) -
+            ogs_free(series->key);
+            /* don't free series->inst (metric ifself) -
              * it will be free'd by ogs_metrics_context_final() */
-            //ogs_free(val);
+            ogs_free(series);
         }
         ogs_hash_destroy(metrics_hash_local);
+        metrics_hash_local = NULL;
     }
 
     ogs_metrics_context_final();
@@ -276,39 +535,118 @@ void mme_metrics_final(void)
 /* Gets an existing one or creates a new one and returns it. 
  * The dynamical ones are different because their labels values
  * aren't known at initialisation time (e.g. an imsi of a UE) */
-static ogs_metrics_inst_t *get_dynamically_initialised_metric(mme_metric_type_local_t t, const char** labels, unsigned int num_labels)
+static mme_metric_series_local_t *get_dynamically_initialised_metric(mme_metric_type_local_t t, const char** labels, unsigned int num_labels)
 {
-    ogs_metrics_inst_t *metrics = NULL;
-    mme_metric_key_local_t *slice_key;
-
-    slice_key = ogs_calloc(1, sizeof(*slice_key));
-    ogs_assert(slice_key);
-    ogs_assert(num_labels <= MAX_NUM_KEY_LOCAL_LABELS);
+    mme_metric_series_local_t *series = NULL;
+    mme_metric_ue_local_t *ue = NULL;
+    char key[MAX_LEN_KEY_LOCAL];
+    int len;
 
+    len = ogs_snprintf(key, sizeof(key), "%d", t);
     for (int i = 0; i < num_labels; ++i) {
-        slice_key->labels[i] = labels[i];
+        ogs_assert(labels[i]);
+        len += ogs_snprintf(key + len, sizeof(key) - len, "\x1f%s", labels[i]);
+        if (len >= sizeof(key)) {
+            ogs_error("Label values too long [%s]", labels[0]);
+            return NULL;
+        }
     }
-    slice_key->t = t;
 
-    metrics = ogs_hash_get(metrics_hash_local,
-            slice_key, sizeof(*slice_key));
+    series = ogs_hash_get(metrics_hash_local, key, OGS_HASH_KEY_STRING);
 
     /* Create the metric if it doesn't already exist.
      * If it does exist then we can just return that. */
-    if (!metrics) {
-        metrics = ogs_metrics_inst_new(
-            mme_metrics_spec_local[t],
-            num_labels,
-            labels
-        );
-
-        ogs_assert(metrics);
+    if (!series) {
+        series = ogs_calloc(1, sizeof(*series));
+        ogs_assert(series);
+        series->key = ogs_strdup(key);
+        ogs_assert(series->key);
+        series->t = t;
+
+        /* In aggregate mode UEs only count towards the global metrics */
+        if (!mme_metrics_spec_def_local[t].dynamic ||
+            !mme_self()->ue_metrics.aggregate) {
+            series->inst = ogs_metrics_inst_new(
+                mme_metrics_spec_local[t],
+                num_labels,
+                labels
+            );
+            ogs_assert(series->inst);
+        }
+
         ogs_hash_set(metrics_hash_local,
-                slice_key, sizeof(*slice_key), metrics);
-    } else {
-        ogs_free(slice_key);
+                series->key, OGS_HASH_KEY_STRING, series);
+
+        /* The IMSI is the first label of the per UE series */
+        if (mme_metrics_spec_def_local[t].dynamic) {
+            ue = ogs_hash_get(metrics_hash_ue, labels[0], OGS_HASH_KEY_STRING);
+            if (!ue) {
+                ue = ogs_calloc(1, sizeof(*ue));
+                ogs_assert(ue);
+                ue->imsi = ogs_strdup(labels[0]);
+                ogs_assert(ue->imsi);
+                ogs_list_init(&ue->series_list);
+                ogs_hash_set(metrics_hash_ue,
+                        ue->imsi, OGS_HASH_KEY_STRING, ue);
+            }
+            ogs_list_add(&ue->series_list, series);
+        }
     }
-    return metrics;
+    return series;
+}
+
+static void set_series_local(mme_metric_series_local_t *series, int val)
+{
+    int old = series->value;
+
+    series->value = val;
+    if (series->inst)
+        ogs_metrics_inst_set(series->inst, val);
+
+    if (!old == !val)
+        return;
+
+    switch (series->t) {
+    case MME_METR_LOCAL_GAUGE_MME_UE_CONNECTED:
+        if (val) {
+            mme_metrics_inst_global_inc(MME_METR_GLOB_GAUGE_UE_CONNECTED);
+            mme_metrics_inst_global_inc(MME_METR_GLOB_CTR_UE_CONNECTED);
+        } else {
+            mme_metrics_inst_global_dec(MME_METR_GLOB_GAUGE_UE_CONNECTED);
+        }
+        break;
+    case MME_METR_LOCAL_GAUGE_MME_UE_IDLE:
+        if (val) {
+            mme_metrics_inst_global_inc(MME_METR_GLOB_GAUGE_UE_IDLE);
+            mme_metrics_inst_global_inc(MME_METR_GLOB_CTR_UE_IDLE);
+        } else {
+            mme_metrics_inst_global_dec(MME_METR_GLOB_GAUGE_UE_IDLE);
+        }
+        break;
+    case MME_METR_LOCAL_GAUGE_MME_UE_SESSION:
+        if (val) {
+            series->since = ogs_get_monotonic_time();
+            mme_metrics_inst_global_inc(MME_METR_GLOB_CTR_UE_SESSION);
+        } else {
+            mme_metrics_inst_global_add(MME_METR_GLOB_HIST_UE_SESSION_DURATION,
+                    ogs_time_sec(ogs_get_monotonic_time() - series->since));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void free_series_local(mme_metric_series_local_t *series)
+{
+    ogs_hash_set(metrics_hash_local, series->key, OGS_HASH_KEY_STRING, NULL);
+
+    /* Removes the series from the exposition */
+    if (series->inst)
+        ogs_metrics_inst_free(series->inst);
+
+    ogs_free(series->key);
+    ogs_free(series);
 }
 
 static void mme_metrics_connected_enb_set(char *ip_address, int val)
@@ -332,10 +670,10 @@ static void mme_metrics_connected_enb_id_set(char* ip_address, char* cell_id, in
         return;
     }
 
-    ogs_metrics_inst_t *metrics = get_dynamically_initialised_metric(MME_METR_LOCAL_GAUGE_ENB_ID, labels, 2);
+    mme_metric_series_local_t *series = get_dynamically_initialised_metric(MME_METR_LOCAL_GAUGE_ENB_ID, labels, 2);
 
-    if (NULL != metrics) {
-        ogs_metrics_inst_set_with_labels(metrics, labels, val);
+    if (NULL != series) {
+        set_series_local(series, val);
     } else {
         ogs_error("Failed to record eNB connection status metrics");
     }
@@ -352,10 +690,10 @@ static void mme_metrics_ue_session_set(char* imsi, char* apn, int val)
         return;
     }
 
-    ogs_metrics_inst_t *metrics = get_dynamically_initialised_metric(MME_METR_LOCAL_GAUGE_MME_UE_SESSION, labels, 2);
+    mme_metric_series_local_t *series = get_dynamically_initialised_metric(MME_METR_LOCAL_GAUGE_MME_UE_SESSION, labels, 2);
 
-    if (NULL != metrics) {
-        ogs_metrics_inst_set_with_labels(metrics, labels, val);
+    if (NULL != series) {
+        set_series_local(series, val);
     } else {
         ogs_error("Failed to record UE session status metrics");
     }
@@ -371,10 +709,10 @@ static void mme_metrics_ue_connected_set(char* imsi, int val)
         return;
     }
 
-    ogs_metrics_inst_t *metrics = get_dynamically_initialised_metric(MME_METR_LOCAL_GAUGE_MME_UE_CONNECTED, labels, 1);
+    mme_metric_series_local_t *series = get_dynamically_initialised_metric(MME_METR_LOCAL_GAUGE_MME_UE_CONNECTED, labels, 1);
 
-    if (NULL != metrics) {
-        ogs_metrics_inst_set_with_labels(metrics, labels, val);
+    if (NULL != series) {
+        set_series_local(series, val);
     } else {
         ogs_error("Failed to record UE connection status metrics");
     }
@@ -389,10 +727,10 @@ static void mme_metrics_ue_idle_set(char* imsi, int val)
         return;
     }
 
-    ogs_metrics_inst_t *metrics = get_dynamically_initialised_metric(MME_METR_LOCAL_GAUGE_MME_UE_IDLE, labels, 1);
+    mme_metric_series_local_t *series = get_dynamically_initialised_metric(MME_METR_LOCAL_GAUGE_MME_UE_IDLE, labels, 1);
 
-    if (NULL != metrics) {
-        ogs_metrics_inst_set_with_labels(metrics, labels, val);
+    if (NULL != series) {
+        set_series_local(series, val);
     } else {
         ogs_error("Failed to record UE idle status metrics");
     }
@@ -12,6 +12,20 @@ typedef enum mme_metric_type_global_s {
     MME_METR_GLOB_GAUGE_ENB_UE,
     MME_METR_GLOB_GAUGE_MME_SESS,
     MME_METR_GLOB_GAUGE_EMERGENCY_BEARERS,
+    MME_METR_GLOB_GAUGE_UE_CONNECTED,
+    MME_METR_GLOB_GAUGE_UE_IDLE,
+    MME_METR_GLOB_GAUGE_RETX_BUFFERS,
+    MME_METR_GLOB_GAUGE_RETX_BYTES,
+    MME_METR_GLOB_CTR_REDIS_DUP_DETECTED,
+    MME_METR_GLOB_CTR_REDIS_DUP_FAIL_OPEN,
+    MME_METR_GLOB_CTR_UE_CONNECTED,
+    MME_METR_GLOB_CTR_UE_IDLE,
+    MME_METR_GLOB_CTR_GTP_XACT_RETRANSMITTED,
+    MME_METR_GLOB_CTR_GTP_XACT_TIMED_OUT,
+    MME_METR_GLOB_CTR_GTP_XACT_DUPLICATED,
+    MME_METR_GLOB_CTR_UE_SESSION,
+    MME_METR_GLOB_HIST_REDIS_DUP_LATENCY,
+    MME_METR_GLOB_HIST_UE_SESSION_DURATION,
     _MME_METR_GLOB_MAX,
 } mme_metric_type_global_t;
 extern ogs_metrics_inst_t *mme_metrics_inst_global[_MME_METR_GLOB_MAX];
@@ -58,6 +72,26 @@ void mme_metrics_ue_connected_clear(char* imsi);
 void mme_metrics_ue_idle_add(char* imsi);
 void mme_metrics_ue_idle_clear(char* imsi);
 
+void mme_metrics_ue_remove(char* imsi);
+
+/* Occupancy of the context pools, labelled by pool name */
+typedef enum mme_metric_pool_s {
+    MME_METR_POOL_MME_UE,
+    MME_METR_POOL_MME_UE_PROFILE,
+    MME_METR_POOL_ENB_UE,
+    MME_METR_POOL_SGW_UE,
+    MME_METR_POOL_MME_SESS,
+    MME_METR_POOL_MME_BEARER,
+    MME_METR_POOL_GTP_XACT,
+    _MME_METR_POOL_MAX,
+} mme_metric_pool_t;
+
+void mme_metrics_pool_set(mme_metric_pool_t p,
+        int size, int used, int peak, int committed);
+
+/* Exports the GTP transaction table, called once per event loop turn */
+void mme_metrics_gtp_xact_update(void);
+
 void mme_metrics_init(void);
 void mme_metrics_final(void);
 
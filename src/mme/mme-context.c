@@ -49,6 +49,7 @@ static OGS_POOL(mme_hssmap_pool, mme_hssmap_t);
 
 static OGS_POOL(mme_enb_pool, mme_enb_t);
 static OGS_POOL(mme_ue_pool, mme_ue_t);
+static OGS_POOL(mme_ue_profile_pool, mme_ue_profile_t);
 static OGS_POOL(mme_s11_teid_pool, ogs_pool_id_t);
 static OGS_POOL(enb_ue_pool, enb_ue_t);
 static OGS_POOL(sgw_ue_pool, sgw_ue_t);
@@ -62,6 +63,11 @@ static int context_initialized = 0;
 static int num_of_enb_ue = 0;
 static int num_of_mme_sess = 0;
 
+#define stats_update_pool(__p, __pool) \
+    mme_metrics_pool_set((__p), ogs_pool_size(__pool), \
+            ogs_pool_size(__pool) - ogs_pool_avail(__pool), \
+            ogs_pool_peak(__pool), ogs_pool_committed(__pool))
+
 static void stats_add_enb_ue(void);
 static void stats_remove_enb_ue(void);
 static void stats_add_mme_session(void);
@@ -73,6 +79,39 @@ static mme_sgw_t *changed_sgw_node(mme_sgw_t *current, enb_ue_t *enb_ue);
 
 static int rand_under(int val);
 
+/*
+ * Fixed-width keys for the UE lookup tables. The packed GUTI is 10 bytes
+ * and is zero-padded to 16; the BCD IMSI is at most 8 bytes and is padded
+ * with 0xff, which is never a valid BCD digit pair, so IMSIs of different
+ * lengths cannot collide.
+ */
+typedef struct mme_guti_key_s {
+    uint64_t word[2];
+} mme_guti_key_t;
+
+OGS_STATIC_ASSERT(sizeof(ogs_nas_eps_guti_t) <= sizeof(mme_guti_key_t));
+OGS_STATIC_ASSERT(OGS_MAX_IMSI_LEN <= sizeof(uint64_t));
+
+static void guti_key(mme_guti_key_t *key, const ogs_nas_eps_guti_t *guti)
+{
+    memset(key, 0, sizeof(*key));
+    memcpy(key, guti, sizeof(*guti));
+}
+
+static uint64_t imsi_key(const uint8_t *imsi, int imsi_len)
+{
+    uint64_t key;
+
+    ogs_assert(imsi_len > 0 && imsi_len <= sizeof(key));
+
+    memset(&key, 0xff, sizeof(key));
+    memcpy(&key, imsi, imsi_len);
+
+    return key;
+}
+
+static void enb_tai_index_clear(mme_enb_t *enb);
+
 void mme_context_init(void)
 {
     ogs_assert(context_initialized == 0);
@@ -114,26 +153,41 @@ void mme_context_init(void)
     /* Allocate TWICE the pool to check if maximum number of eNBs is reached */
     ogs_pool_init(&mme_enb_pool, ogs_app()->max.peer*2);
 
-    ogs_pool_init(&mme_ue_pool, ogs_app()->max.ue);
+    /*
+     * The context pools are sized for the peak number of UEs but only
+     * commit memory as they fill up. The ID pools stay eager since their
+     * IDs are shuffled up front.
+     */
+    ogs_pool_init_lazy(&mme_ue_pool, ogs_app()->max.ue);
+    ogs_pool_init_lazy(&mme_ue_profile_pool, ogs_app()->max.ue);
     ogs_pool_init(&mme_s11_teid_pool, ogs_app()->max.ue);
     ogs_pool_random_id_generate(&mme_s11_teid_pool);
 
-    ogs_pool_init(&enb_ue_pool, ogs_app()->max.ue);
-    ogs_pool_init(&sgw_ue_pool, ogs_app()->max.ue);
-    ogs_pool_init(&mme_sess_pool, ogs_app()->pool.sess);
-    ogs_pool_init(&mme_bearer_pool, ogs_app()->pool.bearer);
+    ogs_pool_init_lazy(&enb_ue_pool, ogs_app()->max.ue);
+    ogs_pool_init_lazy(&sgw_ue_pool, ogs_app()->max.ue);
+    ogs_pool_init_lazy(&mme_sess_pool, ogs_app()->pool.sess);
+    ogs_pool_init_lazy(&mme_bearer_pool, ogs_app()->pool.bearer);
     ogs_pool_init(&m_tmsi_pool, ogs_app()->max.ue*2);
     ogs_pool_random_id_generate(&m_tmsi_pool);
 
-    self.enb_addr_hash = ogs_hash_make();
+    stats_update_pool(MME_METR_POOL_MME_UE, &mme_ue_pool);
+    stats_update_pool(MME_METR_POOL_MME_UE_PROFILE, &mme_ue_profile_pool);
+    stats_update_pool(MME_METR_POOL_ENB_UE, &enb_ue_pool);
+    stats_update_pool(MME_METR_POOL_SGW_UE, &sgw_ue_pool);
+    stats_update_pool(MME_METR_POOL_MME_SESS, &mme_sess_pool);
+    stats_update_pool(MME_METR_POOL_MME_BEARER, &mme_bearer_pool);
+
+    self.enb_addr_hash = ogs_flatmap_create(sizeof(ogs_sockaddr_t));
     ogs_assert(self.enb_addr_hash);
-    self.enb_id_hash = ogs_hash_make();
+    self.enb_id_hash = ogs_flatmap_create(sizeof(uint32_t));
     ogs_assert(self.enb_id_hash);
-    self.imsi_ue_hash = ogs_hash_make();
+    self.tai_enb_hash = ogs_hash_make();
+    ogs_assert(self.tai_enb_hash);
+    self.imsi_ue_hash = ogs_flatmap_create(sizeof(uint64_t));
     ogs_assert(self.imsi_ue_hash);
-    self.guti_ue_hash = ogs_hash_make();
+    self.guti_ue_hash = ogs_flatmap_create(sizeof(mme_guti_key_t));
     ogs_assert(self.guti_ue_hash);
-    self.mme_s11_teid_hash = ogs_hash_make();
+    self.mme_s11_teid_hash = ogs_flatmap_create(sizeof(uint32_t));
     ogs_assert(self.mme_s11_teid_hash);
 
     ogs_list_init(&self.mme_ue_list);
@@ -156,20 +210,23 @@ void mme_context_final(void)
     mme_hssmap_remove_all();
 
     ogs_assert(self.enb_addr_hash);
-    ogs_hash_destroy(self.enb_addr_hash);
+    ogs_flatmap_destroy(self.enb_addr_hash);
     ogs_assert(self.enb_id_hash);
-    ogs_hash_destroy(self.enb_id_hash);
+    ogs_flatmap_destroy(self.enb_id_hash);
+    ogs_assert(self.tai_enb_hash);
+    ogs_hash_destroy(self.tai_enb_hash);
 
     ogs_assert(self.imsi_ue_hash);
-    ogs_hash_destroy(self.imsi_ue_hash);
+    ogs_flatmap_destroy(self.imsi_ue_hash);
     ogs_assert(self.guti_ue_hash);
-    ogs_hash_destroy(self.guti_ue_hash);
+    ogs_flatmap_destroy(self.guti_ue_hash);
     ogs_assert(self.mme_s11_teid_hash);
-    ogs_hash_destroy(self.mme_s11_teid_hash);
+    ogs_flatmap_destroy(self.mme_s11_teid_hash);
 
     ogs_pool_final(&m_tmsi_pool);
     ogs_pool_final(&mme_bearer_pool);
     ogs_pool_final(&mme_sess_pool);
+    ogs_pool_final(&mme_ue_profile_pool);
     ogs_pool_final(&mme_ue_pool);
     ogs_pool_final(&mme_s11_teid_pool);
     ogs_pool_final(&enb_ue_pool);
@@ -201,6 +258,26 @@ static int mme_context_prepare(void)
     self.diam_config->cnf_port = DIAMETER_PORT;
     self.diam_config->cnf_port_tls = DIAMETER_SECURE_PORT;
 
+    self.dns_cache.enabled = true;
+    self.dns_cache.max_entries = 1024;
+    self.dns_cache.negative_ttl_sec = 30;
+    self.dns_cache.max_ttl_sec = 3600;
+    self.dns_async.num_of_thread = 4;
+    self.dns_async.max_inflight = 256;
+    self.dns_async.deadline = ogs_time_from_sec(3);
+
+    self.auth_vectors.num = 1;
+    self.auth_vectors.lifetime = ogs_time_from_sec(3600);
+
+    self.subscription_cache.max_entries = 0;
+    self.subscription_cache.ttl = ogs_time_from_sec(3600);
+
+    self.redis_server_config.connections = 1;
+    self.redis_server_config.timeout = ogs_time_from_msec(500);
+    self.redis_dup_detection.expire_time_sec = 3;
+    self.redis_dup_detection.deadline = ogs_time_from_msec(100);
+    self.redis_dup_detection.local_cache_bits = 1 << 20;
+
     return OGS_OK;
 }
 
@@ -252,6 +329,14 @@ static int mme_context_validation(void)
         return OGS_ERROR;
     }
 
+    if (self.redis_dup_detection.enabled &&
+        (int)self.redis_dup_detection.expire_time_sec <= 0) {
+        ogs_error("Invalid mme.redis_dup_detection.expire_time_sec [%d] "
+                "in '%s'", (int)self.redis_dup_detection.expire_time_sec,
+                ogs_app()->file);
+        return OGS_ERROR;
+    }
+
     if (self.served_gummei[0].num_of_plmn_id == 0) {
         ogs_error("No mme.gummei.plmn_id in '%s'", ogs_app()->file);
         return OGS_ERROR;
@@ -1724,6 +1809,83 @@ int mme_context_parse_config(void)
                     self.mme_name = ogs_yaml_iter_value(&mme_iter);
                 } else if (!strcmp(mme_key, "metrics")) {
                     /* handle config in metrics library */
+                } else if (!strcmp(mme_key, "ue_metrics")) {
+                    const char *v = ogs_yaml_iter_value(&mme_iter);
+                    if (v && !strcmp(v, "aggregate")) {
+                        self.ue_metrics.aggregate = true;
+                    } else if (v && !strcmp(v, "per_ue")) {
+                        self.ue_metrics.aggregate = false;
+                    } else {
+                        ogs_warn("unknown ue_metrics `%s`, using per_ue",
+                                v ? v : "");
+                    }
+                } else if (!strcmp(mme_key, "auth_vectors")) {
+                    ogs_yaml_iter_t av_iter;
+                    ogs_yaml_iter_recurse(&mme_iter, &av_iter);
+
+                    while (ogs_yaml_iter_next(&av_iter)) {
+                        const char *av_key = ogs_yaml_iter_key(&av_iter);
+                        const char *v = ogs_yaml_iter_value(&av_iter);
+                        ogs_assert(av_key);
+
+                        if (!strcmp(av_key, "num")) {
+                            if (v) self.auth_vectors.num = atoi(v);
+                            if (self.auth_vectors.num < 1 ||
+                                self.auth_vectors.num >
+                                    OGS_DIAM_S6A_MAX_NUM_OF_E_UTRAN_VECTOR) {
+                                self.auth_vectors.num = ogs_max(1, ogs_min(
+                                    self.auth_vectors.num,
+                                    OGS_DIAM_S6A_MAX_NUM_OF_E_UTRAN_VECTOR));
+                                ogs_warn("auth_vectors.num must be 1..%d, "
+                                        "using %d",
+                                        OGS_DIAM_S6A_MAX_NUM_OF_E_UTRAN_VECTOR,
+                                        self.auth_vectors.num);
+                            }
+                        } else if (!strcmp(av_key, "lifetime")) {
+                            if (v) self.auth_vectors.lifetime =
+                                ogs_time_from_sec(atoi(v));
+                        } else
+                            ogs_warn("unknown key `%s`", av_key);
+                    }
+                } else if (!strcmp(mme_key, "subscription_cache")) {
+                    ogs_yaml_iter_t sc_iter;
+                    ogs_yaml_iter_recurse(&mme_iter, &sc_iter);
+
+                    while (ogs_yaml_iter_next(&sc_iter)) {
+                        const char *sc_key = ogs_yaml_iter_key(&sc_iter);
+                        const char *v = ogs_yaml_iter_value(&sc_iter);
+                        ogs_assert(sc_key);
+
+                        if (!strcmp(sc_key, "max")) {
+                            if (v) self.subscription_cache.max_entries =
+                                ogs_max(0, atoi(v));
+                        } else if (!strcmp(sc_key, "ttl")) {
+                            if (v && atoi(v) > 0)
+                                self.subscription_cache.ttl =
+                                    ogs_time_from_sec(atoi(v));
+                            else
+                                ogs_warn("subscription_cache.ttl must be "
+                                        "positive, using %lld",
+                                        (long long)ogs_time_sec(
+                                            self.subscription_cache.ttl));
+                        } else
+                            ogs_warn("unknown key `%s`", sc_key);
+                    }
+                } else if (!strcmp(mme_key, "s1ap_decoder")) {
+                    ogs_yaml_iter_t sd_iter;
+                    ogs_yaml_iter_recurse(&mme_iter, &sd_iter);
+
+                    while (ogs_yaml_iter_next(&sd_iter)) {
+                        const char *sd_key = ogs_yaml_iter_key(&sd_iter);
+                        const char *v = ogs_yaml_iter_value(&sd_iter);
+                        ogs_assert(sd_key);
+
+                        if (!strcmp(sd_key, "workers")) {
+                            if (v) self.s1ap_decoder.workers =
+                                ogs_max(0, atoi(v));
+                        } else
+                            ogs_warn("unknown key `%s`", sd_key);
+                    }
                 } else if (!strcmp(mme_key, "eir")) {
                     ogs_yaml_iter_t eir_iter;
                     ogs_yaml_iter_recurse(&mme_iter, &eir_iter);
@@ -1861,6 +2023,7 @@ int mme_context_parse_config(void)
                     const char *c_default_emergency_session_type = ogs_yaml_iter_value(&mme_iter);
                     self.default_emergency_session_type = atoi(c_default_emergency_session_type);
                 } else if (!strcmp(mme_key, "redis_server")) {
+                    redis_server_config_t *config = &self.redis_server_config;
                     ogs_yaml_iter_t redis_iter;
                     ogs_yaml_iter_recurse(&mme_iter, &redis_iter);
 
@@ -1870,12 +2033,91 @@ int mme_context_parse_config(void)
                         ogs_assert(redis_server_config_key);
                         if (!strcmp(redis_server_config_key, "addr")) {
                             const char *redis_addr = ogs_yaml_iter_value(&redis_iter);
-			    snprintf(self.redis_server_config.address, sizeof(self.redis_server_config.address), "%s", redis_addr);
+			    snprintf(config->server[0].address, sizeof(config->server[0].address), "%s", redis_addr);
+                            if (config->num_of_server == 0)
+                                config->num_of_server = 1;
                         } else if (!strcmp(redis_server_config_key, "port")) {
                             const char *redis_port = ogs_yaml_iter_value(&redis_iter);
 
                             if (redis_port)
-                                self.redis_server_config.port = atoi(redis_port);
+                                config->server[0].port = atoi(redis_port);
+                        } else if (!strcmp(redis_server_config_key, "servers")) {
+                            ogs_yaml_iter_t servers_array, servers_iter;
+                            ogs_yaml_iter_recurse(&redis_iter, &servers_array);
+
+                            config->num_of_server = 0;
+                            do {
+                                redis_server_t *server = NULL;
+
+                                if (ogs_yaml_iter_type(&servers_array) ==
+                                        YAML_MAPPING_NODE) {
+                                    memcpy(&servers_iter, &servers_array,
+                                            sizeof(ogs_yaml_iter_t));
+                                } else if (ogs_yaml_iter_type(&servers_array) ==
+                                        YAML_SEQUENCE_NODE) {
+                                    if (!ogs_yaml_iter_next(&servers_array))
+                                        break;
+                                    ogs_yaml_iter_recurse(&servers_array,
+                                            &servers_iter);
+                                } else if (ogs_yaml_iter_type(&servers_array) ==
+                                        YAML_SCALAR_NODE) {
+                                    break;
+                                } else
+                                    ogs_assert_if_reached();
+
+                                if (config->num_of_server >=
+                                        MAX_NUM_OF_REDIS_SERVER) {
+                                    ogs_warn("Ignoring redis server, "
+                                            "at most %d are supported",
+                                            MAX_NUM_OF_REDIS_SERVER);
+                                    break;
+                                }
+                                server = &config->server[config->num_of_server];
+                                server->port = 6379;
+
+                                while (ogs_yaml_iter_next(&servers_iter)) {
+                                    const char *servers_key =
+                                        ogs_yaml_iter_key(&servers_iter);
+                                    ogs_assert(servers_key);
+                                    if (!strcmp(servers_key, "addr")) {
+                                        const char *v =
+                                            ogs_yaml_iter_value(&servers_iter);
+                                        if (v)
+                                            snprintf(server->address,
+                                                    sizeof(server->address),
+                                                    "%s", v);
+                                    } else if (!strcmp(servers_key, "port")) {
+                                        const char *v =
+                                            ogs_yaml_iter_value(&servers_iter);
+                                        if (v)
+                                            server->port = atoi(v);
+                                    } else
+                                        ogs_warn("unknown key `%s`",
+                                                servers_key);
+                                }
+
+                                if (server->address[0])
+                                    config->num_of_server++;
+                            } while (ogs_yaml_iter_type(&servers_array) ==
+                                    YAML_SEQUENCE_NODE);
+                        } else if (!strcmp(redis_server_config_key, "connections")) {
+                            const char *redis_connections = ogs_yaml_iter_value(&redis_iter);
+
+                            if (redis_connections)
+                                config->connections = atoi(redis_connections);
+                            if (config->connections < 1 ||
+                                config->connections > MAX_NUM_OF_REDIS_CONNECTION) {
+                                config->connections = ogs_max(1, ogs_min(
+                                    config->connections, MAX_NUM_OF_REDIS_CONNECTION));
+                                ogs_warn("redis connections must be 1..%d, using %d",
+                                        MAX_NUM_OF_REDIS_CONNECTION,
+                                        config->connections);
+                            }
+                        } else if (!strcmp(redis_server_config_key, "timeout_msec")) {
+                            const char *redis_timeout = ogs_yaml_iter_value(&redis_iter);
+
+                            if (redis_timeout)
+                                config->timeout = ogs_time_from_msec(atoi(redis_timeout));
                         } else
                             ogs_warn("unknown key `%s`", mme_key);
                     }
@@ -1903,6 +2145,54 @@ int mme_context_parse_config(void)
                             if (redis_dup_detection_expire_time_sec) {
                                 self.redis_dup_detection.expire_time_sec = atoi(redis_dup_detection_expire_time_sec);
                             }
+                        } else if (!strcmp(redis_dup_detection_key, "async")) {
+                            const char *redis_dup_detection_async = ogs_yaml_iter_value(&redis_dup_detection_iter);
+                            if (!strcmp("True", redis_dup_detection_async) ||
+                                !strcmp("true", redis_dup_detection_async)) {
+                                ogs_info("Redis message duplication lookups will be asynchronous");
+                                self.redis_dup_detection.async = true;
+                            }
+                            else {
+                                self.redis_dup_detection.async = false;
+                            }
+                        } else if (!strcmp(redis_dup_detection_key, "deadline_msec")) {
+                            const char *redis_dup_detection_deadline_msec = ogs_yaml_iter_value(&redis_dup_detection_iter);
+                            if (redis_dup_detection_deadline_msec) {
+                                self.redis_dup_detection.deadline = ogs_time_from_msec(atoi(redis_dup_detection_deadline_msec));
+                            }
+                        } else if (!strcmp(redis_dup_detection_key, "key")) {
+                            const char *redis_dup_detection_key_type = ogs_yaml_iter_value(&redis_dup_detection_iter);
+                            if (redis_dup_detection_key_type &&
+                                !strcmp("digest", redis_dup_detection_key_type)) {
+                                self.redis_dup_detection.digest_key = true;
+                            } else if (redis_dup_detection_key_type &&
+                                !strcmp("pdu", redis_dup_detection_key_type)) {
+                                self.redis_dup_detection.digest_key = false;
+                            } else {
+                                ogs_warn("unknown redis key type `%s`, valid types are: digest, pdu",
+                                        redis_dup_detection_key_type);
+                            }
+                        } else if (!strcmp(redis_dup_detection_key, "local_cache")) {
+                            const char *redis_dup_detection_local_cache = ogs_yaml_iter_value(&redis_dup_detection_iter);
+                            if (!strcmp("True", redis_dup_detection_local_cache) ||
+                                !strcmp("true", redis_dup_detection_local_cache)) {
+                                ogs_info("Redis message duplication local cache has been enabled");
+                                self.redis_dup_detection.local_cache = true;
+                            }
+                            else {
+                                self.redis_dup_detection.local_cache = false;
+                            }
+                        } else if (!strcmp(redis_dup_detection_key, "local_cache_bits")) {
+                            const char *redis_dup_detection_local_cache_bits = ogs_yaml_iter_value(&redis_dup_detection_iter);
+                            if (redis_dup_detection_local_cache_bits) {
+                                uint64_t bits = atoll(redis_dup_detection_local_cache_bits);
+                                uint64_t size = 64;
+
+                                /* Power of two, so the filter can be masked */
+                                while (size < bits)
+                                    size <<= 1;
+                                self.redis_dup_detection.local_cache_bits = size;
+                            }
                         } else
                             ogs_warn("unknown key `%s`", mme_key);
                     }
@@ -1932,6 +2222,43 @@ int mme_context_parse_config(void)
                         } else if (strcmp(dns_key, "base_domain") == 0) {
 			    snprintf(self.dns_base_domain, MAX_DNS_BASE_DOMAIN_NAME, "%s", dns_value);
                             ogs_info("DNS lookups using base domain '%s'", self.dns_base_domain);
+                        } else if (strcmp(dns_key, "cache") == 0) {
+                            if (!strcmp("True", dns_value) ||
+                                !strcmp("true", dns_value)) {
+                                self.dns_cache.enabled = true;
+                            } else {
+                                ogs_info("DNS cache disabled");
+                                self.dns_cache.enabled = false;
+                            }
+                        } else if (strcmp(dns_key, "cache_max_entries") == 0) {
+                            self.dns_cache.max_entries = atoi(dns_value);
+                        } else if (strcmp(dns_key, "cache_negative_ttl_sec") == 0) {
+                            self.dns_cache.negative_ttl_sec = atoi(dns_value);
+                        } else if (strcmp(dns_key, "cache_max_ttl_sec") == 0) {
+                            self.dns_cache.max_ttl_sec = atoi(dns_value);
+                        } else if (strcmp(dns_key, "async") == 0) {
+                            if (!strcmp("True", dns_value) ||
+                                !strcmp("true", dns_value)) {
+                                ogs_info("DNS lookups run off the MME thread");
+                                self.dns_async.enabled = true;
+                            } else {
+                                self.dns_async.enabled = false;
+                            }
+                        } else if (strcmp(dns_key, "async_threads") == 0) {
+                            self.dns_async.num_of_thread = atoi(dns_value);
+                            if (self.dns_async.num_of_thread < 1 ||
+                                self.dns_async.num_of_thread > MAX_NUM_OF_DNS_THREAD) {
+                                self.dns_async.num_of_thread = ogs_max(1, ogs_min(
+                                    self.dns_async.num_of_thread, MAX_NUM_OF_DNS_THREAD));
+                                ogs_warn("DNS async_threads must be 1..%d, using %d",
+                                        MAX_NUM_OF_DNS_THREAD,
+                                        self.dns_async.num_of_thread);
+                            }
+                        } else if (strcmp(dns_key, "async_max_inflight") == 0) {
+                            self.dns_async.max_inflight = ogs_max(1, atoi(dns_value));
+                        } else if (strcmp(dns_key, "async_deadline_msec") == 0) {
+                            self.dns_async.deadline =
+                                ogs_time_from_msec(ogs_max(1, atoi(dns_value)));
                         } else {
                             ogs_warn("unknown key `%s`", dns_key);
                         }
@@ -2894,7 +3221,7 @@ mme_enb_t *mme_enb_add(ogs_sock_t *sock, ogs_sockaddr_t *addr)
 
     if (enb->sctp.type == SOCK_STREAM) {
         enb->sctp.poll.read = ogs_pollset_add(ogs_app()->pollset,
-            OGS_POLLIN, sock->fd, s1ap_recv_upcall, sock);
+            OGS_POLLIN, sock->fd, s1ap_recv_upcall, enb);
         ogs_assert(enb->sctp.poll.read);
 
         ogs_list_init(&enb->sctp.write_queue);
@@ -2905,8 +3232,7 @@ mme_enb_t *mme_enb_add(ogs_sock_t *sock, ogs_sockaddr_t *addr)
 
     ogs_list_init(&enb->enb_ue_list);
 
-    ogs_hash_set(self.enb_addr_hash,
-            enb->sctp.addr, sizeof(ogs_sockaddr_t), enb);
+    ogs_flatmap_set(self.enb_addr_hash, enb->sctp.addr, enb);
 
     memset(&e, 0, sizeof(e));
     e.enb = enb;
@@ -2937,9 +3263,9 @@ int mme_enb_remove(mme_enb_t *enb)
     e.enb = enb;
     ogs_fsm_fini(&enb->sm, &e);
 
-    ogs_hash_set(self.enb_addr_hash,
-            enb->sctp.addr, sizeof(ogs_sockaddr_t), NULL);
-    ogs_hash_set(self.enb_id_hash, &enb->enb_id, sizeof(enb->enb_id), NULL);
+    ogs_flatmap_set(self.enb_addr_hash, enb->sctp.addr, NULL);
+    ogs_flatmap_set_u32(self.enb_id_hash, enb->enb_id, NULL);
+    enb_tai_index_clear(enb);
 
     /*
      * CHECK:
@@ -3011,29 +3337,118 @@ int mme_cbc_remove(void)
 mme_enb_t *mme_enb_find_by_addr(ogs_sockaddr_t *addr)
 {
     ogs_assert(addr);
-    return (mme_enb_t *)ogs_hash_get(self.enb_addr_hash,
-            addr, sizeof(ogs_sockaddr_t));
+    return (mme_enb_t *)ogs_flatmap_get(self.enb_addr_hash, addr);
 
     return NULL;
 }
 
 mme_enb_t *mme_enb_find_by_enb_id(uint32_t enb_id)
 {
-    return (mme_enb_t *)ogs_hash_get(self.enb_id_hash, &enb_id, sizeof(enb_id));
+    return (mme_enb_t *)ogs_flatmap_get_u32(self.enb_id_hash, enb_id);
 }
 
 int mme_enb_set_enb_id(mme_enb_t *enb, uint32_t enb_id)
 {
     ogs_assert(enb);
 
-    ogs_hash_set(self.enb_id_hash, &enb_id, sizeof(enb_id), NULL);
+    ogs_flatmap_set_u32(self.enb_id_hash, enb_id, NULL);
 
     enb->enb_id = enb_id;
-    ogs_hash_set(self.enb_id_hash, &enb->enb_id, sizeof(enb->enb_id), enb);
+    ogs_flatmap_set_u32(self.enb_id_hash, enb->enb_id, enb);
 
     return OGS_OK;
 }
 
+/*
+ * Rebuild the TAI index of the eNB from supported_ta_list.
+ * Called whenever the Supported TAs of the eNB change.
+ */
+void mme_enb_update_tai_index(mme_enb_t *enb)
+{
+    mme_tai_enb_set_t *set = NULL;
+    mme_enb_tai_t *link = NULL;
+    int i, j;
+
+    ogs_assert(enb);
+
+    enb_tai_index_clear(enb);
+
+    if (enb->num_of_supported_ta_list == 0)
+        return;
+
+    enb->tai_index = ogs_calloc(
+            enb->num_of_supported_ta_list, sizeof(mme_enb_tai_t));
+    ogs_assert(enb->tai_index);
+
+    for (i = 0; i < enb->num_of_supported_ta_list; i++) {
+        ogs_eps_tai_t *tai = &enb->supported_ta_list[i];
+
+        set = ogs_hash_get(self.tai_enb_hash, tai, sizeof(ogs_eps_tai_t));
+        if (!set) {
+            set = ogs_calloc(1, sizeof(mme_tai_enb_set_t));
+            ogs_assert(set);
+            memcpy(&set->tai, tai, sizeof(ogs_eps_tai_t));
+            ogs_list_init(&set->list);
+            ogs_hash_set(self.tai_enb_hash,
+                    &set->tai, sizeof(ogs_eps_tai_t), set);
+        }
+
+        /* Same TAI listed twice by the eNB */
+        for (j = 0; j < enb->num_of_tai_index; j++)
+            if (enb->tai_index[j].set == set)
+                break;
+        if (j < enb->num_of_tai_index)
+            continue;
+
+        link = &enb->tai_index[enb->num_of_tai_index++];
+        link->enb = enb;
+        link->set = set;
+        ogs_list_add(&set->list, link);
+    }
+}
+
+/*
+ * Returns the first eNB supporting the TAI, or NULL.
+ * The rest follow with ogs_list_next().
+ */
+mme_enb_tai_t *mme_enb_tai_first(ogs_eps_tai_t *tai)
+{
+    mme_tai_enb_set_t *set = NULL;
+
+    ogs_assert(tai);
+
+    set = ogs_hash_get(self.tai_enb_hash, tai, sizeof(ogs_eps_tai_t));
+    if (!set)
+        return NULL;
+
+    return ogs_list_first(&set->list);
+}
+
+static void enb_tai_index_clear(mme_enb_t *enb)
+{
+    mme_tai_enb_set_t *set = NULL;
+    int i;
+
+    ogs_assert(enb);
+
+    for (i = 0; i < enb->num_of_tai_index; i++) {
+        set = enb->tai_index[i].set;
+        ogs_assert(set);
+
+        ogs_list_remove(&set->list, &enb->tai_index[i]);
+        if (ogs_list_first(&set->list) == NULL) {
+            ogs_hash_set(self.tai_enb_hash,
+                    &set->tai, sizeof(ogs_eps_tai_t), NULL);
+            ogs_free(set);
+        }
+    }
+
+    if (enb->tai_index)
+        ogs_free(enb->tai_index);
+    enb->tai_index = NULL;
+    enb->num_of_tai_index = 0;
+}
+
 int mme_enb_sock_type(ogs_sock_t *sock)
 {
     ogs_socknode_t *snode = NULL;
@@ -3098,6 +3513,7 @@ enb_ue_t *enb_ue_add(mme_enb_t *enb, uint32_t enb_ue_s1ap_id)
     ogs_list_add(&enb->enb_ue_list, enb_ue);
 
     stats_add_enb_ue();
+    stats_update_pool(MME_METR_POOL_ENB_UE, &enb_ue_pool);
 
     return enb_ue;
 }
@@ -3121,6 +3537,7 @@ void enb_ue_remove(enb_ue_t *enb_ue)
     ogs_pool_free(&enb_ue_pool, enb_ue);
 
     stats_remove_enb_ue();
+    stats_update_pool(MME_METR_POOL_ENB_UE, &enb_ue_pool);
 }
 
 void enb_ue_switch_to_enb(enb_ue_t *enb_ue, mme_enb_t *new_enb)
@@ -3190,6 +3607,8 @@ sgw_ue_t *sgw_ue_add(mme_sgw_t *sgw)
 
     ogs_list_add(&sgw->sgw_ue_list, sgw_ue);
 
+    stats_update_pool(MME_METR_POOL_SGW_UE, &sgw_ue_pool);
+
     return sgw_ue;
 }
 
@@ -3215,6 +3634,8 @@ void sgw_ue_remove(sgw_ue_t *sgw_ue)
     memset(sgw_ue, 0, sizeof(*sgw_ue));
 
     ogs_pool_free(&sgw_ue_pool, sgw_ue);
+
+    stats_update_pool(MME_METR_POOL_SGW_UE, &sgw_ue_pool);
 }
 
 void sgw_ue_switch_to_sgw(sgw_ue_t *sgw_ue, mme_sgw_t *new_sgw)
@@ -3310,13 +3731,15 @@ void mme_ue_new_guti(mme_ue_t *mme_ue)
 
 void mme_ue_confirm_guti(mme_ue_t *mme_ue)
 {
+    mme_guti_key_t key;
+
     ogs_assert(mme_ue->next.m_tmsi);
 
     if (mme_ue->current.m_tmsi) {
         /* MME has a VALID GUTI
          * As such, we need to remove previous GUTI in hash table */
-        ogs_hash_set(self.guti_ue_hash,
-                &mme_ue->current.guti, sizeof(ogs_nas_eps_guti_t), NULL);
+        guti_key(&key, &mme_ue->current.guti);
+        ogs_flatmap_set(self.guti_ue_hash, &key, NULL);
         ogs_assert(mme_m_tmsi_free(mme_ue->current.m_tmsi) == OGS_OK);
     }
 
@@ -3326,8 +3749,8 @@ void mme_ue_confirm_guti(mme_ue_t *mme_ue)
             &mme_ue->next.guti, sizeof(ogs_nas_eps_guti_t));
 
     /* Hashing Current GUTI */
-    ogs_hash_set(self.guti_ue_hash,
-            &mme_ue->current.guti, sizeof(ogs_nas_eps_guti_t), mme_ue);
+    guti_key(&key, &mme_ue->current.guti);
+    ogs_flatmap_set(self.guti_ue_hash, &key, mme_ue);
 
     /* Clear Next GUTI */
     mme_ue->next.m_tmsi = NULL;
@@ -3477,6 +3900,14 @@ mme_ue_t *mme_ue_add(enb_ue_t *enb_ue, ogs_nas_eps_message_t *nas_message)
     }
     mme_ue->t_implicit_detach.pkbuf = NULL;
 
+    ogs_pool_alloc(&mme_ue_profile_pool, &mme_ue->profile);
+    if (!mme_ue->profile) {
+        ogs_error("Could not allocate mme_ue profile from pool");
+        ogs_pool_free(&mme_ue_pool, mme_ue);
+        return NULL;
+    }
+    memset(mme_ue->profile, 0, sizeof *mme_ue->profile);
+
     mme_ebi_pool_init(mme_ue);
 
     ogs_list_init(&mme_ue->sess_list);
@@ -3487,20 +3918,22 @@ mme_ue_t *mme_ue_add(enb_ue_t *enb_ue, ogs_nas_eps_message_t *nas_message)
 
     mme_ue->mme_s11_teid = *(mme_ue->mme_s11_teid_node);
 
-    ogs_hash_set(self.mme_s11_teid_hash,
-            &mme_ue->mme_s11_teid, sizeof(mme_ue->mme_s11_teid), mme_ue);
+    ogs_flatmap_set_u32(self.mme_s11_teid_hash, mme_ue->mme_s11_teid, mme_ue);
 
     /* SGW selection takes place in mme_s11_build_create_session_request */
     /* PGW selection takes place in mme_s11_build_create_session_request */
 
     /* Clear VLR */
-    mme_ue->csmap = NULL;
+    mme_ue->profile->csmap = NULL;
     mme_ue->vlr_ostream_id = 0;
 
     mme_ue_fsm_init(mme_ue);
 
     ogs_list_add(&self.mme_ue_list, mme_ue);
 
+    stats_update_pool(MME_METR_POOL_MME_UE, &mme_ue_pool);
+    stats_update_pool(MME_METR_POOL_MME_UE_PROFILE, &mme_ue_profile_pool);
+
     ogs_info("[Added] Number of MME-UEs is now %d",
             ogs_list_count(&self.mme_ue_list));
 
@@ -3520,19 +3953,22 @@ void mme_ue_remove(mme_ue_t *mme_ue)
 
     mme_ue_fsm_fini(mme_ue);
 
-    ogs_hash_set(self.mme_s11_teid_hash,
-            &mme_ue->mme_s11_teid, sizeof(mme_ue->mme_s11_teid), NULL);
+    mme_metrics_ue_remove(mme_ue->imsi_bcd);
+
+    ogs_flatmap_set_u32(self.mme_s11_teid_hash, mme_ue->mme_s11_teid, NULL);
 
     sgw_ue_remove(mme_ue->sgw_ue);
 
     if (0 != mme_ue->imsi_len) {
-        ogs_hash_set(mme_self()->imsi_ue_hash,
-                mme_ue->imsi, mme_ue->imsi_len, NULL);
+        ogs_flatmap_set_u64(mme_self()->imsi_ue_hash,
+                imsi_key(mme_ue->imsi, mme_ue->imsi_len), NULL);
     }
 
     if (mme_ue->current.m_tmsi) {
-        ogs_hash_set(self.guti_ue_hash,
-                &mme_ue->current.guti, sizeof(ogs_nas_eps_guti_t), NULL);
+        mme_guti_key_t key;
+
+        guti_key(&key, &mme_ue->current.guti);
+        ogs_flatmap_set(self.guti_ue_hash, &key, NULL);
         ogs_assert(mme_m_tmsi_free(mme_ue->current.m_tmsi) == OGS_OK);
     }
 
@@ -3570,11 +4006,17 @@ void mme_ue_remove(mme_ue_t *mme_ue)
 
     ogs_pool_free(&mme_s11_teid_pool, mme_ue->mme_s11_teid_node);
 
+    memset(mme_ue->profile, 0, sizeof(*mme_ue->profile));
+    ogs_pool_free(&mme_ue_profile_pool, mme_ue->profile);
+
     /* Clear mme_ue so if pointer is used again use-after-free is easier to detect */
     memset(mme_ue, 0, sizeof(*mme_ue));
 
     ogs_pool_free(&mme_ue_pool, mme_ue);
 
+    stats_update_pool(MME_METR_POOL_MME_UE, &mme_ue_pool);
+    stats_update_pool(MME_METR_POOL_MME_UE_PROFILE, &mme_ue_profile_pool);
+
     ogs_info("[Removed] Number of MME-UEs is now %d",
             ogs_list_count(&self.mme_ue_list));
 }
@@ -3635,20 +4077,23 @@ mme_ue_t *mme_ue_find_by_imsi(uint8_t *imsi, int imsi_len)
 {
     ogs_assert(imsi && imsi_len);
 
-    return (mme_ue_t *)ogs_hash_get(self.imsi_ue_hash, imsi, imsi_len);
+    return (mme_ue_t *)ogs_flatmap_get_u64(
+            self.imsi_ue_hash, imsi_key(imsi, imsi_len));
 }
 
 mme_ue_t *mme_ue_find_by_guti(ogs_nas_eps_guti_t *guti)
 {
+    mme_guti_key_t key;
+
     ogs_assert(guti);
 
-    return (mme_ue_t *)ogs_hash_get(
-            self.guti_ue_hash, guti, sizeof(ogs_nas_eps_guti_t));
+    guti_key(&key, guti);
+    return (mme_ue_t *)ogs_flatmap_get(self.guti_ue_hash, &key);
 }
 
 mme_ue_t *mme_ue_find_by_teid(uint32_t teid)
 {
-    return ogs_hash_get(self.mme_s11_teid_hash, &teid, sizeof(teid));
+    return ogs_flatmap_get_u32(self.mme_s11_teid_hash, teid);
 }
 
 mme_ue_t *mme_ue_find_by_message(ogs_nas_eps_message_t *message)
@@ -3907,18 +4352,19 @@ int mme_ue_set_imsi(mme_ue_t *mme_ue, char *imsi_bcd)
     }
 
     if (mme_ue->imsi_len != 0)
-        ogs_hash_set(mme_self()->imsi_ue_hash,
-                mme_ue->imsi, mme_ue->imsi_len, NULL);
+        ogs_flatmap_set_u64(mme_self()->imsi_ue_hash,
+                imsi_key(mme_ue->imsi, mme_ue->imsi_len), NULL);
 
-    ogs_hash_set(self.imsi_ue_hash, mme_ue->imsi, mme_ue->imsi_len, mme_ue);
+    ogs_flatmap_set_u64(self.imsi_ue_hash,
+            imsi_key(mme_ue->imsi, mme_ue->imsi_len), mme_ue);
 	
-    mme_ue->hssmap = mme_hssmap_find_by_imsi_bcd(mme_ue->imsi_bcd);
-    if (mme_ue->hssmap) {
+    mme_ue->profile->hssmap = mme_hssmap_find_by_imsi_bcd(mme_ue->imsi_bcd);
+    if (mme_ue->profile->hssmap) {
         char plmn_id_str[OGS_PLMNIDSTRLEN];
-        const char *realm = mme_ue->hssmap->realm ? mme_ue->hssmap->realm : "NULL";
-        const char *host = mme_ue->hssmap->host ? mme_ue->hssmap->host : "NULL";
+        const char *realm = mme_ue->profile->hssmap->realm ? mme_ue->profile->hssmap->realm : "NULL";
+        const char *host = mme_ue->profile->hssmap->host ? mme_ue->profile->hssmap->host : "NULL";
 
-        ogs_plmn_id_to_string(&mme_ue->hssmap->plmn_id, plmn_id_str);
+        ogs_plmn_id_to_string(&mme_ue->profile->hssmap->plmn_id, plmn_id_str);
         ogs_debug("[%s]: HSS Map HPLMN[%s] Realm[%s] Host[%s]",
                    mme_ue->imsi_bcd, plmn_id_str, realm, host);
 
@@ -4036,6 +4482,57 @@ int mme_ue_xact_count(mme_ue_t *mme_ue, uint8_t org)
                 ogs_list_count(&gnode->remote_list);
 }
 
+static int retx_size(ogs_pkbuf_t *pkbuf)
+{
+    return pkbuf ? pkbuf->end - pkbuf->head : 0;
+}
+
+void mme_retx_hold(mme_ue_t *mme_ue, ogs_pkbuf_t *pkbuf)
+{
+    ogs_assert(mme_ue);
+    ogs_assert(pkbuf);
+
+    mme_metrics_inst_global_inc(MME_METR_GLOB_GAUGE_RETX_BUFFERS);
+    mme_metrics_inst_global_add(
+            MME_METR_GLOB_GAUGE_RETX_BYTES, retx_size(pkbuf));
+
+    ogs_debug("[%s] Holding %d bytes for retransmission [UE total:%d]",
+            mme_ue->imsi_bcd, retx_size(pkbuf),
+            (int)mme_ue_retx_size(mme_ue));
+}
+
+void mme_retx_release(ogs_pkbuf_t *pkbuf)
+{
+    ogs_assert(pkbuf);
+
+    mme_metrics_inst_global_dec(MME_METR_GLOB_GAUGE_RETX_BUFFERS);
+    mme_metrics_inst_global_add(
+            MME_METR_GLOB_GAUGE_RETX_BYTES, -retx_size(pkbuf));
+}
+
+size_t mme_ue_retx_size(mme_ue_t *mme_ue)
+{
+    mme_sess_t *sess = NULL;
+    mme_bearer_t *bearer = NULL;
+    size_t size = 0;
+
+    ogs_assert(mme_ue);
+
+    size += retx_size(mme_ue->t3413.pkbuf);
+    size += retx_size(mme_ue->t3422.pkbuf);
+    size += retx_size(mme_ue->t3450.pkbuf);
+    size += retx_size(mme_ue->t3460.pkbuf);
+    size += retx_size(mme_ue->t3470.pkbuf);
+
+    ogs_list_for_each(&mme_ue->sess_list, sess) {
+        ogs_list_for_each(&sess->bearer_list, bearer) {
+            size += retx_size(bearer->t3489.pkbuf);
+        }
+    }
+
+    return size;
+}
+
 bool imsi_is_roaming(ogs_nas_mobile_identity_imsi_t *nas_imsi)
 {
     ogs_assert(nas_imsi);
@@ -4220,6 +4717,7 @@ mme_sess_t *mme_sess_add(mme_ue_t *mme_ue, uint8_t pti)
     ogs_list_add(&mme_ue->sess_list, sess);
 
     stats_add_mme_session();
+    stats_update_pool(MME_METR_POOL_MME_SESS, &mme_sess_pool);
 
     return sess;
 }
@@ -4262,6 +4760,7 @@ void mme_sess_remove(mme_sess_t *sess)
     ogs_pool_free(&mme_sess_pool, sess);
 
     stats_remove_mme_session();
+    stats_update_pool(MME_METR_POOL_MME_SESS, &mme_sess_pool);
 }
 
 void mme_sess_remove_all(mme_ue_t *mme_ue)
@@ -4389,6 +4888,8 @@ mme_bearer_t *mme_bearer_add(mme_sess_t *sess)
     e.bearer = bearer;
     ogs_fsm_init(&bearer->sm, esm_state_initial, esm_state_final, &e);
 
+    stats_update_pool(MME_METR_POOL_MME_BEARER, &mme_bearer_pool);
+
     return bearer;
 }
 
@@ -4418,6 +4919,8 @@ void mme_bearer_remove(mme_bearer_t *bearer)
     memset(bearer, 0, sizeof(*bearer));
 
     ogs_pool_free(&mme_bearer_pool, bearer);
+
+    stats_update_pool(MME_METR_POOL_MME_BEARER, &mme_bearer_pool);
 }
 
 void mme_bearer_remove_all(mme_sess_t *sess)
@@ -4691,14 +5194,14 @@ void mme_session_remove_all(mme_ue_t *mme_ue)
     mme_ue = mme_ue_cycle(mme_ue);
     ogs_assert(mme_ue);
 
-    ogs_assert(mme_ue->num_of_session <= OGS_MAX_NUM_OF_SESS);
-    for (i = 0; i < mme_ue->num_of_session; i++) {
-        if (mme_ue->session[i].name) {
-            ogs_free(mme_ue->session[i].name);
+    ogs_assert(mme_ue->profile->num_of_session <= OGS_MAX_NUM_OF_SESS);
+    for (i = 0; i < mme_ue->profile->num_of_session; i++) {
+        if (mme_ue->profile->session[i].name) {
+            ogs_free(mme_ue->profile->session[i].name);
         }
     }
 
-    mme_ue->num_of_session = 0;
+    mme_ue->profile->num_of_session = 0;
 }
 
 ogs_session_t *mme_session_find_by_apn(mme_ue_t *mme_ue, char *apn)
@@ -4709,9 +5212,9 @@ ogs_session_t *mme_session_find_by_apn(mme_ue_t *mme_ue, char *apn)
     ogs_assert(mme_ue);
     ogs_assert(apn);
 
-    ogs_assert(mme_ue->num_of_session <= OGS_MAX_NUM_OF_SESS);
-    for (i = 0; i < mme_ue->num_of_session; i++) {
-        session = &mme_ue->session[i];
+    ogs_assert(mme_ue->profile->num_of_session <= OGS_MAX_NUM_OF_SESS);
+    for (i = 0; i < mme_ue->profile->num_of_session; i++) {
+        session = &mme_ue->profile->session[i];
         ogs_assert(session->name);
         if (ogs_strcasecmp(session->name, apn) == 0)
             return session;
@@ -4726,10 +5229,10 @@ ogs_session_t *mme_emergency_session(mme_ue_t *mme_ue)
     int i = 0;
 
     ogs_assert(mme_ue);
-    ogs_assert(mme_ue->num_of_session <= OGS_MAX_NUM_OF_SESS);
+    ogs_assert(mme_ue->profile->num_of_session <= OGS_MAX_NUM_OF_SESS);
 
-    for (i = 0; i < mme_ue->num_of_session; i++) {
-        session = &mme_ue->session[i];
+    for (i = 0; i < mme_ue->profile->num_of_session; i++) {
+        session = &mme_ue->profile->session[i];
         if (strstr(session->name, "sos")) {
             return session;
         }
@@ -4745,10 +5248,10 @@ ogs_session_t *mme_default_session(mme_ue_t *mme_ue)
 
     ogs_assert(mme_ue);
 
-    ogs_assert(mme_ue->num_of_session <= OGS_MAX_NUM_OF_SESS);
-    for (i = 0; i < mme_ue->num_of_session; i++) {
-        session = &mme_ue->session[i];
-        if (session->context_identifier == mme_ue->context_identifier)
+    ogs_assert(mme_ue->profile->num_of_session <= OGS_MAX_NUM_OF_SESS);
+    for (i = 0; i < mme_ue->profile->num_of_session; i++) {
+        session = &mme_ue->profile->session[i];
+        if (session->context_identifier == mme_ue->profile->context_identifier)
             return session;
     }
 
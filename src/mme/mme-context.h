@@ -91,15 +91,31 @@ typedef struct {
     uint16_t bcd_decimal;
 } emergency_number_list_item_t;
 
+#define MAX_NUM_OF_REDIS_SERVER 8       /* OGS_REDIS_MAX_ENDPOINTS */
+#define MAX_NUM_OF_REDIS_CONNECTION 8   /* OGS_REDIS_MAX_CONNECTIONS */
+
 typedef struct {
-    bool enabled;
     char address[16];
     unsigned port;
+} redis_server_t;
+
+typedef struct {
+    bool enabled;
+    int num_of_server;      /* Keys are sharded across all of them */
+    redis_server_t server[MAX_NUM_OF_REDIS_SERVER];
+
+    int connections;        /* Blocking connections per server */
+    ogs_time_t timeout;     /* Connect and command timeout */
 } redis_server_config_t;
 
 typedef struct {
     bool enabled;
     unsigned expire_time_sec;
+    bool async;             /* Lookups run on the MME pollset */
+    ogs_time_t deadline;    /* Async lookups fail open after this */
+    bool digest_key;        /* Key on a digest rather than the raw PDU */
+    bool local_cache;       /* Bloom filter in front of redis */
+    uint64_t local_cache_bits;
 } redis_dup_detection_t;
 
 typedef struct {
@@ -192,12 +208,13 @@ typedef struct mme_context_s {
 
     ogs_list_t      mme_ue_list;
 
-    ogs_hash_t *enb_addr_hash;  /* hash table for ENB Address */
-    ogs_hash_t *enb_id_hash;    /* hash table for ENB-ID */
-    ogs_hash_t *imsi_ue_hash;   /* hash table (IMSI : MME_UE) */
-    ogs_hash_t *guti_ue_hash;   /* hash table (GUTI : MME_UE) */
+    ogs_flatmap_t *enb_addr_hash;   /* hash table for ENB Address */
+    ogs_flatmap_t *enb_id_hash;     /* hash table for ENB-ID */
+    ogs_hash_t *tai_enb_hash;   /* hash table (TAI : mme_tai_enb_set_t) */
+    ogs_flatmap_t *imsi_ue_hash;    /* hash table (IMSI : MME_UE) */
+    ogs_flatmap_t *guti_ue_hash;    /* hash table (GUTI : MME_UE) */
 
-    ogs_hash_t *mme_s11_teid_hash;  /* hash table (MME-S11-TEID : MME_UE) */
+    ogs_flatmap_t *mme_s11_teid_hash; /* hash table (MME-S11-TEID : MME_UE) */
 
     struct {
         struct {
@@ -221,6 +238,34 @@ typedef struct mme_context_s {
     bool dns_target_sgw;
     bool dns_target_pgw;
     char dns_base_domain[MAX_DNS_BASE_DOMAIN_NAME];
+    struct {
+        bool enabled;
+        int max_entries;
+        unsigned negative_ttl_sec;  /* NXDOMAIN and empty answers */
+        unsigned max_ttl_sec;       /* Caps the record TTLs */
+    } dns_cache;
+    struct {
+        bool enabled;               /* Lookups off the MME thread */
+#define MAX_NUM_OF_DNS_THREAD 16
+        int num_of_thread;
+        int max_inflight;
+        ogs_time_t deadline;        /* CSR goes on without the answer */
+    } dns_async;
+    struct {
+        bool aggregate;             /* No per IMSI series */
+    } ue_metrics;
+    struct {
+        int num;                    /* Number-Of-Requested-Vectors */
+        ogs_time_t lifetime;        /* Unused vectors are dropped after */
+    } auth_vectors;
+    struct {
+        int max_entries;            /* 0 disables the cache */
+        ogs_time_t ttl;
+    } subscription_cache;
+    struct {
+        int workers;                /* 0 decodes on the MME thread */
+    } s1ap_decoder;
+
     struct { uint16_t mnc; uint16_t mcc; } home_mnc_mcc[OGS_MAX_NUM_OF_SERVED_TAI];
     size_t home_mnc_mcc_sz;
 
@@ -254,8 +299,8 @@ typedef struct mme_pgw_s {
 } mme_pgw_t;
 
 #define MME_SGSAP_IS_CONNECTED(__mME) \
-    ((__mME) && ((__mME)->csmap) && ((__mME)->csmap->vlr) && \
-     (OGS_FSM_CHECK(&(__mME)->csmap->vlr->sm, sgsap_state_connected)))
+    ((__mME) && ((__mME)->profile->csmap) && ((__mME)->profile->csmap->vlr) && \
+     (OGS_FSM_CHECK(&(__mME)->profile->csmap->vlr->sm, sgsap_state_connected)))
 #define MME_P_TMSI_IS_AVAILABLE(__mME) \
     (MME_SGSAP_IS_CONNECTED(__mME) && (__mME)->p_tmsi)
 
@@ -294,6 +339,18 @@ typedef struct mme_hssmap_s {
     char            *host;
 } mme_hssmap_t;
 
+/* eNBs whose Supported TAs include the TAI, stored in tai_enb_hash */
+typedef struct mme_tai_enb_set_s {
+    ogs_eps_tai_t   tai;
+    ogs_list_t      list;           /* List of mme_enb_tai_t */
+} mme_tai_enb_set_t;
+
+typedef struct mme_enb_tai_s {
+    ogs_lnode_t     lnode;
+    struct mme_enb_s *enb;
+    mme_tai_enb_set_t *set;
+} mme_enb_tai_t;
+
 typedef struct mme_enb_s {
     ogs_lnode_t     lnode;
 
@@ -312,6 +369,12 @@ typedef struct mme_enb_s {
     int             num_of_supported_ta_list;
     ogs_eps_tai_t   supported_ta_list[OGS_MAX_NUM_OF_TAI*OGS_MAX_NUM_OF_BPLMN];
 
+    /* Membership of this eNB in tai_enb_hash, one per distinct TAI */
+    int             num_of_tai_index;
+    mme_enb_tai_t   *tai_index;
+
+    uint32_t        broadcast_seq;  /* Last TAI-scoped broadcast sent */
+
     ogs_pkbuf_t     *s1_reset_ack; /* Reset message */
 
     ogs_list_t      enb_ue_list;
@@ -385,6 +448,51 @@ struct sgw_ue_s {
     mme_ue_t        *mme_ue;
 };
 
+/*
+ * Subscription data received from the HSS and the unused authentication
+ * vectors. These are read when the UE attaches or a PDN connection is set
+ * up, not on every S1AP/NAS message, so they are kept out of mme_ue_t and
+ * allocated from a separate pool. This keeps the per-message working set
+ * of mme_ue_t (state, identities, NAS security, timers) in fewer cache
+ * lines. The emergency number list and emergency bearer settings are
+ * configuration shared by all UEs and live in mme_context_t.
+ */
+typedef struct mme_ue_profile_s {
+    uint8_t         msisdn[OGS_MAX_MSISDN_LEN];
+    int             msisdn_len;
+    char            msisdn_bcd[OGS_MAX_MSISDN_BCD_LEN+1];
+
+    uint8_t         a_msisdn[OGS_MAX_MSISDN_LEN];
+    int             a_msisdn_len;
+    char            a_msisdn_bcd[OGS_MAX_MSISDN_BCD_LEN+1];
+
+    ogs_bitrate_t   ambr; /* UE-AMBR */
+    uint32_t        network_access_mode; /* Permitted EPS Attach Type */
+    uint8_t         charging_characteristics[OGS_CHRGCHARS_LEN]; /* Subscription Level Charging Characteristics */
+    bool            charging_characteristics_presence;
+
+    uint32_t        context_identifier; /* default APN */
+
+    int num_of_session;
+    ogs_session_t session[OGS_MAX_NUM_OF_SESS];
+
+    /*
+     * VLR (SGs) and HSS selected for this UE. Only used when building
+     * SGsAP/S6a messages and CS fallback IEs, not on every S1AP/NAS
+     * message. Not part of the subscription, so not cached with it.
+     */
+    mme_csmap_t     *csmap;
+    mme_hssmap_t    *hssmap;
+
+    /* Unused vectors of the last AIA, in the order the HSS sent them */
+    struct {
+        ogs_diam_e_utran_vector_t
+            vector[OGS_DIAM_S6A_MAX_NUM_OF_E_UTRAN_VECTOR-1];
+        int num;
+        ogs_time_t expires;
+    } auth_vectors;
+} mme_ue_profile_t;
+
 struct mme_ue_s {
     ogs_lnode_t     lnode;
     ogs_fsm_t       sm;     /* A state machine */
@@ -436,14 +544,6 @@ struct mme_ue_s {
     char            imeisv_bcd[OGS_MAX_IMEISV_BCD_LEN+1];
     ogs_nas_mobile_identity_imeisv_t nas_mobile_identity_imeisv;
 
-    uint8_t         msisdn[OGS_MAX_MSISDN_LEN];
-    int             msisdn_len;
-    char            msisdn_bcd[OGS_MAX_MSISDN_BCD_LEN+1];
-
-    uint8_t         a_msisdn[OGS_MAX_MSISDN_LEN];
-    int             a_msisdn_len;
-    char            a_msisdn_bcd[OGS_MAX_MSISDN_BCD_LEN+1];
-
     mme_p_tmsi_t    p_tmsi;
 
     struct {
@@ -475,6 +575,11 @@ struct mme_ue_s {
         (__mME)->mac_failed = 0; \
         (__mME)->nas_eps.ksi = 0; \
     } while(0)
+#define CLEAR_AUTH_VECTORS(__mME) \
+    do { \
+        ogs_assert((__mME)); \
+        (__mME)->profile->auth_vectors.num = 0; \
+    } while(0)
     int             security_context_available;
     int             mac_failed;
 
@@ -490,8 +595,7 @@ struct mme_ue_s {
     uint8_t         kasme[OGS_SHA256_DIGEST_SIZE];
     uint8_t         rand[OGS_RAND_LEN];
     uint8_t         autn[OGS_AUTN_LEN];
-    uint8_t         knas_int[OGS_SHA256_DIGEST_SIZE/2];
-    uint8_t         knas_enc[OGS_SHA256_DIGEST_SIZE/2];
+    ogs_nas_security_key_t nas_key; /* KNASint/KNASenc and AES schedules */
     uint32_t        dl_count;
     union {
         struct {
@@ -523,16 +627,8 @@ struct mme_ue_s {
      * #define NAS_SECURITY_ALGORITHMS_128_EIA3    3 */
     uint8_t         selected_int_algorithm;
 
-    /* HSS Info */
-    ogs_bitrate_t   ambr; /* UE-AMBR */
-    uint32_t        network_access_mode; /* Permitted EPS Attach Type */
-    uint8_t         charging_characteristics[OGS_CHRGCHARS_LEN]; /* Subscription Level Charging Characteristics */
-    bool            charging_characteristics_presence;
-
-    uint32_t        context_identifier; /* default APN */
-
-    int num_of_session;
-    ogs_session_t session[OGS_MAX_NUM_OF_SESS];
+    /* HSS Info, see mme_ue_profile_t */
+    mme_ue_profile_t *profile;
 
     /* ESM Info */
     ogs_list_t      sess_list;
@@ -614,6 +710,7 @@ struct mme_ue_s {
     do { \
         ogs_timer_stop((__mME_UE_TIMER).timer); \
         if ((__mME_UE_TIMER).pkbuf) { \
+            mme_retx_release((__mME_UE_TIMER).pkbuf); \
             ogs_pkbuf_free((__mME_UE_TIMER).pkbuf); \
             (__mME_UE_TIMER).pkbuf = NULL; \
         } \
@@ -682,9 +779,6 @@ struct mme_ue_s {
     } gtp_counter[MAX_NUM_OF_GTP_COUNTER];
 
     ogs_list_t      bearer_to_modify_list;
-
-    mme_csmap_t     *csmap;
-    mme_hssmap_t    *hssmap;
 };
 
 #define SESSION_CONTEXT_IS_AVAILABLE(__mME) \
@@ -813,6 +907,7 @@ typedef struct mme_bearer_s {
         ogs_timer_stop((__bEARER_TIMER).timer); \
         if ((__bEARER_TIMER).pkbuf) \
         { \
+            mme_retx_release((__bEARER_TIMER).pkbuf); \
             ogs_pkbuf_free((__bEARER_TIMER).pkbuf); \
             (__bEARER_TIMER).pkbuf = NULL; \
         } \
@@ -886,6 +981,8 @@ int mme_enb_remove_all(void);
 mme_enb_t *mme_enb_find_by_addr(ogs_sockaddr_t *addr);
 mme_enb_t *mme_enb_find_by_enb_id(uint32_t enb_id);
 int mme_enb_set_enb_id(mme_enb_t *enb, uint32_t enb_id);
+void mme_enb_update_tai_index(mme_enb_t *enb);
+mme_enb_tai_t *mme_enb_tai_first(ogs_eps_tai_t *tai);
 int mme_enb_sock_type(ogs_sock_t *sock);
 mme_enb_t *mme_enb_cycle(mme_enb_t *enb);
 
@@ -943,6 +1040,16 @@ bool mme_sess_have_session_release_pending(mme_sess_t *sess);
 
 int mme_ue_xact_count(mme_ue_t *mme_ue, uint8_t org);
 
+/*
+ * Accounting of the messages kept in the t3413/t3422/t3450/t3460/t3470
+ * and t3489 slots for retransmission. mme_retx_hold() is called once a
+ * slot is filled, mme_retx_release() once it is emptied, either by the
+ * CLEAR_*_TIMER() macros or by handing the buffer over to the send path.
+ */
+void mme_retx_hold(mme_ue_t *mme_ue, ogs_pkbuf_t *pkbuf);
+void mme_retx_release(ogs_pkbuf_t *pkbuf);
+size_t mme_ue_retx_size(mme_ue_t *mme_ue);
+
 bool imsi_is_roaming(ogs_nas_mobile_identity_imsi_t *nas_imsi);
 
 /*
@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <resolv.h>
+
+#include "mme-dns.h"
+#include "mme-event.h"
+#include "mme-gtp-path.h"
+#include "nas-path.h"
+
+struct mme_dns_query_s {
+    ogs_lnode_t lnode;
+
+    /* Owned by the MME thread */
+    mme_sess_t *sess;
+    mme_ue_t *mme_ue;
+    int create_action;
+    ogs_timer_t *t_deadline;
+    bool expired;           /* Went on without the answer */
+
+    /* Filled in on the MME thread, resolved on a resolver thread */
+    bool sgw_dns;
+    ResolverContext sgw_context;
+    bool sgw_resolved;
+    char sgw_ipv4[INET_ADDRSTRLEN];
+
+    bool pgw_dns;
+    ResolverContext pgw_context;
+    char pgw_retry_mnc[DNS_RESOLVERS_MAX_MNC_STR];
+    bool pgw_resolved;
+    char pgw_ipv4[INET_ADDRSTRLEN];
+};
+
+static struct {
+    bool opened;
+
+    ogs_queue_t *request_queue;
+    ogs_thread_t *thread[MAX_NUM_OF_DNS_THREAD];
+    int num_of_thread;
+
+    ogs_list_t query_list;  /* Until the resolver thread is done with it */
+} self;
+
+static void dns_thread_main(void *data);
+static void dns_deadline_cb(void *data);
+static void dns_query_complete(mme_dns_query_t *query);
+static void dns_query_free(mme_dns_query_t *query);
+
+int mme_dns_open(void)
+{
+    int i;
+
+    if (!mme_self()->dns_async.enabled)
+        return OGS_OK;
+
+    ogs_assert(mme_self()->dns_async.num_of_thread > 0 &&
+            mme_self()->dns_async.num_of_thread <= MAX_NUM_OF_DNS_THREAD);
+    ogs_assert(mme_self()->dns_async.max_inflight > 0);
+
+    ogs_list_init(&self.query_list);
+
+    self.request_queue = ogs_queue_create(mme_self()->dns_async.max_inflight);
+    ogs_assert(self.request_queue);
+
+    for (i = 0; i < mme_self()->dns_async.num_of_thread; i++) {
+        self.thread[i] = ogs_thread_create(dns_thread_main, NULL);
+        if (!self.thread[i]) {
+            ogs_error("Failed to start DNS resolver thread");
+            break;
+        }
+        self.num_of_thread++;
+    }
+
+    if (0 == self.num_of_thread) {
+        ogs_queue_destroy(self.request_queue);
+        self.request_queue = NULL;
+        return OGS_ERROR;
+    }
+
+    self.opened = true;
+    ogs_info("DNS resolution runs on %d thread(s)", self.num_of_thread);
+
+    return OGS_OK;
+}
+
+void mme_dns_close(void)
+{
+    mme_dns_query_t *query = NULL, *next_query = NULL;
+    int i;
+
+    if (!self.opened)
+        return;
+
+    /* Idle threads return at once, busy ones once
+     * their lookup is done, see dns_thread_main() */
+    ogs_queue_term(self.request_queue);
+    for (i = 0; i < self.num_of_thread; i++)
+        ogs_thread_destroy(self.thread[i]);
+
+    ogs_list_for_each_safe(&self.query_list, next_query, query)
+        dns_query_free(query);
+
+    ogs_queue_destroy(self.request_queue);
+
+    memset(&self, 0, sizeof(self));
+}
+
+bool mme_dns_async_enabled(void)
+{
+    return self.opened;
+}
+
+void mme_dns_sgw_context(mme_ue_t *mme_ue, ResolverContext *context)
+{
+    uint16_t tac;
+
+    ogs_assert(mme_ue);
+    ogs_assert(context);
+
+    snprintf(context->mnc, DNS_RESOLVERS_MAX_MNC_STR, "%03u", ogs_plmn_id_mnc(&mme_ue->tai.plmn_id));
+    snprintf(context->mcc, DNS_RESOLVERS_MAX_MCC_STR, "%03u", ogs_plmn_id_mcc(&mme_ue->tai.plmn_id));
+
+    strncpy(context->domain_suffix, mme_self()->dns_base_domain, DNS_RESOLVERS_MAX_DOMAIN_SUFFIX_STR - 1);
+    context->domain_suffix[DNS_RESOLVERS_MAX_DOMAIN_SUFFIX_STR - 1] = '\0';
+
+    /* Split TAC into high and low bytes */
+    tac = mme_ue->tai.tac;
+    context->tac_low  = tac & 0xFF;
+    context->tac_high = (tac >> 8) & 0xFF;
+
+    strncpy(context->target, "sgw", DNS_RESOLVERS_MAX_TARGET_STR);
+    context->target[DNS_RESOLVERS_MAX_TARGET_STR - 1] = '\0';
+
+    /* we select the S11 interface i think this is correct */
+    strncpy(context->interface, "s11", DNS_RESOLVERS_MAX_INTERFACE_STR);
+    context->interface[DNS_RESOLVERS_MAX_INTERFACE_STR - 1] = '\0';
+
+    /* set the protocol type to NULL for the SGW selection */
+    context->protocol[0] = '\0';
+}
+
+void mme_dns_pgw_context(mme_sess_t *sess,
+        ResolverContext *context, char *retry_mnc)
+{
+    enum { MAX_MCC_MNC_STR = 6 };
+    mme_ue_t *mme_ue = NULL;
+    char mme_mnc[MAX_MCC_MNC_STR] = "";
+    char imsi_mcc[MAX_MCC_MNC_STR] = "000";
+    char imsi_mnc_2[MAX_MCC_MNC_STR] = "000";
+    char imsi_mnc_3[MAX_MCC_MNC_STR] = "000";
+
+    ogs_assert(sess);
+    ogs_assert(sess->session);
+    mme_ue = sess->mme_ue;
+    ogs_assert(mme_ue);
+    ogs_assert(context);
+    ogs_assert(retry_mnc);
+
+    /* Load MNC from config and format it */
+    snprintf(mme_mnc, MAX_MCC_MNC_STR, "%u", ogs_plmn_id_mnc(&mme_ue->tai.plmn_id));
+    strncpy(context->apn, sess->session->name, DNS_RESOLVERS_MAX_APN_STR - 1);
+    context->apn[DNS_RESOLVERS_MAX_APN_STR - 1] = '\0';
+    strncpy(context->target, "pgw", DNS_RESOLVERS_MAX_TARGET_STR);
+    strncpy(context->protocol, "gtp", DNS_RESOLVERS_MAX_PROTOCOL_STR);
+    /* Load our domain suffix from the config */
+    strncpy(context->domain_suffix, mme_self()->dns_base_domain, DNS_RESOLVERS_MAX_DOMAIN_SUFFIX_STR);
+
+    memcpy(imsi_mcc, &mme_ue->imsi_bcd[0], 3);
+    memcpy(&imsi_mnc_2[1], &mme_ue->imsi_bcd[3], 2);
+    memcpy(imsi_mnc_3, &mme_ue->imsi_bcd[3], 3);
+
+    strncpy(context->mcc, imsi_mcc, DNS_RESOLVERS_MAX_MCC_STR);
+
+    retry_mnc[0] = '\0';
+    if (imsi_is_roaming(&mme_ue->nas_mobile_identity_imsi)) {
+        /* This is roaming, check roaming with a 3 digit MNC
+         * and if that fails with a 2 digit MNC */
+        strncpy(context->interface, "s8", DNS_RESOLVERS_MAX_INTERFACE_STR);
+        strcpy(context->mnc, imsi_mnc_3);
+        strcpy(retry_mnc, imsi_mnc_2);
+    } else {
+        /* Might be home, check home */
+        strncpy(context->interface, "s5", DNS_RESOLVERS_MAX_INTERFACE_STR);
+        strncpy(context->mnc, mme_mnc, DNS_RESOLVERS_MAX_MNC_STR);
+    }
+}
+
+bool mme_dns_resolve_sgw(ResolverContext *context, char *buf, size_t buf_sz)
+{
+    ogs_assert(context);
+    ogs_assert(buf);
+
+    if (true == resolve_sgw_naptr(context, buf, buf_sz))
+        return true;
+
+    ogs_error("Failed to resolve dns and update SGW IP in CSR, falling back to default selection method");
+    return false;
+}
+
+bool mme_dns_resolve_pgw(ResolverContext *context,
+        const char *retry_mnc, char *buf, size_t buf_sz)
+{
+    ogs_assert(context);
+    ogs_assert(retry_mnc);
+    ogs_assert(buf);
+
+    ogs_debug("Attempting NAPTR resolv for [MCC:%s] [MNC:%s]\n", context->mcc, context->mnc);
+    if (true == resolve_naptr(context, buf, buf_sz))
+        return true;
+
+    if (retry_mnc[0]) {
+        /* We failed to resolve with assumption of a 3 digit MNC,
+         * try the 2 digit MNC */
+        strcpy(context->mnc, retry_mnc);
+
+        ogs_debug("Attempting NAPTR resolv for roming [MCC:%s] [MNC:%s]\n", context->mcc, context->mnc);
+        return resolve_naptr(context, buf, buf_sz);
+    }
+
+    return false;
+}
+
+int mme_dns_send_create_session_query(mme_sess_t *sess,
+        int create_action, bool sgw_dns, bool pgw_dns)
+{
+    mme_dns_query_t *query = NULL;
+    int rv;
+
+    ogs_assert(sess);
+    ogs_assert(sess->mme_ue);
+    ogs_assert(self.opened);
+
+    if (ogs_list_count(&self.query_list) >=
+            mme_self()->dns_async.max_inflight) {
+        /* Would only queue up behind lookups already
+         * late, go on as if the lookup had failed */
+        ogs_warn("Too many DNS lookups in flight [%d]",
+                mme_self()->dns_async.max_inflight);
+        return mme_gtp_resume_create_session_request(sess, create_action,
+                sgw_dns, NULL, pgw_dns, NULL);
+    }
+
+    query = ogs_calloc(1, sizeof(*query));
+    ogs_assert(query);
+
+    query->sess = sess;
+    query->mme_ue = sess->mme_ue;
+    query->create_action = create_action;
+
+    query->sgw_dns = sgw_dns;
+    if (sgw_dns)
+        mme_dns_sgw_context(sess->mme_ue, &query->sgw_context);
+    query->pgw_dns = pgw_dns;
+    if (pgw_dns)
+        mme_dns_pgw_context(sess, &query->pgw_context, query->pgw_retry_mnc);
+
+    query->t_deadline = ogs_timer_add(
+            ogs_app()->timer_mgr, dns_deadline_cb, query);
+    ogs_assert(query->t_deadline);
+
+    rv = ogs_queue_trypush(self.request_queue, query);
+    if (rv != OGS_OK) {
+        ogs_error("ogs_queue_trypush() failed:%d", (int)rv);
+        dns_query_free(query);
+        return mme_gtp_resume_create_session_request(sess, create_action,
+                sgw_dns, NULL, pgw_dns, NULL);
+    }
+
+    ogs_list_add(&self.query_list, query);
+    ogs_timer_start(query->t_deadline, mme_self()->dns_async.deadline);
+
+    ogs_debug("Create Session Request parked for DNS [SGW:%d] [PGW:%d]",
+            sgw_dns, pgw_dns);
+
+    return OGS_OK;
+}
+
+void mme_dns_handle_resolved(mme_dns_query_t *query)
+{
+    ogs_assert(query);
+
+    if (!query->expired) {
+        ogs_timer_stop(query->t_deadline);
+        dns_query_complete(query);
+    }
+
+    ogs_list_remove(&self.query_list, query);
+    dns_query_free(query);
+}
+
+static void dns_deadline_cb(void *data)
+{
+    mme_dns_query_t *query = data;
+
+    ogs_assert(query);
+
+    /* The resolver thread still owns the query,
+     * it is freed once it comes back */
+    ogs_warn("No DNS answer within %lldms, going on without it",
+            (long long)ogs_time_to_msec(mme_self()->dns_async.deadline));
+
+    query->expired = true;
+    dns_query_complete(query);
+}
+
+static void dns_query_complete(mme_dns_query_t *query)
+{
+    mme_sess_t *sess = NULL;
+    int rv, r;
+
+    ogs_assert(query);
+
+    sess = mme_sess_cycle(query->sess);
+    if (!sess || sess->mme_ue != mme_ue_cycle(query->mme_ue)) {
+        ogs_warn("Session released while resolving DNS");
+        return;
+    }
+
+    /* Once expired the results belong to the resolver thread */
+    rv = mme_gtp_resume_create_session_request(sess, query->create_action,
+            query->sgw_dns,
+            (!query->expired && query->sgw_resolved) ? query->sgw_ipv4 : NULL,
+            query->pgw_dns,
+            (!query->expired && query->pgw_resolved) ? query->pgw_ipv4 : NULL);
+    if (rv != OGS_OK) {
+        ogs_error("Failed to send create session request");
+        r = nas_eps_send_pdn_connectivity_reject(
+                sess, OGS_NAS_ESM_CAUSE_NETWORK_FAILURE,
+                query->create_action);
+        ogs_expect(r == OGS_OK);
+    }
+}
+
+static void dns_query_free(mme_dns_query_t *query)
+{
+    ogs_assert(query);
+
+    if (query->t_deadline)
+        ogs_timer_delete(query->t_deadline);
+    ogs_free(query);
+}
+
+static void dns_thread_main(void *data)
+{
+    mme_dns_query_t *query = NULL;
+    mme_event_t *e = NULL;
+    int rv;
+
+    /* Each thread has its own resolver state, bound it so a dead
+     * name server does not hold the thread much past the deadline */
+    res_init();
+    _res.retrans = ogs_max(1,
+            ogs_time_sec(mme_self()->dns_async.deadline + OGS_USEC_PER_SEC - 1));
+    _res.retry = 1;
+
+    for ( ;; ) {
+        rv = ogs_queue_pop(self.request_queue, (void **)&query);
+        if (rv == OGS_DONE)
+            break;
+        if (rv == OGS_RETRY)
+            continue;
+        ogs_assert(rv == OGS_OK);
+        ogs_assert(query);
+
+        /* Only the contexts and results are touched here */
+        if (query->sgw_dns)
+            query->sgw_resolved = mme_dns_resolve_sgw(&query->sgw_context,
+                    query->sgw_ipv4, sizeof(query->sgw_ipv4));
+        if (query->pgw_dns)
+            query->pgw_resolved = mme_dns_resolve_pgw(&query->pgw_context,
+                    query->pgw_retry_mnc,
+                    query->pgw_ipv4, sizeof(query->pgw_ipv4));
+
+        e = mme_event_new(MME_EVENT_DNS_RESOLVED);
+        ogs_assert(e);
+        e->dns_query = query;
+
+        rv = ogs_queue_push(ogs_app()->queue, e);
+        if (rv != OGS_OK) {
+            /* Left in query_list, freed by mme_dns_close() */
+            ogs_error("ogs_queue_push() failed:%d", (int)rv);
+            mme_event_free(e);
+        } else {
+            ogs_pollset_notify(ogs_app()->pollset);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MME_DNS_H
+#define MME_DNS_H
+
+#include "mme-context.h"
+#include "mme-event.h"
+#include "dns_resolvers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * SGW/PGW selection through DNS (dns_target_sgw, dns_target_pgw).
+ *
+ * res_query() blocks, so with dns.async the lookups run on a pool of
+ * resolver threads instead of the MME thread. The Create Session
+ * Request is parked until the answer comes back as an
+ * MME_EVENT_DNS_RESOLVED event, or until the deadline passes, in
+ * which case it goes on as if the lookup had failed.
+ */
+
+int mme_dns_open(void);
+void mme_dns_close(void);
+
+bool mme_dns_async_enabled(void);
+
+/* Blocking resolution, used when dns.async is off */
+void mme_dns_sgw_context(mme_ue_t *mme_ue, ResolverContext *context);
+void mme_dns_pgw_context(mme_sess_t *sess,
+        ResolverContext *context, char *retry_mnc);
+bool mme_dns_resolve_sgw(ResolverContext *context, char *buf, size_t buf_sz);
+bool mme_dns_resolve_pgw(ResolverContext *context,
+        const char *retry_mnc, char *buf, size_t buf_sz);
+
+/* Parks the Create Session Request of sess until the SGW and/or
+ * PGW lookups are done, then mme_gtp_resume_create_session_request()
+ * sends it */
+int mme_dns_send_create_session_query(mme_sess_t *sess,
+        int create_action, bool sgw_dns, bool pgw_dns);
+void mme_dns_handle_resolved(mme_dns_query_t *query);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MME_DNS_H */
@@ -70,6 +70,10 @@ const char *mme_event_get_name(mme_event_t *e)
         return "MME_EVENT_S1AP_LO_SCTP_COMM_UP";
     case MME_EVENT_S1AP_LO_CONNREFUSED:
         return "MME_EVENT_S1AP_LO_CONNREFUSED";
+    case MME_EVENT_S1AP_DUP_CHECKED:
+        return "MME_EVENT_S1AP_DUP_CHECKED";
+    case MME_EVENT_S1AP_DECODED:
+        return "MME_EVENT_S1AP_DECODED";
 
     case MME_EVENT_EMM_MESSAGE:
         return "MME_EVENT_EMM_MESSAGE";
@@ -100,6 +104,9 @@ const char *mme_event_get_name(mme_event_t *e)
         return "MME_EVENT_SGSAP_LO_CONNREFUSED";
     case MME_EVENT_GN_MESSAGE:
         return "MME_EVENT_GN_MESSAGE";
+
+    case MME_EVENT_DNS_RESOLVED:
+        return "MME_EVENT_DNS_RESOLVED";
     default:
        break;
     }
@@ -140,3 +147,38 @@ void mme_sctp_event_push(mme_event_e id,
     }
 #endif
 }
+
+/*
+ * Same as mme_sctp_event_push(), but for a message received on a socket
+ * that already belongs to a known eNB. The eNB rides in the event, so
+ * neither a copy of the peer address nor an address lookup is needed.
+ */
+void mme_sctp_message_push(mme_event_e id,
+        void *sock, mme_enb_t *enb, ogs_pkbuf_t *pkbuf)
+{
+    mme_event_t *e = NULL;
+    int rv;
+
+    ogs_assert(id);
+    ogs_assert(sock);
+    ogs_assert(enb);
+    ogs_assert(pkbuf);
+
+    e = mme_event_new(id);
+    ogs_assert(e);
+    e->sock = sock;
+    e->enb = enb;
+    e->pkbuf = pkbuf;
+
+    rv = ogs_queue_push(ogs_app()->queue, e);
+    if (rv != OGS_OK) {
+        ogs_error("ogs_queue_push() failed:%d", (int)rv);
+        ogs_pkbuf_free(e->pkbuf);
+        mme_event_free(e);
+    }
+#if HAVE_USRSCTP
+    else {
+        ogs_pollset_notify(ogs_app()->pollset);
+    }
+#endif
+}
@@ -35,6 +35,8 @@ typedef enum {
     MME_EVENT_S1AP_LO_ACCEPT,
     MME_EVENT_S1AP_LO_SCTP_COMM_UP,
     MME_EVENT_S1AP_LO_CONNREFUSED,
+    MME_EVENT_S1AP_DUP_CHECKED,
+    MME_EVENT_S1AP_DECODED,
 
     MME_EVENT_SBCAP_MESSAGE,
     MME_EVENT_SBCAP_LO_ACCEPT,
@@ -58,6 +60,8 @@ typedef enum {
     MME_EVENT_SGSAP_LO_CONNREFUSED,
 
     MME_EVENT_GN_MESSAGE,
+
+    MME_EVENT_DNS_RESOLVED,
     
 
     MAX_NUM_OF_MME_EVENT,
@@ -78,6 +82,7 @@ typedef struct mme_ue_s mme_ue_t;
 typedef struct mme_sess_s mme_sess_t;
 typedef struct mme_bearer_s mme_bearer_t;
 typedef struct ogs_gtp_node_s ogs_gtp_node_t;
+typedef struct mme_dns_query_s mme_dns_query_t;
 
 typedef struct mme_event_s {
     int id;
@@ -93,6 +98,7 @@ typedef struct mme_event_s {
 
     S1AP_ProcedureCode_t s1ap_code;
     ogs_s1ap_message_t *s1ap_message;
+    ogs_arena_t *s1ap_arena;    /* Holds s1ap_message if not NULL */
 
     ogs_gtp_node_t *gnode;
 
@@ -112,6 +118,8 @@ typedef struct mme_event_s {
     mme_sess_t *sess;
     mme_bearer_t *bearer;
 
+    mme_dns_query_t *dns_query;
+
     ogs_timer_t *timer;
 } mme_event_t;
 
@@ -129,6 +137,8 @@ const char *mme_event_get_name(mme_event_t *e);
 void mme_sctp_event_push(mme_event_e id,
         void *sock, ogs_sockaddr_t *addr, ogs_pkbuf_t *pkbuf,
         uint16_t max_num_of_istreams, uint16_t max_num_of_ostreams);
+void mme_sctp_message_push(mme_event_e id,
+        void *sock, mme_enb_t *enb, ogs_pkbuf_t *pkbuf);
 
 #ifdef __cplusplus
 }
@@ -19,6 +19,7 @@
 
 #include "mme-event.h"
 #include "mme-fd-path.h"
+#include "mme-subscription-cache.h"
 
 /* handler for Cancel-Location-Request cb */
 static struct disp_hdl *hdl_s6a_clr = NULL;
@@ -38,8 +39,12 @@ static int mme_s6a_subscription_data_from_avp(struct avp *avp,
 struct sess_state {
     mme_ue_t *mme_ue;
     struct timespec ts; /* Time of sending the message */
+    bool skip_subscriber_data; /* ULR asked the HSS to skip the profile */
 };
 
+static int mme_s6a_e_utran_vector_from_avp(struct avp *avp,
+        ogs_diam_e_utran_vector_t *e_utran_vector);
+static int mme_s6a_aia_from_auth_vectors(mme_ue_t *mme_ue);
 static void mme_s6a_aia_cb(void *data, struct msg **msg);
 static void mme_s6a_ula_cb(void *data, struct msg **msg);
 static void mme_s13_eca_cb(void *data, struct msg **msg);
@@ -61,9 +66,9 @@ static void mme_add_hss_destination(mme_ue_t *mme_ue, struct msg *req)
     ogs_assert(mme_ue);
     ogs_assert(req);
 
-    if (mme_ue->hssmap) {
-        realm = mme_ue->hssmap->realm;
-        host = mme_ue->hssmap->host;
+    if (mme_ue->profile->hssmap) {
+        realm = mme_ue->profile->hssmap->realm;
+        host = mme_ue->profile->hssmap->host;
     }
 
     if (realm == NULL)
@@ -122,11 +127,11 @@ static int mme_s6a_subscription_data_from_avp(struct avp *avp,
         ret = fd_msg_avp_hdr(avpch1, &hdr);
         ogs_assert(ret == 0);
         if (hdr->avp_value->os.data && hdr->avp_value->os.len) {
-            mme_ue->msisdn_len = hdr->avp_value->os.len;
-            memcpy(mme_ue->msisdn, hdr->avp_value->os.data,
-                    ogs_min(mme_ue->msisdn_len, OGS_MAX_MSISDN_LEN));
-            ogs_buffer_to_bcd(mme_ue->msisdn,
-                    mme_ue->msisdn_len, mme_ue->msisdn_bcd);
+            mme_ue->profile->msisdn_len = hdr->avp_value->os.len;
+            memcpy(mme_ue->profile->msisdn, hdr->avp_value->os.data,
+                    ogs_min(mme_ue->profile->msisdn_len, OGS_MAX_MSISDN_LEN));
+            ogs_buffer_to_bcd(mme_ue->profile->msisdn,
+                    mme_ue->profile->msisdn_len, mme_ue->profile->msisdn_bcd);
             *subdatamask = (*subdatamask | OGS_DIAM_S6A_SUBDATA_MSISDN);
         }
     }
@@ -145,11 +150,11 @@ static int mme_s6a_subscription_data_from_avp(struct avp *avp,
         ret = fd_msg_avp_hdr(avpch1, &hdr);
         ogs_assert(ret == 0);
         if (hdr->avp_value->os.data && hdr->avp_value->os.len) {
-            mme_ue->a_msisdn_len = hdr->avp_value->os.len;
-            memcpy(mme_ue->a_msisdn, hdr->avp_value->os.data,
-                    ogs_min(mme_ue->a_msisdn_len, OGS_MAX_MSISDN_LEN));
-            ogs_buffer_to_bcd(mme_ue->a_msisdn,
-                    mme_ue->a_msisdn_len, mme_ue->a_msisdn_bcd);
+            mme_ue->profile->a_msisdn_len = hdr->avp_value->os.len;
+            memcpy(mme_ue->profile->a_msisdn, hdr->avp_value->os.data,
+                    ogs_min(mme_ue->profile->a_msisdn_len, OGS_MAX_MSISDN_LEN));
+            ogs_buffer_to_bcd(mme_ue->profile->a_msisdn,
+                    mme_ue->profile->a_msisdn_len, mme_ue->profile->a_msisdn_bcd);
             *subdatamask = (*subdatamask | OGS_DIAM_S6A_SUBDATA_A_MSISDN);
         }
     }
@@ -165,7 +170,7 @@ static int mme_s6a_subscription_data_from_avp(struct avp *avp,
     if (avpch1) {
         ret = fd_msg_avp_hdr(avpch1, &hdr);
         ogs_assert(ret == 0);
-        mme_ue->network_access_mode = hdr->avp_value->i32;
+        mme_ue->profile->network_access_mode = hdr->avp_value->i32;
         *subdatamask = (*subdatamask | OGS_DIAM_S6A_SUBDATA_NAM);
     }
 
@@ -185,8 +190,8 @@ static int mme_s6a_subscription_data_from_avp(struct avp *avp,
         ogs_ascii_to_hex(
             (char*)hdr->avp_value->os.data, (int)hdr->avp_value->os.len,
             buf, sizeof(buf));
-        memcpy(mme_ue->charging_characteristics, buf, OGS_CHRGCHARS_LEN);
-        mme_ue->charging_characteristics_presence = true;
+        memcpy(mme_ue->profile->charging_characteristics, buf, OGS_CHRGCHARS_LEN);
+        mme_ue->profile->charging_characteristics_presence = true;
         *subdatamask = (*subdatamask | OGS_DIAM_S6A_SUBDATA_CC);
     }
 
@@ -709,6 +714,138 @@ static int mme_s6a_subscription_data_from_avp(struct avp *avp,
     return error;
 }
 
+static int mme_s6a_e_utran_vector_from_avp(struct avp *avp,
+        ogs_diam_e_utran_vector_t *e_utran_vector)
+{
+    int ret;
+    struct avp *avp_xres, *avp_kasme, *avp_rand, *avp_autn;
+    struct avp_hdr *hdr;
+
+    ogs_assert(avp);
+    ogs_assert(e_utran_vector);
+
+    ret = fd_avp_search_avp(avp, ogs_diam_s6a_xres, &avp_xres);
+    ogs_assert(ret == 0);
+    if (!avp_xres) {
+        ogs_error("no_XRES");
+        return OGS_ERROR;
+    }
+    ret = fd_msg_avp_hdr(avp_xres, &hdr);
+    ogs_assert(ret == 0);
+    if (hdr->avp_value->os.len > OGS_MAX_RES_LEN) {
+        ogs_error("Invalid XRES length [%d]", (int)hdr->avp_value->os.len);
+        return OGS_ERROR;
+    }
+    memcpy(e_utran_vector->xres,
+            hdr->avp_value->os.data, hdr->avp_value->os.len);
+    e_utran_vector->xres_len = hdr->avp_value->os.len;
+
+    ret = fd_avp_search_avp(avp, ogs_diam_s6a_kasme, &avp_kasme);
+    ogs_assert(ret == 0);
+    if (!avp_kasme) {
+        ogs_error("no_KASME");
+        return OGS_ERROR;
+    }
+    ret = fd_msg_avp_hdr(avp_kasme, &hdr);
+    ogs_assert(ret == 0);
+    if (hdr->avp_value->os.len != OGS_SHA256_DIGEST_SIZE) {
+        ogs_error("Invalid KASME length [%d]", (int)hdr->avp_value->os.len);
+        return OGS_ERROR;
+    }
+    memcpy(e_utran_vector->kasme,
+            hdr->avp_value->os.data, hdr->avp_value->os.len);
+
+    ret = fd_avp_search_avp(avp, ogs_diam_s6a_rand, &avp_rand);
+    ogs_assert(ret == 0);
+    if (!avp_rand) {
+        ogs_error("no_RAND");
+        return OGS_ERROR;
+    }
+    ret = fd_msg_avp_hdr(avp_rand, &hdr);
+    ogs_assert(ret == 0);
+    if (hdr->avp_value->os.len != OGS_RAND_LEN) {
+        ogs_error("Invalid RAND length [%d]", (int)hdr->avp_value->os.len);
+        return OGS_ERROR;
+    }
+    memcpy(e_utran_vector->rand,
+            hdr->avp_value->os.data, hdr->avp_value->os.len);
+
+    ret = fd_avp_search_avp(avp, ogs_diam_s6a_autn, &avp_autn);
+    ogs_assert(ret == 0);
+    if (!avp_autn) {
+        ogs_error("no_AUTN");
+        return OGS_ERROR;
+    }
+    ret = fd_msg_avp_hdr(avp_autn, &hdr);
+    ogs_assert(ret == 0);
+    if (hdr->avp_value->os.len != OGS_AUTN_LEN) {
+        ogs_error("Invalid AUTN length [%d]", (int)hdr->avp_value->os.len);
+        return OGS_ERROR;
+    }
+    memcpy(e_utran_vector->autn,
+            hdr->avp_value->os.data, hdr->avp_value->os.len);
+
+    return OGS_OK;
+}
+
+/*
+ * Authenticates the UE with the oldest unused vector of the last AIA.
+ * The answer goes through the event queue like one from the HSS.
+ */
+static int mme_s6a_aia_from_auth_vectors(mme_ue_t *mme_ue)
+{
+    int rv;
+    mme_event_t *e = NULL;
+    ogs_diam_s6a_message_t *s6a_message = NULL;
+    ogs_diam_s6a_aia_message_t *aia_message = NULL;
+
+    ogs_assert(mme_ue);
+
+    if (mme_ue->profile->auth_vectors.num == 0)
+        return OGS_ERROR;
+
+    if (ogs_get_monotonic_time() >= mme_ue->profile->auth_vectors.expires) {
+        ogs_debug("[%s] Authentication vectors expired", mme_ue->imsi_bcd);
+        CLEAR_AUTH_VECTORS(mme_ue);
+        return OGS_ERROR;
+    }
+
+    s6a_message = ogs_calloc(1, sizeof(ogs_diam_s6a_message_t));
+    ogs_assert(s6a_message);
+    s6a_message->cmd_code = OGS_DIAM_S6A_CMD_CODE_AUTHENTICATION_INFORMATION;
+    s6a_message->result_code = ER_DIAMETER_SUCCESS;
+    aia_message = &s6a_message->aia_message;
+
+    aia_message->num_of_e_utran_vector = 1;
+    memcpy(&aia_message->e_utran_vector[0],
+            &mme_ue->profile->auth_vectors.vector[0],
+            sizeof(ogs_diam_e_utran_vector_t));
+
+    mme_ue->profile->auth_vectors.num--;
+    memmove(&mme_ue->profile->auth_vectors.vector[0],
+            &mme_ue->profile->auth_vectors.vector[1],
+            mme_ue->profile->auth_vectors.num *
+            sizeof(ogs_diam_e_utran_vector_t));
+
+    ogs_debug("[%s] Stored authentication vector [%d left]",
+            mme_ue->imsi_bcd, mme_ue->profile->auth_vectors.num);
+
+    e = mme_event_new(MME_EVENT_S6A_MESSAGE);
+    ogs_assert(e);
+    e->mme_ue = mme_ue;
+    e->s6a_message = s6a_message;
+    rv = ogs_queue_push(ogs_app()->queue, e);
+    if (rv != OGS_OK) {
+        ogs_error("ogs_queue_push() failed:%d", (int)rv);
+        ogs_free(s6a_message);
+        mme_event_free(e);
+        return OGS_ERROR;
+    }
+    ogs_pollset_notify(ogs_app()->pollset);
+
+    return OGS_OK;
+}
+
 /* MME Sends Authentication Information Request to HSS */
 void mme_s6a_send_air(mme_ue_t *mme_ue,
     ogs_nas_authentication_failure_parameter_t
@@ -734,6 +871,15 @@ void mme_s6a_send_air(mme_ue_t *mme_ue,
     /* Clear Security Context */
     CLEAR_SECURITY_CONTEXT(mme_ue);
 
+    /* Vectors issued before a re-synchronisation carry a stale SQN */
+    if (authentication_failure_parameter)
+        CLEAR_AUTH_VECTORS(mme_ue);
+    else if (mme_s6a_aia_from_auth_vectors(mme_ue) == OGS_OK)
+        return;
+
+    /* The new AIA replaces any vector left */
+    CLEAR_AUTH_VECTORS(mme_ue);
+
     /* Create the random value to store with the session */
     sess_data = ogs_calloc(1, sizeof (*sess_data));
     ogs_assert(sess_data);
@@ -794,7 +940,7 @@ void mme_s6a_send_air(mme_ue_t *mme_ue,
     ogs_assert(ret == 0);
     ret = fd_msg_avp_new(ogs_diam_s6a_number_of_requested_vectors, 0, &avpch);
     ogs_assert(ret == 0);
-    val.u32 = 1;
+    val.u32 = mme_self()->auth_vectors.num;
     ret = fd_msg_avp_setvalue (avpch, &val);
     ogs_assert(ret == 0);
     ret = fd_msg_avp_add (avp, MSG_BRW_LAST_CHILD, avpch);
@@ -879,7 +1025,7 @@ static void mme_s6a_aia_cb(void *data, struct msg **msg)
     struct timespec ts;
     struct session *session;
     struct avp *avp, *avpch;
-    struct avp *avp_e_utran_vector, *avp_xres, *avp_kasme, *avp_rand, *avp_autn;
+    struct avp *avp_e_utran_vector;
     struct avp_hdr *hdr;
     unsigned long dur;
     int error = 0;
@@ -930,8 +1076,6 @@ static void mme_s6a_aia_cb(void *data, struct msg **msg)
     s6a_message->cmd_code = OGS_DIAM_S6A_CMD_CODE_AUTHENTICATION_INFORMATION;
     aia_message = &s6a_message->aia_message;
     ogs_assert(aia_message);
-    e_utran_vector = &aia_message->e_utran_vector;
-    ogs_assert(e_utran_vector);
     
     /* Value of Result Code */
     ret = fd_msg_search_avp(*msg, ogs_diam_result_code, &avp);
@@ -1013,62 +1157,33 @@ static void mme_s6a_aia_cb(void *data, struct msg **msg)
         error++;
     }
 
-    ret = fd_avp_search_avp(
-            avp, ogs_diam_s6a_e_utran_vector, &avp_e_utran_vector);
-    ogs_assert(ret == 0);
     if (avp) {
-        ret = fd_msg_avp_hdr(avp_e_utran_vector, &hdr);
+        ret = fd_msg_browse(avp, MSG_BRW_FIRST_CHILD,
+                &avp_e_utran_vector, NULL);
         ogs_assert(ret == 0);
-    } else {
-        ogs_error("no_E-UTRAN-Vector-Info ");
-        error++;
-    }
-
-    ret = fd_avp_search_avp(avp_e_utran_vector, ogs_diam_s6a_xres, &avp_xres);
-    ogs_assert(ret == 0);
-    if (avp) {
-        ret = fd_msg_avp_hdr(avp_xres, &hdr);
-        ogs_assert(ret == 0);
-        memcpy(e_utran_vector->xres,
-                hdr->avp_value->os.data, hdr->avp_value->os.len);
-        e_utran_vector->xres_len = hdr->avp_value->os.len;
-    } else {
-        ogs_error("no_XRES");
-        error++;
-    }
-
-    ret = fd_avp_search_avp(avp_e_utran_vector, ogs_diam_s6a_kasme, &avp_kasme);
-    ogs_assert(ret == 0);
-    if (avp) {
-        ret = fd_msg_avp_hdr(avp_kasme, &hdr);
-        ogs_assert(ret == 0);
-        memcpy(e_utran_vector->kasme,
-                hdr->avp_value->os.data, hdr->avp_value->os.len);
-    } else {
-        ogs_error("no_KASME");
-        error++;
-    }
-
-
-    ret = fd_avp_search_avp(avp_e_utran_vector, ogs_diam_s6a_rand, &avp_rand);
-    if (avp) {
-        ret = fd_msg_avp_hdr(avp_rand, &hdr);
-        memcpy(e_utran_vector->rand,
-                hdr->avp_value->os.data, hdr->avp_value->os.len);
-    } else {
-        ogs_error("no_RAND");
-        error++;
+        while (avp_e_utran_vector) {
+            ret = fd_msg_avp_hdr(avp_e_utran_vector, &hdr);
+            ogs_assert(ret == 0);
+            if (hdr->avp_code == OGS_DIAM_S6A_AVP_CODE_E_UTRAN_VECTOR) {
+                if (aia_message->num_of_e_utran_vector <
+                        OGS_DIAM_S6A_MAX_NUM_OF_E_UTRAN_VECTOR) {
+                    e_utran_vector = &aia_message->e_utran_vector[
+                        aia_message->num_of_e_utran_vector];
+                    if (mme_s6a_e_utran_vector_from_avp(
+                                avp_e_utran_vector, e_utran_vector) == OGS_OK)
+                        aia_message->num_of_e_utran_vector++;
+                } else {
+                    ogs_warn("Ignore E-UTRAN-Vector beyond %d",
+                            OGS_DIAM_S6A_MAX_NUM_OF_E_UTRAN_VECTOR);
+                }
+            }
+            fd_msg_browse(avp_e_utran_vector, MSG_BRW_NEXT,
+                    &avp_e_utran_vector, NULL);
+        }
     }
 
-    ret = fd_avp_search_avp(avp_e_utran_vector, ogs_diam_s6a_autn, &avp_autn);
-    ogs_assert(ret == 0);
-    if (avp) {
-        ret = fd_msg_avp_hdr(avp_autn, &hdr);
-        ogs_assert(ret == 0);
-        memcpy(e_utran_vector->autn,
-                hdr->avp_value->os.data, hdr->avp_value->os.len);
-    } else {
-        ogs_error("no_AUTN");
+    if (!aia_message->num_of_e_utran_vector) {
+        ogs_error("no_E-UTRAN-Vector-Info ");
         error++;
     }
 
@@ -1155,6 +1270,14 @@ void mme_s6a_send_ulr(mme_ue_t *mme_ue)
     ogs_assert(sess_data);
     sess_data->mme_ue = mme_ue;
 
+    /*
+     * With the profile restored from the cache, the HSS may leave
+     * Subscription-Data out of the ULA. It still sends it if the
+     * subscription changed since this MME was last updated.
+     */
+    sess_data->skip_subscriber_data =
+        mme_subscription_cache_get(mme_ue->imsi_bcd, mme_ue->profile);
+
     /* Create the request */
     ret = fd_msg_new(ogs_diam_s6a_cmd_ulr, MSGFL_ALLOC_ETEID, &req);
     ogs_assert(ret == 0);
@@ -1244,6 +1367,8 @@ void mme_s6a_send_ulr(mme_ue_t *mme_ue)
     ret = fd_msg_avp_new(ogs_diam_s6a_ulr_flags, 0, &avp);
     ogs_assert(ret == 0);
     val.u32 = OGS_DIAM_S6A_ULR_S6A_S6D_INDICATOR;
+    if (sess_data->skip_subscriber_data)
+        val.u32 |= OGS_DIAM_S6A_ULR_SKIP_SUBSCRIBER_DATA;
     ret = fd_msg_avp_setvalue(avp, &val);
     ogs_assert(ret == 0);
     ret = fd_msg_avp_add(req, MSG_BRW_LAST_CHILD, avp);
@@ -1571,9 +1696,9 @@ static void mme_s6a_ula_cb(void *data, struct msg **msg)
 
         if (!(subdatamask & OGS_DIAM_S6A_SUBDATA_NAM)) {
             const char *network_access_mode_str = "unknown";
-            mme_ue->network_access_mode = mme_self()->network_access_mode_default;
+            mme_ue->profile->network_access_mode = mme_self()->network_access_mode_default;
 
-            switch (mme_ue->network_access_mode) {
+            switch (mme_ue->profile->network_access_mode) {
                 case OGS_NETWORK_ACCESS_MODE_PACKET_AND_CIRCUIT:
                     network_access_mode_str = "OGS_NETWORK_ACCESS_MODE_PACKET_AND_CIRCUIT";
                     break;
@@ -1586,12 +1711,12 @@ static void mme_s6a_ula_cb(void *data, struct msg **msg)
             }
             
             ogs_warn("no subscribed Network-Access-Mode, defaulting to "
-                "%s (%i)", network_access_mode_str, mme_ue->network_access_mode);
+                "%s (%i)", network_access_mode_str, mme_ue->profile->network_access_mode);
         }
         if (!(subdatamask & OGS_DIAM_S6A_SUBDATA_CC)) {
-            memcpy(mme_ue->charging_characteristics, (uint8_t *)"\x00\x00", 
+            memcpy(mme_ue->profile->charging_characteristics, (uint8_t *)"\x00\x00", 
                 OGS_CHRGCHARS_LEN);
-            mme_ue->charging_characteristics_presence = false;
+            mme_ue->profile->charging_characteristics_presence = false;
         }
         if (!(subdatamask & OGS_DIAM_S6A_SUBDATA_UEAMBR)) {
             ogs_error("no_AMBR");
@@ -1605,6 +1730,8 @@ static void mme_s6a_ula_cb(void *data, struct msg **msg)
             ogs_error("no_APN-Configuration-Profile");
             error++;
         }
+    } else if (sess_data->skip_subscriber_data) {
+        ogs_debug("    Subscription-Data skipped");
     } else {
         ogs_error("no_Subscription-Data");
         error++;
@@ -1926,6 +2053,9 @@ static int mme_ogs_diam_s6a_clr_cb( struct msg **msg, struct avp *avp,
     ogs_cpystrn(imsi_bcd, (char*)hdr->avp_value->os.data,
         ogs_min(hdr->avp_value->os.len, OGS_MAX_IMSI_BCD_LEN)+1);
 
+    /* Whatever happens next, the cached profile is no longer current */
+    mme_subscription_cache_remove(imsi_bcd);
+
     mme_ue = mme_ue_find_by_imsi_bcd(imsi_bcd);
 
     if (!mme_ue) {
@@ -2066,6 +2196,9 @@ static int mme_ogs_diam_s6a_idr_cb( struct msg **msg, struct avp *avp,
     ogs_cpystrn(imsi_bcd, (char*)hdr->avp_value->os.data,
         ogs_min(hdr->avp_value->os.len, OGS_MAX_IMSI_BCD_LEN)+1);
 
+    /* Whatever happens next, the cached profile is no longer current */
+    mme_subscription_cache_remove(imsi_bcd);
+
     mme_ue = mme_ue_find_by_imsi_bcd(imsi_bcd);
 
     if (!mme_ue) {
@@ -25,7 +25,7 @@
 #include "s1ap-path.h"
 #include "mme-s11-build.h"
 #include "mme-sm.h"
-#include "dns_resolvers.h"
+#include "mme-dns.h"
 
 static void _gtpv2_c_recv_cb(short when, ogs_socket_t fd, void *data)
 {
@@ -210,101 +210,106 @@ void mme_gtp_close(void)
     ogs_socknode_remove_all(&ogs_gtp_self()->gtpc_list6);
 }
 
-int mme_gtp_send_create_session_request(mme_sess_t *sess, int create_action)
+/* Whether the SGW of mme_ue is found through DNS */
+static bool sgw_selected_by_dns(mme_ue_t *mme_ue, ogs_session_t *session)
 {
-    int rv;
-    ogs_gtp2_header_t h;
-    ogs_pkbuf_t *pkbuf = NULL;
-    ogs_gtp_xact_t *xact = NULL;
-    mme_ue_t *mme_ue = NULL;
-    sgw_ue_t *sgw_ue = NULL;
-    ogs_session_t *session = NULL;
-
-    ogs_assert(sess);
-    mme_ue = sess->mme_ue;
     ogs_assert(mme_ue);
-    session = sess->session;
     ogs_assert(session);
-    sgw_ue = sgw_ue_cycle(mme_ue->sgw_ue);
-
-	
 
-    /* Select a  SGW if one has not been chosen */
-if (NULL == sgw_ue) {
-    mme_sgw_t *sgw = NULL;
-    int rv;
+    /* If APN is SOS then skip DNS lookup and assign SGW/PGW from local config */
+    if (0 == strcmp(session->name, "sos"))
+        return false;
+    if (imsi_is_roaming(&mme_ue->nas_mobile_identity_imsi))
+        return false;
 
-    if (0 == strcmp(session->name, "sos")) {
-        /* If APN is SOS then skip DNS lookup and assign SGW/PGW from local config */
-        sgw = select_random_sgw();
-    } else if (imsi_is_roaming(&mme_ue->nas_mobile_identity_imsi)) {
-        sgw = select_random_sgw_roaming();
-    } else if (mme_self()->dns_target_sgw) {
-        char ipv4[INET_ADDRSTRLEN] = "";
-        ResolverContext context = {};
+    return mme_self()->dns_target_sgw;
+}
 
-        snprintf(context.mnc, DNS_RESOLVERS_MAX_MNC_STR, "%03u", ogs_plmn_id_mnc(&mme_ue->tai.plmn_id));
-        snprintf(context.mcc, DNS_RESOLVERS_MAX_MCC_STR, "%03u", ogs_plmn_id_mcc(&mme_ue->tai.plmn_id));
+/* Whether the PGW of session is still to be found through DNS */
+static bool pgw_selected_by_dns(ogs_session_t *session)
+{
+    ogs_assert(session);
 
-        /* Split TAC into high and low bytes */
-        uint16_t tac = mme_ue->tai.tac;
-        uint8_t tac_high = (tac >> 8) & 0xFF;
-        uint8_t tac_low = tac & 0xFF;
+    if (0 == strcmp(session->name, "sos"))
+        return false;
+    if ((NULL != session->pgw_addr) || (NULL != session->pgw_addr6))
+        return false;
 
-        strncpy(context.domain_suffix, mme_self()->dns_base_domain, DNS_RESOLVERS_MAX_DOMAIN_SUFFIX_STR - 1);
-        context.domain_suffix[DNS_RESOLVERS_MAX_DOMAIN_SUFFIX_STR - 1] = '\0';
+    return mme_self()->dns_target_pgw;
+}
 
-	context.tac_low  = tac_low;
-	context.tac_high = tac_high;
-	
-	strncpy(context.target, "sgw", DNS_RESOLVERS_MAX_TARGET_STR);
-	context.target[DNS_RESOLVERS_MAX_TARGET_STR - 1] = '\0';
+static int sgw_find_or_connect(const char *ipv4, mme_sgw_t **sgw_out)
+{
+    int rv;
+    ogs_sockaddr_t *sgw_addr = NULL;
+    mme_sgw_t *sgw = NULL;
 
-	/* we select the S11 interface i think this is correct */
-	strncpy(context.interface, "s11", DNS_RESOLVERS_MAX_INTERFACE_STR);
-	context.interface[DNS_RESOLVERS_MAX_INTERFACE_STR - 1] = '\0';
+    ogs_assert(ipv4);
+    ogs_assert(sgw_out);
 
-	/* set the protocol type to NULL for the SGW selection */
-	context.protocol[0] = '\0';
+    ogs_addaddrinfo(
+        &sgw_addr,
+        AF_INET,
+        ipv4,
+        ogs_gtp_self()->gtpc_port,
+        0
+    );
 
-        if (true == resolve_sgw_naptr(&context, ipv4, INET_ADDRSTRLEN)) {
-            ogs_sockaddr_t *sgw_addr = NULL;
+    if (NULL != sgw_addr) {
+        sgw = mme_sgw_find_by_addr(sgw_addr);
 
-            ogs_info("NAPTR resolve success, SGW address is '%s'", ipv4);
+        if (NULL == sgw) {
+            ogs_debug("Looks like we haven't used this SGW (%s) yet, lets add it and connect to it", ipv4);
+            sgw = mme_sgw_add(sgw_addr);
 
-            ogs_addaddrinfo(
-                &sgw_addr,
-                AF_INET,
-                ipv4,
-                ogs_gtp_self()->gtpc_port,
-                0
+            rv = ogs_gtp_connect(
+                ogs_gtp_self()->gtpc_sock,
+                ogs_gtp_self()->gtpc_sock6,
+                (ogs_gtp_node_t *)sgw
             );
 
-            if (NULL != sgw_addr) {
-                sgw = mme_sgw_find_by_addr(sgw_addr);
-
-                if (NULL == sgw) {
-                    ogs_debug("Looks like we haven't used this SGW (%s) yet, lets add it and connect to it", ipv4);
-                    sgw = mme_sgw_add(sgw_addr);
-
-                    rv = ogs_gtp_connect(
-                        ogs_gtp_self()->gtpc_sock,
-                        ogs_gtp_self()->gtpc_sock6,
-                        (ogs_gtp_node_t *)sgw
-                    );
-
-                    if (OGS_OK != rv) {
-                        ogs_error("Failed to connect to new SGW with address '%s'", ipv4);
-                        mme_sgw_remove(sgw);
-                        return OGS_ERROR;
-                    }
-                }
-            } else {
-                ogs_error("Failed to set SGW address to '%s', falling back to default selection method", ipv4);
+            if (OGS_OK != rv) {
+                ogs_error("Failed to connect to new SGW with address '%s'", ipv4);
+                mme_sgw_remove(sgw);
+                return OGS_ERROR;
             }
         } else {
-            ogs_error("Failed to resolve dns and update SGW IP in CSR, falling back to default selection method");
+            ogs_freeaddrinfo(sgw_addr);
         }
+    } else {
+        ogs_error("Failed to set SGW address to '%s', falling back to default selection method", ipv4);
+    }
+
+    *sgw_out = sgw;
+
+    return OGS_OK;
+}
+
+/*
+ * Selects the SGW of mme_ue and associates a new sgw_ue with it.
+ * dns_ipv4 is what DNS resolved the SGW to, NULL if DNS is not
+ * used for this UE or did not resolve.
+ */
+static int associate_sgw(
+        mme_ue_t *mme_ue, ogs_session_t *session, const char *dns_ipv4)
+{
+    mme_sgw_t *sgw = NULL;
+    sgw_ue_t *sgw_ue = NULL;
+    int rv;
+
+    ogs_assert(mme_ue);
+    ogs_assert(session);
+
+    if (0 == strcmp(session->name, "sos")) {
+        /* If APN is SOS then skip DNS lookup and assign SGW/PGW from local config */
+        sgw = select_random_sgw();
+    } else if (imsi_is_roaming(&mme_ue->nas_mobile_identity_imsi)) {
+        sgw = select_random_sgw_roaming();
+    } else if (NULL != dns_ipv4) {
+        ogs_info("NAPTR resolve success, SGW address is '%s'", dns_ipv4);
+
+        rv = sgw_find_or_connect(dns_ipv4, &sgw);
+        if (OGS_OK != rv) return OGS_ERROR;
     }
 
     if (NULL == sgw) {
@@ -316,11 +321,18 @@ if (NULL == sgw_ue) {
     ogs_assert(sgw_ue);
     ogs_assert(sgw_ue->gnode); /* sgw_ue->gnode is a union with the sgw_ue->sgw */
     sgw_ue_associate_mme_ue(sgw_ue, mme_ue);
-}
-ogs_assert(sgw_ue);
-
 
+    return OGS_OK;
+}
 
+/*
+ * Sets the PGW address of session if one has not been chosen.
+ * dns_ipv4 is what DNS resolved the PGW to, NULL if DNS is
+ * not used for this session or did not resolve.
+ */
+static int assign_pgw(ogs_session_t *session, bool dns_wanted, const char *dns_ipv4)
+{
+    ogs_assert(session);
 
     /* If this is a SOS APN the we want to set the address in the session to a local PGW */
     if (0 == strcmp(session->name, "sos")) {
@@ -334,65 +346,13 @@ ogs_assert(sgw_ue);
     } else if ((NULL == session->pgw_addr) && (NULL == session->pgw_addr6)) {
         /* Pick PGW if one has not been chosen */
 
-        if (mme_self()->dns_target_pgw) {
-            bool resolved_dns = false;
-            enum { MAX_MCC_MNC_STR = 6 };
-            char ipv4[INET_ADDRSTRLEN] = "";
-            ResolverContext context = {};
-            char mme_mcc[MAX_MCC_MNC_STR] = "";
-            char mme_mnc[MAX_MCC_MNC_STR] = "";
-            char imsi_mcc[MAX_MCC_MNC_STR] = "000";
-            char imsi_mnc_2[MAX_MCC_MNC_STR] = "000";
-            char imsi_mnc_3[MAX_MCC_MNC_STR] = "000";
-            
-            /* Load MCC and MNC from config and format them */
-            snprintf(mme_mcc, MAX_MCC_MNC_STR, "%u", ogs_plmn_id_mcc(&mme_ue->tai.plmn_id));
-            snprintf(mme_mnc, MAX_MCC_MNC_STR, "%u", ogs_plmn_id_mnc(&mme_ue->tai.plmn_id));
-	    strncpy(context.apn, sess->session->name, DNS_RESOLVERS_MAX_APN_STR - 1);
-		context.apn[DNS_RESOLVERS_MAX_APN_STR - 1] = '\0';
-            strncpy(context.target, "pgw", DNS_RESOLVERS_MAX_TARGET_STR);
-            strncpy(context.protocol, "gtp", DNS_RESOLVERS_MAX_PROTOCOL_STR);
-            /* Load our domain suffix from the config */
-            strncpy(context.domain_suffix, mme_self()->dns_base_domain, DNS_RESOLVERS_MAX_DOMAIN_SUFFIX_STR);
-
-            memcpy(imsi_mcc, &mme_ue->imsi_bcd[0], 3);
-            memcpy(&imsi_mnc_2[1], &mme_ue->imsi_bcd[3], 2);
-            memcpy(imsi_mnc_3, &mme_ue->imsi_bcd[3], 3);
-
-            strncpy(context.mcc, imsi_mcc, DNS_RESOLVERS_MAX_MCC_STR);
-
-            if (imsi_is_roaming(&mme_ue->nas_mobile_identity_imsi)) {
-                /* This is roaming, check roaming with a 3 digit MNC */
-                strncpy(context.interface, "s8", DNS_RESOLVERS_MAX_INTERFACE_STR);
-                strcpy(context.mnc, imsi_mnc_3);
-
-                ogs_debug("Attempting NAPTR resolv for roming [MCC:%s] [MNC:%s]\n", context.mcc, context.mnc);
-                if (true == resolve_naptr(&context, ipv4, INET_ADDRSTRLEN)) {
-                    /* We resolved for roming */
-                    resolved_dns = true;
-                } else {
-                    /* We failed to resolve with assumption of a 3 digit MNC,
-                    * try the 2 digit MNC */
-                    strcpy(context.mnc, imsi_mnc_2);
-
-                    ogs_debug("Attempting NAPTR resolv for roming [MCC:%s] [MNC:%s]\n", context.mcc, context.mnc);
-                    resolved_dns = resolve_naptr(&context, ipv4, INET_ADDRSTRLEN);
-                }
-            } else {
-                /* Might be home, check home */
-                strncpy(context.interface, "s5", DNS_RESOLVERS_MAX_INTERFACE_STR);
-                strncpy(context.mnc, mme_mnc, DNS_RESOLVERS_MAX_MNC_STR);
-                
-                ogs_debug("Attempting NAPTR resolv for home [MCC:%s] [MNC:%s]\n", context.mcc, context.mnc);
-                resolved_dns = resolve_naptr(&context, ipv4, INET_ADDRSTRLEN);
-            }
-
-            if (resolved_dns) {
-                ogs_info("NAPTR resolve success, PGW address is '%s'", ipv4);
+        if (dns_wanted) {
+            if (NULL != dns_ipv4) {
+                ogs_info("NAPTR resolve success, PGW address is '%s'", dns_ipv4);
                 ogs_addaddrinfo(
                     &session->pgw_addr,
                     AF_INET,
-                    ipv4,
+                    dns_ipv4,
                     ogs_gtp_self()->gtpc_port,
                     0
                 );
@@ -413,6 +373,70 @@ ogs_assert(sgw_ue);
         }
     }
 
+    return OGS_OK;
+}
+
+int mme_gtp_send_create_session_request(mme_sess_t *sess, int create_action)
+{
+    int rv;
+    ogs_gtp2_header_t h;
+    ogs_pkbuf_t *pkbuf = NULL;
+    ogs_gtp_xact_t *xact = NULL;
+    mme_ue_t *mme_ue = NULL;
+    sgw_ue_t *sgw_ue = NULL;
+    ogs_session_t *session = NULL;
+    bool sgw_dns = false, pgw_dns = false;
+
+    ogs_assert(sess);
+    mme_ue = sess->mme_ue;
+    ogs_assert(mme_ue);
+    session = sess->session;
+    ogs_assert(session);
+    sgw_ue = sgw_ue_cycle(mme_ue->sgw_ue);
+
+    sgw_dns = (NULL == sgw_ue) && sgw_selected_by_dns(mme_ue, session);
+    pgw_dns = pgw_selected_by_dns(session);
+
+    /* The request is parked until the resolver threads answer and
+     * is sent from mme_gtp_resume_create_session_request() */
+    if ((sgw_dns || pgw_dns) && mme_dns_async_enabled())
+        return mme_dns_send_create_session_query(
+                sess, create_action, sgw_dns, pgw_dns);
+
+    /* Select a  SGW if one has not been chosen */
+    if (NULL == sgw_ue) {
+        char ipv4[INET_ADDRSTRLEN] = "";
+        bool resolved = false;
+
+        if (sgw_dns) {
+            ResolverContext context = {};
+
+            mme_dns_sgw_context(mme_ue, &context);
+            resolved = mme_dns_resolve_sgw(&context, ipv4, sizeof(ipv4));
+        }
+
+        rv = associate_sgw(mme_ue, session, resolved ? ipv4 : NULL);
+        if (OGS_OK != rv) return OGS_ERROR;
+
+        sgw_ue = sgw_ue_cycle(mme_ue->sgw_ue);
+    }
+    ogs_assert(sgw_ue);
+
+    if (pgw_dns) {
+        char ipv4[INET_ADDRSTRLEN] = "";
+        char retry_mnc[DNS_RESOLVERS_MAX_MNC_STR] = "";
+        ResolverContext context = {};
+        bool resolved;
+
+        mme_dns_pgw_context(sess, &context, retry_mnc);
+        resolved = mme_dns_resolve_pgw(&context, retry_mnc, ipv4, sizeof(ipv4));
+
+        rv = assign_pgw(session, true, resolved ? ipv4 : NULL);
+    } else {
+        rv = assign_pgw(session, false, NULL);
+    }
+    if (OGS_OK != rv) return OGS_ERROR;
+
     if (create_action == OGS_GTP_CREATE_IN_PATH_SWITCH_REQUEST) {
         sgw_ue = sgw_ue_cycle(sgw_ue->target_ue);
         ogs_assert(sgw_ue);
@@ -442,6 +466,40 @@ ogs_assert(sgw_ue);
     return rv;
 }
 
+int mme_gtp_resume_create_session_request(mme_sess_t *sess,
+        int create_action, bool sgw_dns, const char *sgw_ipv4,
+        bool pgw_dns, const char *pgw_ipv4)
+{
+    int rv;
+    mme_ue_t *mme_ue = NULL;
+    ogs_session_t *session = NULL;
+
+    ogs_assert(sess);
+    mme_ue = sess->mme_ue;
+    ogs_assert(mme_ue);
+    session = sess->session;
+    ogs_assert(session);
+
+    if (sgw_dns) {
+        if (NULL == sgw_ipv4)
+            ogs_error("Failed to resolve dns and update SGW IP in CSR, falling back to default selection method");
+
+        /* Another session of the UE may have got there first */
+        if (NULL == sgw_ue_cycle(mme_ue->sgw_ue)) {
+            rv = associate_sgw(mme_ue, session, sgw_ipv4);
+            if (OGS_OK != rv) return OGS_ERROR;
+        }
+    }
+
+    if (pgw_dns) {
+        rv = assign_pgw(session, true, pgw_ipv4);
+        if (OGS_OK != rv) return OGS_ERROR;
+    }
+
+    /* Nothing is left to resolve */
+    return mme_gtp_send_create_session_request(sess, create_action);
+}
+
 int mme_gtp_send_modify_bearer_request(
         mme_ue_t *mme_ue, int uli_presence, int modify_action)
 {
@@ -30,6 +30,9 @@ int mme_gtp_open(void);
 void mme_gtp_close(void);
 
 int mme_gtp_send_create_session_request(mme_sess_t *sess, int create_action);
+int mme_gtp_resume_create_session_request(mme_sess_t *sess,
+        int create_action, bool sgw_dns, const char *sgw_ipv4,
+        bool pgw_dns, const char *pgw_ipv4);
 int mme_gtp_send_modify_bearer_request(
         mme_ue_t *mme_ue, int uli_presence, int modify_action);
 int mme_gtp_send_delete_session_request(
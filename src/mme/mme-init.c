@@ -32,6 +32,9 @@
 #include "mme-gtp-path.h"
 #include "metrics.h"
 #include "mme-redis.h"
+#include "mme-dns.h"
+#include "mme-subscription-cache.h"
+#include "s1ap-decoder.h"
 
 static ogs_thread_t *thread;
 static void mme_main(void *data);
@@ -59,6 +62,21 @@ int mme_initialize(void)
     rv = mme_context_parse_config();
     if (rv != OGS_OK) return rv;
 
+    if (mme_self()->dns_cache.enabled) {
+        if (mme_self()->dns_cache.max_entries > 0)
+            dns_resolvers_cache_init(mme_self()->dns_cache.max_entries,
+                    mme_self()->dns_cache.negative_ttl_sec,
+                    mme_self()->dns_cache.max_ttl_sec);
+        else
+            ogs_warn("DNS cache_max_entries must be positive, "
+                    "DNS cache disabled");
+    }
+
+    if (mme_self()->subscription_cache.max_entries > 0)
+        mme_subscription_cache_init(
+                mme_self()->subscription_cache.max_entries,
+                mme_self()->subscription_cache.ttl);
+
     rv = ogs_log_config_domain(
             ogs_app()->logger.domain, ogs_app()->logger.level);
     if (rv != OGS_OK) return rv;
@@ -80,11 +98,21 @@ int mme_initialize(void)
     rv = sbcap_open();
     if (rv != OGS_OK) return OGS_ERROR;
 
+    /* Before the MME thread starts polling, async
+     * duplicate detection registers with the pollset */
+    mme_redis_init();
+
+    rv = mme_dns_open();
+    if (rv != OGS_OK) return OGS_ERROR;
+
+    if (mme_self()->s1ap_decoder.workers > 0) {
+        rv = s1ap_decoder_init(mme_self()->s1ap_decoder.workers);
+        if (rv != OGS_OK) return OGS_ERROR;
+    }
+
     thread = ogs_thread_create(mme_main, NULL);
     if (!thread) return OGS_ERROR;
 
-    mme_redis_init();
-    
     initialized = 1;
 
     return OGS_OK;
@@ -98,6 +126,10 @@ void mme_terminate(void)
 
     ogs_thread_destroy(thread);
 
+    s1ap_decoder_final();
+
+    mme_dns_close();
+
     mme_gtp_close();
     sgsap_close();
     s1ap_close();
@@ -111,6 +143,10 @@ void mme_terminate(void)
     
     mme_redis_final();
 
+    dns_resolvers_cache_final();
+
+    mme_subscription_cache_final();
+
     ogs_gtp_context_final();
 
     ogs_gtp_xact_final();
@@ -158,6 +194,8 @@ static void mme_main(void *data)
             ogs_fsm_dispatch(&mme_sm, e);
             mme_event_free(e);
         }
+
+        mme_metrics_gtp_xact_update();
     }
 done:
 
@@ -3,44 +3,197 @@
 #include "mme-context.h"
 
 
-static redisContext* connection = NULL;
+/* Seeds for the two halves of the 128-bit message digest */
+#define REDIS_DUP_DIGEST_SEED_0 0x5331415044555030ULL
+#define REDIS_DUP_DIGEST_SEED_1 0x5331415044555031ULL
+
+#define REDIS_BLOOM_NUM_OF_HASHES 4
+
+typedef struct redis_dup_key_s {
+    uint64_t digest[2];     /* Over eNB-ID and PDU */
+
+    /* What is actually sent to redis, prefix then buf */
+    uint8_t prefix[4];      /* eNB-ID with key: pdu */
+    size_t prefix_len;
+    const void *buf;
+    size_t len;
+} redis_dup_key_t;
+
+typedef struct redis_pending_s {
+    ogs_lnode_t lnode;
+
+    ogs_sock_t *sock;   /* Association the PDU arrived on */
+    mme_enb_t *enb;
+    ogs_pkbuf_t *pkbuf;
+    ogs_time_t sent_time;
+    int shard;          /* Redis server the key lives on */
+
+    bool decided;       /* Either redis replied or the deadline passed */
+    bool is_dup;
+    bool in_flight;     /* Redis still owes us a reply for this entry */
+    bool handed_back;   /* No longer in pending_list */
+} redis_pending_t;
+
+/*
+ * Two generations of a Bloom filter, each one covering expire_time_sec.
+ * A miss in both means we have definitely not seen the message within
+ * the expiry window. A hit may be a false positive, redis decides.
+ */
+static struct {
+    uint8_t *bits[2];       /* [0] is current, [1] is previous */
+    uint64_t mask;          /* Number of bits - 1 */
+    ogs_time_t rotated;     /* When [0] became current */
+} bloom;
+
+static ogs_redis_pool_t *pool = NULL;
+
+static ogs_list_t pending_list;
+static ogs_timer_t *t_deadline = NULL;
+static bool finalising = false;
+
+static void redis_dup_key_build(
+        redis_dup_key_t *key, mme_enb_t *enb, ogs_pkbuf_t *pkbuf);
+static bool redis_bloom_check_and_add(redis_dup_key_t *key);
+
+static void redis_dup_reply_cb(redisAsyncContext *c, void *r, void *privdata);
+static void redis_deadline_cb(void *data);
+static void redis_pending_drain(void);
 
 
 void mme_redis_init(void) {
-    if (mme_self()->redis_dup_detection.enabled) {
-        connection = ogs_redis_initialise(
-            mme_self()->redis_server_config.address,
-            mme_self()->redis_server_config.port
-        );
+    redis_server_config_t *config = &mme_self()->redis_server_config;
+    ogs_redis_endpoint_t endpoints[MAX_NUM_OF_REDIS_SERVER];
+    int i;
+
+    if (!mme_self()->redis_dup_detection.enabled)
+        return;
+
+    if (mme_self()->redis_dup_detection.local_cache) {
+        size_t size = mme_self()->redis_dup_detection.local_cache_bits / 8;
+
+        ogs_assert(size);
+        bloom.bits[0] = ogs_calloc(1, size);
+        ogs_assert(bloom.bits[0]);
+        bloom.bits[1] = ogs_calloc(1, size);
+        ogs_assert(bloom.bits[1]);
+        bloom.mask = mme_self()->redis_dup_detection.local_cache_bits - 1;
+        bloom.rotated = ogs_get_monotonic_time();
+    }
+
+    for (i = 0; i < config->num_of_server; i++) {
+        endpoints[i].address = config->server[i].address;
+        endpoints[i].port = config->server[i].port;
     }
+
+    if (config->num_of_server == 0) {
+        ogs_error("redis_dup_detection is enabled but "
+                "no redis_server is configured");
+    } else if (mme_self()->redis_dup_detection.async) {
+        /* Only the pollset connections are used */
+        pool = ogs_redis_pool_create(endpoints, config->num_of_server,
+                0, config->timeout, ogs_app()->timer_mgr, ogs_app()->pollset);
+        ogs_assert(pool);
+    } else {
+        pool = ogs_redis_pool_create(endpoints, config->num_of_server,
+                config->connections, config->timeout,
+                ogs_app()->timer_mgr, NULL);
+        ogs_assert(pool);
+    }
+
+    if (!mme_self()->redis_dup_detection.async)
+        return;
+
+    ogs_list_init(&pending_list);
+    finalising = false;
+
+    t_deadline = ogs_timer_add(
+            ogs_app()->timer_mgr, redis_deadline_cb, NULL);
+    ogs_assert(t_deadline);
 }
 
 void mme_redis_final(void) {
-    if (mme_self()->redis_dup_detection.enabled) {
-        ogs_redis_finalise(connection);
+    redis_pending_t *pending = NULL, *next_pending = NULL;
+
+    if (!mme_self()->redis_dup_detection.enabled)
+        return;
+
+    if (bloom.bits[0]) {
+        ogs_free(bloom.bits[0]);
+        ogs_free(bloom.bits[1]);
+        memset(&bloom, 0, sizeof(bloom));
+    }
+
+    /* Nothing is dispatched anymore, outstanding replies are
+     * flushed with a NULL reply by redisAsyncFree() */
+    finalising = true;
+
+    if (NULL != pool) {
+        ogs_redis_pool_destroy(pool);
+        pool = NULL;
+    }
+
+    if (!mme_self()->redis_dup_detection.async)
+        return;
+
+    ogs_list_for_each_safe(&pending_list, next_pending, pending) {
+        ogs_list_remove(&pending_list, pending);
+        ogs_pkbuf_free(pending->pkbuf);
+        ogs_free(pending);
+    }
+
+    if (t_deadline) {
+        ogs_timer_delete(t_deadline);
+        t_deadline = NULL;
     }
 }
 
-bool redis_is_message_dup(uint8_t *buf, size_t buf_sz) {
+bool redis_is_message_dup(mme_enb_t *enb, ogs_pkbuf_t *pkbuf) {
     bool is_dup = true;
     redisReply *reply = NULL;
+    redis_dup_key_t key;
+    ogs_time_t sent_time;
+
+    ogs_assert(enb);
+    ogs_assert(pkbuf);
 
-    if (NULL == connection) {
+    if (NULL == pool) {
         ogs_error("Cannot call redis_is_message_dup without a valid redis connection");
         return false;
     }
 
-    /* Have we seen this exact message recently? */
-    reply = redisCommand(connection, "GET %b", buf, buf_sz);
+    redis_dup_key_build(&key, enb, pkbuf);
+
+    if (mme_self()->redis_dup_detection.local_cache &&
+        !redis_bloom_check_and_add(&key)) {
+        /* Definitely new, redis only needs to remember it for
+         * other MMEs so the write is pipelined and not waited on */
+        ogs_redis_pool_append(pool, key.buf, key.len, "SET %b%b 1 EX %u",
+                key.prefix, key.prefix_len, key.buf, key.len,
+                mme_self()->redis_dup_detection.expire_time_sec);
+        return false;
+    }
+
+    /* Remember this message for expire_time_sec, the key
+     * is only set if we have not seen this exact message recently */
+    sent_time = ogs_get_monotonic_time();
+    reply = ogs_redis_pool_command(pool, key.buf, key.len,
+            "SET %b%b 1 NX EX %u",
+            key.prefix, key.prefix_len, key.buf, key.len,
+            mme_self()->redis_dup_detection.expire_time_sec);
 
     if (NULL == reply) {
         ogs_error("Failed to get a reply from redis server");
+        mme_metrics_inst_global_inc(MME_METR_GLOB_CTR_REDIS_DUP_FAIL_OPEN);
         return false;
     }
 
-    if (reply->type != REDIS_REPLY_NIL) {
+    mme_metrics_inst_global_add(MME_METR_GLOB_HIST_REDIS_DUP_LATENCY,
+            (int)(ogs_get_monotonic_time() - sent_time));
+
+    if (reply->type == REDIS_REPLY_NIL) {
         ogs_debug("S1AP message was a duplicate");
         is_dup = true;
+        mme_metrics_inst_global_inc(MME_METR_GLOB_CTR_REDIS_DUP_DETECTED);
     }
     else {
         ogs_debug("S1AP message was not a duplicate");
@@ -48,11 +201,242 @@ bool redis_is_message_dup(uint8_t *buf, size_t buf_sz) {
     }
     freeReplyObject(reply);
 
-    /* Tell redis to remember this message for expire_time_sec */
-    reply = redisCommand(connection, "INCR %b", buf, buf_sz);
-    freeReplyObject(reply);
-    reply = redisCommand(connection, "EXPIRE %b %i", buf, buf_sz, mme_self()->redis_dup_detection.expire_time_sec);
-    freeReplyObject(reply);
-
     return is_dup;
-}
\ No newline at end of file
+}
+
+void redis_dup_check_async(
+        ogs_sock_t *sock, mme_enb_t *enb, ogs_pkbuf_t *pkbuf) {
+    redis_pending_t *pending = NULL;
+    redisAsyncContext *async_connection = NULL;
+    redis_dup_key_t key;
+    int rv;
+
+    ogs_assert(sock);
+    ogs_assert(enb);
+    ogs_assert(pkbuf);
+
+    pending = ogs_calloc(1, sizeof(*pending));
+    ogs_assert(pending);
+
+    pending->sock = sock;
+    pending->enb = enb;
+    pending->pkbuf = pkbuf;
+    pending->sent_time = ogs_get_monotonic_time();
+
+    ogs_list_add(&pending_list, pending);
+
+    redis_dup_key_build(&key, enb, pkbuf);
+
+    if (NULL != pool) {
+        pending->shard = ogs_redis_pool_shard(pool, key.buf, key.len);
+        async_connection = ogs_redis_pool_async(pool, pending->shard);
+    }
+
+    if (mme_self()->redis_dup_detection.local_cache &&
+        !redis_bloom_check_and_add(&key)) {
+        /* Definitely new, tell redis but do not wait for it */
+        pending->decided = true;
+        if (NULL != async_connection)
+            redisAsyncCommand(async_connection, NULL, NULL,
+                    "SET %b%b 1 EX %u",
+                    key.prefix, key.prefix_len, key.buf, key.len,
+                    mme_self()->redis_dup_detection.expire_time_sec);
+    } else if (NULL == async_connection) {
+        /* Fail open, but still behind anything already parked */
+        pending->decided = true;
+        mme_metrics_inst_global_inc(MME_METR_GLOB_CTR_REDIS_DUP_FAIL_OPEN);
+    } else {
+        /* Replies on one connection come back in the order the
+         * commands were sent, so commands are simply pipelined.
+         * Across servers the pending list keeps the order */
+        rv = redisAsyncCommand(async_connection,
+                redis_dup_reply_cb, pending, "SET %b%b 1 NX EX %u",
+                key.prefix, key.prefix_len, key.buf, key.len,
+                mme_self()->redis_dup_detection.expire_time_sec);
+        if (REDIS_OK == rv) {
+            pending->in_flight = true;
+        } else {
+            ogs_error("Failed to queue redis command");
+            pending->decided = true;
+            mme_metrics_inst_global_inc(
+                    MME_METR_GLOB_CTR_REDIS_DUP_FAIL_OPEN);
+        }
+    }
+
+    redis_pending_drain();
+}
+
+static void redis_dup_key_build(
+        redis_dup_key_t *key, mme_enb_t *enb, ogs_pkbuf_t *pkbuf) {
+    uint8_t enb_id[4];
+    uint64_t seed[2] = { REDIS_DUP_DIGEST_SEED_0, REDIS_DUP_DIGEST_SEED_1 };
+    int i;
+
+    ogs_assert(key);
+    ogs_assert(enb);
+    ogs_assert(pkbuf);
+
+    /* The same PDU from two different eNBs is not a duplicate, whether
+     * the Bloom filter or redis is asked, so both keys carry the eNB-ID */
+    ogs_uint64_to_buffer(enb->enb_id, 4, enb_id);
+
+    for (i = 0; i < 2; i++) {
+        seed[i] = ogs_hash_xxh64(enb_id, sizeof(enb_id), seed[i]);
+        key->digest[i] = ogs_hash_xxh64(pkbuf->data, pkbuf->len, seed[i]);
+    }
+
+    if (mme_self()->redis_dup_detection.digest_key) {
+        key->prefix_len = 0;
+        key->buf = key->digest;
+        key->len = sizeof(key->digest);
+    } else {
+        memcpy(key->prefix, enb_id, sizeof(enb_id));
+        key->prefix_len = sizeof(enb_id);
+        key->buf = pkbuf->data;
+        key->len = pkbuf->len;
+    }
+}
+
+/* Returns false if the message is definitely new, true if redis
+ * has to be asked. Either way it is remembered from now on */
+static bool redis_bloom_check_and_add(redis_dup_key_t *key) {
+    uint64_t index[REDIS_BLOOM_NUM_OF_HASHES];
+    bool in_current = true, in_previous = true;
+    ogs_time_t now;
+    int i;
+
+    ogs_assert(key);
+    ogs_assert(bloom.bits[0]);
+
+    now = ogs_get_monotonic_time();
+    if (now - bloom.rotated >= ogs_time_from_sec(
+                mme_self()->redis_dup_detection.expire_time_sec)) {
+        uint8_t *oldest = bloom.bits[1];
+
+        bloom.bits[1] = bloom.bits[0];
+        bloom.bits[0] = oldest;
+        memset(bloom.bits[0], 0, (bloom.mask + 1) / 8);
+        bloom.rotated = now;
+    }
+
+    /* Double hashing over the two halves of the digest */
+    for (i = 0; i < REDIS_BLOOM_NUM_OF_HASHES; i++) {
+        index[i] = (key->digest[0] + i * (key->digest[1] | 1)) & bloom.mask;
+
+        if (!(bloom.bits[0][index[i] >> 3] & (1 << (index[i] & 7))))
+            in_current = false;
+        if (!(bloom.bits[1][index[i] >> 3] & (1 << (index[i] & 7))))
+            in_previous = false;
+    }
+
+    for (i = 0; i < REDIS_BLOOM_NUM_OF_HASHES; i++)
+        bloom.bits[0][index[i] >> 3] |= (1 << (index[i] & 7));
+
+    return in_current || in_previous;
+}
+
+static void redis_dup_reply_cb(redisAsyncContext *c, void *r, void *privdata) {
+    redisReply *reply = r;
+    redis_pending_t *pending = privdata;
+
+    ogs_assert(pending);
+    pending->in_flight = false;
+
+    if (!finalising)
+        ogs_redis_pool_observe(pool, pending->shard,
+                ogs_get_monotonic_time() - pending->sent_time,
+                NULL == reply || REDIS_REPLY_ERROR == reply->type);
+
+    if (pending->handed_back) {
+        /* Deadline already passed and the message went on without us */
+        ogs_free(pending);
+        return;
+    }
+
+    if (finalising)
+        return;
+
+    if (NULL == reply || REDIS_REPLY_ERROR == reply->type) {
+        ogs_error("Failed to get a reply from redis server");
+        mme_metrics_inst_global_inc(MME_METR_GLOB_CTR_REDIS_DUP_FAIL_OPEN);
+        pending->is_dup = false;
+    } else {
+        mme_metrics_inst_global_add(MME_METR_GLOB_HIST_REDIS_DUP_LATENCY,
+                (int)(ogs_get_monotonic_time() - pending->sent_time));
+
+        pending->is_dup = (REDIS_REPLY_NIL == reply->type);
+    }
+    pending->decided = true;
+
+    redis_pending_drain();
+}
+
+static void redis_deadline_cb(void *data) {
+    redis_pending_t *pending = NULL;
+    ogs_time_t now = ogs_get_monotonic_time();
+
+    ogs_list_for_each(&pending_list, pending) {
+        if (pending->sent_time +
+                mme_self()->redis_dup_detection.deadline > now)
+            break;
+
+        if (!pending->decided) {
+            ogs_warn("No reply from redis within %lldms, passing message on",
+                    (long long)ogs_time_to_msec(
+                        mme_self()->redis_dup_detection.deadline));
+            mme_metrics_inst_global_inc(
+                    MME_METR_GLOB_CTR_REDIS_DUP_FAIL_OPEN);
+            pending->is_dup = false;
+            pending->decided = true;
+        }
+    }
+
+    redis_pending_drain();
+}
+
+/* Hands decided messages back in arrival order and
+ * re-arms the deadline for whatever is now at the head */
+static void redis_pending_drain(void) {
+    redis_pending_t *pending = NULL;
+    mme_event_t *e = NULL;
+    ogs_time_t expires;
+    int rv;
+
+    while ((pending = ogs_list_first(&pending_list)) && pending->decided) {
+        ogs_list_remove(&pending_list, pending);
+        pending->handed_back = true;
+
+        if (pending->is_dup) {
+            ogs_debug("S1AP message was a duplicate");
+            mme_metrics_inst_global_inc(MME_METR_GLOB_CTR_REDIS_DUP_DETECTED);
+            ogs_pkbuf_free(pending->pkbuf);
+        } else {
+            e = mme_event_new(MME_EVENT_S1AP_DUP_CHECKED);
+            ogs_assert(e);
+            e->sock = pending->sock;
+            e->enb = pending->enb;
+            e->pkbuf = pending->pkbuf;
+
+            rv = ogs_queue_push(ogs_app()->queue, e);
+            if (rv != OGS_OK) {
+                ogs_error("ogs_queue_push() failed:%d", (int)rv);
+                ogs_pkbuf_free(e->pkbuf);
+                mme_event_free(e);
+            }
+        }
+        pending->pkbuf = NULL;
+
+        if (!pending->in_flight)
+            ogs_free(pending);
+    }
+
+    pending = ogs_list_first(&pending_list);
+    if (NULL == pending) {
+        ogs_timer_stop(t_deadline);
+        return;
+    }
+
+    expires = pending->sent_time +
+        mme_self()->redis_dup_detection.deadline - ogs_get_monotonic_time();
+    ogs_timer_start(t_deadline, expires > 0 ? expires : 0);
+}
@@ -1,7 +1,17 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "mme-event.h"
+
 void mme_redis_init(void);
 void mme_redis_final(void);
 
-bool redis_is_message_dup(uint8_t *buf, size_t buf_sz);
\ No newline at end of file
+bool redis_is_message_dup(mme_enb_t *enb, ogs_pkbuf_t *pkbuf);
+
+/* Takes ownership of pkbuf. The message is handed back to the MME
+ * state machine as MME_EVENT_S1AP_DUP_CHECKED once redis replies,
+ * or once the deadline passes (fail open). Duplicates are dropped.
+ * Messages are always handed back in the order they were received,
+ * together with sock so that a reused eNB slot can be told apart */
+void redis_dup_check_async(
+        ogs_sock_t *sock, mme_enb_t *enb, ogs_pkbuf_t *pkbuf);
@@ -83,10 +83,10 @@ ogs_pkbuf_t *mme_s11_build_create_session_request(
         req->me_identity.len = mme_ue->imeisv_len;
     }
 
-    if (mme_ue->msisdn_len) {
+    if (mme_ue->profile->msisdn_len) {
         req->msisdn.presence = 1;
-        req->msisdn.data = mme_ue->msisdn;
-        req->msisdn.len = mme_ue->msisdn_len;
+        req->msisdn.data = mme_ue->profile->msisdn;
+        req->msisdn.len = mme_ue->profile->msisdn_len;
     }
 
     memset(&uli, 0, sizeof(ogs_gtp2_uli_t));
@@ -390,9 +390,9 @@ ogs_pkbuf_t *mme_s11_build_create_session_request(
         req->charging_characteristics.presence = 1;
         req->charging_characteristics.data = session->charging_characteristics;
         req->charging_characteristics.len = OGS_CHRGCHARS_LEN;
-    } else if (mme_ue->charging_characteristics_presence == true) {
+    } else if (mme_ue->profile->charging_characteristics_presence == true) {
         req->charging_characteristics.presence = 1;
-        req->charging_characteristics.data = mme_ue->charging_characteristics;
+        req->charging_characteristics.data = mme_ue->profile->charging_characteristics;
         req->charging_characteristics.len = OGS_CHRGCHARS_LEN;
     }
 
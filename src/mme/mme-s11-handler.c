@@ -410,10 +410,10 @@ void mme_s11_handle_create_session_response(
 
     if (create_action == OGS_GTP_CREATE_IN_ATTACH_REQUEST) {
         mme_csmap_t *csmap = mme_csmap_find_by_tai(&mme_ue->tai);
-        mme_ue->csmap = csmap;
+        mme_ue->profile->csmap = csmap;
 	
 	if (!csmap ||
-            mme_ue->network_access_mode ==
+            mme_ue->profile->network_access_mode ==
                 OGS_NETWORK_ACCESS_MODE_ONLY_PACKET ||
             mme_ue->nas_eps.attach.value ==
                 OGS_NAS_ATTACH_TYPE_EPS_ATTACH) {
@@ -24,6 +24,7 @@
 
 #include "mme-sm.h"
 #include "mme-s6a-handler.h"
+#include "mme-subscription-cache.h"
 
 /* Unfortunately fd doesn't distinguish
  * between result-code and experimental-result-code.
@@ -47,8 +48,6 @@ uint8_t mme_s6a_handle_aia(
     ogs_assert(s6a_message);
     aia_message = &s6a_message->aia_message;
     ogs_assert(aia_message);
-    e_utran_vector = &aia_message->e_utran_vector;
-    ogs_assert(e_utran_vector);
 
     if (s6a_message->result_code != ER_DIAMETER_SUCCESS) {
         ogs_warn("Authentication Information failed [%d]",
@@ -56,6 +55,21 @@ uint8_t mme_s6a_handle_aia(
         return emm_cause_from_diameter(s6a_message->err, s6a_message->exp_err);
     }
 
+    ogs_assert(aia_message->num_of_e_utran_vector >= 1);
+    e_utran_vector = &aia_message->e_utran_vector[0];
+
+    /* Keep the others for the next authentications */
+    if (aia_message->num_of_e_utran_vector > 1) {
+        mme_ue->profile->auth_vectors.num =
+            aia_message->num_of_e_utran_vector - 1;
+        memcpy(mme_ue->profile->auth_vectors.vector,
+                &aia_message->e_utran_vector[1],
+                mme_ue->profile->auth_vectors.num *
+                sizeof(ogs_diam_e_utran_vector_t));
+        mme_ue->profile->auth_vectors.expires =
+            ogs_get_monotonic_time() + mme_self()->auth_vectors.lifetime;
+    }
+
     mme_ue->xres_len = e_utran_vector->xres_len;
     memcpy(mme_ue->xres, e_utran_vector->xres, mme_ue->xres_len);
     memcpy(mme_ue->kasme, e_utran_vector->kasme, OGS_SHA256_DIGEST_SIZE);
@@ -94,30 +108,43 @@ uint8_t mme_s6a_handle_ula(
 
     if (s6a_message->result_code != ER_DIAMETER_SUCCESS) {
         ogs_error("Update Location failed [%d]", s6a_message->result_code);
+        mme_subscription_cache_remove(mme_ue->imsi_bcd);
         return emm_cause_from_diameter(s6a_message->err, s6a_message->exp_err);
     }
 
-    ogs_assert(subscription_data->num_of_slice == 1);
-    slice_data = &subscription_data->slice[0];
+    if (subscription_data->num_of_slice == 0) {
+        /* The HSS skipped Subscription-Data, mme_s6a_send_ulr() has
+         * already restored the profile from the cache */
+        if (mme_ue->profile->num_of_session == 0) {
+            ogs_error("No Subscription-Data");
+            return OGS_NAS_EMM_CAUSE_SEVERE_NETWORK_FAILURE;
+        }
+    } else {
+        ogs_assert(subscription_data->num_of_slice == 1);
+        slice_data = &subscription_data->slice[0];
 
-    memcpy(&mme_ue->ambr, &subscription_data->ambr, sizeof(ogs_bitrate_t));
+        memcpy(&mme_ue->profile->ambr, &subscription_data->ambr,
+                sizeof(ogs_bitrate_t));
 
-    mme_session_remove_all(mme_ue);
+        mme_session_remove_all(mme_ue);
 
-    num_of_session = mme_ue_session_from_slice_data(mme_ue, slice_data);
-    if (num_of_session == 0) {
-        ogs_error("No Session");
-        return OGS_NAS_EMM_CAUSE_SEVERE_NETWORK_FAILURE;
-    }
-    mme_ue->num_of_session = num_of_session;
+        num_of_session = mme_ue_session_from_slice_data(mme_ue, slice_data);
+        if (num_of_session == 0) {
+            ogs_error("No Session");
+            return OGS_NAS_EMM_CAUSE_SEVERE_NETWORK_FAILURE;
+        }
+        mme_ue->profile->num_of_session = num_of_session;
 
-    mme_ue->context_identifier = slice_data->context_identifier;
+        mme_ue->profile->context_identifier = slice_data->context_identifier;
+
+        mme_subscription_cache_put(mme_ue->imsi_bcd, mme_ue->profile);
+    }
 
     /* If there is no sos session and the config has specified to add one, we add one */
     if ((NULL == mme_emergency_session(mme_ue)) && (0 != mme_self()->default_emergency_session_type)) {
-        if (mme_ue->num_of_session < OGS_MAX_NUM_OF_SESS) {
+        if (mme_ue->profile->num_of_session < OGS_MAX_NUM_OF_SESS) {
             ogs_info("No sos session was present for UE, adding our default now...");
-            ogs_session_t *session = &mme_ue->session[mme_ue->num_of_session];
+            ogs_session_t *session = &mme_ue->profile->session[mme_ue->profile->num_of_session];
             
             session->name = ogs_strdup("sos");
             session->context_identifier = 0;
@@ -136,8 +163,8 @@ uint8_t mme_s6a_handle_ula(
             session->ambr.uplink = 128000;
             memset(&session->smf_ip, 0, sizeof(session->smf_ip));
 
-            mme_ue->num_of_session++;
-            ogs_debug("number of sessions is now %i", mme_ue->num_of_session);
+            mme_ue->profile->num_of_session++;
+            ogs_debug("number of sessions is now %i", mme_ue->profile->num_of_session);
         } else {
             ogs_error("Cannot add sos session to mme_ue, not enough session slots... rejecting UE...");
             return OGS_NAS_EMM_CAUSE_SEVERE_NETWORK_FAILURE;
@@ -205,7 +232,7 @@ uint8_t mme_s6a_handle_idr(
     ogs_assert(subscription_data);
 
     if (idr_message->subdatamask & OGS_DIAM_S6A_SUBDATA_UEAMBR) {
-        memcpy(&mme_ue->ambr, &subscription_data->ambr, sizeof(ogs_bitrate_t));
+        memcpy(&mme_ue->profile->ambr, &subscription_data->ambr, sizeof(ogs_bitrate_t));
     }
 
     if (idr_message->subdatamask & OGS_DIAM_S6A_SUBDATA_APN_CONFIG) {
@@ -220,14 +247,14 @@ uint8_t mme_s6a_handle_idr(
                 ogs_error("No Session");
                 return OGS_ERROR;
             }
-            mme_ue->num_of_session = num_of_session;
+            mme_ue->profile->num_of_session = num_of_session;
         } else {
             ogs_error ("[%d] Partial APN-Configuration Not Supported in IDR.",
                         slice_data->all_apn_config_inc);
             return OGS_ERROR;
         }
 
-        mme_ue->context_identifier = slice_data->context_identifier;
+        mme_ue->profile->context_identifier = slice_data->context_identifier;
     }
 
     return OGS_OK;
@@ -250,6 +277,8 @@ void mme_s6a_handle_clr(mme_ue_t *mme_ue, ogs_diam_s6a_message_t *s6a_message)
         return;
     }
 
+    CLEAR_AUTH_VECTORS(mme_ue);
+
     /*
      * This causes issues in this scenario:
      * 1. UE attaches
@@ -365,41 +394,41 @@ static uint8_t mme_ue_session_from_slice_data(mme_ue_t *mme_ue,
         }
 
         if (slice_data->session[i].name) {
-            mme_ue->session[i].name = ogs_strdup(slice_data->session[i].name);
-            ogs_assert(mme_ue->session[i].name);
+            mme_ue->profile->session[i].name = ogs_strdup(slice_data->session[i].name);
+            ogs_assert(mme_ue->profile->session[i].name);
         }
 
-        mme_ue->session[i].context_identifier =
+        mme_ue->profile->session[i].context_identifier =
             slice_data->session[i].context_identifier;
 
         if (slice_data->session[i].session_type == OGS_PDU_SESSION_TYPE_IPV4 ||
             slice_data->session[i].session_type == OGS_PDU_SESSION_TYPE_IPV6 ||
             slice_data->session[i].session_type ==
                 OGS_PDU_SESSION_TYPE_IPV4V6) {
-            mme_ue->session[i].session_type =
+            mme_ue->profile->session[i].session_type =
                 slice_data->session[i].session_type;
         } else {
             ogs_error("Invalid PDN_TYPE[%d]",
                 slice_data->session[i].session_type);
-            if (mme_ue->session[i].name)
-                ogs_free(mme_ue->session[i].name);
+            if (mme_ue->profile->session[i].name)
+                ogs_free(mme_ue->profile->session[i].name);
             break;
         }
-        memcpy(&mme_ue->session[i].paa, &slice_data->session[i].paa,
-                sizeof(mme_ue->session[i].paa));
+        memcpy(&mme_ue->profile->session[i].paa, &slice_data->session[i].paa,
+                sizeof(mme_ue->profile->session[i].paa));
 
-        memcpy(&mme_ue->session[i].qos, &slice_data->session[i].qos,
-                sizeof(mme_ue->session[i].qos));
-        memcpy(&mme_ue->session[i].ambr, &slice_data->session[i].ambr,
-                sizeof(mme_ue->session[i].ambr));
+        memcpy(&mme_ue->profile->session[i].qos, &slice_data->session[i].qos,
+                sizeof(mme_ue->profile->session[i].qos));
+        memcpy(&mme_ue->profile->session[i].ambr, &slice_data->session[i].ambr,
+                sizeof(mme_ue->profile->session[i].ambr));
 
-        memcpy(&mme_ue->session[i].smf_ip, &slice_data->session[i].smf_ip,
-                sizeof(mme_ue->session[i].smf_ip));
+        memcpy(&mme_ue->profile->session[i].smf_ip, &slice_data->session[i].smf_ip,
+                sizeof(mme_ue->profile->session[i].smf_ip));
 
-        memcpy(&mme_ue->session[i].charging_characteristics,
+        memcpy(&mme_ue->profile->session[i].charging_characteristics,
                 &slice_data->session[i].charging_characteristics,
-                sizeof(mme_ue->session[i].charging_characteristics));
-        mme_ue->session[i].charging_characteristics_presence =
+                sizeof(mme_ue->profile->session[i].charging_characteristics));
+        mme_ue->profile->session[i].charging_characteristics_presence =
             slice_data->session[i].charging_characteristics_presence;
     }
 
@@ -37,6 +37,52 @@
 #include "mme-s13-handler.h"
 #include "mme-path.h"
 #include "mme-redis.h"
+#include "mme-dns.h"
+#include "s1ap-decoder.h"
+
+/* A NULL s1ap_message means the PDU could not be decoded */
+static void s1ap_decoded_dispatch(mme_event_t *e,
+        mme_enb_t *enb, ogs_s1ap_message_t *s1ap_message)
+{
+    int r;
+
+    ogs_assert(e);
+    ogs_assert(enb);
+
+    if (s1ap_message) {
+        e->id = MME_EVENT_S1AP_MESSAGE;
+        e->enb = enb;
+        e->s1ap_message = s1ap_message;
+        ogs_fsm_dispatch(&enb->sm, e);
+    } else {
+        ogs_warn("Cannot decode S1AP message");
+        r = s1ap_send_error_indication(
+                enb, NULL, NULL, S1AP_Cause_PR_protocol,
+                S1AP_CauseProtocol_abstract_syntax_error_falsely_constructed_message);
+        ogs_expect(r == OGS_OK);
+        ogs_assert(r != OGS_ERROR);
+    }
+}
+
+/*
+ * S1AP and SBcAP PDUs decoded on the MME thread take their IEs from this
+ * arena; it is reset once the message has been handled.
+ */
+static ogs_arena_t *decode_arena;
+
+static void s1ap_message_dispatch(
+        mme_event_t *e, mme_enb_t *enb, ogs_pkbuf_t *pkbuf)
+{
+    ogs_s1ap_message_t s1ap_message;
+    int rc;
+
+    ogs_assert(pkbuf);
+
+    rc = ogs_s1ap_decode_arena(&s1ap_message, pkbuf, decode_arena);
+    s1ap_decoded_dispatch(e, enb, rc == OGS_OK ? &s1ap_message : NULL);
+
+    ogs_s1ap_free_arena(&s1ap_message, decode_arena);
+}
 
 void mme_state_initial(ogs_fsm_t *s, mme_event_t *e)
 {
@@ -44,6 +90,10 @@ void mme_state_initial(ogs_fsm_t *s, mme_event_t *e)
 
     ogs_assert(s);
 
+    decode_arena = ogs_arena_create(
+            OGS_ASN_ARENA_CHUNK_SIZE, OGS_ASN_ARENA_MAX_SIZE);
+    ogs_assert(decode_arena);
+
     OGS_FSM_TRAN(s, &mme_state_operational);
 }
 
@@ -52,6 +102,11 @@ void mme_state_final(ogs_fsm_t *s, mme_event_t *e)
     mme_sm_debug(e);
 
     ogs_assert(s);
+
+    if (decode_arena) {
+        ogs_arena_destroy(decode_arena);
+        decode_arena = NULL;
+    }
 }
 
 void mme_state_operational(ogs_fsm_t *s, mme_event_t *e)
@@ -64,7 +119,6 @@ void mme_state_operational(ogs_fsm_t *s, mme_event_t *e)
     mme_enb_t *enb = NULL;
     uint16_t max_num_of_ostreams = 0;
 
-    ogs_s1ap_message_t s1ap_message;
     ogs_pkbuf_t *pkbuf = NULL;
     int rc, r;
 
@@ -180,45 +234,103 @@ void mme_state_operational(ogs_fsm_t *s, mme_event_t *e)
     case MME_EVENT_S1AP_MESSAGE:
         sock = e->sock;
         ogs_assert(sock);
-        addr = e->addr;
-        ogs_assert(addr);
         pkbuf = e->pkbuf;
         ogs_assert(pkbuf);
 
-        ogs_assert(addr->ogs_sa_family == AF_INET ||
-                addr->ogs_sa_family == AF_INET6);
+        if (e->enb) {
+            /* Received on the eNB's own association */
+            enb = mme_enb_cycle(e->enb);
+            if (!enb || enb->sctp.sock != sock) {
+                ogs_warn("eNB has already been removed");
+                ogs_pkbuf_free(pkbuf);
+                break;
+            }
+        } else {
+            addr = e->addr;
+            ogs_assert(addr);
 
-        enb = mme_enb_find_by_addr(addr);
-        ogs_free(addr);
+            ogs_assert(addr->ogs_sa_family == AF_INET ||
+                    addr->ogs_sa_family == AF_INET6);
 
-        ogs_assert(enb);
+            enb = mme_enb_find_by_addr(addr);
+            ogs_free(addr);
+
+            ogs_assert(enb);
+        }
         ogs_assert(OGS_FSM_STATE(&enb->sm));
 
-        rc = ogs_s1ap_decode(&s1ap_message, pkbuf);
+        if (mme_self()->redis_dup_detection.enabled &&
+            mme_self()->redis_dup_detection.async) {
+            /* Comes back as MME_EVENT_S1AP_DUP_CHECKED */
+            redis_dup_check_async(enb->sctp.sock, enb, pkbuf);
+            break;
+        }
 
         bool is_dup = false;
         if (mme_self()->redis_dup_detection.enabled) {
-            is_dup = redis_is_message_dup(pkbuf->data, pkbuf->len);
+            is_dup = redis_is_message_dup(enb, pkbuf);
         }
 
         /* If the message is a duplicate then
          * we pretend we never got a message */
-        if (!is_dup) {
-            if (rc == OGS_OK) {
-                e->enb = enb;
-                e->s1ap_message = &s1ap_message;
-                ogs_fsm_dispatch(&enb->sm, e);
-            } else {
-                ogs_warn("Cannot decode S1AP message");
-                r = s1ap_send_error_indication(
-                        enb, NULL, NULL, S1AP_Cause_PR_protocol,
-                        S1AP_CauseProtocol_abstract_syntax_error_falsely_constructed_message);
-                ogs_expect(r == OGS_OK);
-                ogs_assert(r != OGS_ERROR);
-            }
+        if (is_dup) {
+            ogs_pkbuf_free(pkbuf);
+            break;
         }
 
-        ogs_s1ap_free(&s1ap_message);
+        if (s1ap_decoder_enabled()) {
+            /* Comes back as MME_EVENT_S1AP_DECODED */
+            s1ap_decoder_push(enb->sctp.sock, enb, pkbuf);
+            break;
+        }
+
+        s1ap_message_dispatch(e, enb, pkbuf);
+
+        ogs_pkbuf_free(pkbuf);
+        break;
+
+    case MME_EVENT_S1AP_DUP_CHECKED:
+        pkbuf = e->pkbuf;
+        ogs_assert(pkbuf);
+
+        /* The eNB may have gone while redis was being asked, and its
+         * slot may since have been taken by a new association */
+        enb = mme_enb_cycle(e->enb);
+        if (!enb || enb->sctp.sock != e->sock) {
+            ogs_warn("eNB has already been removed");
+            ogs_pkbuf_free(pkbuf);
+            break;
+        }
+        ogs_assert(OGS_FSM_STATE(&enb->sm));
+
+        if (s1ap_decoder_enabled()) {
+            s1ap_decoder_push(enb->sctp.sock, enb, pkbuf);
+            break;
+        }
+
+        /* From here on it is a regular S1AP message for the eNB FSM */
+        s1ap_message_dispatch(e, enb, pkbuf);
+
+        ogs_pkbuf_free(pkbuf);
+        break;
+
+    case MME_EVENT_S1AP_DECODED:
+        pkbuf = e->pkbuf;
+        ogs_assert(pkbuf);
+
+        /* The eNB may have gone while the PDU was being decoded */
+        enb = mme_enb_cycle(e->enb);
+        if (!enb || enb->sctp.sock != e->sock) {
+            ogs_warn("eNB has already been removed");
+        } else {
+            ogs_assert(OGS_FSM_STATE(&enb->sm));
+            s1ap_decoded_dispatch(e, enb, e->s1ap_message);
+        }
+
+        if (e->s1ap_message)
+            ogs_s1ap_free_arena(e->s1ap_message, e->s1ap_arena);
+        if (e->s1ap_arena)
+            ogs_arena_destroy(e->s1ap_arena);
         ogs_pkbuf_free(pkbuf);
         break;
 
@@ -333,10 +445,11 @@ void mme_state_operational(ogs_fsm_t *s, mme_event_t *e)
 
         ogs_sbcap_message_t sbcap_message = {};
         memset(&sbcap_message, 0, sizeof(sbcap_message));
-        rc = ogs_sbcap_decode(&sbcap_message, pkbuf);
+        rc = ogs_sbcap_decode_arena(&sbcap_message, pkbuf, decode_arena);
 
         if (OGS_OK != rc) {
             ogs_error("Failed to decode sbcab packet");
+            ogs_sbcap_free_arena(&sbcap_message, decode_arena);
             ogs_pkbuf_free(pkbuf);
             break;
         }
@@ -365,6 +478,7 @@ void mme_state_operational(ogs_fsm_t *s, mme_event_t *e)
                 break;
         }
 
+        ogs_sbcap_free_arena(&sbcap_message, decode_arena);
         ogs_pkbuf_free(pkbuf);
         break;
 
@@ -921,6 +1035,11 @@ void mme_state_operational(ogs_fsm_t *s, mme_event_t *e)
         CLEAR_SGW_S1U_PATH(sess);
         break;
 
+    case MME_EVENT_DNS_RESOLVED:
+        ogs_assert(e->dns_query);
+        mme_dns_handle_resolved(e->dns_query);
+        break;
+
     default:
         ogs_error("No handler for event %s", mme_event_get_name(e));
         break;
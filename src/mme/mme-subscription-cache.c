@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mme-subscription-cache.h"
+
+typedef struct cache_entry_s {
+    ogs_lnode_t lnode;          /* LRU, least recently used first */
+
+    char imsi_bcd[OGS_MAX_IMSI_BCD_LEN+1];
+    ogs_time_t expires;
+
+    mme_ue_profile_t profile;
+} cache_entry_t;
+
+static struct {
+    bool enabled;
+    ogs_thread_mutex_t mutex;
+
+    ogs_hash_t *hash;
+    ogs_list_t lru_list;
+    int num_of_entries;
+
+    int max_entries;
+    ogs_time_t ttl;
+} self;
+
+static cache_entry_t *entry_find(const char *imsi_bcd);
+static void entry_remove(cache_entry_t *entry);
+static void profile_copy(mme_ue_profile_t *dst, const mme_ue_profile_t *src);
+static void profile_clear(mme_ue_profile_t *profile);
+
+void mme_subscription_cache_init(int max_entries, ogs_time_t ttl)
+{
+    ogs_assert(max_entries > 0);
+    ogs_assert(ttl > 0);
+    ogs_assert(self.enabled == false);
+
+    self.hash = ogs_hash_make();
+    ogs_assert(self.hash);
+    ogs_list_init(&self.lru_list);
+    self.num_of_entries = 0;
+
+    self.max_entries = max_entries;
+    self.ttl = ttl;
+
+    ogs_thread_mutex_init(&self.mutex);
+    self.enabled = true;
+}
+
+void mme_subscription_cache_final(void)
+{
+    cache_entry_t *entry = NULL, *next_entry = NULL;
+
+    if (self.enabled == false) return;
+
+    ogs_list_for_each_safe(&self.lru_list, next_entry, entry)
+        entry_remove(entry);
+
+    ogs_hash_destroy(self.hash);
+    ogs_thread_mutex_destroy(&self.mutex);
+
+    memset(&self, 0, sizeof(self));
+}
+
+bool mme_subscription_cache_enabled(void)
+{
+    return self.enabled;
+}
+
+void mme_subscription_cache_put(
+        const char *imsi_bcd, const mme_ue_profile_t *profile)
+{
+    cache_entry_t *entry = NULL;
+
+    ogs_assert(imsi_bcd);
+    ogs_assert(profile);
+
+    if (self.enabled == false) return;
+    if (imsi_bcd[0] == '\0') return;
+
+    ogs_thread_mutex_lock(&self.mutex);
+
+    entry = ogs_hash_get(self.hash, imsi_bcd, OGS_HASH_KEY_STRING);
+    if (entry) entry_remove(entry);
+
+    if (self.num_of_entries >= self.max_entries)
+        entry_remove(ogs_list_first(&self.lru_list));
+
+    entry = ogs_calloc(1, sizeof(*entry));
+    ogs_assert(entry);
+
+    ogs_cpystrn(entry->imsi_bcd, imsi_bcd, sizeof(entry->imsi_bcd));
+    entry->expires = ogs_get_monotonic_time() + self.ttl;
+    profile_copy(&entry->profile, profile);
+
+    ogs_hash_set(self.hash, entry->imsi_bcd, OGS_HASH_KEY_STRING, entry);
+    ogs_list_add(&self.lru_list, entry);
+    self.num_of_entries++;
+
+    ogs_thread_mutex_unlock(&self.mutex);
+
+    ogs_debug("[%s] Subscription data cached", imsi_bcd);
+}
+
+bool mme_subscription_cache_get(
+        const char *imsi_bcd, mme_ue_profile_t *profile)
+{
+    cache_entry_t *entry = NULL;
+
+    ogs_assert(imsi_bcd);
+    ogs_assert(profile);
+
+    if (self.enabled == false) return false;
+
+    ogs_thread_mutex_lock(&self.mutex);
+
+    entry = entry_find(imsi_bcd);
+    if (entry) {
+        profile_clear(profile);
+        profile_copy(profile, &entry->profile);
+    }
+
+    ogs_thread_mutex_unlock(&self.mutex);
+
+    ogs_debug("[%s] Subscription data cache %s",
+            imsi_bcd, entry ? "hit" : "miss");
+
+    return entry != NULL;
+}
+
+void mme_subscription_cache_remove(const char *imsi_bcd)
+{
+    cache_entry_t *entry = NULL;
+
+    ogs_assert(imsi_bcd);
+
+    if (self.enabled == false) return;
+
+    ogs_thread_mutex_lock(&self.mutex);
+
+    entry = ogs_hash_get(self.hash, imsi_bcd, OGS_HASH_KEY_STRING);
+    if (entry) {
+        ogs_debug("[%s] Subscription data dropped from cache", imsi_bcd);
+        entry_remove(entry);
+    }
+
+    ogs_thread_mutex_unlock(&self.mutex);
+}
+
+int mme_subscription_cache_count(void)
+{
+    int count;
+
+    if (self.enabled == false) return 0;
+
+    ogs_thread_mutex_lock(&self.mutex);
+    count = self.num_of_entries;
+    ogs_thread_mutex_unlock(&self.mutex);
+
+    return count;
+}
+
+static cache_entry_t *entry_find(const char *imsi_bcd)
+{
+    cache_entry_t *entry = NULL;
+
+    ogs_assert(imsi_bcd);
+
+    entry = ogs_hash_get(self.hash, imsi_bcd, OGS_HASH_KEY_STRING);
+    if (entry == NULL) return NULL;
+
+    if (entry->expires <= ogs_get_monotonic_time()) {
+        entry_remove(entry);
+        return NULL;
+    }
+
+    /* Most recently used go last */
+    ogs_list_remove(&self.lru_list, entry);
+    ogs_list_add(&self.lru_list, entry);
+
+    return entry;
+}
+
+static void entry_remove(cache_entry_t *entry)
+{
+    ogs_assert(entry);
+
+    ogs_hash_set(self.hash, entry->imsi_bcd, OGS_HASH_KEY_STRING, NULL);
+    ogs_list_remove(&self.lru_list, entry);
+    self.num_of_entries--;
+
+    profile_clear(&entry->profile);
+    ogs_free(entry);
+}
+
+static void profile_copy(mme_ue_profile_t *dst, const mme_ue_profile_t *src)
+{
+    int i;
+
+    ogs_assert(dst);
+    ogs_assert(src);
+    ogs_assert(src->num_of_session <= OGS_MAX_NUM_OF_SESS);
+
+    memcpy(dst->msisdn, src->msisdn, sizeof(dst->msisdn));
+    dst->msisdn_len = src->msisdn_len;
+    memcpy(dst->msisdn_bcd, src->msisdn_bcd, sizeof(dst->msisdn_bcd));
+
+    memcpy(dst->a_msisdn, src->a_msisdn, sizeof(dst->a_msisdn));
+    dst->a_msisdn_len = src->a_msisdn_len;
+    memcpy(dst->a_msisdn_bcd, src->a_msisdn_bcd, sizeof(dst->a_msisdn_bcd));
+
+    memcpy(&dst->ambr, &src->ambr, sizeof(dst->ambr));
+    dst->network_access_mode = src->network_access_mode;
+    memcpy(dst->charging_characteristics, src->charging_characteristics,
+            sizeof(dst->charging_characteristics));
+    dst->charging_characteristics_presence =
+        src->charging_characteristics_presence;
+
+    dst->context_identifier = src->context_identifier;
+
+    for (i = 0; i < src->num_of_session; i++) {
+        memcpy(&dst->session[i], &src->session[i], sizeof(ogs_session_t));
+
+        if (src->session[i].name) {
+            dst->session[i].name = ogs_strdup(src->session[i].name);
+            ogs_assert(dst->session[i].name);
+        }
+
+        /* Not set from the subscription, looked up again when needed */
+        dst->session[i].ipv4_framed_routes = NULL;
+        dst->session[i].ipv6_framed_routes = NULL;
+        dst->session[i].pgw_addr = NULL;
+        dst->session[i].pgw_addr6 = NULL;
+    }
+    dst->num_of_session = src->num_of_session;
+}
+
+static void profile_clear(mme_ue_profile_t *profile)
+{
+    int i;
+
+    ogs_assert(profile);
+
+    for (i = 0; i < profile->num_of_session; i++) {
+        if (profile->session[i].name) {
+            ogs_free(profile->session[i].name);
+            profile->session[i].name = NULL;
+        }
+    }
+    profile->num_of_session = 0;
+}
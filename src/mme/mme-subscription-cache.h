@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MME_SUBSCRIPTION_CACHE_H
+#define MME_SUBSCRIPTION_CACHE_H
+
+#include "mme-context.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Subscription data of recently seen IMSIs (mme.subscription_cache).
+ *
+ * The entries outlive the UE context, so a UE that detaches and
+ * attaches again, or comes back with an inter-MME TAU, can send the
+ * Update-Location-Request with the Skip-Subscriber-Data flag and keep
+ * the profile from the cache when the HSS leaves Subscription-Data out
+ * of the answer (TS 29.272 7.3.7).
+ *
+ * Entries expire after the configured TTL, the least recently used one
+ * is evicted when the cache is full, and Insert-Subscriber-Data or
+ * Cancel-Location for the IMSI drops it. The IDR/CLR callbacks run on
+ * the freeDiameter thread, so the cache has its own lock.
+ */
+
+void mme_subscription_cache_init(int max_entries, ogs_time_t ttl);
+void mme_subscription_cache_final(void);
+bool mme_subscription_cache_enabled(void);
+
+/* Stores the subscription part of the profile, the auth vectors are
+ * not cached */
+void mme_subscription_cache_put(
+        const char *imsi_bcd, const mme_ue_profile_t *profile);
+/* On a hit, replaces the subscription part of the profile with the
+ * cached one and returns true. The profile is untouched on a miss */
+bool mme_subscription_cache_get(
+        const char *imsi_bcd, mme_ue_profile_t *profile);
+void mme_subscription_cache_remove(const char *imsi_bcd);
+
+int mme_subscription_cache_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MME_SUBSCRIPTION_CACHE_H */
@@ -157,6 +157,7 @@ int nas_eps_send_attach_accept(mme_ue_t *mme_ue)
         ogs_pkbuf_free(emmbuf);
         return OGS_ERROR;
     }
+    mme_retx_hold(mme_ue, mme_ue->t3450.pkbuf);
     ogs_timer_start(mme_ue->t3450.timer,
             mme_timer_cfg(MME_TIMER_T3450)->duration);
 
@@ -246,6 +247,7 @@ int nas_eps_send_identity_request(mme_ue_t *mme_ue)
 
     if (mme_ue->t3470.pkbuf) {
         emmbuf = mme_ue->t3470.pkbuf;
+        mme_retx_release(emmbuf);
     } else {
         emmbuf = emm_build_identity_request(mme_ue);
         if (!emmbuf) {
@@ -260,6 +262,7 @@ int nas_eps_send_identity_request(mme_ue_t *mme_ue)
         ogs_pkbuf_free(emmbuf);
         return OGS_ERROR;
     }
+    mme_retx_hold(mme_ue, mme_ue->t3470.pkbuf);
     ogs_timer_start(mme_ue->t3470.timer, 
             mme_timer_cfg(MME_TIMER_T3470)->duration);
 
@@ -288,6 +291,7 @@ int nas_eps_send_authentication_request(mme_ue_t *mme_ue)
 
     if (mme_ue->t3460.pkbuf) {
         emmbuf = mme_ue->t3460.pkbuf;
+        mme_retx_release(emmbuf);
     } else {
         emmbuf = emm_build_authentication_request(mme_ue);
         if (!emmbuf) {
@@ -302,6 +306,7 @@ int nas_eps_send_authentication_request(mme_ue_t *mme_ue)
         ogs_pkbuf_free(emmbuf);
         return OGS_ERROR;
     }
+    mme_retx_hold(mme_ue, mme_ue->t3460.pkbuf);
     ogs_timer_start(mme_ue->t3460.timer, 
             mme_timer_cfg(MME_TIMER_T3460)->duration);
 
@@ -330,6 +335,7 @@ int nas_eps_send_security_mode_command(mme_ue_t *mme_ue)
 
     if (mme_ue->t3460.pkbuf) {
         emmbuf = mme_ue->t3460.pkbuf;
+        mme_retx_release(emmbuf);
     } else {
         emmbuf = emm_build_security_mode_command(mme_ue);
         if (!emmbuf) {
@@ -344,6 +350,7 @@ int nas_eps_send_security_mode_command(mme_ue_t *mme_ue)
         ogs_pkbuf_free(emmbuf);
         return OGS_ERROR;
     }
+    mme_retx_hold(mme_ue, mme_ue->t3460.pkbuf);
     ogs_timer_start(mme_ue->t3460.timer, 
             mme_timer_cfg(MME_TIMER_T3460)->duration);
 
@@ -401,6 +408,7 @@ int nas_eps_send_detach_request(mme_ue_t *mme_ue)
 
     if (mme_ue->t3422.pkbuf) {
         emmbuf = mme_ue->t3422.pkbuf;
+        mme_retx_release(emmbuf);
     } else {
         emmbuf = emm_build_detach_request(mme_ue);
         if (!emmbuf) {
@@ -415,6 +423,7 @@ int nas_eps_send_detach_request(mme_ue_t *mme_ue)
         ogs_pkbuf_free(emmbuf);
         return OGS_ERROR;
     }
+    mme_retx_hold(mme_ue, mme_ue->t3422.pkbuf);
     ogs_timer_start(mme_ue->t3422.timer, 
             mme_timer_cfg(MME_TIMER_T3422)->duration);    
 
@@ -535,6 +544,7 @@ int nas_eps_send_esm_information_request(mme_bearer_t *bearer)
 
     if (bearer->t3489.pkbuf) {
         esmbuf = bearer->t3489.pkbuf;
+        mme_retx_release(esmbuf);
     } else {
         esmbuf = esm_build_information_request(bearer);
         if (!esmbuf) {
@@ -549,6 +559,7 @@ int nas_eps_send_esm_information_request(mme_bearer_t *bearer)
         ogs_pkbuf_free(esmbuf);
         return OGS_ERROR;
     }
+    mme_retx_hold(mme_ue, bearer->t3489.pkbuf);
     ogs_timer_start(bearer->t3489.timer, 
             mme_timer_cfg(MME_TIMER_T3489)->duration);
 
@@ -837,6 +848,7 @@ int nas_eps_send_tau_accept(
             ogs_pkbuf_free(emmbuf);
             return OGS_ERROR;
         }
+        mme_retx_hold(mme_ue, mme_ue->t3450.pkbuf);
         ogs_timer_start(mme_ue->t3450.timer,
                 mme_timer_cfg(MME_TIMER_T3450)->duration);
     }
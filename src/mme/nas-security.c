@@ -82,8 +82,8 @@ ogs_pkbuf_t *nas_eps_security_encode(
 
     if (ciphered) {
         /* encrypt NAS message */
-        ogs_nas_encrypt(mme_ue->selected_enc_algorithm,
-            mme_ue->knas_enc, mme_ue->dl_count, NAS_SECURITY_BEARER,
+        ogs_nas_encrypt_key(mme_ue->selected_enc_algorithm,
+            &mme_ue->nas_key, mme_ue->dl_count, NAS_SECURITY_BEARER,
             OGS_NAS_SECURITY_DOWNLINK_DIRECTION, new);
     }
 
@@ -95,8 +95,8 @@ ogs_pkbuf_t *nas_eps_security_encode(
         uint8_t mac[NAS_SECURITY_MAC_SIZE];
 
         /* calculate NAS MAC(message authentication code) */
-        ogs_nas_mac_calculate(mme_ue->selected_int_algorithm,
-            mme_ue->knas_int, mme_ue->dl_count, NAS_SECURITY_BEARER, 
+        ogs_nas_mac_calculate_key(mme_ue->selected_int_algorithm,
+            &mme_ue->nas_key, mme_ue->dl_count, NAS_SECURITY_BEARER, 
             OGS_NAS_SECURITY_DOWNLINK_DIRECTION, new, mac);
         memcpy(&h.message_authentication_code, mac, sizeof(mac));
     }
@@ -151,8 +151,8 @@ int nas_eps_security_decode(mme_ue_t *mme_ue,
         memcpy(original_mac, pkbuf->data + 2, SHORT_MAC_SIZE);
 
         ogs_pkbuf_trim(pkbuf, 2);
-        ogs_nas_mac_calculate(mme_ue->selected_int_algorithm,
-            mme_ue->knas_int, mme_ue->ul_count.i32, NAS_SECURITY_BEARER,
+        ogs_nas_mac_calculate_key(mme_ue->selected_int_algorithm,
+            &mme_ue->nas_key, mme_ue->ul_count.i32, NAS_SECURITY_BEARER,
             OGS_NAS_SECURITY_UPLINK_DIRECTION, pkbuf, mac);
 
         ogs_pkbuf_put_data(pkbuf, original_mac, SHORT_MAC_SIZE);
@@ -205,8 +205,8 @@ int nas_eps_security_decode(mme_ue_t *mme_ue,
             uint32_t original_mac = h->message_authentication_code;
 
             /* calculate NAS MAC(message authentication code) */
-            ogs_nas_mac_calculate(mme_ue->selected_int_algorithm,
-                mme_ue->knas_int, mme_ue->ul_count.i32, NAS_SECURITY_BEARER, 
+            ogs_nas_mac_calculate_key(mme_ue->selected_int_algorithm,
+                &mme_ue->nas_key, mme_ue->ul_count.i32, NAS_SECURITY_BEARER, 
                 OGS_NAS_SECURITY_UPLINK_DIRECTION, pkbuf, mac);
             h->message_authentication_code = original_mac;
 
@@ -223,8 +223,8 @@ int nas_eps_security_decode(mme_ue_t *mme_ue,
 
         if (security_header_type.ciphered) {
             /* decrypt NAS message */
-            ogs_nas_encrypt(mme_ue->selected_enc_algorithm,
-                mme_ue->knas_enc, mme_ue->ul_count.i32, NAS_SECURITY_BEARER,
+            ogs_nas_encrypt_key(mme_ue->selected_enc_algorithm,
+                &mme_ue->nas_key, mme_ue->ul_count.i32, NAS_SECURITY_BEARER,
                 OGS_NAS_SECURITY_UPLINK_DIRECTION, pkbuf);
         }
     }
@@ -354,14 +354,14 @@ ogs_pkbuf_t *s1ap_build_initial_context_setup_request(
     *ENB_UE_S1AP_ID = enb_ue->enb_ue_s1ap_id;
 
     ogs_debug("    AMBR[DL:%lld,UL:%lld]",
-        (long long)mme_ue->ambr.downlink, (long long)mme_ue->ambr.uplink);
+        (long long)mme_ue->profile->ambr.downlink, (long long)mme_ue->profile->ambr.uplink);
 
     asn_uint642INTEGER(
             &UEAggregateMaximumBitrate->uEaggregateMaximumBitRateUL, 
-            mme_ue->ambr.uplink);
+            mme_ue->profile->ambr.uplink);
     asn_uint642INTEGER(
             &UEAggregateMaximumBitrate->uEaggregateMaximumBitRateDL, 
-            mme_ue->ambr.downlink);
+            mme_ue->profile->ambr.downlink);
 
     ogs_list_for_each(&mme_ue->sess_list, sess) {
         ogs_list_for_each(&sess->bearer_list, bearer) {
@@ -605,9 +605,9 @@ ogs_pkbuf_t *s1ap_build_initial_context_setup_request(
 
         ogs_s1ap_buffer_to_OCTET_STRING(
             &mme_ue->tai.plmn_id, sizeof(ogs_plmn_id_t), &LAI->pLMNidentity);
-        ogs_assert(mme_ue->csmap);
+        ogs_assert(mme_ue->profile->csmap);
         ogs_assert(mme_ue->p_tmsi);
-        ogs_asn_uint16_to_OCTET_STRING(mme_ue->csmap->lai.lac, &LAI->lAC);
+        ogs_asn_uint16_to_OCTET_STRING(mme_ue->profile->csmap->lai.lac, &LAI->lAC);
 
     }
 
@@ -798,9 +798,9 @@ ogs_pkbuf_t *s1ap_build_ue_context_modification_request(mme_ue_t *mme_ue)
 
         ogs_s1ap_buffer_to_OCTET_STRING(
             &mme_ue->tai.plmn_id, sizeof(ogs_plmn_id_t), &LAI->pLMNidentity);
-        ogs_assert(mme_ue->csmap);
+        ogs_assert(mme_ue->profile->csmap);
         ogs_assert(mme_ue->p_tmsi);
-        ogs_asn_uint16_to_OCTET_STRING(mme_ue->csmap->lai.lac, &LAI->lAC);
+        ogs_asn_uint16_to_OCTET_STRING(mme_ue->profile->csmap->lai.lac, &LAI->lAC);
 
     } else {
         ie = CALLOC(1, sizeof(S1AP_UEContextModificationRequestIEs_t));
@@ -1282,10 +1282,10 @@ ogs_pkbuf_t *s1ap_build_e_rab_release_command(
     if (UEAggregateMaximumBitrate) {
         asn_uint642INTEGER(
                 &UEAggregateMaximumBitrate->uEaggregateMaximumBitRateUL,
-                mme_ue->ambr.uplink);
+                mme_ue->profile->ambr.uplink);
         asn_uint642INTEGER(
                 &UEAggregateMaximumBitrate->uEaggregateMaximumBitRateDL,
-                mme_ue->ambr.downlink);
+                mme_ue->profile->ambr.downlink);
     }
 
     item = CALLOC(1, sizeof(S1AP_E_RABItemIEs_t));
@@ -2151,10 +2151,10 @@ ogs_pkbuf_t *s1ap_build_handover_request(
 
     asn_uint642INTEGER(
             &UEAggregateMaximumBitrate->uEaggregateMaximumBitRateUL, 
-            mme_ue->ambr.uplink);
+            mme_ue->profile->ambr.uplink);
     asn_uint642INTEGER(
             &UEAggregateMaximumBitrate->uEaggregateMaximumBitRateDL, 
-            mme_ue->ambr.downlink);
+            mme_ue->profile->ambr.downlink);
 
     ogs_list_for_each(&mme_ue->sess_list, sess) {
         ogs_list_for_each(&sess->bearer_list, bearer) {
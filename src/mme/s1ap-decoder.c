@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "s1ap-decoder.h"
+
+typedef struct s1ap_decoder_worker_s {
+    ogs_thread_t *thread;
+    ogs_queue_t *queue;
+} s1ap_decoder_worker_t;
+
+static s1ap_decoder_worker_t *workers;
+static int num_of_workers;
+
+static void s1ap_decoder_main(void *data)
+{
+    s1ap_decoder_worker_t *worker = data;
+    mme_event_t *e = NULL;
+    ogs_s1ap_message_t *s1ap_message = NULL;
+    ogs_arena_t *arena = NULL;
+    int rv;
+
+    ogs_assert(worker);
+
+    for ( ;; ) {
+        rv = ogs_queue_pop(worker->queue, (void **)&e);
+        if (rv == OGS_DONE)
+            break;
+        if (rv != OGS_OK)
+            continue;
+
+        ogs_assert(e);
+        ogs_assert(e->pkbuf);
+
+        /*
+         * The message is freed on the MME thread, so each one gets an
+         * arena of its own, which also holds the message itself.
+         */
+        arena = ogs_arena_create(
+                OGS_ASN_ARENA_CHUNK_SIZE, OGS_ASN_ARENA_MAX_SIZE);
+        ogs_assert(arena);
+        s1ap_message = ogs_arena_calloc(arena, 1, sizeof(*s1ap_message));
+        ogs_assert(s1ap_message);
+
+        if (ogs_s1ap_decode_arena(s1ap_message, e->pkbuf, arena) == OGS_OK) {
+            e->s1ap_message = s1ap_message;
+            e->s1ap_arena = arena;
+        } else {
+            /* The MME thread answers with an Error Indication */
+            ogs_s1ap_free_arena(s1ap_message, arena);
+            ogs_arena_destroy(arena);
+        }
+
+        rv = ogs_queue_push(ogs_app()->queue, e);
+        if (rv != OGS_OK) {
+            ogs_error("ogs_queue_push() failed:%d", (int)rv);
+            if (e->s1ap_message) {
+                ogs_s1ap_free_arena(e->s1ap_message, e->s1ap_arena);
+                ogs_arena_destroy(e->s1ap_arena);
+            }
+            ogs_pkbuf_free(e->pkbuf);
+            mme_event_free(e);
+            continue;
+        }
+        ogs_pollset_notify(ogs_app()->pollset);
+    }
+}
+
+int s1ap_decoder_init(int num)
+{
+    int i;
+
+    ogs_assert(num > 0);
+    ogs_assert(workers == NULL);
+
+    workers = ogs_calloc(num, sizeof(*workers));
+    ogs_assert(workers);
+
+    for (i = 0; i < num; i++) {
+        workers[i].queue = ogs_queue_create(ogs_app()->pool.event);
+        ogs_assert(workers[i].queue);
+    }
+    num_of_workers = num;
+
+    for (i = 0; i < num; i++) {
+        workers[i].thread = ogs_thread_create(s1ap_decoder_main, &workers[i]);
+        if (!workers[i].thread) {
+            ogs_error("Cannot create S1AP decoder thread");
+            return OGS_ERROR;
+        }
+    }
+
+    ogs_info("S1AP decoding on %d worker thread(s)", num);
+
+    return OGS_OK;
+}
+
+/* Called once the MME thread has stopped taking events */
+void s1ap_decoder_final(void)
+{
+    mme_event_t *e = NULL;
+    int i;
+
+    if (!workers)
+        return;
+
+    for (i = 0; i < num_of_workers; i++) {
+        ogs_queue_term(workers[i].queue);
+        if (workers[i].thread)
+            ogs_thread_destroy(workers[i].thread);
+
+        while (ogs_queue_trypop(workers[i].queue, (void **)&e) == OGS_OK) {
+            ogs_pkbuf_free(e->pkbuf);
+            mme_event_free(e);
+        }
+        ogs_queue_destroy(workers[i].queue);
+    }
+
+    ogs_free(workers);
+    workers = NULL;
+    num_of_workers = 0;
+}
+
+bool s1ap_decoder_enabled(void)
+{
+    return workers != NULL;
+}
+
+void s1ap_decoder_push(ogs_sock_t *sock, mme_enb_t *enb, ogs_pkbuf_t *pkbuf)
+{
+    s1ap_decoder_worker_t *worker = NULL;
+    mme_event_t *e = NULL;
+    int rv;
+
+    ogs_assert(workers);
+    ogs_assert(sock);
+    ogs_assert(enb);
+    ogs_assert(pkbuf);
+
+    /* eNBs come from a pool, so the slot spreads them evenly */
+    worker = &workers[((uintptr_t)enb / sizeof(*enb)) % num_of_workers];
+
+    e = mme_event_new(MME_EVENT_S1AP_DECODED);
+    ogs_assert(e);
+    e->sock = sock;
+    e->enb = enb;
+    e->pkbuf = pkbuf;
+
+    rv = ogs_queue_push(worker->queue, e);
+    if (rv != OGS_OK) {
+        ogs_error("ogs_queue_push() failed:%d", (int)rv);
+        ogs_pkbuf_free(e->pkbuf);
+        mme_event_free(e);
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef S1AP_DECODER_H
+#define S1AP_DECODER_H
+
+#include "mme-context.h"
+#include "mme-event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * S1AP decode workers (mme.s1ap_decoder).
+ *
+ * ASN.1 decoding needs no MME context, so with workers configured the
+ * state machine hands each received S1AP PDU to a worker and gets it
+ * back fully decoded as MME_EVENT_S1AP_DECODED. All PDUs of an eNB go
+ * to the same worker, so they reach the eNB FSM in the order they were
+ * received. Everything that touches the context, NAS included, stays on
+ * the MME thread.
+ */
+
+int s1ap_decoder_init(int num_of_workers);
+void s1ap_decoder_final(void);
+bool s1ap_decoder_enabled(void);
+
+/* Takes over the pkbuf */
+void s1ap_decoder_push(ogs_sock_t *sock, mme_enb_t *enb, ogs_pkbuf_t *pkbuf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* S1AP_DECODER_H */
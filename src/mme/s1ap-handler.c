@@ -156,6 +156,7 @@ void s1ap_handle_s1_setup_request(mme_enb_t *enb, ogs_s1ap_message_t *message)
             enb->num_of_supported_ta_list++;
         }
     }
+    mme_enb_update_tai_index(enb);
 
     if (maximum_number_of_enbs_is_reached()) {
         ogs_warn("S1-Setup failure:");
@@ -81,6 +81,73 @@ int s1ap_send_to_enb(mme_enb_t *enb, ogs_pkbuf_t *pkbuf, uint16_t stream_no)
     }
 }
 
+static int broadcast_to_enb(
+        mme_enb_t *enb, ogs_pkbuf_t *pkbuf, uint16_t stream_no)
+{
+    ogs_pkbuf_t *sharebuf = NULL;
+    int rv;
+
+    sharebuf = ogs_pkbuf_share(pkbuf);
+    if (!sharebuf) {
+        ogs_error("ogs_pkbuf_share() failed");
+        return OGS_ERROR;
+    }
+
+    rv = s1ap_send_to_enb(enb, sharebuf, stream_no);
+    ogs_expect(rv == OGS_OK);
+
+    return rv;
+}
+
+/*
+ * Send one encoded PDU to every eNB supporting any of the TAIs,
+ * or to every eNB when num_of_tai is 0. Each eNB gets a pkbuf
+ * sharing the data of pkbuf, which is consumed.
+ */
+int s1ap_broadcast_to_enb(ogs_pkbuf_t *pkbuf,
+        ogs_eps_tai_t *tai, int num_of_tai, uint16_t stream_no)
+{
+    static uint32_t broadcast_seq = 0;
+    mme_enb_t *enb = NULL;
+    mme_enb_tai_t *link = NULL;
+    int i, rv = OGS_OK;
+
+    ogs_assert(pkbuf);
+
+    if (num_of_tai == 0) {
+        ogs_list_for_each(&mme_self()->enb_list, enb) {
+            if (broadcast_to_enb(enb, pkbuf, stream_no) != OGS_OK)
+                rv = OGS_ERROR;
+        }
+        ogs_pkbuf_free(pkbuf);
+        return rv;
+    }
+
+    ogs_assert(tai);
+
+    /* An eNB supporting several of the TAIs is sent the PDU once */
+    if (++broadcast_seq == 0)
+        broadcast_seq++;
+
+    for (i = 0; i < num_of_tai; i++) {
+        for (link = mme_enb_tai_first(&tai[i]); link;
+                link = ogs_list_next(link)) {
+            enb = link->enb;
+            ogs_assert(enb);
+
+            if (enb->broadcast_seq == broadcast_seq)
+                continue;
+            enb->broadcast_seq = broadcast_seq;
+
+            if (broadcast_to_enb(enb, pkbuf, stream_no) != OGS_OK)
+                rv = OGS_ERROR;
+        }
+    }
+
+    ogs_pkbuf_free(pkbuf);
+    return rv;
+}
+
 int s1ap_send_to_enb_ue(enb_ue_t *enb_ue, ogs_pkbuf_t *pkbuf)
 {
     int rv;
@@ -408,8 +475,6 @@ int s1ap_send_ue_context_release_command(
 int s1ap_send_paging(mme_ue_t *mme_ue, S1AP_CNDomain_t cn_domain)
 {
     ogs_pkbuf_t *s1apbuf = NULL;
-    mme_enb_t *enb = NULL;
-    int i;
     int rv;
 
     ogs_debug("S1-Paging");
@@ -424,37 +489,28 @@ int s1ap_send_paging(mme_ue_t *mme_ue, S1AP_CNDomain_t cn_domain)
         return OGS_ERROR;
     }
 
-    /* Find enB with matched TAI */
-    ogs_list_for_each(&mme_self()->enb_list, enb) {
-        for (i = 0; i < enb->num_of_supported_ta_list; i++) {
-
-            if (memcmp(&enb->supported_ta_list[i], &mme_ue->tai,
-                        sizeof(ogs_eps_tai_t)) == 0) {
-
-                if (mme_ue->t3413.pkbuf) {
-                    s1apbuf = mme_ue->t3413.pkbuf;
-                } else {
-                    s1apbuf = s1ap_build_paging(mme_ue, cn_domain);
-                    if (!s1apbuf) {
-                        ogs_error("s1ap_build_paging() failed");
-                        return OGS_ERROR;
-                    }
-                }
-
-                mme_ue->t3413.pkbuf = ogs_pkbuf_copy(s1apbuf);
-                if (!mme_ue->t3413.pkbuf) {
-                    ogs_error("ogs_pkbuf_copy() failed");
-                    ogs_pkbuf_free(s1apbuf);
-                    return OGS_ERROR;
-                }
-
-                rv = s1ap_send_to_enb(enb, s1apbuf, S1AP_NON_UE_SIGNALLING);
-                if (rv != OGS_OK) {
-                    ogs_error("s1ap_send_to_enb() failed");
-                    return rv;
-                }
-            }
+    /* Kept for retransmission on T3413 expiry */
+    if (!mme_ue->t3413.pkbuf) {
+        mme_ue->t3413.pkbuf = s1ap_build_paging(mme_ue, cn_domain);
+        if (!mme_ue->t3413.pkbuf) {
+            ogs_error("s1ap_build_paging() failed");
+            return OGS_ERROR;
         }
+        mme_retx_hold(mme_ue, mme_ue->t3413.pkbuf);
+    }
+
+    s1apbuf = ogs_pkbuf_share(mme_ue->t3413.pkbuf);
+    if (!s1apbuf) {
+        ogs_error("ogs_pkbuf_share() failed");
+        return OGS_ERROR;
+    }
+
+    /* Send to eNBs with matched TAI */
+    rv = s1ap_broadcast_to_enb(
+            s1apbuf, &mme_ue->tai, 1, S1AP_NON_UE_SIGNALLING);
+    if (rv != OGS_OK) {
+        ogs_error("s1ap_broadcast_to_enb() failed");
+        return rv;
     }
 
     /* Start T3413 */
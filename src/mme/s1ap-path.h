@@ -30,6 +30,7 @@ extern "C" {
 #define S1AP_NON_UE_SIGNALLING   0
 
 #define s1ap_event_push  mme_sctp_event_push
+#define s1ap_message_push  mme_sctp_message_push
 
 int s1ap_open(void);
 void s1ap_close(void);
@@ -40,6 +41,8 @@ void s1ap_recv_upcall(short when, ogs_socket_t fd, void *data);
 int s1ap_send_to_enb(
         mme_enb_t *enb, ogs_pkbuf_t *pkb, uint16_t stream_no);
 int s1ap_send_to_enb_ue(enb_ue_t *enb_ue, ogs_pkbuf_t *pkbuf);
+int s1ap_broadcast_to_enb(ogs_pkbuf_t *pkbuf,
+        ogs_eps_tai_t *tai, int num_of_tai, uint16_t stream_no);
 int s1ap_delayed_send_to_enb_ue(enb_ue_t *enb_ue,
         ogs_pkbuf_t *pkbuf, ogs_time_t duration);
 int s1ap_send_to_nas(enb_ue_t *enb_ue,
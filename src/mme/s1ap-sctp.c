@@ -28,8 +28,11 @@ static void usrsctp_recv_handler(struct socket *socket, void *data, int flags);
 static void lksctp_accept_handler(short when, ogs_socket_t fd, void *data);
 #endif
 
+/* Messages drained from one socket before yielding to the event loop */
+#define S1AP_RECV_BUDGET            32
+
 void s1ap_accept_handler(ogs_sock_t *sock);
-void s1ap_recv_handler(ogs_sock_t *sock);
+void s1ap_recv_handler(ogs_sock_t *sock, mme_enb_t *enb);
 
 ogs_sock_t *s1ap_server(ogs_socknode_t *node)
 {
@@ -67,13 +70,14 @@ ogs_sock_t *s1ap_server(ogs_socknode_t *node)
 
 void s1ap_recv_upcall(short when, ogs_socket_t fd, void *data)
 {
-    ogs_sock_t *sock = NULL;
+    mme_enb_t *enb = NULL;
 
     ogs_assert(fd != INVALID_SOCKET);
-    sock = data;
-    ogs_assert(sock);
+    enb = data;
+    ogs_assert(enb);
+    ogs_assert(enb->sctp.sock);
 
-    s1ap_recv_handler(sock);
+    s1ap_recv_handler(enb->sctp.sock, enb);
 }
 
 #if HAVE_USRSCTP
@@ -83,7 +87,7 @@ static void usrsctp_recv_handler(struct socket *socket, void *data, int flags)
 
     while ((events = usrsctp_get_events(socket)) &&
            (events & SCTP_EVENT_READ)) {
-        s1ap_recv_handler((ogs_sock_t *)socket);
+        s1ap_recv_handler((ogs_sock_t *)socket, NULL);
     }
 }
 #else
@@ -120,135 +124,168 @@ void s1ap_accept_handler(ogs_sock_t *sock)
     }
 }
 
-void s1ap_recv_handler(ogs_sock_t *sock)
+/*
+ * Handle one SCTP notification. Returns false once the association is
+ * going away, so the caller stops draining the socket.
+ */
+static bool s1ap_recv_notification(ogs_sock_t *sock,
+        ogs_sockaddr_t *from, union sctp_notification *not, int flags)
 {
-    ogs_pkbuf_t *pkbuf;
-    int size;
     ogs_sockaddr_t *addr = NULL;
-    ogs_sockaddr_t from;
-    ogs_sctp_info_t sinfo;
-    int flags = 0;
 
-    ogs_assert(sock);
+    switch(not->sn_header.sn_type) {
+    case SCTP_ASSOC_CHANGE :
+        ogs_debug("SCTP_ASSOC_CHANGE:"
+                "[T:%d, F:0x%x, S:%d, I/O:%d/%d]", 
+                not->sn_assoc_change.sac_type,
+                not->sn_assoc_change.sac_flags,
+                not->sn_assoc_change.sac_state,
+                not->sn_assoc_change.sac_inbound_streams,
+                not->sn_assoc_change.sac_outbound_streams);
 
-    pkbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
-    ogs_assert(pkbuf);
-    ogs_pkbuf_put(pkbuf, OGS_MAX_SDU_LEN);
-    size = ogs_sctp_recvmsg(
-            sock, pkbuf->data, pkbuf->len, &from, &sinfo, &flags);
-    if (size < 0 || size >= OGS_MAX_SDU_LEN) {
-        ogs_error("ogs_sctp_recvmsg(%d) failed(%d:%s)",
-                size, errno, strerror(errno));
-        ogs_pkbuf_free(pkbuf);
-        return;
-    }
+        if (not->sn_assoc_change.sac_state == SCTP_COMM_UP) {
+            ogs_debug("SCTP_COMM_UP");
 
-    if (flags & MSG_NOTIFICATION) {
-        union sctp_notification *not =
-            (union sctp_notification *)pkbuf->data;
-
-        switch(not->sn_header.sn_type) {
-        case SCTP_ASSOC_CHANGE :
-            ogs_debug("SCTP_ASSOC_CHANGE:"
-                    "[T:%d, F:0x%x, S:%d, I/O:%d/%d]", 
-                    not->sn_assoc_change.sac_type,
-                    not->sn_assoc_change.sac_flags,
-                    not->sn_assoc_change.sac_state,
+            addr = ogs_calloc(1, sizeof(ogs_sockaddr_t));
+            ogs_assert(addr);
+            memcpy(addr, from, sizeof(ogs_sockaddr_t));
+
+            s1ap_event_push(MME_EVENT_S1AP_LO_SCTP_COMM_UP,
+                    sock, addr, NULL,
                     not->sn_assoc_change.sac_inbound_streams,
                     not->sn_assoc_change.sac_outbound_streams);
+        } else if (not->sn_assoc_change.sac_state == SCTP_SHUTDOWN_COMP ||
+                not->sn_assoc_change.sac_state == SCTP_COMM_LOST) {
 
-            if (not->sn_assoc_change.sac_state == SCTP_COMM_UP) {
-                ogs_debug("SCTP_COMM_UP");
-
-                addr = ogs_calloc(1, sizeof(ogs_sockaddr_t));
-                ogs_assert(addr);
-                memcpy(addr, &from, sizeof(ogs_sockaddr_t));
-
-                s1ap_event_push(MME_EVENT_S1AP_LO_SCTP_COMM_UP,
-                        sock, addr, NULL,
-                        not->sn_assoc_change.sac_inbound_streams,
-                        not->sn_assoc_change.sac_outbound_streams);
-            } else if (not->sn_assoc_change.sac_state == SCTP_SHUTDOWN_COMP ||
-                    not->sn_assoc_change.sac_state == SCTP_COMM_LOST) {
-
-                if (not->sn_assoc_change.sac_state == SCTP_SHUTDOWN_COMP)
-                    ogs_debug("SCTP_SHUTDOWN_COMP");
-                if (not->sn_assoc_change.sac_state == SCTP_COMM_LOST)
-                    ogs_debug("SCTP_COMM_LOST");
-
-                addr = ogs_calloc(1, sizeof(ogs_sockaddr_t));
-                ogs_assert(addr);
-                memcpy(addr, &from, sizeof(ogs_sockaddr_t));
-
-                s1ap_event_push(MME_EVENT_S1AP_LO_CONNREFUSED,
-                        sock, addr, NULL, 0, 0);
-            }
-            break;
-
-        case SCTP_SHUTDOWN_EVENT :
-            ogs_debug("SCTP_SHUTDOWN_EVENT:[T:%d, F:0x%x, L:%d]",
-                    not->sn_shutdown_event.sse_type,
-                    not->sn_shutdown_event.sse_flags,
-                    not->sn_shutdown_event.sse_length);
+            if (not->sn_assoc_change.sac_state == SCTP_SHUTDOWN_COMP)
+                ogs_debug("SCTP_SHUTDOWN_COMP");
+            if (not->sn_assoc_change.sac_state == SCTP_COMM_LOST)
+                ogs_debug("SCTP_COMM_LOST");
 
             addr = ogs_calloc(1, sizeof(ogs_sockaddr_t));
             ogs_assert(addr);
-            memcpy(addr, &from, sizeof(ogs_sockaddr_t));
+            memcpy(addr, from, sizeof(ogs_sockaddr_t));
 
             s1ap_event_push(MME_EVENT_S1AP_LO_CONNREFUSED,
                     sock, addr, NULL, 0, 0);
-            break;
+            return false;
+        }
+        break;
+
+    case SCTP_SHUTDOWN_EVENT :
+        ogs_debug("SCTP_SHUTDOWN_EVENT:[T:%d, F:0x%x, L:%d]",
+                not->sn_shutdown_event.sse_type,
+                not->sn_shutdown_event.sse_flags,
+                not->sn_shutdown_event.sse_length);
 
-        case SCTP_SEND_FAILED :
+        addr = ogs_calloc(1, sizeof(ogs_sockaddr_t));
+        ogs_assert(addr);
+        memcpy(addr, from, sizeof(ogs_sockaddr_t));
+
+        s1ap_event_push(MME_EVENT_S1AP_LO_CONNREFUSED,
+                sock, addr, NULL, 0, 0);
+        return false;
+
+    case SCTP_SEND_FAILED :
 #if HAVE_USRSCTP
-            ogs_error("SCTP_SEND_FAILED:[T:%d, F:0x%x, S:%d]",
-                    not->sn_send_failed_event.ssfe_type,
-                    not->sn_send_failed_event.ssfe_flags,
-                    not->sn_send_failed_event.ssfe_error);
+        ogs_error("SCTP_SEND_FAILED:[T:%d, F:0x%x, S:%d]",
+                not->sn_send_failed_event.ssfe_type,
+                not->sn_send_failed_event.ssfe_flags,
+                not->sn_send_failed_event.ssfe_error);
 #else
-            ogs_error("SCTP_SEND_FAILED:[T:%d, F:0x%x, S:%d]",
-                    not->sn_send_failed.ssf_type,
-                    not->sn_send_failed.ssf_flags,
-                    not->sn_send_failed.ssf_error);
+        ogs_error("SCTP_SEND_FAILED:[T:%d, F:0x%x, S:%d]",
+                not->sn_send_failed.ssf_type,
+                not->sn_send_failed.ssf_flags,
+                not->sn_send_failed.ssf_error);
 #endif
-            break;
-
-        case SCTP_PEER_ADDR_CHANGE:
-            ogs_warn("SCTP_PEER_ADDR_CHANGE:[T:%d, F:0x%x, S:%d]", 
-                    not->sn_paddr_change.spc_type,
-                    not->sn_paddr_change.spc_flags,
-                    not->sn_paddr_change.spc_error);
-            break;
-        case SCTP_REMOTE_ERROR:
-            ogs_warn("SCTP_REMOTE_ERROR:[T:%d, F:0x%x, S:%d]", 
-                    not->sn_remote_error.sre_type,
-                    not->sn_remote_error.sre_flags,
-                    not->sn_remote_error.sre_error);
-            break;
-        default :
-            ogs_error("Discarding event with unknown flags:0x%x type:0x%x",
-                    flags, not->sn_header.sn_type);
-            break;
+        break;
+
+    case SCTP_PEER_ADDR_CHANGE:
+        ogs_warn("SCTP_PEER_ADDR_CHANGE:[T:%d, F:0x%x, S:%d]", 
+                not->sn_paddr_change.spc_type,
+                not->sn_paddr_change.spc_flags,
+                not->sn_paddr_change.spc_error);
+        break;
+    case SCTP_REMOTE_ERROR:
+        ogs_warn("SCTP_REMOTE_ERROR:[T:%d, F:0x%x, S:%d]", 
+                not->sn_remote_error.sre_type,
+                not->sn_remote_error.sre_flags,
+                not->sn_remote_error.sre_error);
+        break;
+    default :
+        ogs_error("Discarding event with unknown flags:0x%x type:0x%x",
+                flags, not->sn_header.sn_type);
+        break;
+    }
+
+    return true;
+}
+
+/*
+ * Drain up to S1AP_RECV_BUDGET messages from the socket per wakeup.
+ *
+ * Each message is received into a scratch buffer on the stack and then
+ * copied into a pkbuf of exactly its size, so a burst no longer pins a
+ * 32 KB cluster per message. When the socket belongs to a known eNB
+ * (one-to-one lksctp association), the eNB is carried in the event;
+ * otherwise (usrsctp one-to-many socket) the peer address is copied
+ * and the eNB is looked up in the state machine as before.
+ */
+void s1ap_recv_handler(ogs_sock_t *sock, mme_enb_t *enb)
+{
+    uint8_t buf[OGS_MAX_SDU_LEN];
+    ogs_pkbuf_t *pkbuf;
+    int size, n;
+    ogs_sockaddr_t *addr = NULL;
+    ogs_sockaddr_t from;
+    ogs_sctp_info_t sinfo;
+    int flags;
+
+    ogs_assert(sock);
+
+    for (n = 0; n < S1AP_RECV_BUDGET; n++) {
+        flags = 0;
+        size = ogs_sctp_recvmsg(
+                sock, buf, sizeof(buf), &from, &sinfo, &flags);
+        if (size < 0 || size >= OGS_MAX_SDU_LEN) {
+            /* The socket is drained */
+            if (size < 0 && n > 0 && ogs_socket_errno == OGS_EAGAIN)
+                return;
+
+            ogs_error("ogs_sctp_recvmsg(%d) failed(%d:%s)",
+                    size, errno, strerror(errno));
+            return;
         }
-    } else if (flags & MSG_EOR) {
-        ogs_pkbuf_trim(pkbuf, size);
 
-        addr = ogs_calloc(1, sizeof(ogs_sockaddr_t));
-        ogs_assert(addr);
-        memcpy(addr, &from, sizeof(ogs_sockaddr_t));
+        if (flags & MSG_NOTIFICATION) {
+            if (s1ap_recv_notification(sock, &from,
+                        (union sctp_notification *)buf, flags) == false)
+                return;
+        } else if (flags & MSG_EOR) {
+            pkbuf = ogs_pkbuf_alloc(NULL, size);
+            ogs_assert(pkbuf);
+            ogs_pkbuf_put_data(pkbuf, buf, size);
+
+            if (enb) {
+                s1ap_message_push(MME_EVENT_S1AP_MESSAGE, sock, enb, pkbuf);
+            } else {
+                addr = ogs_calloc(1, sizeof(ogs_sockaddr_t));
+                ogs_assert(addr);
+                memcpy(addr, &from, sizeof(ogs_sockaddr_t));
 
-        s1ap_event_push(MME_EVENT_S1AP_MESSAGE, sock, addr, pkbuf, 0, 0);
-        return;
-    } else {
-        if (ogs_socket_errno != OGS_EAGAIN) {
-            ogs_fatal("ogs_sctp_recvmsg(%d) failed(%d:%s-0x%x)",
-                    size, errno, strerror(errno), flags);
-            ogs_assert_if_reached();
+                s1ap_event_push(MME_EVENT_S1AP_MESSAGE,
+                        sock, addr, pkbuf, 0, 0);
+            }
         } else {
-            ogs_error("ogs_sctp_recvmsg(%d) failed(%d:%s-0x%x)",
-                    size, errno, strerror(errno), flags);
+            if (ogs_socket_errno != OGS_EAGAIN) {
+                ogs_fatal("ogs_sctp_recvmsg(%d) failed(%d:%s-0x%x)",
+                        size, errno, strerror(errno), flags);
+                ogs_assert_if_reached();
+            } else {
+                ogs_error("ogs_sctp_recvmsg(%d) failed(%d:%s-0x%x)",
+                        size, errno, strerror(errno), flags);
+            }
+            return;
         }
     }
-
-    ogs_pkbuf_free(pkbuf);
 }
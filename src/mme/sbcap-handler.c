@@ -22,43 +22,99 @@
 #include "s1ap-build.h"
 #include "sbcap-handler.h"
 
-/* Builds and sends a Write-Replace-Warning-Request to all eNBs over S1AP */
-void sbcap_handle_write_replace_warning_request(SBcAP_Write_Replace_Warning_Request_t *request)
+#define MAX_NUM_OF_WARNING_TAI (OGS_MAX_NUM_OF_TAI*OGS_MAX_NUM_OF_BPLMN)
+
+/*
+ * Converts the List of TAIs used to select the target eNBs.
+ * Returns 0 if the list is absent or too long, meaning every eNB.
+ */
+static int warning_tai_list(
+        SBcAP_List_of_TAIs_t *List_of_TAIs, ogs_eps_tai_t *tai)
 {
-    mme_enb_t *enb = NULL;
+    int i, num_of_tai = 0;
+
+    if (!List_of_TAIs)
+        return 0;
 
-    ogs_list_for_each(&mme_self()->enb_list, enb) {
-        int rv;
-        ogs_pkbuf_t *s1apbuf = NULL;
+    if (List_of_TAIs->list.count > MAX_NUM_OF_WARNING_TAI) {
+        ogs_warn("Too many TAIs [%d], sending to all eNBs",
+                List_of_TAIs->list.count);
+        return 0;
+    }
 
-        s1apbuf = s1ap_build_write_replace_warning_request(request);
-        if (!s1apbuf) {
-            ogs_error("s1ap_build_write_replace_warning_request() failed");
-            return;
+    for (i = 0; i < List_of_TAIs->list.count; i++) {
+        List_of_TAIs__Member *member = List_of_TAIs->list.array[i];
+        ogs_assert(member);
+
+        if (member->tai.pLMNidentity.size != sizeof(ogs_plmn_id_t) ||
+            member->tai.tAC.size != sizeof(uint16_t)) {
+            ogs_error("Invalid TAI [PLMN:%d TAC:%d]",
+                    (int)member->tai.pLMNidentity.size,
+                    (int)member->tai.tAC.size);
+            continue;
         }
 
-        /* Send to enb */
-        rv = s1ap_send_to_enb(enb, s1apbuf, S1AP_NON_UE_SIGNALLING);
-        ogs_expect(rv == OGS_OK);
+        memcpy(&tai[num_of_tai].plmn_id,
+                member->tai.pLMNidentity.buf, sizeof(ogs_plmn_id_t));
+        memcpy(&tai[num_of_tai].tac,
+                member->tai.tAC.buf, sizeof(uint16_t));
+        tai[num_of_tai].tac = be16toh(tai[num_of_tai].tac);
+        num_of_tai++;
     }
+
+    return num_of_tai;
 }
 
-void sbcap_handle_stop_warning_request(SBcAP_Stop_Warning_Request_t *request)
+/* Builds a Write-Replace-Warning-Request once and sends it over S1AP to
+ * the eNBs in the List of TAIs, or to all eNBs if there is none */
+void sbcap_handle_write_replace_warning_request(SBcAP_Write_Replace_Warning_Request_t *request)
 {
-    mme_enb_t *enb = NULL;
+    SBcAP_List_of_TAIs_t *List_of_TAIs = NULL;
+    ogs_eps_tai_t tai[MAX_NUM_OF_WARNING_TAI];
+    int i, num_of_tai, rv;
+    ogs_pkbuf_t *s1apbuf = NULL;
 
-    ogs_list_for_each(&mme_self()->enb_list, enb) {
-        int rv;
-        ogs_pkbuf_t *s1apbuf = NULL;
+    for (i = 0; i < request->protocolIEs.list.count; i++) {
+        SBcAP_Write_Replace_Warning_Request_IEs_t *ie =
+            request->protocolIEs.list.array[i];
+        if (ie->id == SBcAP_ProtocolIE_ID_List_of_TAIs)
+            List_of_TAIs = &ie->value.choice.List_of_TAIs;
+    }
+    num_of_tai = warning_tai_list(List_of_TAIs, tai);
 
-        s1apbuf = s1ap_build_kill_request(request);
-        if (!s1apbuf) {
-            ogs_error("s1ap_build_kill_request() failed");
-            return;
-        }
+    s1apbuf = s1ap_build_write_replace_warning_request(request);
+    if (!s1apbuf) {
+        ogs_error("s1ap_build_write_replace_warning_request() failed");
+        return;
+    }
+
+    rv = s1ap_broadcast_to_enb(
+            s1apbuf, tai, num_of_tai, S1AP_NON_UE_SIGNALLING);
+    ogs_expect(rv == OGS_OK);
+}
+
+void sbcap_handle_stop_warning_request(SBcAP_Stop_Warning_Request_t *request)
+{
+    SBcAP_List_of_TAIs_t *List_of_TAIs = NULL;
+    ogs_eps_tai_t tai[MAX_NUM_OF_WARNING_TAI];
+    int i, num_of_tai, rv;
+    ogs_pkbuf_t *s1apbuf = NULL;
 
-        /* Send to enb */
-        rv = s1ap_send_to_enb(enb, s1apbuf, S1AP_NON_UE_SIGNALLING);
-        ogs_expect(rv == OGS_OK);
+    for (i = 0; i < request->protocolIEs.list.count; i++) {
+        SBcAP_Stop_Warning_Request_IEs_t *ie =
+            request->protocolIEs.list.array[i];
+        if (ie->id == SBcAP_ProtocolIE_ID_List_of_TAIs)
+            List_of_TAIs = &ie->value.choice.List_of_TAIs;
     }
+    num_of_tai = warning_tai_list(List_of_TAIs, tai);
+
+    s1apbuf = s1ap_build_kill_request(request);
+    if (!s1apbuf) {
+        ogs_error("s1ap_build_kill_request() failed");
+        return;
+    }
+
+    rv = s1ap_broadcast_to_enb(
+            s1apbuf, tai, num_of_tai, S1AP_NON_UE_SIGNALLING);
+    ogs_expect(rv == OGS_OK);
 }
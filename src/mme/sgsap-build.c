@@ -38,7 +38,7 @@ ogs_pkbuf_t *sgsap_build_location_update_request(mme_ue_t *mme_ue)
     ogs_e_cgi_t e_cgi;
 
     ogs_assert(mme_ue);
-    csmap = mme_ue->csmap;
+    csmap = mme_ue->profile->csmap;
     ogs_assert(csmap);
     vlr = csmap->vlr;
     ogs_assert(vlr);
@@ -99,7 +99,7 @@ ogs_pkbuf_t *sgsap_build_tmsi_reallocation_complete(mme_ue_t *mme_ue)
     ogs_pkbuf_t *pkbuf = NULL;
 
     ogs_assert(mme_ue);
-    csmap = mme_ue->csmap;
+    csmap = mme_ue->profile->csmap;
     ogs_assert(csmap);
     vlr = csmap->vlr;
     ogs_assert(vlr);
@@ -138,7 +138,7 @@ ogs_pkbuf_t *sgsap_build_detach_indication(mme_ue_t *mme_ue)
     uint8_t indication = SGSAP_EPS_DETACH_UE_INITIATED;
 
     ogs_assert(mme_ue);
-    csmap = mme_ue->csmap;
+    csmap = mme_ue->profile->csmap;
     ogs_assert(csmap);
     vlr = csmap->vlr;
     ogs_assert(vlr);
@@ -216,7 +216,7 @@ ogs_pkbuf_t *sgsap_build_mo_csfb_indication(mme_ue_t *mme_ue)
     ogs_pkbuf_t *pkbuf = NULL;
 
     ogs_assert(mme_ue);
-    csmap = mme_ue->csmap;
+    csmap = mme_ue->profile->csmap;
     ogs_assert(csmap);
     vlr = csmap->vlr;
     ogs_assert(vlr);
@@ -283,7 +283,7 @@ ogs_pkbuf_t *sgsap_build_service_request(mme_ue_t *mme_ue, uint8_t emm_mode)
     ogs_pkbuf_t *pkbuf = NULL;
 
     ogs_assert(mme_ue);
-    csmap = mme_ue->csmap;
+    csmap = mme_ue->profile->csmap;
     ogs_assert(csmap);
     vlr = csmap->vlr;
     ogs_assert(vlr);
@@ -364,7 +364,7 @@ ogs_pkbuf_t *sgsap_build_uplink_unidata(mme_ue_t *mme_ue,
     ogs_assert(nas_message_container);
 
     ogs_assert(mme_ue);
-    csmap = mme_ue->csmap;
+    csmap = mme_ue->profile->csmap;
     ogs_assert(csmap);
     vlr = csmap->vlr;
     ogs_assert(vlr);
@@ -401,7 +401,7 @@ ogs_pkbuf_t *sgsap_build_ue_unreachable(mme_ue_t *mme_ue, uint8_t sgs_cause)
     ogs_pkbuf_t *pkbuf = NULL;
 
     ogs_assert(mme_ue);
-    csmap = mme_ue->csmap;
+    csmap = mme_ue->profile->csmap;
     ogs_assert(csmap);
     vlr = csmap->vlr;
     ogs_assert(vlr);
@@ -97,7 +97,7 @@ int sgsap_send_to_vlr(mme_ue_t *mme_ue, ogs_pkbuf_t *pkbuf)
     ogs_assert(pkbuf);
 
     ogs_assert(mme_ue);
-    csmap = mme_ue->csmap;
+    csmap = mme_ue->profile->csmap;
     ogs_assert(csmap);
     vlr = csmap->vlr;
     ogs_assert(vlr);
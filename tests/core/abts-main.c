@@ -37,6 +37,8 @@ abts_suite *test_poll(abts_suite *suite);
 abts_suite *test_tlv(abts_suite *suite);
 abts_suite *test_fsm(abts_suite *suite);
 abts_suite *test_hash(abts_suite *suite);
+abts_suite *test_flatmap(abts_suite *suite);
+abts_suite *test_arena(abts_suite *suite);
 abts_suite *test_uuid(abts_suite *suite);
 
 const struct testlist {
@@ -59,6 +61,8 @@ const struct testlist {
     {test_tlv},
     {test_fsm},
     {test_hash},
+    {test_flatmap},
+    {test_arena},
     {test_uuid},
     {NULL},
 };
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ogs-core.h"
+#include "core/abts.h"
+
+static void arena_alloc_test(abts_case *tc, void *data)
+{
+    ogs_arena_t *arena = NULL;
+    uint8_t *ptr[100];
+    int i, j, bad;
+
+    arena = ogs_arena_create(256, 4096);
+    ABTS_PTR_NOTNULL(tc, arena);
+
+    for (i = 0; i < 100; i++) {
+        ptr[i] = ogs_arena_alloc(arena, i % 13 + 1);
+        ABTS_PTR_NOTNULL(tc, ptr[i]);
+        ABTS_INT_EQUAL(tc, 0, (uintptr_t)ptr[i] % 8);
+        memset(ptr[i], i, i % 13 + 1);
+    }
+    ABTS_INT_EQUAL(tc, 100, ogs_arena_num_of_alloc(arena));
+    ABTS_TRUE(tc, !ogs_arena_exhausted(arena));
+
+    for (bad = 0, i = 0; i < 100; i++) {
+        ABTS_TRUE(tc, ogs_arena_owns(arena, ptr[i]));
+        ABTS_INT_EQUAL(tc, i % 13 + 1, ogs_arena_size_of(ptr[i]));
+        for (j = 0; j < i % 13 + 1; j++)
+            if (ptr[i][j] != i)
+                bad++;
+    }
+    ABTS_INT_EQUAL(tc, 0, bad);
+    ABTS_TRUE(tc, !ogs_arena_owns(arena, &bad));
+
+    ptr[0] = ogs_arena_calloc(arena, 10, 10);
+    ABTS_PTR_NOTNULL(tc, ptr[0]);
+    for (bad = 0, i = 0; i < 100; i++)
+        if (ptr[0][i])
+            bad++;
+    ABTS_INT_EQUAL(tc, 0, bad);
+
+    ogs_arena_reset(arena);
+    ABTS_INT_EQUAL(tc, 0, ogs_arena_num_of_alloc(arena));
+    ABTS_INT_EQUAL(tc, 0, ogs_arena_used(arena));
+
+    ogs_arena_destroy(arena);
+}
+
+static void arena_realloc_test(abts_case *tc, void *data)
+{
+    ogs_arena_t *arena = NULL;
+    uint8_t *ptr = NULL, *other = NULL, *grown = NULL;
+
+    arena = ogs_arena_create(256, 4096);
+    ABTS_PTR_NOTNULL(tc, arena);
+
+    /* The last allocation grows in place */
+    ptr = ogs_arena_alloc(arena, 16);
+    memset(ptr, 0xaa, 16);
+    grown = ogs_arena_realloc(arena, ptr, 64);
+    ABTS_PTR_EQUAL(tc, ptr, grown);
+    ABTS_INT_EQUAL(tc, 64, ogs_arena_size_of(grown));
+    ABTS_INT_EQUAL(tc, 64, ogs_arena_used(arena));
+
+    /* Any other one is copied */
+    other = ogs_arena_alloc(arena, 8);
+    ABTS_PTR_NOTNULL(tc, other);
+    grown = ogs_arena_realloc(arena, ptr, 128);
+    ABTS_PTR_NOTNULL(tc, grown);
+    ABTS_TRUE(tc, grown != ptr);
+    ABTS_INT_EQUAL(tc, 0xaa, grown[0]);
+    ABTS_INT_EQUAL(tc, 0xaa, grown[15]);
+
+    /* Past the end of the chunk a new one is used */
+    ptr = grown;
+    grown = ogs_arena_realloc(arena, ptr, 1024);
+    ABTS_PTR_NOTNULL(tc, grown);
+    ABTS_INT_EQUAL(tc, 0xaa, grown[15]);
+    ABTS_TRUE(tc, ogs_arena_owns(arena, grown));
+
+    ABTS_PTR_EQUAL(tc, NULL, ogs_arena_realloc(arena, grown, 8192));
+    ABTS_TRUE(tc, ogs_arena_exhausted(arena));
+
+    ogs_arena_destroy(arena);
+}
+
+static void arena_limit_test(abts_case *tc, void *data)
+{
+    ogs_arena_t *arena = NULL;
+    void *ptr = NULL, *big = NULL;
+    int i, n = 0;
+
+    arena = ogs_arena_create(1024, 8192);
+    ABTS_PTR_NOTNULL(tc, arena);
+
+    /* An oversized object gets a chunk of its own */
+    ptr = ogs_arena_alloc(arena, 100);
+    big = ogs_arena_alloc(arena, 3000);
+    ABTS_PTR_NOTNULL(tc, big);
+    ABTS_PTR_EQUAL(tc, (uint8_t *)ptr + 112, ogs_arena_alloc(arena, 100));
+
+    for (i = 0; i < 1000; i++) {
+        if (!ogs_arena_alloc(arena, 64))
+            break;
+        n++;
+    }
+    ABTS_TRUE(tc, i < 1000);
+    ABTS_TRUE(tc, n > 0);
+    ABTS_TRUE(tc, ogs_arena_exhausted(arena));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_arena_calloc(arena, 1 << 20, 1 << 20));
+
+    /* Reset drops the extra chunks and starts over */
+    ogs_arena_reset(arena);
+    ABTS_TRUE(tc, !ogs_arena_exhausted(arena));
+    ABTS_TRUE(tc, !ogs_arena_owns(arena, big));
+    ABTS_TRUE(tc, ogs_arena_owns(arena, ptr));
+    ABTS_PTR_EQUAL(tc, ptr, ogs_arena_alloc(arena, 100));
+
+    for (i = 0; i < n; i++)
+        ABTS_PTR_NOTNULL(tc, ogs_arena_alloc(arena, 64));
+
+    ogs_arena_destroy(arena);
+}
+
+abts_suite *test_arena(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, arena_alloc_test, NULL);
+    abts_run_test(suite, arena_realloc_test, NULL);
+    abts_run_test(suite, arena_limit_test, NULL);
+
+    return suite;
+}
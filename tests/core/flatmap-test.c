@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ogs-core.h"
+#include "core/abts.h"
+
+#define TEST_KEY_NUM 20000
+
+static int values[TEST_KEY_NUM];
+
+static void flatmap_u32_test(abts_case *tc, void *data)
+{
+    ogs_flatmap_t *map = NULL;
+    int i, miss;
+
+    map = ogs_flatmap_create(sizeof(uint32_t));
+    ABTS_PTR_NOTNULL(tc, map);
+    ABTS_INT_EQUAL(tc, 0, ogs_flatmap_count(map));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_flatmap_get_u32(map, 1));
+
+    for (i = 0; i < TEST_KEY_NUM; i++)
+        ogs_flatmap_set_u32(map, i * 7 + 1, &values[i]);
+    ABTS_INT_EQUAL(tc, TEST_KEY_NUM, ogs_flatmap_count(map));
+
+    for (miss = 0, i = 0; i < TEST_KEY_NUM; i++)
+        if (ogs_flatmap_get_u32(map, i * 7 + 1) != &values[i])
+            miss++;
+    ABTS_INT_EQUAL(tc, 0, miss);
+    ABTS_PTR_EQUAL(tc, NULL, ogs_flatmap_get_u32(map, 0));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_flatmap_get_u32(map, 3));
+
+    /* Overwrite keeps the count */
+    ogs_flatmap_set_u32(map, 1, &values[1]);
+    ABTS_PTR_EQUAL(tc, &values[1], ogs_flatmap_get_u32(map, 1));
+    ABTS_INT_EQUAL(tc, TEST_KEY_NUM, ogs_flatmap_count(map));
+
+    for (i = 0; i < TEST_KEY_NUM; i += 2)
+        ogs_flatmap_set_u32(map, i * 7 + 1, NULL);
+    ABTS_INT_EQUAL(tc, TEST_KEY_NUM / 2, ogs_flatmap_count(map));
+
+    for (miss = 0, i = 0; i < TEST_KEY_NUM; i++)
+        if (ogs_flatmap_get_u32(map, i * 7 + 1) != (i % 2 ? &values[i] : NULL))
+            miss++;
+    ABTS_INT_EQUAL(tc, 0, miss);
+
+    /* Removing an absent key is a no-op */
+    ogs_flatmap_set_u32(map, 3, NULL);
+    ABTS_INT_EQUAL(tc, TEST_KEY_NUM / 2, ogs_flatmap_count(map));
+
+    ogs_flatmap_clear(map);
+    ABTS_INT_EQUAL(tc, 0, ogs_flatmap_count(map));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_flatmap_get_u32(map, 8));
+
+    ogs_flatmap_destroy(map);
+}
+
+typedef struct {
+    uint8_t plmn_id[3];
+    uint16_t mme_gid;
+    uint8_t mme_code;
+    uint32_t m_tmsi;
+} __attribute__ ((packed)) test_guti_t;
+
+static void flatmap_key_size_test(abts_case *tc, void *data)
+{
+    ogs_flatmap_t *map16 = NULL, *map10 = NULL;
+    uint8_t key16[16];
+    test_guti_t guti;
+    int i, miss = 0;
+
+    map16 = ogs_flatmap_create(sizeof(key16));
+    ABTS_PTR_NOTNULL(tc, map16);
+    map10 = ogs_flatmap_create(sizeof(test_guti_t));
+    ABTS_PTR_NOTNULL(tc, map10);
+
+    memset(key16, 0, sizeof(key16));
+    memset(&guti, 0, sizeof(guti));
+    guti.plmn_id[0] = 0x09;
+    guti.plmn_id[1] = 0xf1;
+    guti.plmn_id[2] = 0x07;
+    guti.mme_gid = 2;
+    guti.mme_code = 1;
+
+    for (i = 0; i < TEST_KEY_NUM; i++) {
+        guti.m_tmsi = 0xc0000000 + i;
+        memcpy(key16, &guti, sizeof(guti));
+
+        ogs_flatmap_set(map16, key16, &values[i]);
+        ogs_flatmap_set(map10, &guti, &values[i]);
+    }
+    ABTS_INT_EQUAL(tc, TEST_KEY_NUM, ogs_flatmap_count(map16));
+    ABTS_INT_EQUAL(tc, TEST_KEY_NUM, ogs_flatmap_count(map10));
+
+    for (i = 0; i < TEST_KEY_NUM; i++) {
+        guti.m_tmsi = 0xc0000000 + i;
+        memcpy(key16, &guti, sizeof(guti));
+
+        if (ogs_flatmap_get(map16, key16) != &values[i])
+            miss++;
+        if (ogs_flatmap_get(map10, &guti) != &values[i])
+            miss++;
+    }
+    ABTS_INT_EQUAL(tc, 0, miss);
+
+    /* Same M-TMSI under another MME code is a different key */
+    guti.mme_code = 2;
+    guti.m_tmsi = 0xc0000000;
+    memcpy(key16, &guti, sizeof(guti));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_flatmap_get(map16, key16));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_flatmap_get(map10, &guti));
+
+    ogs_flatmap_destroy(map16);
+    ogs_flatmap_destroy(map10);
+}
+
+/* Random churn checked against ogs_hash_t as the reference */
+static void flatmap_churn_test(abts_case *tc, void *data)
+{
+    ogs_flatmap_t *map = NULL;
+    ogs_hash_t *ref = NULL;
+    static uint64_t keys[TEST_KEY_NUM];
+    int i, n, miss = 0;
+
+    map = ogs_flatmap_create(sizeof(uint64_t));
+    ABTS_PTR_NOTNULL(tc, map);
+    ref = ogs_hash_make();
+    ABTS_PTR_NOTNULL(tc, ref);
+
+    for (i = 0; i < TEST_KEY_NUM; i++)
+        keys[i] = ((uint64_t)ogs_random32() << 32) | i;
+
+    for (n = 0; n < TEST_KEY_NUM * 20; n++) {
+        i = ogs_random32() % TEST_KEY_NUM;
+
+        if (ogs_random32() % 3) {
+            ogs_flatmap_set_u64(map, keys[i], &values[i]);
+            ogs_hash_set(ref, &keys[i], sizeof(keys[i]), &values[i]);
+        } else {
+            ogs_flatmap_set_u64(map, keys[i], NULL);
+            ogs_hash_set(ref, &keys[i], sizeof(keys[i]), NULL);
+        }
+    }
+
+    ABTS_INT_EQUAL(tc, ogs_hash_count(ref), ogs_flatmap_count(map));
+    for (i = 0; i < TEST_KEY_NUM; i++)
+        if (ogs_hash_get(ref, &keys[i], sizeof(keys[i])) !=
+                ogs_flatmap_get_u64(map, keys[i]))
+            miss++;
+    ABTS_INT_EQUAL(tc, 0, miss);
+
+    ogs_hash_destroy(ref);
+    ogs_flatmap_destroy(map);
+}
+
+static int sum_values(void *rec, const void *key, const void *value)
+{
+    int *sum = rec;
+    uint32_t k;
+
+    memcpy(&k, key, sizeof(k));
+    ogs_assert(value == &values[k]);
+    *sum += k;
+
+    return 1;
+}
+
+static int stop_at_first(void *rec, const void *key, const void *value)
+{
+    int *count = rec;
+
+    (*count)++;
+
+    return 0;
+}
+
+static void flatmap_do_test(abts_case *tc, void *data)
+{
+    ogs_flatmap_t *map = NULL;
+    int i, sum = 0, count = 0;
+
+    map = ogs_flatmap_create(sizeof(uint32_t));
+    ABTS_PTR_NOTNULL(tc, map);
+
+    for (i = 0; i < 100; i++)
+        ogs_flatmap_set_u32(map, i, &values[i]);
+
+    ABTS_INT_EQUAL(tc, 1, ogs_flatmap_do(sum_values, &sum, map));
+    ABTS_INT_EQUAL(tc, 99 * 100 / 2, sum);
+
+    ABTS_INT_EQUAL(tc, 0, ogs_flatmap_do(stop_at_first, &count, map));
+    ABTS_INT_EQUAL(tc, 1, count);
+
+    ogs_flatmap_destroy(map);
+}
+
+abts_suite *test_flatmap(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, flatmap_u32_test, NULL);
+    abts_run_test(suite, flatmap_key_size_test, NULL);
+    abts_run_test(suite, flatmap_churn_test, NULL);
+    abts_run_test(suite, flatmap_do_test, NULL);
+
+    return suite;
+}
@@ -386,6 +386,20 @@ static void hash_count_5(abts_case *tc, void *data)
     ogs_hash_destroy(h);
 }
 
+static void xxh64_test(abts_case *tc, void *data)
+{
+    const char *str = "Nobody inspects the spammish repetition";
+
+    ABTS_TRUE(tc, ogs_hash_xxh64("", 0, 0) == 0xef46db3751d8e999ULL);
+    ABTS_TRUE(tc, ogs_hash_xxh64("a", 1, 0) == 0xd24ec4f1a98c6e5bULL);
+    ABTS_TRUE(tc, ogs_hash_xxh64("abc", 3, 0) == 0x44bc2cf5ad770999ULL);
+    ABTS_TRUE(tc, ogs_hash_xxh64(str, strlen(str), 0) ==
+            0xfbcea83c8a378bf1ULL);
+
+    ABTS_TRUE(tc, ogs_hash_xxh64(str, strlen(str), 0) !=
+            ogs_hash_xxh64(str, strlen(str), 1));
+}
+
 abts_suite *test_hash(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -406,6 +420,7 @@ abts_suite *test_hash(abts_suite *suite)
     abts_run_test(suite, hash_clear_test, NULL);
     abts_run_test(suite, hash_traverse, NULL);
     abts_run_test(suite, summation_test, NULL);
+    abts_run_test(suite, xxh64_test, NULL);
 
     return suite;
 }
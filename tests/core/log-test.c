@@ -20,6 +20,10 @@
 #include "ogs-core.h"
 #include "core/abts.h"
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#endif
+
 static void test_basic(abts_case *tc, void *data)
 {
     int domain_id = -1;
@@ -103,11 +107,135 @@ static void test_basic(abts_case *tc, void *data)
 #endif
 }
 
+#if !defined(_WIN32)
+#define ASYNC_NUM_OF_THREAD 4
+#define ASYNC_NUM_OF_LINE   500
+
+static void async_thread(void *data)
+{
+    int id = *(int *)data;
+    int i;
+
+    for (i = 0; i < ASYNC_NUM_OF_LINE; i++)
+        ogs_info("async-test %d %d", id, i);
+}
+
+/* Lines written to the file; per-thread order is checked on the way */
+static int async_read(abts_case *tc, const char *path)
+{
+    FILE *in = NULL;
+    char line[OGS_HUGE_LEN];
+    int next[ASYNC_NUM_OF_THREAD];
+    int id, seq, count = 0, misordered = 0;
+    char *p;
+
+    memset(next, 0, sizeof(next));
+
+    in = fopen(path, "r");
+    ABTS_PTR_NOTNULL(tc, in);
+
+    while (fgets(line, sizeof(line), in)) {
+        p = strstr(line, "async-test ");
+        if (!p || sscanf(p, "async-test %d %d", &id, &seq) != 2)
+            continue;
+
+        if (id < 0 || id >= ASYNC_NUM_OF_THREAD || seq < next[id]) {
+            misordered++;
+            continue;
+        }
+        next[id] = seq + 1;
+        count++;
+    }
+    fclose(in);
+
+    ABTS_INT_EQUAL(tc, 0, misordered);
+
+    return count;
+}
+
+static void async_run(abts_case *tc, const char *path, unsigned int size)
+{
+    ogs_thread_t *thread[ASYNC_NUM_OF_THREAD];
+    int id[ASYNC_NUM_OF_THREAD];
+    ogs_log_t *log = NULL;
+    uint64_t dropped;
+    int total = ASYNC_NUM_OF_THREAD * ASYNC_NUM_OF_LINE;
+    int i, rv, count;
+
+    remove(path);
+    log = ogs_log_add_file(path);
+    ABTS_PTR_NOTNULL(tc, log);
+
+    rv = ogs_log_async_start(size);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    dropped = ogs_log_async_dropped();
+
+    for (i = 0; i < ASYNC_NUM_OF_THREAD; i++) {
+        id[i] = i;
+        thread[i] = ogs_thread_create(async_thread, &id[i]);
+        ABTS_PTR_NOTNULL(tc, thread[i]);
+    }
+    for (i = 0; i < ASYNC_NUM_OF_THREAD; i++)
+        ogs_thread_destroy(thread[i]);
+
+    dropped = ogs_log_async_dropped() - dropped;
+    ogs_log_async_stop();
+    ogs_log_remove(log);
+
+    /*
+     * Each line goes to both the stderr and the file log, so the drop
+     * counter covers both of them: only bound the file's share of it.
+     */
+    count = async_read(tc, path);
+    ABTS_TRUE(tc, count <= total);
+    ABTS_TRUE(tc, count + (int)dropped >= total);
+    if (size >= 2 * total)
+        ABTS_INT_EQUAL(tc, 0, (int)dropped);
+
+    remove(path);
+}
+
+static void test_async(abts_case *tc, void *data)
+{
+    int core = ogs_log_get_domain_id("core");
+    int core_level = ogs_log_get_domain_level(core);
+    char path[64];
+    int fd, null_fd;
+
+    ogs_snprintf(path, sizeof(path), "/tmp/ogs-log-test-%d.log", getpid());
+
+    /* Keep the lines off the console */
+    fflush(stderr);
+    fd = dup(STDERR_FILENO);
+    ABTS_TRUE(tc, fd >= 0);
+    null_fd = open("/dev/null", O_WRONLY);
+    ABTS_TRUE(tc, null_fd >= 0);
+    ABTS_INT_EQUAL(tc, STDERR_FILENO, dup2(null_fd, STDERR_FILENO));
+    close(null_fd);
+
+    ogs_log_set_domain_level(core, OGS_LOG_INFO);
+
+    /* Large enough to never drop */
+    async_run(tc, path, ASYNC_NUM_OF_THREAD * ASYNC_NUM_OF_LINE * 4);
+    /* Small enough to drop under load */
+    async_run(tc, path, 8);
+
+    ogs_log_set_domain_level(core, core_level);
+
+    fflush(stderr);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+}
+#endif
+
 abts_suite *test_log(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, test_basic, NULL);
+#if !defined(_WIN32)
+    abts_run_test(suite, test_async, NULL);
+#endif
 
     return suite;
 }
@@ -70,12 +70,209 @@ static void test2_func(abts_case *tc, void *data)
     ogs_pkbuf_free(p3);
 }
 
+static void test3_func(abts_case *tc, void *data)
+{
+    ogs_pkbuf_t *pkbuf = NULL, *p2 = NULL, *p3 = NULL, *p4 = NULL;
+    unsigned char *tmp = NULL;
+
+    pkbuf = ogs_pkbuf_alloc(NULL, 100);
+    ABTS_PTR_NOTNULL(tc, pkbuf);
+    ogs_pkbuf_reserve(pkbuf, 20);
+    tmp = ogs_pkbuf_put(pkbuf, 30);
+    ABTS_PTR_NOTNULL(tc, tmp);
+    memset(tmp, 0xab, 30);
+
+    p2 = ogs_pkbuf_share(pkbuf);
+    ABTS_PTR_NOTNULL(tc, p2);
+    ABTS_TRUE(tc, p2->data == pkbuf->data);
+    ABTS_INT_EQUAL(tc, 30, p2->len);
+
+    p3 = ogs_pkbuf_share(pkbuf);
+    ABTS_PTR_NOTNULL(tc, p3);
+    ABTS_TRUE(tc, p3->data == pkbuf->data);
+
+    /* Original goes first, shares keep the data */
+    ogs_pkbuf_free(pkbuf);
+    ABTS_INT_EQUAL(tc, 0xab, p2->data[0]);
+    ABTS_INT_EQUAL(tc, 0xab, p3->data[29]);
+
+    /* Headers are independent */
+    tmp = ogs_pkbuf_pull(p2, 10);
+    ABTS_PTR_NOTNULL(tc, tmp);
+    ABTS_INT_EQUAL(tc, 20, p2->len);
+    ABTS_INT_EQUAL(tc, 30, p3->len);
+
+    p4 = ogs_pkbuf_copy(p3);
+    ABTS_PTR_NOTNULL(tc, p4);
+#if OGS_USE_TALLOC == 1
+    /* Without talloc, copying shares the cluster as well */
+    ABTS_TRUE(tc, p4->data != p3->data);
+#endif
+    ABTS_INT_EQUAL(tc, 30, p4->len);
+    ABTS_INT_EQUAL(tc, 20, (p4->data-p4->head));
+    ABTS_INT_EQUAL(tc, 0xab, p4->data[29]);
+
+    ogs_pkbuf_free(p2);
+    ogs_pkbuf_free(p3);
+    ogs_pkbuf_free(p4);
+}
+
+static void test4_func(abts_case *tc, void *data)
+{
+    ogs_pkbuf_class_stats_t before[OGS_PKBUF_NUM_OF_CLASS];
+    ogs_pkbuf_class_stats_t after[OGS_PKBUF_NUM_OF_CLASS];
+    ogs_pkbuf_t *pkbuf[3], *big = NULL, *p2 = NULL;
+    int i;
+
+    ogs_pkbuf_get_stats(before);
+    ABTS_INT_EQUAL(tc, 128, before[0].size);
+    ABTS_INT_EQUAL(tc, 1024, before[3].size);
+
+    for (i = 0; i < 3; i++) {
+        pkbuf[i] = ogs_pkbuf_alloc(NULL, 100);
+        ABTS_PTR_NOTNULL(tc, pkbuf[i]);
+    }
+    big = ogs_pkbuf_alloc(NULL, 1000);
+    ABTS_PTR_NOTNULL(tc, big);
+    p2 = ogs_pkbuf_share(big);
+    ABTS_PTR_NOTNULL(tc, p2);
+
+    ogs_pkbuf_get_stats(after);
+    ABTS_INT_EQUAL(tc, 3, (int)(after[0].alloc - before[0].alloc));
+    ABTS_INT_EQUAL(tc, 3, after[0].in_use - before[0].in_use);
+    ABTS_TRUE(tc, after[0].peak >= after[0].in_use);
+    ABTS_INT_EQUAL(tc, 1, (int)(after[3].alloc - before[3].alloc));
+    ABTS_INT_EQUAL(tc, 1, after[3].in_use - before[3].in_use);
+    ABTS_INT_EQUAL(tc, 0, (int)(after[1].alloc - before[1].alloc));
+
+    for (i = 0; i < 3; i++)
+        ogs_pkbuf_free(pkbuf[i]);
+
+    /* Shared data stays in use until the last holder frees it */
+    ogs_pkbuf_free(big);
+    ogs_pkbuf_get_stats(after);
+    ABTS_INT_EQUAL(tc, before[0].in_use, after[0].in_use);
+    ABTS_INT_EQUAL(tc, before[3].in_use + 1, after[3].in_use);
+
+    ogs_pkbuf_free(p2);
+    ogs_pkbuf_get_stats(after);
+    ABTS_INT_EQUAL(tc, before[3].in_use, after[3].in_use);
+}
+
+#define PKBUF_THREAD_NUM 8
+#define PKBUF_THREAD_LOOP 1000
+#define PKBUF_THREAD_BATCH 100
+
+static int thread_error[PKBUF_THREAD_NUM];
+
+static void thread_func(void *data)
+{
+    int *error = data;
+    ogs_pkbuf_t *pkbuf[PKBUF_THREAD_BATCH];
+    int i, j;
+
+    for (i = 0; i < PKBUF_THREAD_LOOP; i++) {
+        for (j = 0; j < PKBUF_THREAD_BATCH; j++) {
+            pkbuf[j] = ogs_pkbuf_alloc(NULL, 50 + (j % 4) * 200);
+            if (!pkbuf[j]) {
+                (*error)++;
+                break;
+            }
+            memset(ogs_pkbuf_put(pkbuf[j], 50), j, 50);
+        }
+        while (j-- > 0) {
+            if (pkbuf[j]->data[49] != j)
+                (*error)++;
+            ogs_pkbuf_free(pkbuf[j]);
+        }
+    }
+}
+
+static void test5_func(abts_case *tc, void *data)
+{
+    ogs_pkbuf_class_stats_t before[OGS_PKBUF_NUM_OF_CLASS];
+    ogs_pkbuf_class_stats_t after[OGS_PKBUF_NUM_OF_CLASS];
+    ogs_thread_t *thread[PKBUF_THREAD_NUM];
+    int i;
+
+    ogs_pkbuf_get_stats(before);
+
+    for (i = 0; i < PKBUF_THREAD_NUM; i++) {
+        thread_error[i] = 0;
+        thread[i] = ogs_thread_create(thread_func, &thread_error[i]);
+        ABTS_PTR_NOTNULL(tc, thread[i]);
+    }
+    for (i = 0; i < PKBUF_THREAD_NUM; i++) {
+        ogs_thread_destroy(thread[i]);
+        ABTS_INT_EQUAL(tc, 0, thread_error[i]);
+    }
+
+    ogs_pkbuf_get_stats(after);
+    for (i = 0; i < OGS_PKBUF_NUM_OF_CLASS; i++)
+        ABTS_INT_EQUAL(tc, before[i].in_use, after[i].in_use);
+    ABTS_INT_EQUAL(tc,
+            PKBUF_THREAD_NUM * PKBUF_THREAD_LOOP * PKBUF_THREAD_BATCH / 4,
+            (int)(after[2].alloc - before[2].alloc));
+}
+
+static void test6_func(abts_case *tc, void *data)
+{
+    ogs_pkbuf_class_stats_t before[OGS_PKBUF_NUM_OF_CLASS];
+    ogs_pkbuf_class_stats_t after[OGS_PKBUF_NUM_OF_CLASS];
+    ogs_pkbuf_t *pkbuf = NULL, *small = NULL;
+    unsigned char buf[64];
+    int i;
+
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = i;
+
+    ogs_pkbuf_get_stats(before);
+
+    /* Encoder style: worst-case buffer, headroom, data pushed back */
+    pkbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
+    ABTS_PTR_NOTNULL(tc, pkbuf);
+    ogs_pkbuf_reserve(pkbuf, 16);
+    ogs_pkbuf_put(pkbuf, OGS_MAX_SDU_LEN-16);
+    memcpy(pkbuf->data, buf, sizeof(buf));
+    pkbuf->len = sizeof(buf);
+    pkbuf->param[0] = 1;
+    pkbuf->param[1] = 2;
+
+    pkbuf = ogs_pkbuf_compact(pkbuf);
+    ABTS_PTR_NOTNULL(tc, pkbuf);
+    ABTS_INT_EQUAL(tc, 16, ogs_pkbuf_headroom(pkbuf));
+    ABTS_INT_EQUAL(tc, 0, ogs_pkbuf_tailroom(pkbuf));
+    ABTS_INT_EQUAL(tc, sizeof(buf), pkbuf->len);
+    ABTS_TRUE(tc, memcmp(pkbuf->data, buf, sizeof(buf)) == 0);
+    ABTS_INT_EQUAL(tc, 1, (int)pkbuf->param[0]);
+    ABTS_INT_EQUAL(tc, 2, (int)pkbuf->param[1]);
+    ABTS_PTR_NOTNULL(tc, ogs_pkbuf_push(pkbuf, 16));
+
+    ogs_pkbuf_get_stats(after);
+    ABTS_INT_EQUAL(tc, before[0].in_use + 1, after[0].in_use);
+    ABTS_INT_EQUAL(tc, before[6].in_use, after[6].in_use);
+
+    /* Nothing to gain within the same class */
+    small = ogs_pkbuf_alloc(NULL, 100);
+    ABTS_PTR_NOTNULL(tc, small);
+    ogs_pkbuf_put_data(small, buf, 10);
+    ABTS_PTR_EQUAL(tc, small, ogs_pkbuf_compact(small));
+    ABTS_INT_EQUAL(tc, 90, ogs_pkbuf_tailroom(small));
+
+    ogs_pkbuf_free(small);
+    ogs_pkbuf_free(pkbuf);
+}
+
 abts_suite *test_pkbuf(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, test1_func, NULL);
     abts_run_test(suite, test2_func, NULL);
+    abts_run_test(suite, test3_func, NULL);
+    abts_run_test(suite, test4_func, NULL);
+    abts_run_test(suite, test5_func, NULL);
+    abts_run_test(suite, test6_func, NULL);
 
     return suite;
 }
@@ -228,6 +228,103 @@ static void test3_func(abts_case *tc, void *data)
     ogs_pool_final(&testpool);
 }
 
+typedef struct {
+    uint8_t payload[4096];
+} lazynode_t;
+
+#define SIZE_OF_LAZYPOOL (256*1024)
+
+static OGS_POOL(lazypool, lazynode_t);
+
+static void test4_func(abts_case *tc, void *data)
+{
+    static lazynode_t *node[1024];
+    lazynode_t *tmp = NULL;
+    int i, n;
+
+    /* 1GB reserved, nothing committed */
+    ogs_pool_init_lazy(&lazypool, SIZE_OF_LAZYPOOL);
+    ABTS_INT_EQUAL(tc, SIZE_OF_LAZYPOOL, ogs_pool_size(&lazypool));
+    ABTS_INT_EQUAL(tc, SIZE_OF_LAZYPOOL, ogs_pool_avail(&lazypool));
+    ABTS_INT_EQUAL(tc, 0, ogs_pool_committed(&lazypool));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_pool_find(&lazypool, 1));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_pool_find(&lazypool, SIZE_OF_LAZYPOOL));
+
+    for (i = 0; i < 1024; i++) {
+        ogs_pool_alloc(&lazypool, &node[i]);
+        ABTS_PTR_NOTNULL(tc, node[i]);
+        memset(node[i]->payload, i, sizeof(node[i]->payload));
+    }
+    ABTS_INT_EQUAL(tc, SIZE_OF_LAZYPOOL - 1024, ogs_pool_avail(&lazypool));
+    ABTS_INT_EQUAL(tc, 1024, ogs_pool_peak(&lazypool));
+    ABTS_TRUE(tc, ogs_pool_committed(&lazypool) >= 1024);
+    ABTS_TRUE(tc, ogs_pool_committed(&lazypool) < SIZE_OF_LAZYPOOL);
+
+    for (n = 0, i = 0; i < 1024; i++) {
+        if (ogs_pool_index(&lazypool, node[i]) != i + 1)
+            n++;
+        if (ogs_pool_find(&lazypool, i + 1) != node[i])
+            n++;
+        if (node[i]->payload[4095] != (uint8_t)i)
+            n++;
+    }
+    ABTS_INT_EQUAL(tc, 0, n);
+    ABTS_PTR_EQUAL(tc, NULL, ogs_pool_find(&lazypool, 1025));
+
+    /* A freed slot is not reused while the pool can still grow */
+    ogs_pool_free(&lazypool, node[10]);
+    ogs_pool_free(&lazypool, node[20]);
+    ABTS_PTR_EQUAL(tc, NULL, ogs_pool_cycle(&lazypool, node[10]));
+    ogs_pool_alloc(&lazypool, &tmp);
+    ABTS_INT_EQUAL(tc, 1025, ogs_pool_index(&lazypool, tmp));
+    ABTS_PTR_EQUAL(tc, tmp, ogs_pool_cycle(&lazypool, tmp));
+    ABTS_INT_EQUAL(tc, 1024, ogs_pool_peak(&lazypool));
+    ogs_pool_free(&lazypool, tmp);
+
+    /* Once more than a chunk has been freed, slots come back in order */
+    for (i = 0; i < 1024; i++)
+        if (i != 10 && i != 20)
+            ogs_pool_free(&lazypool, node[i]);
+    ABTS_INT_EQUAL(tc, SIZE_OF_LAZYPOOL, ogs_pool_avail(&lazypool));
+
+    ogs_pool_alloc(&lazypool, &tmp);
+    ABTS_PTR_EQUAL(tc, node[10], tmp);
+    ogs_pool_alloc(&lazypool, &node[10]);
+    ABTS_PTR_EQUAL(tc, node[20], node[10]);
+    ogs_pool_free(&lazypool, tmp);
+    ogs_pool_free(&lazypool, node[10]);
+    ABTS_INT_EQUAL(tc, 1024, ogs_pool_peak(&lazypool));
+
+    ogs_pool_final(&lazypool);
+}
+
+static void test5_func(abts_case *tc, void *data)
+{
+    testnode_t *node[6] = { NULL, };
+    int i;
+
+    /* A small lazy pool still runs dry at its size */
+    ogs_pool_init_lazy(&testpool, 5);
+
+    for (i = 0; i < 5; i++) {
+        ogs_pool_alloc(&testpool, &node[i]);
+        ABTS_PTR_NOTNULL(tc, node[i]);
+    }
+    ogs_pool_alloc(&testpool, &node[5]);
+    ABTS_PTR_EQUAL(tc, NULL, node[5]);
+    ABTS_INT_EQUAL(tc, 0, ogs_pool_avail(&testpool));
+    ABTS_INT_EQUAL(tc, 5, ogs_pool_committed(&testpool));
+
+    ogs_pool_free(&testpool, node[3]);
+    ogs_pool_alloc(&testpool, &node[5]);
+    ABTS_PTR_EQUAL(tc, node[3], node[5]);
+
+    for (i = 0; i < 5; i++)
+        ogs_pool_free(&testpool, node[i]);
+
+    ogs_pool_final(&testpool);
+}
+
 abts_suite *test_pool(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -235,6 +332,8 @@ abts_suite *test_pool(abts_suite *suite)
     abts_run_test(suite, test1_func, NULL);
     abts_run_test(suite, test2_func, NULL);
     abts_run_test(suite, test3_func, NULL);
+    abts_run_test(suite, test4_func, NULL);
+    abts_run_test(suite, test5_func, NULL);
 
     return suite;
 }
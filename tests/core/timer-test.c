@@ -41,6 +41,30 @@ void test_expire_func_2(void *data)
     expire_check[index]++;
 }
 
+/*
+ * The timing wheel may wake up at a cascade boundary before anything is
+ * due, so keep polling until the next timer has actually fired.
+ * The rbtree manager always reports the exact expiry and gets one round.
+ */
+static void poll_and_expire(ogs_pollset_t *pollset,
+        ogs_timer_mgr_t *timer, ogs_timer_mgr_type_e type)
+{
+    int n, fired = 0, before = 0;
+
+    for (n = 0; n < OGS_ARRAY_SIZE(expire_check); n++)
+        before += expire_check[n];
+
+    do {
+        ogs_pollset_poll(pollset, ogs_timer_mgr_next(timer));
+        ogs_timer_mgr_expire(timer);
+
+        fired = 0;
+        for (n = 0; n < OGS_ARRAY_SIZE(expire_check); n++)
+            fired += expire_check[n];
+    } while (type == OGS_TIMER_MGR_WHEEL && fired == before &&
+            ogs_timer_mgr_next(timer) != OGS_INFINITE_TIME);
+}
+
 /* basic timer Test */
 static void test1_func(abts_case *tc, void *data)
 {
@@ -51,7 +75,7 @@ static void test1_func(abts_case *tc, void *data)
 
     memset(expire_check, 0, TEST_DURATION/TEST_TIMER_PRECISION);
 
-    timer = ogs_timer_mgr_create(512);
+    timer = ogs_timer_mgr_create_type(512, (uintptr_t)data);
     pollset = ogs_pollset_create(512);
     ogs_assert(timer);
     for(n = 0; n < sizeof(timer_duration)/sizeof(ogs_time_t); n++) {
@@ -61,8 +85,7 @@ static void test1_func(abts_case *tc, void *data)
         ogs_timer_start(timer_array[n], timer_duration[n]);
     }
 
-    ogs_pollset_poll(pollset, ogs_timer_mgr_next(timer));
-    ogs_timer_mgr_expire(timer);
+    poll_and_expire(pollset, timer, (uintptr_t)data);
 
     ABTS_INT_EQUAL(tc, 0, expire_check[0]);
     ABTS_INT_EQUAL(tc, 1, expire_check[1]);
@@ -70,8 +93,7 @@ static void test1_func(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, 0, expire_check[3]);
     ABTS_INT_EQUAL(tc, 0, expire_check[4]);
 
-    ogs_pollset_poll(pollset, ogs_timer_mgr_next(timer));
-    ogs_timer_mgr_expire(timer);
+    poll_and_expire(pollset, timer, (uintptr_t)data);
 
     ABTS_INT_EQUAL(tc, 0, expire_check[0]);
     ABTS_INT_EQUAL(tc, 1, expire_check[1]);
@@ -79,8 +101,7 @@ static void test1_func(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, 1, expire_check[3]);
     ABTS_INT_EQUAL(tc, 0, expire_check[4]);
 
-    ogs_pollset_poll(pollset, ogs_timer_mgr_next(timer));
-    ogs_timer_mgr_expire(timer);
+    poll_and_expire(pollset, timer, (uintptr_t)data);
 
     ABTS_INT_EQUAL(tc, 0, expire_check[0]);
     ABTS_INT_EQUAL(tc, 1, expire_check[1]);
@@ -88,8 +109,7 @@ static void test1_func(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, 1, expire_check[3]);
     ABTS_INT_EQUAL(tc, 0, expire_check[4]);
 
-    ogs_pollset_poll(pollset, ogs_timer_mgr_next(timer));
-    ogs_timer_mgr_expire(timer);
+    poll_and_expire(pollset, timer, (uintptr_t)data);
 
     ABTS_INT_EQUAL(tc, 1, expire_check[0]);
     ABTS_INT_EQUAL(tc, 1, expire_check[1]);
@@ -97,8 +117,7 @@ static void test1_func(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, 1, expire_check[3]);
     ABTS_INT_EQUAL(tc, 0, expire_check[4]);
 
-    ogs_pollset_poll(pollset, ogs_timer_mgr_next(timer));
-    ogs_timer_mgr_expire(timer);
+    poll_and_expire(pollset, timer, (uintptr_t)data);
     ABTS_INT_EQUAL(tc, OGS_INFINITE_TIME, ogs_timer_mgr_next(timer));
 
     ABTS_INT_EQUAL(tc, 1, expire_check[0]);
@@ -126,7 +145,7 @@ static void test2_func(abts_case *tc, void *data)
     memset(expire_check, 0, TEST_DURATION/TEST_TIMER_PRECISION);
     memset(tm_num, 0, sizeof(int)*(TEST_DURATION/TEST_TIMER_PRECISION));
 
-    timer = ogs_timer_mgr_create(512);
+    timer = ogs_timer_mgr_create_type(512, (uintptr_t)data);
     ogs_assert(timer);
 
     for(n = 0; n < TEST_TIMER_NUM; n++) {
@@ -168,7 +187,7 @@ static void test3_func(abts_case *tc, void *data)
     memset(expire_check, 0, TEST_DURATION/TEST_TIMER_PRECISION);
     memset(tm_num, 0, sizeof(int)*(TEST_DURATION/TEST_TIMER_PRECISION));
 
-    timer = ogs_timer_mgr_create(512);
+    timer = ogs_timer_mgr_create_type(512, (uintptr_t)data);
     ogs_assert(timer);
 
     for(n = 0; n < TEST_TIMER_NUM; n++) {
@@ -208,13 +227,107 @@ static void test3_func(abts_case *tc, void *data)
     ogs_timer_mgr_destroy(timer);
 }
 
+static int bench_expired;
+
+static void bench_expire_func(void *data)
+{
+    bench_expired++;
+}
+
+static double bench_nsec_per_op(ogs_time_t start, int num)
+{
+    return (double)(ogs_get_monotonic_time() - start) * 1000 / num;
+}
+
+static void bench_run(abts_case *tc, ogs_timer_mgr_type_e type, int num)
+{
+    ogs_timer_mgr_t *timer = NULL;
+    ogs_timer_t **timer_array = NULL;
+    ogs_time_t start;
+    double add, restart, stop, expire;
+    int n;
+
+    timer = ogs_timer_mgr_create_type(num, type);
+    ABTS_PTR_NOTNULL(tc, timer);
+    timer_array = malloc(sizeof(*timer_array) * num);
+    ABTS_PTR_NOTNULL(tc, timer_array);
+
+    for (n = 0; n < num; n++) {
+        timer_array[n] = ogs_timer_add(timer, bench_expire_func, NULL);
+        ogs_assert(timer_array[n]);
+    }
+
+    /* Arm with durations like the NAS and S1 timers : 1s .. 1h */
+    start = ogs_get_monotonic_time();
+    for (n = 0; n < num; n++)
+        ogs_timer_start(timer_array[n],
+                ogs_time_from_sec(1 + ogs_random32() % 3600));
+    add = bench_nsec_per_op(start, num);
+
+    start = ogs_get_monotonic_time();
+    for (n = 0; n < num; n++)
+        ogs_timer_start(timer_array[n],
+                ogs_time_from_sec(1 + ogs_random32() % 3600));
+    restart = bench_nsec_per_op(start, num);
+
+    start = ogs_get_monotonic_time();
+    for (n = 0; n < num; n++)
+        ogs_timer_stop(timer_array[n]);
+    stop = bench_nsec_per_op(start, num);
+
+    /* All of them due within 100ms, expired in one call */
+    for (n = 0; n < num; n++)
+        ogs_timer_start(timer_array[n],
+                ogs_time_from_msec(1 + ogs_random32() % 100));
+    ogs_usleep(ogs_time_from_msec(110));
+    bench_expired = 0;
+    start = ogs_get_monotonic_time();
+    ogs_timer_mgr_expire(timer);
+    expire = bench_nsec_per_op(start, num);
+    ABTS_INT_EQUAL(tc, num, bench_expired);
+
+    printf("%-8s %9d timers : start %6.1f, restart %6.1f, "
+            "stop %6.1f, expire %6.1f ns/timer\n",
+            type == OGS_TIMER_MGR_WHEEL ? "wheel" : "rbtree", num,
+            add, restart, stop, expire);
+
+    for (n = 0; n < num; n++)
+        ogs_timer_delete(timer_array[n]);
+    free(timer_array);
+
+    ogs_timer_mgr_destroy(timer);
+}
+
+/*
+ * Compares the two managers with millions of armed timers.
+ * Needs several GB of memory, so it only runs with OGS_TIMER_BENCH set.
+ */
+static void bench_func(abts_case *tc, void *data)
+{
+    int num[] = { 1000000, 5000000, 10000000 };
+    int i;
+
+    if (!ogs_env_get("OGS_TIMER_BENCH"))
+        return;
+
+    printf("\n");
+    for (i = 0; i < OGS_ARRAY_SIZE(num); i++) {
+        bench_run(tc, OGS_TIMER_MGR_RBTREE, num[i]);
+        bench_run(tc, OGS_TIMER_MGR_WHEEL, num[i]);
+    }
+}
+
 abts_suite *test_timer(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
 
-    abts_run_test(suite, test1_func, NULL);
-    abts_run_test(suite, test2_func, NULL);
-    abts_run_test(suite, test3_func, NULL);
+    abts_run_test(suite, test1_func, (void *)OGS_TIMER_MGR_RBTREE);
+    abts_run_test(suite, test2_func, (void *)OGS_TIMER_MGR_RBTREE);
+    abts_run_test(suite, test3_func, (void *)OGS_TIMER_MGR_RBTREE);
+    abts_run_test(suite, test1_func, (void *)OGS_TIMER_MGR_WHEEL);
+    abts_run_test(suite, test2_func, (void *)OGS_TIMER_MGR_WHEEL);
+    abts_run_test(suite, test3_func, (void *)OGS_TIMER_MGR_WHEEL);
+    abts_run_test(suite, bench_func, NULL);
 
     return suite;
 }
@@ -20,11 +20,13 @@
 #include "test-app.h"
 
 abts_suite *test_mme_s13_handler(abts_suite *suite);
+abts_suite *test_mme_subscription_cache(abts_suite *suite);
 
 const struct testlist {
     abts_suite *(*func)(abts_suite *suite);
 } alltests[] = {
     {test_mme_s13_handler},
+    {test_mme_subscription_cache},
     {NULL},
 };
 
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays Attach, Service Request and TAU against the MME context layer
+ * alone: no S1AP/NAS codec, no sockets and no peers. Each procedure makes
+ * the same context calls and touches the same mme_ue_t fields as its
+ * handler, over NUM_OF_UE UEs, so the loop can be run under perf to
+ * compare context layouts:
+ *
+ *   perf stat -e cycles,instructions,cache-misses,L1-dcache-load-misses \
+ *       ./tests/mme/mme-context-bench
+ *
+ * Where the kernel exposes the hardware counters, cache misses and L1
+ * data cache load misses are also counted around each procedure loop and
+ * reported per procedure; otherwise they are reported as n/a.
+ *
+ * NUM_OF_UE UEs are about 1 MB of contexts, which fits in the L2/L3 of
+ * current servers, so as is this mostly shows L1 behaviour. To measure
+ * past the last level cache, raise NUM_OF_UE and max.ue in the config
+ * together. No before/after cache miss numbers for the mme_ue_t and
+ * mme_ue_profile_t split have been taken with it yet.
+ *
+ * The number of rounds can be given as the first non-option argument.
+ */
+
+#include "test-app.h"
+
+#include "mme-context.h"
+#include "metrics.h"
+
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#define NUM_OF_UE           1000
+#define NUM_OF_ROUND        20
+#define SERVICE_PER_ROUND   8
+
+typedef struct sample_s {
+    ogs_time_t elapsed;
+    uint64_t cache_misses;
+    uint64_t l1d_misses;
+} sample_t;
+
+static int fd_cache_misses = -1;
+static int fd_l1d_misses = -1;
+
+static mme_enb_t enb;
+static ogs_nas_eps_guti_t guti[NUM_OF_UE];
+static mme_ue_t *ue[NUM_OF_UE];
+static uint32_t enb_ue_s1ap_id;
+
+static enb_ue_t *initial_ue_message(void)
+{
+    enb_ue_t *enb_ue = enb_ue_add(&enb, enb_ue_s1ap_id++);
+    ogs_assert(enb_ue);
+
+    memcpy(&enb_ue->saved.tai.plmn_id,
+            &mme_self()->served_gummei[0].plmn_id[0], OGS_PLMN_ID_LEN);
+    enb_ue->saved.tai.tac = 1;
+    memcpy(&enb_ue->saved.e_cgi.plmn_id,
+            &mme_self()->served_gummei[0].plmn_id[0], OGS_PLMN_ID_LEN);
+    enb_ue->saved.e_cgi.cell_id = enb_ue->enb_ue_s1ap_id;
+
+    return enb_ue;
+}
+
+static void ue_context_release(enb_ue_t *enb_ue, mme_ue_t *mme_ue)
+{
+    enb_ue_deassociate(enb_ue);
+    enb_ue_unlink(mme_ue);
+    enb_ue_remove(enb_ue);
+}
+
+static void update_location(mme_ue_t *mme_ue, enb_ue_t *enb_ue)
+{
+    memcpy(&mme_ue->tai, &enb_ue->saved.tai, sizeof(ogs_eps_tai_t));
+    memcpy(&mme_ue->e_cgi, &enb_ue->saved.e_cgi, sizeof(ogs_e_cgi_t));
+    mme_ue->ue_location_timestamp = ogs_time_now();
+}
+
+static void security_mode(mme_ue_t *mme_ue)
+{
+    mme_ue->security_context_available = 1;
+    mme_ue->mac_failed = 0;
+    mme_ue->nas_eps.ksi = 1;
+
+    mme_ue->ul_count.i32 = 0;
+    mme_ue->dl_count = 0;
+    memset(mme_ue->nas_key.knas_int, 0x11, OGS_KEY_LEN);
+    memset(mme_ue->nas_key.knas_enc, 0x22, OGS_KEY_LEN);
+    ogs_nas_security_key_expand(&mme_ue->nas_key);
+}
+
+static void attach(int i)
+{
+    enb_ue_t *enb_ue = NULL;
+    mme_ue_t *mme_ue = NULL;
+    mme_sess_t *sess = NULL;
+    ogs_nas_eps_message_t message;
+    char imsi_bcd[OGS_MAX_IMSI_BCD_LEN+1];
+    int rv;
+
+    enb_ue = initial_ue_message();
+
+    memset(&message, 0, sizeof(message));
+    mme_ue = mme_ue_add(enb_ue, &message);
+    ogs_assert(mme_ue);
+    enb_ue_associate_mme_ue(enb_ue, mme_ue);
+
+    ogs_snprintf(imsi_bcd, sizeof(imsi_bcd), "99970%010d", i);
+    rv = mme_ue_set_imsi(mme_ue, imsi_bcd);
+    ogs_assert(rv == OGS_OK);
+
+    mme_ue->nas_eps.type = MME_EPS_TYPE_ATTACH_REQUEST;
+    update_location(mme_ue, enb_ue);
+    security_mode(mme_ue);
+
+    /* Update-Location-Answer */
+    mme_ue->profile->ambr.uplink = 1000000000;
+    mme_ue->profile->ambr.downlink = 1000000000;
+    mme_ue->profile->network_access_mode = 0;
+    mme_ue->profile->context_identifier = 1;
+    mme_ue->profile->num_of_session = 1;
+    mme_ue->profile->session[0].name = ogs_strdup("internet");
+    ogs_assert(mme_ue->profile->session[0].name);
+    mme_ue->profile->session[0].context_identifier = 1;
+    mme_ue->profile->session[0].session_type = OGS_PDU_SESSION_TYPE_IPV4V6;
+
+    /* PDN Connectivity Request */
+    sess = mme_sess_add(mme_ue, 1);
+    ogs_assert(sess);
+    sess->session = mme_session_find_by_apn(mme_ue, (char *)"internet");
+    ogs_assert(sess->session);
+
+    mme_ue_new_guti(mme_ue);
+    mme_ue_confirm_guti(mme_ue);
+    memcpy(&guti[i], &mme_ue->current.guti, sizeof(ogs_nas_eps_guti_t));
+
+    ue_context_release(enb_ue, mme_ue);
+    ue[i] = mme_ue;
+}
+
+static void service_request(int i)
+{
+    enb_ue_t *enb_ue = NULL;
+    mme_ue_t *mme_ue = NULL;
+    mme_sess_t *sess = NULL;
+    mme_bearer_t *bearer = NULL;
+
+    enb_ue = initial_ue_message();
+
+    mme_ue = mme_ue_find_by_guti(&guti[i]);
+    ogs_assert(mme_ue == ue[i]);
+    ogs_assert(ECM_IDLE(mme_ue));
+    ogs_assert(SECURITY_CONTEXT_IS_VALID(mme_ue));
+    enb_ue_associate_mme_ue(enb_ue, mme_ue);
+
+    mme_ue->nas_eps.type = MME_EPS_TYPE_SERVICE_REQUEST;
+    mme_ue->ul_count.sqn++;
+    update_location(mme_ue, enb_ue);
+
+    /* Initial Context Setup Request */
+    mme_ue->dl_count++;
+    mme_ue->nhcc = 1;
+    ogs_list_for_each(&mme_ue->sess_list, sess) {
+        ogs_list_for_each(&sess->bearer_list, bearer) {
+            bearer->enb_s1u_teid = enb_ue->enb_ue_s1ap_id;
+        }
+    }
+
+    ue_context_release(enb_ue, mme_ue);
+}
+
+static void tracking_area_update(int i)
+{
+    enb_ue_t *enb_ue = NULL;
+    mme_ue_t *mme_ue = NULL;
+
+    enb_ue = initial_ue_message();
+
+    mme_ue = mme_ue_find_by_guti(&guti[i]);
+    ogs_assert(mme_ue == ue[i]);
+    ogs_assert(SECURITY_CONTEXT_IS_VALID(mme_ue));
+    enb_ue_associate_mme_ue(enb_ue, mme_ue);
+
+    mme_ue->nas_eps.type = MME_EPS_TYPE_TAU_REQUEST;
+    mme_ue->ul_count.sqn++;
+    update_location(mme_ue, enb_ue);
+
+    /* Tracking Area Update Accept */
+    mme_ue_new_guti(mme_ue);
+    mme_ue->dl_count++;
+    mme_ue_confirm_guti(mme_ue);
+    memcpy(&guti[i], &mme_ue->current.guti, sizeof(ogs_nas_eps_guti_t));
+
+    ue_context_release(enb_ue, mme_ue);
+}
+
+static void detach(int i)
+{
+    mme_ue_remove(ue[i]);
+    ue[i] = NULL;
+}
+
+static int counter_open(uint32_t type, uint64_t config)
+{
+#if defined(__linux__)
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static uint64_t counter_read(int fd)
+{
+    uint64_t value = 0;
+
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+        return 0;
+
+    return value;
+}
+
+static void measure(void (*procedure)(int i), sample_t *sample)
+{
+    uint64_t cache_misses = counter_read(fd_cache_misses);
+    uint64_t l1d_misses = counter_read(fd_l1d_misses);
+    ogs_time_t start = ogs_get_monotonic_time();
+    int i;
+
+    for (i = 0; i < NUM_OF_UE; i++)
+        procedure(i);
+
+    sample->elapsed += ogs_get_monotonic_time() - start;
+    sample->cache_misses += counter_read(fd_cache_misses) - cache_misses;
+    sample->l1d_misses += counter_read(fd_l1d_misses) - l1d_misses;
+}
+
+static void report(const char *name, sample_t *sample, int count)
+{
+    printf("%-22s %8d %10lld usec %8.1f nsec/procedure",
+            name, count, (long long)sample->elapsed,
+            sample->elapsed * 1000.0 / count);
+    if (fd_cache_misses >= 0)
+        printf(" %8.1f cache-misses", (double)sample->cache_misses / count);
+    else
+        printf("      n/a cache-misses");
+    if (fd_l1d_misses >= 0)
+        printf(" %8.1f L1-dcache-load-misses\n",
+                (double)sample->l1d_misses / count);
+    else
+        printf("      n/a L1-dcache-load-misses\n");
+}
+
+static void terminate(void)
+{
+    if (fd_cache_misses >= 0)
+        close(fd_cache_misses);
+    if (fd_l1d_misses >= 0)
+        close(fd_l1d_misses);
+
+    mme_context_final();
+    mme_metrics_final();
+
+    ogs_app_terminate();
+}
+
+static void initialize(const char *const argv[])
+{
+    int rv;
+
+    rv = ogs_app_initialize(NULL, NULL, argv);
+    ogs_assert(rv == OGS_OK);
+
+    mme_metrics_init();
+    mme_context_init();
+
+    rv = mme_context_parse_config();
+    ogs_assert(rv == OGS_OK);
+
+    ogs_assert(ogs_app()->max.ue >= NUM_OF_UE);
+}
+
+int main(int argc, const char *const argv[])
+{
+    sample_t attach_sample, service_sample, tau_sample, detach_sample;
+    int round, num_of_round = NUM_OF_ROUND, n, i;
+
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            num_of_round = atoi(argv[i]);
+            break;
+        }
+        if (argv[i][1] && strchr("cem", argv[i][1]))
+            i++;
+    }
+    ogs_assert(num_of_round > 0);
+
+    memset(&attach_sample, 0, sizeof(attach_sample));
+    memset(&service_sample, 0, sizeof(service_sample));
+    memset(&tau_sample, 0, sizeof(tau_sample));
+    memset(&detach_sample, 0, sizeof(detach_sample));
+
+    atexit(terminate);
+    test_app_run(argc, argv, "sample.yaml", initialize);
+
+    memset(&enb, 0, sizeof(enb));
+    enb.max_num_of_ostreams = OGS_DEFAULT_SCTP_MAX_NUM_OF_OSTREAMS;
+    ogs_list_init(&enb.enb_ue_list);
+    enb_ue_s1ap_id = 1;
+
+    printf("mme_ue_t %d bytes, mme_ue_profile_t %d bytes, "
+            "%d UEs, %d rounds\n",
+            (int)sizeof(mme_ue_t), (int)sizeof(mme_ue_profile_t),
+            NUM_OF_UE, num_of_round);
+
+#if defined(__linux__)
+    fd_cache_misses = counter_open(
+            PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fd_l1d_misses = counter_open(PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+
+    for (round = 0; round < num_of_round; round++) {
+        measure(attach, &attach_sample);
+        for (n = 0; n < SERVICE_PER_ROUND; n++)
+            measure(service_request, &service_sample);
+        measure(tracking_area_update, &tau_sample);
+        measure(detach, &detach_sample);
+    }
+
+    report("Attach", &attach_sample, NUM_OF_UE * num_of_round);
+    report("Service Request", &service_sample,
+            NUM_OF_UE * num_of_round * SERVICE_PER_ROUND);
+    report("Tracking Area Update", &tau_sample, NUM_OF_UE * num_of_round);
+    report("Detach", &detach_sample, NUM_OF_UE * num_of_round);
+
+    return 0;
+}
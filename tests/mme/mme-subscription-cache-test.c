@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "test-common.h"
+#include "../../src/mme/mme-subscription-cache.h"
+
+static void profile_fill(mme_ue_profile_t *profile, const char *apn, int ambr)
+{
+    memset(profile, 0, sizeof(*profile));
+
+    profile->ambr.uplink = ambr;
+    profile->ambr.downlink = ambr * 2;
+    profile->network_access_mode = OGS_NETWORK_ACCESS_MODE_ONLY_PACKET;
+    profile->context_identifier = 1;
+
+    profile->num_of_session = 1;
+    profile->session[0].name = ogs_strdup(apn);
+    ogs_assert(profile->session[0].name);
+    profile->session[0].context_identifier = 1;
+    profile->session[0].session_type = OGS_PDU_SESSION_TYPE_IPV4V6;
+}
+
+static void profile_free(mme_ue_profile_t *profile)
+{
+    int i;
+
+    for (i = 0; i < profile->num_of_session; i++)
+        if (profile->session[i].name)
+            ogs_free(profile->session[i].name);
+    profile->num_of_session = 0;
+}
+
+static void subscription_cache_test1(abts_case *tc, void *data)
+{
+    mme_ue_profile_t profile, restored;
+
+    ABTS_TRUE(tc, !mme_subscription_cache_enabled());
+    memset(&restored, 0, sizeof(restored));
+    ABTS_TRUE(tc, !mme_subscription_cache_get("999700000000001", &restored));
+
+    mme_subscription_cache_init(4, ogs_time_from_sec(60));
+    ABTS_TRUE(tc, mme_subscription_cache_enabled());
+
+    profile_fill(&profile, "internet", 1000);
+    mme_subscription_cache_put("999700000000001", &profile);
+    profile_free(&profile);
+    ABTS_INT_EQUAL(tc, 1, mme_subscription_cache_count());
+
+    ABTS_TRUE(tc, !mme_subscription_cache_get("999700000000002", &restored));
+    ABTS_INT_EQUAL(tc, 0, restored.num_of_session);
+
+    /* The auth vectors are not part of the cached data */
+    restored.auth_vectors.num = 2;
+    ABTS_TRUE(tc, mme_subscription_cache_get("999700000000001", &restored));
+    ABTS_INT_EQUAL(tc, 1000, restored.ambr.uplink);
+    ABTS_INT_EQUAL(tc, 2000, restored.ambr.downlink);
+    ABTS_INT_EQUAL(tc, OGS_NETWORK_ACCESS_MODE_ONLY_PACKET,
+            restored.network_access_mode);
+    ABTS_INT_EQUAL(tc, 1, restored.num_of_session);
+    ABTS_STR_EQUAL(tc, "internet", restored.session[0].name);
+    ABTS_INT_EQUAL(tc, 2, restored.auth_vectors.num);
+
+    /* A second hit replaces the restored sessions */
+    profile_fill(&profile, "ims", 3000);
+    mme_subscription_cache_put("999700000000001", &profile);
+    profile_free(&profile);
+    ABTS_INT_EQUAL(tc, 1, mme_subscription_cache_count());
+    ABTS_TRUE(tc, mme_subscription_cache_get("999700000000001", &restored));
+    ABTS_INT_EQUAL(tc, 3000, restored.ambr.uplink);
+    ABTS_STR_EQUAL(tc, "ims", restored.session[0].name);
+
+    /* IDR/CLR */
+    mme_subscription_cache_remove("999700000000001");
+    ABTS_INT_EQUAL(tc, 0, mme_subscription_cache_count());
+    ABTS_TRUE(tc, !mme_subscription_cache_get("999700000000001", &restored));
+    ABTS_STR_EQUAL(tc, "ims", restored.session[0].name);
+
+    profile_free(&restored);
+    mme_subscription_cache_final();
+    ABTS_TRUE(tc, !mme_subscription_cache_enabled());
+}
+
+static void subscription_cache_test2(abts_case *tc, void *data)
+{
+    mme_ue_profile_t profile, restored;
+    char imsi_bcd[OGS_MAX_IMSI_BCD_LEN+1];
+    int i;
+
+    memset(&restored, 0, sizeof(restored));
+    mme_subscription_cache_init(4, ogs_time_from_sec(60));
+
+    profile_fill(&profile, "internet", 1000);
+    for (i = 0; i < 4; i++) {
+        ogs_snprintf(imsi_bcd, sizeof(imsi_bcd), "99970000000000%d", i);
+        mme_subscription_cache_put(imsi_bcd, &profile);
+    }
+    ABTS_INT_EQUAL(tc, 4, mme_subscription_cache_count());
+
+    /* Touch the oldest so that the second one is evicted */
+    ABTS_TRUE(tc, mme_subscription_cache_get("999700000000000", &restored));
+
+    mme_subscription_cache_put("999700000000004", &profile);
+    ABTS_INT_EQUAL(tc, 4, mme_subscription_cache_count());
+
+    ABTS_TRUE(tc, mme_subscription_cache_get("999700000000000", &restored));
+    ABTS_TRUE(tc, !mme_subscription_cache_get("999700000000001", &restored));
+    ABTS_TRUE(tc, mme_subscription_cache_get("999700000000002", &restored));
+    ABTS_TRUE(tc, mme_subscription_cache_get("999700000000004", &restored));
+
+    mme_subscription_cache_final();
+
+    /* Expiry */
+    mme_subscription_cache_init(4, ogs_time_from_msec(50));
+    mme_subscription_cache_put("999700000000001", &profile);
+    ABTS_TRUE(tc, mme_subscription_cache_get("999700000000001", &restored));
+    ogs_msleep(100);
+    ABTS_TRUE(tc, !mme_subscription_cache_get("999700000000001", &restored));
+    ABTS_INT_EQUAL(tc, 0, mme_subscription_cache_count());
+    mme_subscription_cache_final();
+
+    profile_free(&profile);
+    profile_free(&restored);
+}
+
+abts_suite *test_mme_subscription_cache(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, subscription_cache_test1, NULL);
+    abts_run_test(suite, subscription_cache_test2, NULL);
+
+    return suite;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2019-2023 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "test-common.h"
+
+#include <poll.h>
+
+/*
+ * Stands in for the redis server in redis-dup.yaml. It answers only
+ * when told to, so a test controls how long a reply stays outstanding.
+ */
+#define TEST_REDIS_PORT 16379
+
+static ogs_sock_t *redis_server = NULL;
+static ogs_sock_t *redis_conn = NULL;
+
+void test_redis_server_open(void)
+{
+    ogs_sockaddr_t *addr = NULL;
+    int rv;
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.1", TEST_REDIS_PORT, 0);
+    ogs_assert(rv == OGS_OK);
+
+    redis_server = ogs_tcp_server(addr, NULL);
+    ogs_assert(redis_server);
+
+    ogs_freeaddrinfo(addr);
+}
+
+void test_redis_server_close(void)
+{
+    if (redis_conn)
+        ogs_sock_destroy(redis_conn);
+    if (redis_server)
+        ogs_sock_destroy(redis_server);
+}
+
+/* Waits for one command from the MME without answering it */
+static void redis_command_read(abts_case *tc)
+{
+    char buf[OGS_MAX_SDU_LEN];
+    ssize_t size;
+
+    size = ogs_recv(redis_conn->fd, buf, sizeof(buf), 0);
+    ABTS_TRUE(tc, size > 0);
+    ABTS_INT_EQUAL(tc, '*', buf[0]);
+}
+
+/* Reply to SET NX for a key that was not set, i.e. not a duplicate */
+static void redis_reply_ok(abts_case *tc)
+{
+    const char *reply = "+OK\r\n";
+    ssize_t size;
+
+    size = ogs_send(redis_conn->fd, reply, strlen(reply), 0);
+    ABTS_INT_EQUAL(tc, strlen(reply), size);
+}
+
+static void s1setup_func(abts_case *tc, void *data)
+{
+    int rv;
+    ogs_socknode_t *s1ap;
+    ogs_pkbuf_t *sendbuf;
+    ogs_pkbuf_t *recvbuf;
+    ogs_s1ap_message_t message;
+
+    /* The MME connected to redis when it started */
+    redis_conn = ogs_sock_accept(redis_server);
+    ABTS_PTR_NOTNULL(tc, redis_conn);
+
+    s1ap = tests1ap_client(AF_INET);
+    ABTS_PTR_NOTNULL(tc, s1ap);
+
+    /* Send S1-Setup Reqeust */
+    sendbuf = test_s1ap_build_s1_setup_request(
+            S1AP_ENB_ID_PR_macroENB_ID, 0x54f64);
+    ABTS_PTR_NOTNULL(tc, sendbuf);
+    rv = testenb_s1ap_send(s1ap, sendbuf);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    /* Not answered before redis replies */
+    redis_command_read(tc);
+    redis_reply_ok(tc);
+
+    /* Receive S1-Setup Response */
+    recvbuf = testenb_s1ap_read(s1ap);
+    ABTS_PTR_NOTNULL(tc, recvbuf);
+
+    rv = ogs_s1ap_decode(&message, recvbuf);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ABTS_INT_EQUAL(tc, S1AP_S1AP_PDU_PR_successfulOutcome, message.present);
+
+    ogs_s1ap_free(&message);
+    ogs_pkbuf_free(recvbuf);
+
+    testenb_s1ap_close(s1ap);
+
+    ogs_msleep(300);
+}
+
+/*
+ * The eNB goes away while redis still owes the reply for its PDU, and a
+ * new association is added, most likely into the same eNB slot. When
+ * the reply comes, the parked PDU belongs to neither and must be dropped
+ * instead of being handled as if the new eNB had sent it.
+ */
+static void enb_removed_func(abts_case *tc, void *data)
+{
+    int rv;
+    ogs_socknode_t *s1ap;
+    ogs_pkbuf_t *sendbuf;
+    ogs_pkbuf_t *recvbuf;
+    ogs_s1ap_message_t message;
+    struct pollfd pfd;
+
+    s1ap = tests1ap_client(AF_INET);
+    ABTS_PTR_NOTNULL(tc, s1ap);
+
+    sendbuf = test_s1ap_build_s1_setup_request(
+            S1AP_ENB_ID_PR_macroENB_ID, 0x54f64);
+    ABTS_PTR_NOTNULL(tc, sendbuf);
+    rv = testenb_s1ap_send(s1ap, sendbuf);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    /* The PDU is now parked waiting for redis */
+    redis_command_read(tc);
+
+    testenb_s1ap_close(s1ap);
+    ogs_msleep(300);
+
+    s1ap = tests1ap_client(AF_INET);
+    ABTS_PTR_NOTNULL(tc, s1ap);
+    ogs_msleep(300);
+
+    /* Reply for the PDU of the removed eNB */
+    redis_reply_ok(tc);
+    ogs_msleep(300);
+
+    /* Nothing may have been sent to the new eNB */
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = s1ap->sock->fd;
+    pfd.events = POLLIN;
+    ABTS_INT_EQUAL(tc, 0, poll(&pfd, 1, 0));
+
+    /* The new eNB is served as usual */
+    sendbuf = test_s1ap_build_s1_setup_request(
+            S1AP_ENB_ID_PR_macroENB_ID, 0x54f64);
+    ABTS_PTR_NOTNULL(tc, sendbuf);
+    rv = testenb_s1ap_send(s1ap, sendbuf);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    redis_command_read(tc);
+    redis_reply_ok(tc);
+
+    recvbuf = testenb_s1ap_read(s1ap);
+    ABTS_PTR_NOTNULL(tc, recvbuf);
+
+    rv = ogs_s1ap_decode(&message, recvbuf);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ABTS_INT_EQUAL(tc, S1AP_S1AP_PDU_PR_successfulOutcome, message.present);
+
+    ogs_s1ap_free(&message);
+    ogs_pkbuf_free(recvbuf);
+
+    testenb_s1ap_close(s1ap);
+}
+
+abts_suite *test_redis_dup(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, s1setup_func, NULL);
+    abts_run_test(suite, enb_removed_func, NULL);
+
+    return suite;
+}
@@ -32,6 +32,7 @@ void ogs_sbi_message_final(void);
 abts_suite *test_s1ap_message(abts_suite *suite);
 abts_suite *test_nas_message(abts_suite *suite);
 abts_suite *test_gtp_message(abts_suite *suite);
+abts_suite *test_gtp_xact(abts_suite *suite);
 abts_suite *test_ngap_message(abts_suite *suite);
 abts_suite *test_sbi_message(abts_suite *suite);
 abts_suite *test_security(abts_suite *suite);
@@ -43,6 +44,7 @@ const struct testlist {
     {test_s1ap_message},
     {test_nas_message},
     {test_gtp_message},
+    {test_gtp_xact},
     {test_ngap_message},
     {test_sbi_message},
     {test_security},
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ogs-gtp.h"
+#include "ogs-app.h"
+#include "core/abts.h"
+
+static void gnode_init(ogs_gtp_node_t *gnode)
+{
+    memset(gnode, 0, sizeof(*gnode));
+
+    gnode->addr.ogs_sa_family = AF_INET;
+    gnode->addr.sin.sin_addr.s_addr = htobe32(INADDR_LOOPBACK);
+    gnode->addr.ogs_sin_port = htobe16(OGS_GTPV2_C_UDP_PORT);
+
+    ogs_list_init(&gnode->local_list);
+    ogs_list_init(&gnode->remote_list);
+}
+
+static ogs_gtp_xact_t *echo_request_create(ogs_gtp_node_t *gnode)
+{
+    ogs_gtp1_header_t h;
+    ogs_pkbuf_t *pkbuf = NULL;
+
+    memset(&h, 0, sizeof(h));
+    h.type = OGS_GTP1_ECHO_REQUEST_TYPE;
+
+    pkbuf = ogs_pkbuf_alloc(NULL, OGS_GTPV1C_HEADER_LEN);
+    ogs_assert(pkbuf);
+    ogs_pkbuf_reserve(pkbuf, OGS_GTPV1C_HEADER_LEN);
+
+    return ogs_gtp1_xact_local_create(gnode, &h, pkbuf, NULL, NULL);
+}
+
+/* Matches the Echo Response to a transaction and completes it */
+static ogs_gtp_xact_t *echo_response_receive(
+        ogs_gtp_node_t *gnode, uint32_t xid)
+{
+    ogs_gtp1_header_t h;
+    ogs_gtp_xact_t *xact = NULL;
+    int rv;
+
+    memset(&h, 0, sizeof(h));
+    h.version = 1;
+    h.type = OGS_GTP1_ECHO_RESPONSE_TYPE;
+    h.s = 1;
+    h.sqn = OGS_GTP1_XID_TO_SQN(xid);
+
+    rv = ogs_gtp1_xact_receive(gnode, &h, &xact);
+    if (rv != OGS_OK)
+        return NULL;
+
+    return xact;
+}
+
+/*
+ * Two live transactions share an XID on one peer once the XID space
+ * has wrapped around. The older one is matched first and, when it is
+ * gone, the younger one takes its place.
+ */
+static void gtp_xact_test1(abts_case *tc, void *data)
+{
+    ogs_gtp_node_t peer, other;
+    ogs_gtp_xact_t *old = NULL, *young = NULL, *xact = NULL;
+    ogs_gtp_xact_stats_t stats;
+    uint32_t xid;
+    int i;
+
+    gnode_init(&peer);
+    gnode_init(&other);
+
+    old = echo_request_create(&peer);
+    ABTS_PTR_NOTNULL(tc, old);
+
+    /* Wrap the GTPv1 XID space around on another peer */
+    for (i = OGS_GTP1_MIN_XACT_ID; i < OGS_GTP1_MAX_XACT_ID; i++) {
+        xact = echo_request_create(&other);
+        ogs_assert(xact);
+        ogs_gtp_xact_delete_all(&other);
+    }
+
+    young = echo_request_create(&peer);
+    ABTS_PTR_NOTNULL(tc, young);
+    ABTS_INT_EQUAL(tc, old->xid, young->xid);
+    xid = old->xid;
+
+    xact = echo_response_receive(&peer, xid);
+    ABTS_PTR_EQUAL(tc, old, xact);
+    ABTS_INT_EQUAL(tc, OGS_OK, ogs_gtp_xact_commit(xact));
+
+    xact = echo_response_receive(&peer, xid);
+    ABTS_PTR_EQUAL(tc, young, xact);
+    ABTS_INT_EQUAL(tc, OGS_OK, ogs_gtp_xact_commit(xact));
+
+    ogs_gtp_xact_get_stats(&stats);
+    ABTS_INT_EQUAL(tc, 0, stats.used);
+}
+
+abts_suite *test_gtp_xact(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    ogs_app()->pool.xact = 4;
+    ogs_app()->timer_mgr = ogs_timer_mgr_create(8);
+    ogs_assert(ogs_app()->timer_mgr);
+    ogs_gtp_xact_init();
+
+    abts_run_test(suite, gtp_xact_test1, NULL);
+
+    ogs_gtp_xact_final();
+    ogs_timer_mgr_destroy(ogs_app()->timer_mgr);
+    ogs_app()->timer_mgr = NULL;
+
+    return suite;
+}
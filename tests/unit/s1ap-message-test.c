@@ -1330,6 +1330,95 @@ static void s1ap_message_test10(abts_case *tc, void *data)
     ogs_pkbuf_free(s1apbuf);
 }
 
+/*
+ * Decodes the captured PDUs above into an arena and checks that they
+ * re-encode to the same bytes as a heap decode. The allocation count
+ * is what every plain ogs_s1ap_decode() costs in calls to ogs_calloc().
+ */
+static void s1ap_message_test11(abts_case *tc, void *data)
+{
+    static const struct {
+        const char *payload;
+        int len;
+    } sample[] = {
+        { "0011002d000004003b00090000f11040"
+          "54f64010003c400903004a4c542d3632"
+          "3100400007000c0e4000f11000894001"
+          "00", 49 },
+        { "000c406f000006000800020001001a00"
+          "3c3b17df675aa8050741020bf600f110"
+          "000201030003e605f070000010000502"
+          "15d011d15200f11030395c0a003103e5"
+          "e0349011035758a65d0100e0c1004300"
+          "060000f1103039006440080000f1108c"
+          "3378200086400130004b00070000f110"
+          "000201", 115 },
+        { "2009002500000300004005c0020000bf"
+          "0008400200010033400f000032400a0a"
+          "1f0a0123c601000908", 41 },
+        { "0025004a000001007900432036715489 0164f0000100010002548f0264f00000"
+          "010064f000400000002057974b81054c 84000000204f81005581014d860064f0"
+          "00000280094064f0000100010002", 78 },
+    };
+
+    ogs_s1ap_message_t message;
+    ogs_arena_t *arena = NULL, *tiny = NULL;
+    ogs_pkbuf_t *pkbuf;
+    asn_enc_rval_t heap, enc;
+    uint8_t heapbuf[256], encbuf[256];
+    char hexbuf[OGS_HUGE_LEN];
+    int i, result;
+
+    arena = ogs_arena_create(
+            OGS_ASN_ARENA_CHUNK_SIZE, OGS_ASN_ARENA_MAX_SIZE);
+    ABTS_PTR_NOTNULL(tc, arena);
+
+    /* Small enough that most IEs fall back to the heap */
+    tiny = ogs_arena_create(64, 128);
+    ABTS_PTR_NOTNULL(tc, tiny);
+
+    for (i = 0; i < OGS_ARRAY_SIZE(sample); i++) {
+        pkbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
+        ogs_assert(pkbuf);
+        ogs_pkbuf_put_data(pkbuf, ogs_hex_from_string(
+                    sample[i].payload, hexbuf, sizeof(hexbuf)),
+                sample[i].len);
+
+        result = ogs_s1ap_decode(&message, pkbuf);
+        ABTS_INT_EQUAL(tc, 0, result);
+        heap = aper_encode_to_buffer(&asn_DEF_S1AP_S1AP_PDU, NULL,
+                &message, heapbuf, sizeof(heapbuf));
+        ABTS_TRUE(tc, heap.encoded > 0);
+        ogs_s1ap_free(&message);
+
+        result = ogs_s1ap_decode_arena(&message, pkbuf, arena);
+        ABTS_INT_EQUAL(tc, 0, result);
+        ABTS_TRUE(tc, ogs_arena_num_of_alloc(arena) > 0);
+        ABTS_TRUE(tc, !ogs_arena_exhausted(arena));
+        ogs_debug("S1AP sample %d: %u allocations, %d bytes", i,
+                ogs_arena_num_of_alloc(arena), (int)ogs_arena_used(arena));
+        enc = aper_encode_to_buffer(&asn_DEF_S1AP_S1AP_PDU, NULL,
+                &message, encbuf, sizeof(encbuf));
+        ABTS_INT_EQUAL(tc, heap.encoded, enc.encoded);
+        ABTS_TRUE(tc, memcmp(heapbuf, encbuf, (heap.encoded + 7) >> 3) == 0);
+        ogs_s1ap_free_arena(&message, arena);
+        ABTS_INT_EQUAL(tc, 0, ogs_arena_num_of_alloc(arena));
+
+        result = ogs_s1ap_decode_arena(&message, pkbuf, tiny);
+        ABTS_INT_EQUAL(tc, 0, result);
+        enc = aper_encode_to_buffer(&asn_DEF_S1AP_S1AP_PDU, NULL,
+                &message, encbuf, sizeof(encbuf));
+        ABTS_INT_EQUAL(tc, heap.encoded, enc.encoded);
+        ABTS_TRUE(tc, memcmp(heapbuf, encbuf, (heap.encoded + 7) >> 3) == 0);
+        ogs_s1ap_free_arena(&message, tiny);
+
+        ogs_pkbuf_free(pkbuf);
+    }
+
+    ogs_arena_destroy(tiny);
+    ogs_arena_destroy(arena);
+}
+
 abts_suite *test_s1ap_message(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -1346,6 +1435,7 @@ abts_suite *test_s1ap_message(abts_suite *suite)
     abts_run_test(suite, s1ap_message_test8, NULL);
     abts_run_test(suite, s1ap_message_test9, NULL);
     abts_run_test(suite, s1ap_message_test10, NULL);
+    abts_run_test(suite, s1ap_message_test11, NULL);
 
     return suite;
 }
@@ -398,6 +398,155 @@ static void security_test9(abts_case *tc, void *data)
     ogs_pkbuf_free(pkbuf);
 }
 
+static void security_test10(abts_case *tc, void *data)
+{
+    const char *_ik = "d3c5d592 327fb11c 4035c668 0af8c6d1";
+    const char *_message = "484583d5 afe082ae";
+    const char *_mact = "b93787e6";
+    const char *_ck = "2bd6459f 82c440e0 952c4910 4805ff48";
+    const char *_plain = 
+        "7ec61272 743bf161 4726446a 6c38ced1 66f6ca76 eb543004 4286346c ef130f92"
+        "922b0345 0d3a9975 e5bd2ea0 eb55ad8e 1b199e3e c4316020 e9a1b285 e7627953" 
+        "59b7bdfd 39bef4b2 484583d5 afe082ae e638bf5f d5a60619 3901a08f 4ab41aab" 
+        "9b134880";
+    const char *_cipher = 
+        "59616053 53c64bdc a15b195e 288553a9 10632506 d6200aa7 90c4c806 c99904cf"
+        "2445cc50 bb1cf168 a4967373 4e081b57 e324ce52 59c0e78d 4cd97b87 0976503c"
+        "0943f2cb 5ae8f052 c7b7d392 239587b8 956086bc ab188360 42e2e6ce 42432a17"
+        "105c53d3";
+    ogs_nas_security_key_t key;
+    uint8_t message[8];
+    uint8_t plain[SECURITY_TEST7_LEN];
+    uint8_t tmp[SECURITY_TEST7_LEN];
+    uint8_t mac[4];
+    ogs_pkbuf_t *pkbuf = NULL;
+    int hw;
+
+    /* The cached schedules give the same results as the software tables */
+    for (hw = 0; hw < 2; hw++) {
+        ogs_aes_hw_enable(hw);
+
+        memset(&key, 0, sizeof(key));
+        ogs_hex_from_string(_ik, key.knas_int, sizeof(key.knas_int));
+        ogs_hex_from_string(_ck, key.knas_enc, sizeof(key.knas_enc));
+        ogs_nas_security_key_expand(&key);
+        ABTS_INT_EQUAL(tc, hw && ogs_aes_hw_available(), key.eea2.hw);
+
+        pkbuf = ogs_pkbuf_alloc(NULL, OGS_NAS_HEADROOM+sizeof(message));
+        ogs_assert(pkbuf);
+        ogs_pkbuf_reserve(pkbuf, OGS_NAS_HEADROOM);
+        ogs_pkbuf_put_data(pkbuf,
+                ogs_hex_from_string(_message, message, sizeof(message)),
+                sizeof(message));
+
+        ogs_nas_mac_calculate_key(OGS_NAS_SECURITY_ALGORITHMS_128_EIA2,
+                &key, 0x398a59b4, 0x1a, 1, pkbuf, mac);
+        ABTS_TRUE(tc, memcmp(mac,
+                    ogs_hex_from_string(_mact, tmp, sizeof(mac)), 4) == 0);
+        ogs_pkbuf_free(pkbuf);
+
+        pkbuf = ogs_pkbuf_alloc(NULL, OGS_NAS_HEADROOM+SECURITY_TEST7_LEN);
+        ogs_assert(pkbuf);
+        ogs_pkbuf_reserve(pkbuf, OGS_NAS_HEADROOM);
+        ogs_pkbuf_put_data(pkbuf,
+                ogs_hex_from_string(_plain, plain, sizeof(plain)),
+                SECURITY_TEST7_LEN);
+
+        ogs_nas_encrypt_key(OGS_NAS_SECURITY_ALGORITHMS_128_EEA2,
+                &key, 0xc675a64b, 0x0c, 1, pkbuf);
+        ABTS_TRUE(tc, memcmp(pkbuf->data,
+                    ogs_hex_from_string(_cipher, tmp, sizeof(tmp)),
+                    SECURITY_TEST7_LEN) == 0);
+        ogs_pkbuf_free(pkbuf);
+    }
+
+    ogs_aes_hw_enable(true);
+}
+
+/*
+ * Messages per second for each algorithm on a NAS-sized message, with
+ * the keys expanded once as the MME does. Run `unit -e info security-test`
+ * to see the report.
+ */
+#define SECURITY_BENCH_LEN      64
+#define SECURITY_BENCH_COUNT    20000
+
+static double security_bench_run(int mac, uint8_t algorithm_identity,
+        ogs_nas_security_key_t *key, ogs_pkbuf_t *pkbuf)
+{
+    ogs_time_t start;
+    uint8_t digest[4];
+    int i;
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < SECURITY_BENCH_COUNT; i++) {
+        if (mac)
+            ogs_nas_mac_calculate_key(algorithm_identity,
+                    key, i, 0, 1, pkbuf, digest);
+        else
+            ogs_nas_encrypt_key(algorithm_identity,
+                    key, i, 0, 1, pkbuf);
+    }
+
+    return SECURITY_BENCH_COUNT * 1000000.0 /
+        ogs_max(ogs_get_monotonic_time() - start, 1);
+}
+
+static void security_bench(abts_case *tc, void *data)
+{
+    static const struct {
+        const char *name;
+        int mac;
+        uint8_t algorithm_identity;
+    } algorithm[] = {
+        { "128-EIA1", 1, OGS_NAS_SECURITY_ALGORITHMS_128_EIA1 },
+        { "128-EIA2", 1, OGS_NAS_SECURITY_ALGORITHMS_128_EIA2 },
+        { "128-EIA3", 1, OGS_NAS_SECURITY_ALGORITHMS_128_EIA3 },
+        { "128-EEA1", 0, OGS_NAS_SECURITY_ALGORITHMS_128_EEA1 },
+        { "128-EEA2", 0, OGS_NAS_SECURITY_ALGORITHMS_128_EEA2 },
+        { "128-EEA3", 0, OGS_NAS_SECURITY_ALGORITHMS_128_EEA3 },
+    };
+    ogs_nas_security_key_t key;
+    ogs_pkbuf_t *pkbuf = NULL;
+    uint8_t message[SECURITY_BENCH_LEN];
+    double rate, sw;
+    int i;
+
+    memset(&key, 0, sizeof(key));
+    ogs_random(key.knas_int, sizeof(key.knas_int));
+    ogs_random(key.knas_enc, sizeof(key.knas_enc));
+    ogs_random(message, sizeof(message));
+
+    pkbuf = ogs_pkbuf_alloc(NULL, OGS_NAS_HEADROOM+SECURITY_BENCH_LEN);
+    ogs_assert(pkbuf);
+    ogs_pkbuf_reserve(pkbuf, OGS_NAS_HEADROOM);
+    ogs_pkbuf_put_data(pkbuf, message, sizeof(message));
+
+    for (i = 0; i < OGS_ARRAY_SIZE(algorithm); i++) {
+        ogs_aes_hw_enable(false);
+        ogs_nas_security_key_expand(&key);
+        sw = security_bench_run(algorithm[i].mac,
+                algorithm[i].algorithm_identity, &key, pkbuf);
+
+        ogs_aes_hw_enable(true);
+        ogs_nas_security_key_expand(&key);
+        rate = security_bench_run(algorithm[i].mac,
+                algorithm[i].algorithm_identity, &key, pkbuf);
+
+        ABTS_TRUE(tc, rate > 0);
+        if (key.eea2.hw && (algorithm[i].algorithm_identity ==
+                    OGS_NAS_SECURITY_ALGORITHMS_128_EIA2 ||
+                algorithm[i].algorithm_identity ==
+                    OGS_NAS_SECURITY_ALGORITHMS_128_EEA2))
+            ogs_info("%s %10.0f msg/s (AES-NI, %.0f msg/s software)",
+                    algorithm[i].name, rate, sw);
+        else
+            ogs_info("%s %10.0f msg/s", algorithm[i].name, rate);
+    }
+
+    ogs_pkbuf_free(pkbuf);
+}
+
 abts_suite *test_security(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -411,6 +560,8 @@ abts_suite *test_security(abts_suite *suite)
     abts_run_test(suite, security_test7, NULL);
     abts_run_test(suite, security_test8, NULL);
     abts_run_test(suite, security_test9, NULL);
+    abts_run_test(suite, security_test10, NULL);
+    abts_run_test(suite, security_bench, NULL);
 
     return suite;
 }